@@ -20,6 +20,8 @@
 
 #include <sys/types.h>
 
+#include <zlib.h>
+
 #if defined(CONF_WEBSOCKETS)
 #include <engine/shared/websockets.h>
 #endif
@@ -27,6 +29,7 @@
 #if defined(CONF_FAMILY_UNIX)
 #include <csignal>
 #include <locale>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/utsname.h>
@@ -110,6 +113,20 @@ void net_buffer_init(NETSOCKET_BUFFER *buffer);
 void net_buffer_reinit(NETSOCKET_BUFFER *buffer);
 void net_buffer_simple(NETSOCKET_BUFFER *buffer, char **buf, int *size);
 
+#ifdef CONF_PLATFORM_LINUX
+// packets queued by net_udp_send while send batching is enabled
+typedef struct
+{
+	int count;
+	struct mmsghdr msgs[VLEN];
+	struct iovec iovecs[VLEN];
+	char bufs[VLEN][PACKETSIZE];
+	struct sockaddr_storage sockaddrs[VLEN];
+} NETSOCKET_SEND_QUEUE;
+
+static std::atomic_bool sendmmsg_unsupported = false;
+#endif
+
 struct NETSOCKET_INTERNAL
 {
 	int type;
@@ -118,6 +135,10 @@ struct NETSOCKET_INTERNAL
 	int web_ipv4sock;
 
 	NETSOCKET_BUFFER buffer;
+#ifdef CONF_PLATFORM_LINUX
+	NETSOCKET_SEND_QUEUE *ipv4_send_queue;
+	NETSOCKET_SEND_QUEUE *ipv6_send_queue;
+#endif
 };
 static NETSOCKET_INTERNAL invalid_socket = {NETTYPE_INVALID, -1, -1, -1};
 
@@ -440,6 +461,38 @@ int io_error(IOHANDLE io)
 	return ferror((FILE *)io);
 }
 
+void *io_map(IOHANDLE io, int64_t size)
+{
+	if(size <= 0)
+	{
+		return nullptr;
+	}
+#if defined(CONF_FAMILY_WINDOWS)
+	HANDLE mapping = CreateFileMappingW((HANDLE)_get_osfhandle(_fileno((FILE *)io)), nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	if(mapping == nullptr)
+	{
+		return nullptr;
+	}
+	// the view keeps the mapping object alive
+	void *data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, size);
+	CloseHandle(mapping);
+	return data;
+#else
+	void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno((FILE *)io), 0);
+	return data == MAP_FAILED ? nullptr : data;
+#endif
+}
+
+void io_unmap(void *data, int64_t size)
+{
+#if defined(CONF_FAMILY_WINDOWS)
+	(void)size;
+	UnmapViewOfFile(data);
+#else
+	munmap(data, size);
+#endif
+}
+
 IOHANDLE io_stdin()
 {
 	return stdin;
@@ -507,6 +560,12 @@ struct ASYNCIO
 	unsigned int read_pos;
 	unsigned int write_pos;
 
+	// gzip stream the data is compressed with, nullptr if uncompressed,
+	// only accessed by the writer thread
+	z_stream *zstream;
+	unsigned char *zbuffer;
+	std::chrono::nanoseconds zflush_time;
+
 	int error;
 	unsigned char finish;
 	unsigned char refcount;
@@ -553,12 +612,37 @@ static void aio_handle_free_and_unlock(ASYNCIO *aio) RELEASE(aio->lock)
 	aio->lock.unlock();
 	if(do_free)
 	{
+		if(aio->zstream)
+		{
+			deflateEnd(aio->zstream);
+			delete aio->zstream;
+			free(aio->zbuffer);
+		}
 		free(aio->buffer);
 		sphore_destroy(&aio->sphore);
 		delete aio;
 	}
 }
 
+// Compresses the data and writes the output to the file, returns 0 on success.
+static int aio_deflate(ASYNCIO *aio, const unsigned char *data, unsigned int size, int flush)
+{
+	z_stream *zstream = aio->zstream;
+	zstream->next_in = (Bytef *)data;
+	zstream->avail_in = size;
+	do
+	{
+		zstream->next_out = aio->zbuffer;
+		zstream->avail_out = ASYNC_LOCAL_BUFSIZE;
+		if(deflate(zstream, flush) == Z_STREAM_ERROR)
+		{
+			return 1;
+		}
+		io_write(aio->io, aio->zbuffer, ASYNC_LOCAL_BUFSIZE - zstream->avail_out);
+	} while(zstream->avail_out == 0);
+	return 0;
+}
+
 static void aio_thread(void *user)
 {
 	ASYNCIO *aio = (ASYNCIO *)user;
@@ -575,6 +659,13 @@ static void aio_thread(void *user)
 		{
 			if(aio->finish != ASYNCIO_RUNNING)
 			{
+				if(aio->zstream)
+				{
+					// terminate the gzip stream even if the caller closes the file
+					int result_deflate_error = aio_deflate(aio, nullptr, 0, Z_FINISH);
+					io_flush(aio->io);
+					aio->error = result_deflate_error ? result_deflate_error : io_error(aio->io);
+				}
 				if(aio->finish == ASYNCIO_CLOSE)
 				{
 					io_close(aio->io);
@@ -610,16 +701,40 @@ static void aio_thread(void *user)
 		aio->read_pos = (aio->read_pos + buffers.len1 + buffers.len2) % aio->buffer_size;
 		aio->lock.unlock();
 
-		io_write(aio->io, local_buffer, local_buffer_len);
-		io_flush(aio->io);
-		result_io_error = io_error(aio->io);
+		if(aio->zstream)
+		{
+			// Flushing the compressor costs compression ratio, so only
+			// make the data readable from the file about once per second.
+			int flush = Z_NO_FLUSH;
+			const std::chrono::nanoseconds now = time_get_nanoseconds();
+			if(now - aio->zflush_time >= std::chrono::seconds(1))
+			{
+				flush = Z_SYNC_FLUSH;
+				aio->zflush_time = now;
+			}
+			result_io_error = aio_deflate(aio, local_buffer, local_buffer_len, flush);
+			if(flush != Z_NO_FLUSH)
+			{
+				io_flush(aio->io);
+			}
+		}
+		else
+		{
+			io_write(aio->io, local_buffer, local_buffer_len);
+			io_flush(aio->io);
+			result_io_error = 0;
+		}
+		if(!result_io_error)
+		{
+			result_io_error = io_error(aio->io);
+		}
 
 		aio->lock.lock();
 		aio->error = result_io_error;
 	}
 }
 
-ASYNCIO *aio_new(IOHANDLE io)
+static ASYNCIO *aio_new_impl(IOHANDLE io, z_stream *zstream)
 {
 	ASYNCIO *aio = new ASYNCIO;
 	if(!aio)
@@ -631,8 +746,13 @@ ASYNCIO *aio_new(IOHANDLE io)
 	aio->thread = nullptr;
 
 	aio->buffer = (unsigned char *)malloc(ASYNC_BUFSIZE);
-	if(!aio->buffer)
+	aio->zstream = zstream;
+	aio->zbuffer = zstream ? (unsigned char *)malloc(ASYNC_LOCAL_BUFSIZE) : nullptr;
+	aio->zflush_time = time_get_nanoseconds();
+	if(!aio->buffer || (zstream && !aio->zbuffer))
 	{
+		free(aio->buffer);
+		free(aio->zbuffer);
 		sphore_destroy(&aio->sphore);
 		delete aio;
 		return nullptr;
@@ -648,6 +768,7 @@ ASYNCIO *aio_new(IOHANDLE io)
 	if(!aio->thread)
 	{
 		free(aio->buffer);
+		free(aio->zbuffer);
 		sphore_destroy(&aio->sphore);
 		delete aio;
 		return nullptr;
@@ -655,6 +776,30 @@ ASYNCIO *aio_new(IOHANDLE io)
 	return aio;
 }
 
+ASYNCIO *aio_new(IOHANDLE io)
+{
+	return aio_new_impl(io, nullptr);
+}
+
+ASYNCIO *aio_new_compressed(IOHANDLE io, int level)
+{
+	z_stream *zstream = new z_stream;
+	mem_zero(zstream, sizeof(*zstream));
+	// 15 window bits plus 16 to write a gzip header and trailer
+	if(deflateInit2(zstream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		delete zstream;
+		return nullptr;
+	}
+	ASYNCIO *aio = aio_new_impl(io, zstream);
+	if(!aio)
+	{
+		deflateEnd(zstream);
+		delete zstream;
+	}
+	return aio;
+}
+
 static unsigned int buffer_len(ASYNCIO *aio)
 {
 	if(aio->write_pos >= aio->read_pos)
@@ -1470,6 +1615,9 @@ static void priv_net_close_socket(int sock)
 
 static int priv_net_close_all_sockets(NETSOCKET sock)
 {
+	/* send what is still queued */
+	net_udp_set_send_batching(sock, false);
+
 	/* close down ipv4 */
 	if(sock->ipv4sock >= 0)
 	{
@@ -1674,10 +1822,123 @@ NETSOCKET net_udp_create(NETADDR bindaddr)
 	return sock;
 }
 
+#if defined(CONF_PLATFORM_LINUX)
+static NETSOCKET_SEND_QUEUE *priv_net_send_queue_create()
+{
+	NETSOCKET_SEND_QUEUE *queue = (NETSOCKET_SEND_QUEUE *)malloc(sizeof(*queue));
+	mem_zero(queue, sizeof(*queue));
+	for(int i = 0; i < VLEN; ++i)
+	{
+		queue->iovecs[i].iov_base = queue->bufs[i];
+		queue->msgs[i].msg_hdr.msg_iov = &(queue->iovecs[i]);
+		queue->msgs[i].msg_hdr.msg_iovlen = 1;
+		queue->msgs[i].msg_hdr.msg_name = &(queue->sockaddrs[i]);
+	}
+	return queue;
+}
+
+static void priv_net_send_queue_flush(int socket, NETSOCKET_SEND_QUEUE *queue)
+{
+	int pos = 0;
+	while(pos < queue->count)
+	{
+		int sent = -1;
+		if(!sendmmsg_unsupported)
+		{
+			sent = sendmmsg(socket, queue->msgs + pos, queue->count - pos, 0);
+			network_stats.send_syscalls++;
+			if(sent < 0 && errno == ENOSYS)
+				sendmmsg_unsupported = true;
+		}
+		if(sent > 0)
+		{
+			pos += sent;
+			continue;
+		}
+
+		// the first packet failed or sendmmsg is not available, send it on
+		// its own so that errors only lose that packet like they would with sendto
+		const struct msghdr *hdr = &queue->msgs[pos].msg_hdr;
+		sendto(socket, hdr->msg_iov->iov_base, hdr->msg_iov->iov_len, 0, (const struct sockaddr *)hdr->msg_name, hdr->msg_namelen);
+		network_stats.send_syscalls++;
+		pos++;
+	}
+	queue->count = 0;
+}
+
+static void priv_net_send_queue_add(int socket, NETSOCKET_SEND_QUEUE *queue, const void *sa, socklen_t sa_size, const void *data, int size)
+{
+	if(queue->count == VLEN)
+		priv_net_send_queue_flush(socket, queue);
+	const int i = queue->count++;
+	mem_copy(queue->bufs[i], data, size);
+	queue->iovecs[i].iov_len = size;
+	mem_copy(&queue->sockaddrs[i], sa, sa_size);
+	queue->msgs[i].msg_hdr.msg_namelen = sa_size;
+}
+#endif
+
+void net_udp_set_send_batching(NETSOCKET sock, bool enable)
+{
+#if defined(CONF_PLATFORM_LINUX)
+	if(enable)
+	{
+		if(sock->ipv4sock >= 0 && !sock->ipv4_send_queue)
+			sock->ipv4_send_queue = priv_net_send_queue_create();
+		if(sock->ipv6sock >= 0 && !sock->ipv6_send_queue)
+			sock->ipv6_send_queue = priv_net_send_queue_create();
+	}
+	else
+	{
+		net_udp_flush(sock);
+		free(sock->ipv4_send_queue);
+		sock->ipv4_send_queue = nullptr;
+		free(sock->ipv6_send_queue);
+		sock->ipv6_send_queue = nullptr;
+	}
+#endif
+}
+
+void net_udp_flush(NETSOCKET sock)
+{
+#if defined(CONF_PLATFORM_LINUX)
+	if(sock->ipv4_send_queue)
+		priv_net_send_queue_flush(sock->ipv4sock, sock->ipv4_send_queue);
+	if(sock->ipv6_send_queue)
+		priv_net_send_queue_flush(sock->ipv6sock, sock->ipv6_send_queue);
+#endif
+}
+
 int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size)
 {
 	int d = -1;
 
+#if defined(CONF_PLATFORM_LINUX)
+	// queue plain unicast packets if batching is enabled
+	if(size <= PACKETSIZE && !sendmmsg_unsupported)
+	{
+		const int type = addr->type & (NETTYPE_ALL | NETTYPE_LINK_BROADCAST);
+		if(type == NETTYPE_IPV4 && sock->ipv4_send_queue)
+		{
+			struct sockaddr_in sa;
+			netaddr_to_sockaddr_in(addr, &sa);
+			priv_net_send_queue_add(sock->ipv4sock, sock->ipv4_send_queue, &sa, sizeof(sa), data, size);
+			network_stats.sent_bytes += size;
+			network_stats.sent_packets++;
+			return size;
+		}
+		if(type == NETTYPE_IPV6 && sock->ipv6_send_queue)
+		{
+			struct sockaddr_in6 sa;
+			netaddr_to_sockaddr_in6(addr, &sa);
+			priv_net_send_queue_add(sock->ipv6sock, sock->ipv6_send_queue, &sa, sizeof(sa), data, size);
+			network_stats.sent_bytes += size;
+			network_stats.sent_packets++;
+			return size;
+		}
+	}
+#endif
+
 	if(addr->type & NETTYPE_IPV4)
 	{
 		if(sock->ipv4sock >= 0)
@@ -1694,6 +1955,7 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 				netaddr_to_sockaddr_in(addr, &sa);
 
 			d = sendto((int)sock->ipv4sock, (const char *)data, size, 0, (struct sockaddr *)&sa, sizeof(sa));
+			network_stats.send_syscalls++;
 		}
 		else
 		{
@@ -1734,6 +1996,7 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 				netaddr_to_sockaddr_in6(addr, &sa);
 
 			d = sendto((int)sock->ipv6sock, (const char *)data, size, 0, (struct sockaddr *)&sa, sizeof(sa));
+			network_stats.send_syscalls++;
 		}
 		else
 			log_error("net", "Cannot send IPv6 traffic to this socket");
@@ -1797,6 +2060,7 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data)
 		{
 			net_buffer_reinit(&sock->buffer);
 			sock->buffer.size = recvmmsg(sock->ipv4sock, sock->buffer.msgs, VLEN, 0, NULL);
+			network_stats.recv_syscalls++;
 			sock->buffer.pos = 0;
 		}
 	}
@@ -1807,6 +2071,7 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data)
 		{
 			net_buffer_reinit(&sock->buffer);
 			sock->buffer.size = recvmmsg(sock->ipv6sock, sock->buffer.msgs, VLEN, 0, NULL);
+			network_stats.recv_syscalls++;
 			sock->buffer.pos = 0;
 		}
 	}
@@ -1826,6 +2091,7 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data)
 	{
 		socklen_t fromlen = sizeof(struct sockaddr_in);
 		bytes = recvfrom(sock->ipv4sock, sock->buffer.buf, sizeof(sock->buffer.buf), 0, (struct sockaddr *)&sockaddrbuf, &fromlen);
+		network_stats.recv_syscalls++;
 		*data = (unsigned char *)sock->buffer.buf;
 	}
 
@@ -1833,6 +2099,7 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data)
 	{
 		socklen_t fromlen = sizeof(struct sockaddr_in6);
 		bytes = recvfrom(sock->ipv6sock, sock->buffer.buf, sizeof(sock->buffer.buf), 0, (struct sockaddr *)&sockaddrbuf, &fromlen);
+		network_stats.recv_syscalls++;
 		*data = (unsigned char *)sock->buffer.buf;
 	}
 #endif
@@ -458,6 +458,32 @@ int io_sync(IOHANDLE io);
  */
 int io_error(IOHANDLE io);
 
+/**
+ * Maps the start of a file into memory.
+ *
+ * @ingroup File-IO
+ *
+ * @param io Handle to the file.
+ * @param size Number of bytes to map, must be at least `1` and at most the size of the file.
+ *
+ * @return Pointer to the mapped file content, or `nullptr` on failure.
+ *
+ * @remark The memory is writable, but changes are private to the process and not written to the file.
+ * @remark The mapping stays valid after the file is closed and must be released with @link io_unmap @endlink.
+ * @remark Accessing the memory after the file has been truncated by another writer may crash the process.
+ */
+void *io_map(IOHANDLE io, int64_t size);
+
+/**
+ * Releases memory mapped by @link io_map @endlink.
+ *
+ * @ingroup File-IO
+ *
+ * @param data Pointer returned by @link io_map @endlink.
+ * @param size Size that was passed to @link io_map @endlink.
+ */
+void io_unmap(void *data, int64_t size);
+
 /**
  * Returns a handle for the standard input.
  *
@@ -518,6 +544,26 @@ typedef struct ASYNCIO ASYNCIO;
  */
 ASYNCIO *aio_new(IOHANDLE io);
 
+/**
+ * Wraps a @link IOHANDLE @endlink for asynchronous writing of a gzip
+ * compressed stream.
+ *
+ * @ingroup File-IO
+ *
+ * @param io Handle to the file.
+ * @param level zlib compression level, 1 - 9.
+ *
+ * @return The handle for asynchronous writing.
+ *
+ * @remark The data is compressed by the writer thread, writing to the
+ * handle costs the same as for @link aio_new @endlink.
+ * @remark The compressor is flushed to the file about once per second,
+ * so a crash loses at most the last second of data.
+ * @remark The gzip stream is terminated by @link aio_close @endlink or
+ * @link aio_wait @endlink.
+ */
+ASYNCIO *aio_new_compressed(IOHANDLE io, int level);
+
 /**
  * Locks the `ASYNCIO` structure so it can't be written into by
  * other threads.
@@ -1038,6 +1084,33 @@ NETSOCKET net_udp_create(NETADDR bindaddr);
  */
 int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size);
 
+/**
+ * Enables or disables batching of sent packets on an UDP socket.
+ *
+ * @ingroup Network-UDP
+ *
+ * @param sock Socket to use.
+ * @param enable Whether to batch sent packets.
+ *
+ * @remark While enabled, unicast packets passed to @link net_udp_send @endlink are queued
+ *         and sent with a single system call by @link net_udp_flush @endlink. Disabling
+ *         flushes the queue.
+ * @remark Only has an effect on platforms with `sendmmsg`, elsewhere packets are always sent immediately.
+ * @remark The queue is not thread-safe.
+ */
+void net_udp_set_send_batching(NETSOCKET sock, bool enable);
+
+/**
+ * Sends all packets queued on an UDP socket.
+ *
+ * @ingroup Network-UDP
+ *
+ * @param sock Socket to use.
+ *
+ * @see net_udp_set_send_batching
+ */
+void net_udp_flush(NETSOCKET sock);
+
 /**
  * Receives a packet over an UDP socket.
  *
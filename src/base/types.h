@@ -83,6 +83,8 @@ typedef struct NETSTATS
 	uint64_t sent_bytes;
 	uint64_t recv_packets;
 	uint64_t recv_bytes;
+	uint64_t send_syscalls;
+	uint64_t recv_syscalls;
 } NETSTATS;
 
 #endif // BASE_TYPES_H
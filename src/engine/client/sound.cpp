@@ -5,11 +5,14 @@
 #include <base/math.h>
 #include <base/system.h>
 
+#include <engine/engine.h>
 #include <engine/graphics.h>
 #include <engine/shared/config.h>
+#include <engine/shared/jobs.h>
 #include <engine/storage.h>
 
 #include "sound.h"
+#include "sound_mix.h"
 
 #if defined(CONF_VIDEORECORDER)
 #include <engine/shared/video.h>
@@ -24,6 +27,253 @@ extern "C" {
 static constexpr int SAMPLE_INDEX_USED = -2;
 static constexpr int SAMPLE_INDEX_FULL = -1;
 
+// Decodes an Opus file in chunks ahead of the voices playing it. The mixer
+// only mixes chunks that are already decoded and requests the chunk it is
+// in and the next one, a job on the engine's job pool decodes them.
+class CSampleStream
+{
+	enum
+	{
+		CHUNK_FRAMES = 8192,
+		NUM_CHUNKS = 8,
+		// the chunks voices need, two per voice playing the sample
+		NUM_REQUESTS = NUM_CHUNKS / 2,
+	};
+
+	struct CChunk
+	{
+		int m_Index = -1;
+		unsigned m_LastUse = 0;
+		short *m_pData = nullptr;
+	};
+
+	struct CRequest
+	{
+		int m_Index = -1;
+		unsigned m_LastUse = 0;
+	};
+
+	// only used while decoding, by one job at a time
+	unsigned char *m_pFileData;
+	OggOpusFile *m_pOpusFile = nullptr;
+	// frame at which op_read continues without seeking
+	int m_DecodeFrame = 0;
+
+	const int m_NumFrames;
+	const int m_Channels;
+
+	CLock m_Lock;
+	CChunk m_aChunks[NUM_CHUNKS] GUARDED_BY(m_Lock);
+	CRequest m_aRequests[NUM_REQUESTS] GUARDED_BY(m_Lock);
+	unsigned m_UseCounter GUARDED_BY(m_Lock) = 0;
+	bool m_DecodeQueued GUARDED_BY(m_Lock) = false;
+
+	int NumChunkIndices() const { return (m_NumFrames + CHUNK_FRAMES - 1) / CHUNK_FRAMES; }
+
+	CChunk *FindChunk(int Index) REQUIRES(m_Lock)
+	{
+		for(auto &Chunk : m_aChunks)
+			if(Chunk.m_Index == Index)
+				return &Chunk;
+		return nullptr;
+	}
+
+	void Request(int Index) REQUIRES(m_Lock)
+	{
+		CRequest *pRequest = nullptr;
+		for(auto &Request : m_aRequests)
+		{
+			if(Request.m_Index == Index)
+			{
+				pRequest = &Request;
+				break;
+			}
+			if(!pRequest || Request.m_LastUse < pRequest->m_LastUse)
+				pRequest = &Request;
+		}
+		pRequest->m_Index = Index;
+		pRequest->m_LastUse = ++m_UseCounter;
+	}
+
+	// Returns a requested chunk that isn't decoded yet, or -1.
+	int MissingIndex() REQUIRES(m_Lock)
+	{
+		for(const auto &Request : m_aRequests)
+			if(Request.m_Index != -1 && !FindChunk(Request.m_Index))
+				return Request.m_Index;
+		return -1;
+	}
+
+	bool IsRequested(int Index) REQUIRES(m_Lock)
+	{
+		for(const auto &Request : m_aRequests)
+			if(Request.m_Index == Index)
+				return true;
+		return false;
+	}
+
+	bool DecodeChunk(short *pData, int Index)
+	{
+		const int Start = Index * CHUNK_FRAMES;
+		const int NumFrames = minimum<int>(CHUNK_FRAMES, m_NumFrames - Start);
+		if(m_DecodeFrame != Start)
+		{
+			const int Result = op_pcm_seek(m_pOpusFile, Start);
+			if(Result < 0)
+			{
+				dbg_msg("sound/opus", "op_pcm_seek error %d at %d", Result, Start);
+				return false;
+			}
+			m_DecodeFrame = Start;
+		}
+
+		int Pos = 0;
+		while(Pos < NumFrames)
+		{
+			const int Read = op_read(m_pOpusFile, pData + Pos * m_Channels, (NumFrames - Pos) * m_Channels, nullptr);
+			if(Read < 0)
+			{
+				// position of the decoder is unknown now
+				m_DecodeFrame = -1;
+				dbg_msg("sound/opus", "op_read error %d at %d", Read, Start + Pos);
+				return false;
+			}
+			else if(Read == 0) // EOF
+				break;
+			Pos += Read;
+		}
+		m_DecodeFrame = Start + Pos;
+		// shorter than the header said, play silence for the rest
+		mem_zero(pData + Pos * m_Channels, (size_t)(CHUNK_FRAMES - Pos) * m_Channels * sizeof(short));
+		return true;
+	}
+
+public:
+	CSampleStream(const void *pData, unsigned DataSize, int NumFrames, int Channels) :
+		m_NumFrames(NumFrames), m_Channels(Channels)
+	{
+		m_pFileData = (unsigned char *)malloc(DataSize);
+		mem_copy(m_pFileData, pData, DataSize);
+		int OpusError = 0;
+		m_pOpusFile = op_open_memory(m_pFileData, DataSize, &OpusError);
+		const CLockScope LockScope(m_Lock);
+		for(auto &Chunk : m_aChunks)
+			Chunk.m_pData = (short *)malloc((size_t)CHUNK_FRAMES * Channels * sizeof(short));
+		// sounds mostly start at the beginning, have it ready right away
+		if(m_pOpusFile && DecodeChunk(m_aChunks[0].m_pData, 0))
+			m_aChunks[0].m_Index = 0;
+	}
+
+	~CSampleStream()
+	{
+		if(m_pOpusFile)
+			op_free(m_pOpusFile);
+		free(m_pFileData);
+		const CLockScope LockScope(m_Lock);
+		for(auto &Chunk : m_aChunks)
+			free(Chunk.m_pData);
+	}
+
+	bool IsValid() const { return m_pOpusFile != nullptr; }
+
+	// Mixes the decoded frames of a voice and requests the chunks it needs
+	// next. Frames that aren't decoded yet stay silent.
+	void Mix(int *pMixBuffer, int Frame, int NumFrames, int VolumeL, int VolumeR) REQUIRES(!m_Lock)
+	{
+		dbg_assert(Frame >= 0 && Frame + NumFrames <= m_NumFrames, "frames out of range");
+		const CLockScope LockScope(m_Lock);
+		const int LastIndex = (Frame + NumFrames - 1) / CHUNK_FRAMES;
+		for(int Index = Frame / CHUNK_FRAMES; Index <= LastIndex; Index++)
+		{
+			const int Start = maximum(Frame, Index * CHUNK_FRAMES);
+			const int End = minimum(Frame + NumFrames, (Index + 1) * CHUNK_FRAMES);
+			Request(Index);
+			if(CChunk *pChunk = FindChunk(Index))
+			{
+				pChunk->m_LastUse = ++m_UseCounter;
+				SoundMixFrames(pMixBuffer + 2 * (Start - Frame), pChunk->m_pData + (Start - Index * CHUNK_FRAMES) * m_Channels, m_Channels, End - Start, VolumeL, VolumeR);
+			}
+		}
+		// looping voices continue at the first chunk
+		Request((LastIndex + 1) % NumChunkIndices());
+	}
+
+	// Requests the chunk of a voice that starts playing.
+	void Start(int Frame) REQUIRES(!m_Lock)
+	{
+		const CLockScope LockScope(m_Lock);
+		if(Frame < m_NumFrames)
+			Request(Frame / CHUNK_FRAMES);
+	}
+
+	// Returns true if requested chunks are missing and no decode job is
+	// queued, the caller must queue one then.
+	bool NeedsDecodeJob() REQUIRES(!m_Lock)
+	{
+		const CLockScope LockScope(m_Lock);
+		if(m_DecodeQueued || MissingIndex() == -1)
+			return false;
+		m_DecodeQueued = true;
+		return true;
+	}
+
+	// Decodes the requested chunks that are missing, runs in the decode job.
+	void Decode() REQUIRES(!m_Lock)
+	{
+		while(true)
+		{
+			int Index;
+			CChunk *pChunk = nullptr;
+			{
+				const CLockScope LockScope(m_Lock);
+				Index = MissingIndex();
+				if(Index == -1)
+				{
+					m_DecodeQueued = false;
+					return;
+				}
+				// replace the chunk used least recently that isn't requested
+				for(auto &Chunk : m_aChunks)
+					if(Chunk.m_Index == -1 || !IsRequested(Chunk.m_Index))
+						if(!pChunk || Chunk.m_Index == -1 || (pChunk->m_Index != -1 && Chunk.m_LastUse < pChunk->m_LastUse))
+							pChunk = &Chunk;
+				dbg_assert(pChunk != nullptr, "no chunk to decode into");
+				// hidden from the mixer while it is being written
+				pChunk->m_Index = -1;
+			}
+
+			const bool Success = DecodeChunk(pChunk->m_pData, Index);
+
+			const CLockScope LockScope(m_Lock);
+			if(!Success)
+			{
+				// don't retry a broken chunk until a voice requests it again
+				for(auto &Request : m_aRequests)
+					if(Request.m_Index == Index)
+						Request.m_Index = -1;
+				continue;
+			}
+			pChunk->m_Index = Index;
+			pChunk->m_LastUse = ++m_UseCounter;
+		}
+	}
+};
+
+class CSampleStreamJob : public IJob
+{
+	std::shared_ptr<CSampleStream> m_pStream;
+
+	void Run() override { m_pStream->Decode(); }
+
+public:
+	CSampleStreamJob(std::shared_ptr<CSampleStream> pStream) :
+		m_pStream(std::move(pStream))
+	{
+		// voices play silence until the chunks are decoded
+		SetPriority(PRIORITY_HIGH);
+	}
+};
+
 void CSound::Mix(short *pFinalOut, unsigned Frames)
 {
 	Frames = minimum(Frames, m_MaxFrames);
@@ -32,6 +282,8 @@ void CSound::Mix(short *pFinalOut, unsigned Frames)
 	// acquire lock while we are mixing
 	m_SoundLock.lock();
 
+	ProcessVoiceCommands();
+
 	const int MasterVol = m_SoundVolume.load(std::memory_order_relaxed);
 
 	for(auto &Voice : m_aVoices)
@@ -39,13 +291,6 @@ void CSound::Mix(short *pFinalOut, unsigned Frames)
 		if(!Voice.m_pSample)
 			continue;
 
-		// mix voice
-		int *pOut = m_pMixBuffer;
-
-		const int Step = Voice.m_pSample->m_Channels; // setup input sources
-		short *pInL = &Voice.m_pSample->m_pData[Voice.m_Tick * Step];
-		short *pInR = &Voice.m_pSample->m_pData[Voice.m_Tick * Step + 1];
-
 		unsigned End = Voice.m_pSample->m_NumFrames - Voice.m_Tick;
 
 		int VolumeR = round_truncate(Voice.m_pChannel->m_Vol * (Voice.m_Vol / 255.0f));
@@ -55,10 +300,6 @@ void CSound::Mix(short *pFinalOut, unsigned Frames)
 		if(Frames < End)
 			End = Frames;
 
-		// check if we have a mono sound
-		if(Voice.m_pSample->m_Channels == 1)
-			pInR = pInL;
-
 		// volume calculation
 		if(Voice.m_Flags & ISound::FLAG_POS && Voice.m_pChannel->m_Pan)
 		{
@@ -131,15 +372,19 @@ void CSound::Mix(short *pFinalOut, unsigned Frames)
 			}
 		}
 
-		// process all frames
-		for(unsigned s = 0; s < End; s++)
+		// mix voice, inaudible voices only advance
+		if(VolumeL || VolumeR)
 		{
-			*pOut++ += (*pInL) * VolumeL;
-			*pOut++ += (*pInR) * VolumeR;
-			pInL += Step;
-			pInR += Step;
-			Voice.m_Tick++;
+			const int Channels = Voice.m_pSample->m_Channels;
+			if(Voice.m_pSample->m_pStream)
+			{
+				if(End > 0)
+					Voice.m_pSample->m_pStream->Mix(m_pMixBuffer, Voice.m_Tick, End, VolumeL, VolumeR);
+			}
+			else
+				SoundMixFrames(m_pMixBuffer, &Voice.m_pSample->m_pData[Voice.m_Tick * Channels], Channels, End, VolumeL, VolumeR);
 		}
+		Voice.m_Tick += End;
 
 		// free voice if not used any more
 		if(Voice.m_Tick == Voice.m_pSample->m_NumFrames)
@@ -157,8 +402,7 @@ void CSound::Mix(short *pFinalOut, unsigned Frames)
 	m_SoundLock.unlock();
 
 	// clamp accumulated values
-	for(unsigned i = 0; i < Frames * 2; i++)
-		pFinalOut[i] = clamp<int>(((m_pMixBuffer[i] * MasterVol) / 101) >> 8, std::numeric_limits<short>::min(), std::numeric_limits<short>::max());
+	SoundClipFrames(pFinalOut, m_pMixBuffer, Frames, MasterVol);
 
 #if defined(CONF_ARCH_ENDIAN_BIG)
 	swap_endian(pFinalOut, sizeof(short), Frames * 2);
@@ -188,6 +432,7 @@ int CSound::Init()
 	m_SoundEnabled = false;
 	m_pGraphics = Kernel()->RequestInterface<IEngineGraphics>();
 	m_pStorage = Kernel()->RequestInterface<IStorage>();
+	m_pEngine = Kernel()->RequestInterface<IEngine>();
 
 	// Initialize sample indices. We always need them to load sounds in
 	// the editor even if sound is disabled or failed to be enabled.
@@ -198,6 +443,7 @@ int CSound::Init()
 		m_aSamples[i].m_Index = i;
 		m_aSamples[i].m_NextFreeSampleIndex = i + 1;
 		m_aSamples[i].m_pData = nullptr;
+		m_aSamples[i].m_pStream = nullptr;
 	}
 	m_aSamples[std::size(m_aSamples) - 1].m_Index = std::size(m_aSamples) - 1;
 	m_aSamples[std::size(m_aSamples) - 1].m_NextFreeSampleIndex = SAMPLE_INDEX_FULL;
@@ -246,9 +492,18 @@ int CSound::Init()
 int CSound::Update()
 {
 	UpdateVolume();
+	QueueStreamDecoding();
 	return 0;
 }
 
+void CSound::QueueStreamDecoding()
+{
+	const CLockScope LockScope(m_SoundLock);
+	for(auto &Sample : m_aSamples)
+		if(Sample.m_pStream && Sample.m_pStream->NeedsDecodeJob())
+			m_pEngine->AddJob(std::make_shared<CSampleStreamJob>(Sample.m_pStream));
+}
+
 void CSound::UpdateVolume()
 {
 	int WantedVolume = g_Config.m_SndVolume;
@@ -271,6 +526,7 @@ void CSound::Shutdown()
 	{
 		free(Sample.m_pData);
 		Sample.m_pData = nullptr;
+		Sample.m_pStream = nullptr;
 	}
 
 	free(m_pMixBuffer);
@@ -286,7 +542,7 @@ CSample *CSound::AllocSample()
 
 	CSample *pSample = &m_aSamples[m_FirstFreeSampleIndex];
 	dbg_assert(
-		pSample->m_pData == nullptr && pSample->m_NextFreeSampleIndex != SAMPLE_INDEX_USED,
+		pSample->m_pData == nullptr && pSample->m_pStream == nullptr && pSample->m_NextFreeSampleIndex != SAMPLE_INDEX_USED,
 		"Sample was not unloaded (index=%d, next=%d, duration=%f, data=%p)",
 		pSample->m_Index, pSample->m_NextFreeSampleIndex, pSample->TotalTime(), pSample->m_pData);
 	m_FirstFreeSampleIndex = pSample->m_NextFreeSampleIndex;
@@ -352,6 +608,30 @@ bool CSound::DecodeOpus(CSample &Sample, const void *pData, unsigned DataSize) c
 			return false;
 		}
 
+		// decoding only the part that is playing doesn't need memory for
+		// the whole sound, but there is no resampling while mixing
+		const size_t DecodedSize = (size_t)NumSamples * NumChannels * sizeof(short);
+		if(g_Config.m_SndStreamThreshold > 0 && DecodedSize > (size_t)g_Config.m_SndStreamThreshold * 1024 && m_MixingRate == 48000)
+		{
+			op_free(pOpusFile);
+			std::shared_ptr<CSampleStream> pStream = std::make_shared<CSampleStream>(pData, DataSize, NumSamples, NumChannels);
+			if(!pStream->IsValid())
+			{
+				dbg_msg("sound/opus", "failed to open stream");
+				return false;
+			}
+
+			Sample.m_pData = nullptr;
+			Sample.m_pStream = pStream;
+			Sample.m_NumFrames = NumSamples;
+			Sample.m_Rate = 48000;
+			Sample.m_Channels = NumChannels;
+			Sample.m_LoopStart = -1;
+			Sample.m_LoopEnd = -1;
+			Sample.m_PausedAt = 0;
+			return true;
+		}
+
 		short *pSampleData = (short *)calloc((size_t)NumSamples * NumChannels, sizeof(short));
 
 		int Pos = 0;
@@ -434,6 +714,8 @@ static int PushBackByte(void *pId, int Char)
 }
 #endif
 
+// WavPack sounds are always decoded when loading, the bundled decoder can't
+// seek and reads through the global buffer above, so it can't stream.
 bool CSound::DecodeWV(CSample &Sample, const void *pData, unsigned DataSize) const
 {
 	char aError[100];
@@ -649,9 +931,10 @@ void CSound::UnloadSample(int SampleId)
 			}
 		}
 
-		// Free data
+		// Free data, a running decode job keeps the stream until it is done
 		free(Sample.m_pData);
 		Sample.m_pData = nullptr;
+		Sample.m_pStream = nullptr;
 	}
 
 	// Free slot
@@ -725,116 +1008,131 @@ void CSound::SetListenerPosition(vec2 Position)
 
 void CSound::SetVoiceVolume(CVoiceHandle Voice, float Volume)
 {
-	if(!Voice.IsValid())
-		return;
-
-	int VoiceId = Voice.Id();
-
-	const CLockScope LockScope(m_SoundLock);
-	if(m_aVoices[VoiceId].m_Age != Voice.Age())
-		return;
-
-	Volume = clamp(Volume, 0.0f, 1.0f);
-	m_aVoices[VoiceId].m_Vol = (int)(Volume * 255.0f);
+	PushVoiceCommand(Voice, CVoiceCommand::VOLUME, clamp(Volume, 0.0f, 1.0f));
 }
 
 void CSound::SetVoiceFalloff(CVoiceHandle Voice, float Falloff)
 {
-	if(!Voice.IsValid())
-		return;
-
-	int VoiceId = Voice.Id();
-
-	const CLockScope LockScope(m_SoundLock);
-	if(m_aVoices[VoiceId].m_Age != Voice.Age())
-		return;
-
-	Falloff = clamp(Falloff, 0.0f, 1.0f);
-	m_aVoices[VoiceId].m_Falloff = Falloff;
+	PushVoiceCommand(Voice, CVoiceCommand::FALLOFF, clamp(Falloff, 0.0f, 1.0f));
 }
 
 void CSound::SetVoicePosition(CVoiceHandle Voice, vec2 Position)
 {
-	if(!Voice.IsValid())
-		return;
-
-	int VoiceId = Voice.Id();
-
-	const CLockScope LockScope(m_SoundLock);
-	if(m_aVoices[VoiceId].m_Age != Voice.Age())
-		return;
-
-	m_aVoices[VoiceId].m_Position = Position;
+	PushVoiceCommand(Voice, CVoiceCommand::POSITION, 0.0f, Position);
 }
 
 void CSound::SetVoiceTimeOffset(CVoiceHandle Voice, float TimeOffset)
 {
-	if(!Voice.IsValid())
-		return;
-
-	int VoiceId = Voice.Id();
-
-	const CLockScope LockScope(m_SoundLock);
-	if(m_aVoices[VoiceId].m_Age != Voice.Age())
-		return;
-
-	if(!m_aVoices[VoiceId].m_pSample)
-		return;
+	PushVoiceCommand(Voice, CVoiceCommand::TIME_OFFSET, TimeOffset);
+}
 
-	int Tick = 0;
-	bool IsLooping = m_aVoices[VoiceId].m_Flags & ISound::FLAG_LOOP;
-	uint64_t TickOffset = m_aVoices[VoiceId].m_pSample->m_Rate * TimeOffset;
-	if(m_aVoices[VoiceId].m_pSample->m_NumFrames > 0 && IsLooping)
-		Tick = TickOffset % m_aVoices[VoiceId].m_pSample->m_NumFrames;
-	else
-		Tick = clamp(TickOffset, (uint64_t)0, (uint64_t)m_aVoices[VoiceId].m_pSample->m_NumFrames);
+void CSound::SetVoiceCircle(CVoiceHandle Voice, float Radius)
+{
+	PushVoiceCommand(Voice, CVoiceCommand::CIRCLE, maximum(0.0f, Radius));
+}
 
-	// at least 200msec off, else depend on buffer size
-	float Threshold = maximum(0.2f * m_aVoices[VoiceId].m_pSample->m_Rate, (float)m_MaxFrames);
-	if(absolute(m_aVoices[VoiceId].m_Tick - Tick) > Threshold)
-	{
-		// take care of looping (modulo!)
-		if(!(IsLooping && (minimum(m_aVoices[VoiceId].m_Tick, Tick) + m_aVoices[VoiceId].m_pSample->m_NumFrames - maximum(m_aVoices[VoiceId].m_Tick, Tick)) <= Threshold))
-		{
-			m_aVoices[VoiceId].m_Tick = Tick;
-		}
-	}
+void CSound::SetVoiceRectangle(CVoiceHandle Voice, float Width, float Height)
+{
+	PushVoiceCommand(Voice, CVoiceCommand::RECTANGLE, 0.0f, vec2(maximum(0.0f, Width), maximum(0.0f, Height)));
 }
 
-void CSound::SetVoiceCircle(CVoiceHandle Voice, float Radius)
+void CSound::PushVoiceCommand(CVoiceHandle Voice, int Type, float Value, vec2 Vector)
 {
 	if(!Voice.IsValid())
 		return;
 
-	int VoiceId = Voice.Id();
+	CVoiceCommand Command;
+	Command.m_Type = Type;
+	Command.m_VoiceId = Voice.Id();
+	Command.m_Age = Voice.Age();
+	Command.m_Value = Value;
+	Command.m_Vector = Vector;
 
-	const CLockScope LockScope(m_SoundLock);
-	if(m_aVoices[VoiceId].m_Age != Voice.Age())
+	const unsigned Written = m_VoiceCommandsWritten.load(std::memory_order_relaxed);
+	// without a running mixer nothing empties the queue, same if it is full
+	if(!m_SoundEnabled || Written - m_VoiceCommandsRead.load(std::memory_order_acquire) == std::size(m_aVoiceCommands))
+	{
+		const CLockScope LockScope(m_SoundLock);
+		ProcessVoiceCommands();
+		ApplyVoiceCommand(Command);
 		return;
+	}
 
-	m_aVoices[VoiceId].m_Shape = ISound::SHAPE_CIRCLE;
-	m_aVoices[VoiceId].m_Circle.m_Radius = maximum(0.0f, Radius);
+	m_aVoiceCommands[Written % std::size(m_aVoiceCommands)] = Command;
+	m_VoiceCommandsWritten.store(Written + 1, std::memory_order_release);
 }
 
-void CSound::SetVoiceRectangle(CVoiceHandle Voice, float Width, float Height)
+void CSound::ProcessVoiceCommands()
 {
-	if(!Voice.IsValid())
-		return;
-
-	int VoiceId = Voice.Id();
+	unsigned Read = m_VoiceCommandsRead.load(std::memory_order_relaxed);
+	const unsigned Written = m_VoiceCommandsWritten.load(std::memory_order_acquire);
+	for(; Read != Written; Read++)
+		ApplyVoiceCommand(m_aVoiceCommands[Read % std::size(m_aVoiceCommands)]);
+	m_VoiceCommandsRead.store(Read, std::memory_order_release);
+}
 
-	const CLockScope LockScope(m_SoundLock);
-	if(m_aVoices[VoiceId].m_Age != Voice.Age())
+void CSound::ApplyVoiceCommand(const CVoiceCommand &Command)
+{
+	CVoice &Voice = m_aVoices[Command.m_VoiceId];
+	if(Voice.m_Age != Command.m_Age)
 		return;
 
-	m_aVoices[VoiceId].m_Shape = ISound::SHAPE_RECTANGLE;
-	m_aVoices[VoiceId].m_Rectangle.m_Width = maximum(0.0f, Width);
-	m_aVoices[VoiceId].m_Rectangle.m_Height = maximum(0.0f, Height);
+	switch(Command.m_Type)
+	{
+	case CVoiceCommand::VOLUME:
+		Voice.m_Vol = (int)(Command.m_Value * 255.0f);
+		break;
+	case CVoiceCommand::FALLOFF:
+		Voice.m_Falloff = Command.m_Value;
+		break;
+	case CVoiceCommand::POSITION:
+		Voice.m_Position = Command.m_Vector;
+		break;
+	case CVoiceCommand::TIME_OFFSET:
+	{
+		if(!Voice.m_pSample)
+			break;
+
+		int Tick = 0;
+		bool IsLooping = Voice.m_Flags & ISound::FLAG_LOOP;
+		uint64_t TickOffset = Voice.m_pSample->m_Rate * Command.m_Value;
+		if(Voice.m_pSample->m_NumFrames > 0 && IsLooping)
+			Tick = TickOffset % Voice.m_pSample->m_NumFrames;
+		else
+			Tick = clamp(TickOffset, (uint64_t)0, (uint64_t)Voice.m_pSample->m_NumFrames);
+
+		// at least 200msec off, else depend on buffer size
+		float Threshold = maximum(0.2f * Voice.m_pSample->m_Rate, (float)m_MaxFrames);
+		if(absolute(Voice.m_Tick - Tick) > Threshold)
+		{
+			// take care of looping (modulo!)
+			if(!(IsLooping && (minimum(Voice.m_Tick, Tick) + Voice.m_pSample->m_NumFrames - maximum(Voice.m_Tick, Tick)) <= Threshold))
+			{
+				Voice.m_Tick = Tick;
+			}
+		}
+		break;
+	}
+	case CVoiceCommand::CIRCLE:
+		Voice.m_Shape = ISound::SHAPE_CIRCLE;
+		Voice.m_Circle.m_Radius = Command.m_Value;
+		break;
+	case CVoiceCommand::RECTANGLE:
+		Voice.m_Shape = ISound::SHAPE_RECTANGLE;
+		Voice.m_Rectangle.m_Width = Command.m_Vector.x;
+		Voice.m_Rectangle.m_Height = Command.m_Vector.y;
+		break;
+	default:
+		dbg_assert(false, "invalid voice command type %d", Command.m_Type);
+	}
 }
 
 ISound::CVoiceHandle CSound::Play(int ChannelId, int SampleId, int Flags, float Volume, vec2 Position)
 {
 	const CLockScope LockScope(m_SoundLock);
+	// stopped voices can be reused with the same age, don't let queued
+	// changes for the previous sound apply to the new one
+	ProcessVoiceCommands();
 
 	// search for voice
 	int VoiceId = -1;
@@ -875,6 +1173,14 @@ ISound::CVoiceHandle CSound::Play(int ChannelId, int SampleId, int Flags, float
 	m_aVoices[VoiceId].m_Falloff = 0.0f;
 	m_aVoices[VoiceId].m_Shape = ISound::SHAPE_CIRCLE;
 	m_aVoices[VoiceId].m_Circle.m_Radius = 1500;
+
+	// have the start decoded before the mixer reaches it
+	if(const std::shared_ptr<CSampleStream> &pStream = m_aSamples[SampleId].m_pStream)
+	{
+		pStream->Start(m_aVoices[VoiceId].m_Tick);
+		if(pStream->NeedsDecodeJob())
+			m_pEngine->AddJob(std::make_shared<CSampleStreamJob>(pStream));
+	}
 	return CreateVoiceHandle(VoiceId, m_aVoices[VoiceId].m_Age);
 }
 
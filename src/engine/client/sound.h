@@ -10,6 +10,9 @@
 #include <SDL_audio.h>
 
 #include <atomic>
+#include <memory>
+
+class CSampleStream;
 
 struct CSample
 {
@@ -17,6 +20,8 @@ struct CSample
 	int m_NextFreeSampleIndex;
 
 	short *m_pData;
+	// long Opus sounds are decoded ahead of playing instead of into m_pData
+	std::shared_ptr<CSampleStream> m_pStream;
 	int m_NumFrames;
 	int m_Rate;
 	int m_Channels;
@@ -31,7 +36,7 @@ struct CSample
 
 	bool IsLoaded() const
 	{
-		return m_pData != nullptr;
+		return m_pData != nullptr || m_pStream != nullptr;
 	}
 };
 
@@ -90,9 +95,38 @@ class CSound : public IEngineSound
 
 	class IEngineGraphics *m_pGraphics = nullptr;
 	IStorage *m_pStorage = nullptr;
+	class IEngine *m_pEngine = nullptr;
 
 	int *m_pMixBuffer = nullptr;
 
+	// Changes to playing voices, queued so the game thread doesn't have to
+	// wait for the mixer. Only the game thread pushes, only the holder of
+	// m_SoundLock pops.
+	struct CVoiceCommand
+	{
+		enum
+		{
+			VOLUME,
+			FALLOFF,
+			POSITION,
+			TIME_OFFSET,
+			CIRCLE,
+			RECTANGLE,
+		};
+		int m_Type;
+		int m_VoiceId;
+		int m_Age;
+		float m_Value;
+		vec2 m_Vector;
+	};
+	CVoiceCommand m_aVoiceCommands[1024];
+	std::atomic<unsigned> m_VoiceCommandsWritten{0};
+	std::atomic<unsigned> m_VoiceCommandsRead{0};
+
+	void PushVoiceCommand(CVoiceHandle Voice, int Type, float Value, vec2 Vector = vec2(0.0f, 0.0f)) REQUIRES(!m_SoundLock);
+	void ProcessVoiceCommands() REQUIRES(m_SoundLock);
+	void ApplyVoiceCommand(const CVoiceCommand &Command) REQUIRES(m_SoundLock);
+
 	CSample *AllocSample() REQUIRES(!m_SoundLock);
 	void RateConvert(CSample &Sample) const;
 
@@ -100,6 +134,7 @@ class CSound : public IEngineSound
 	bool DecodeWV(CSample &Sample, const void *pData, unsigned DataSize) const;
 
 	void UpdateVolume();
+	void QueueStreamDecoding() REQUIRES(!m_SoundLock);
 
 public:
 	int Init() override REQUIRES(!m_SoundLock);
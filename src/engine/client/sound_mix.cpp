@@ -0,0 +1,104 @@
+#include "sound_mix.h"
+
+#include <base/detect.h>
+#include <base/math.h>
+
+#include <limits>
+
+// SSE2 and NEON are part of the baseline of these architectures, so they
+// need no runtime detection. Other architectures use the scalar loops.
+#if defined(CONF_ARCH_AMD64) || (defined(CONF_ARCH_IA32) && defined(__SSE2__))
+#define SOUND_MIX_SSE2 1
+#include <emmintrin.h>
+#elif defined(CONF_ARCH_ARM64) || (defined(CONF_ARCH_ARM) && defined(__ARM_NEON))
+#define SOUND_MIX_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(SOUND_MIX_SSE2)
+// adds the 32 bit products of eight 16 bit samples and volumes to the mix
+static inline void MixSse2(int *pMix, __m128i In, __m128i Volume)
+{
+	const __m128i Low = _mm_mullo_epi16(In, Volume);
+	const __m128i High = _mm_mulhi_epi16(In, Volume);
+	_mm_storeu_si128((__m128i *)pMix, _mm_add_epi32(_mm_loadu_si128((const __m128i *)pMix), _mm_unpacklo_epi16(Low, High)));
+	_mm_storeu_si128((__m128i *)(pMix + 4), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(pMix + 4)), _mm_unpackhi_epi16(Low, High)));
+}
+#endif
+
+void SoundMixFrames(int *pMix, const short *pIn, int Channels, unsigned Frames, int VolumeL, int VolumeR)
+{
+	unsigned i = 0;
+	// the vector paths multiply the volumes as 16 bit values
+	const bool ShortVolumes = VolumeL >= 0 && VolumeL <= std::numeric_limits<short>::max() && VolumeR >= 0 && VolumeR <= std::numeric_limits<short>::max();
+#if defined(SOUND_MIX_SSE2)
+	if(ShortVolumes)
+	{
+		const __m128i Volume = _mm_set_epi16(VolumeR, VolumeL, VolumeR, VolumeL, VolumeR, VolumeL, VolumeR, VolumeL);
+		if(Channels == 1)
+		{
+			for(; i + 8 <= Frames; i += 8)
+			{
+				const __m128i In = _mm_loadu_si128((const __m128i *)(pIn + i));
+				MixSse2(pMix + 2 * i, _mm_unpacklo_epi16(In, In), Volume);
+				MixSse2(pMix + 2 * i + 8, _mm_unpackhi_epi16(In, In), Volume);
+			}
+		}
+		else
+		{
+			for(; i + 4 <= Frames; i += 4)
+				MixSse2(pMix + 2 * i, _mm_loadu_si128((const __m128i *)(pIn + 2 * i)), Volume);
+		}
+	}
+#elif defined(SOUND_MIX_NEON)
+	if(ShortVolumes)
+	{
+		const short aVolume[4] = {(short)VolumeL, (short)VolumeR, (short)VolumeL, (short)VolumeR};
+		const int16x4_t Volume = vld1_s16(aVolume);
+		if(Channels == 1)
+		{
+			for(; i + 4 <= Frames; i += 4)
+			{
+				const int16x4_t In = vld1_s16(pIn + i);
+				const int16x4x2_t Doubled = vzip_s16(In, In);
+				vst1q_s32(pMix + 2 * i, vmlal_s16(vld1q_s32(pMix + 2 * i), Doubled.val[0], Volume));
+				vst1q_s32(pMix + 2 * i + 4, vmlal_s16(vld1q_s32(pMix + 2 * i + 4), Doubled.val[1], Volume));
+			}
+		}
+		else
+		{
+			for(; i + 2 <= Frames; i += 2)
+				vst1q_s32(pMix + 2 * i, vmlal_s16(vld1q_s32(pMix + 2 * i), vld1_s16(pIn + 2 * i), Volume));
+		}
+	}
+#endif
+	const int OffsetR = Channels == 1 ? 0 : 1;
+	for(; i < Frames; i++)
+	{
+		pMix[2 * i] += pIn[i * Channels] * VolumeL;
+		pMix[2 * i + 1] += pIn[i * Channels + OffsetR] * VolumeR;
+	}
+}
+
+void SoundClipFrames(short *pOut, const int *pMix, unsigned Frames, int MasterVol)
+{
+	// the mix is in 8 bit fixed point, the master volume goes up to 100
+	const float Scale = MasterVol / (101.0f * 256.0f);
+	const unsigned Samples = Frames * 2;
+	unsigned i = 0;
+#if defined(SOUND_MIX_SSE2)
+	const __m128 Scale4 = _mm_set1_ps(Scale);
+	for(; i + 8 <= Samples; i += 8)
+	{
+		const __m128i Low = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(pMix + i))), Scale4));
+		const __m128i High = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(pMix + i + 4))), Scale4));
+		// saturates to the range of short
+		_mm_storeu_si128((__m128i *)(pOut + i), _mm_packs_epi32(Low, High));
+	}
+#elif defined(SOUND_MIX_NEON)
+	for(; i + 4 <= Samples; i += 4)
+		vst1_s16(pOut + i, vqmovn_s32(vcvtq_s32_f32(vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(pMix + i)), Scale))));
+#endif
+	for(; i < Samples; i++)
+		pOut[i] = clamp<int>((int)(pMix[i] * Scale), std::numeric_limits<short>::min(), std::numeric_limits<short>::max());
+}
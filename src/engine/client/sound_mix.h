@@ -0,0 +1,32 @@
+#ifndef ENGINE_CLIENT_SOUND_MIX_H
+#define ENGINE_CLIENT_SOUND_MIX_H
+
+/*
+	Function: SoundMixFrames
+		Adds frames of a mono or stereo sample to an interleaved stereo
+		mix buffer, scaling the left and right side by their volume.
+
+	Parameters:
+		pMix - Mix buffer with room for 2 * Frames values.
+		pIn - Sample data at the first frame to mix.
+		Channels - 1 for mono or 2 for stereo sample data.
+		Frames - Number of frames to mix.
+		VolumeL - Volume of the left side.
+		VolumeR - Volume of the right side.
+*/
+void SoundMixFrames(int *pMix, const short *pIn, int Channels, unsigned Frames, int VolumeL, int VolumeR);
+
+/*
+	Function: SoundClipFrames
+		Applies the master volume to an interleaved stereo mix buffer
+		and clips the result to 16 bit output samples.
+
+	Parameters:
+		pOut - Output with room for 2 * Frames samples.
+		pMix - Mix buffer as filled by <SoundMixFrames>.
+		Frames - Number of frames to output.
+		MasterVol - Master volume, 0 - 100.
+*/
+void SoundClipFrames(short *pOut, const int *pMix, unsigned Frames, int MasterVol);
+
+#endif
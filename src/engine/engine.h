@@ -8,6 +8,7 @@
 #include <memory>
 
 class CFutureLogger;
+class CJobGroup;
 class IJob;
 class ILogger;
 
@@ -20,6 +21,8 @@ public:
 
 	virtual void Init() = 0;
 	virtual void AddJob(std::shared_ptr<IJob> pJob) = 0;
+	virtual void AddJobGroup(std::shared_ptr<CJobGroup> pGroup) = 0;
+	virtual void RunJobCompletions() = 0;
 	virtual void ShutdownJobs() = 0;
 	virtual void SetAdditionalLogger(std::shared_ptr<ILogger> &&pLogger) = 0;
 };
@@ -22,6 +22,8 @@ public:
 	virtual const char *GetDataString(int Index) = 0;
 	virtual void UnloadData(int Index) = 0;
 	virtual int NumData() const = 0;
+	// starts decompressing data in the background, before it is used
+	virtual void StartDecompression(int Index) = 0;
 
 	virtual int GetItemSize(int Index) = 0;
 	virtual void *GetItem(int Index, int *pType = nullptr, int *pId = nullptr) = 0;
@@ -35,6 +37,8 @@ class IEngineMap : public IMap
 {
 	MACRO_INTERFACE("enginemap")
 public:
+	// IEngine must be registered in the kernel, the tile layers are
+	// decompressed in its job pool
 	virtual bool Load(const char *pMapName) = 0;
 	virtual void Unload() = 0;
 	virtual bool IsLoaded() const = 0;
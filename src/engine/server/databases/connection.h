@@ -88,6 +88,18 @@ public:
 	// SQL statements, that can't be abstracted, has side effects to the result
 	virtual bool AddPoints(const char *pPlayer, int Points, char *pError, int ErrorSize) = 0;
 
+	// Groups the following statements into one transaction. Statements
+	// between AddSavepoint and ReleaseSavepoint can be undone on their own
+	// without ending the transaction.
+	//
+	// returns true on success
+	virtual bool BeginTransaction(char *pError, int ErrorSize) = 0;
+	virtual bool CommitTransaction(char *pError, int ErrorSize) = 0;
+	virtual bool RollbackTransaction(char *pError, int ErrorSize) = 0;
+	virtual bool AddSavepoint(char *pError, int ErrorSize) = 0;
+	// undoes the statements since the savepoint first if Undo is set
+	virtual bool ReleaseSavepoint(bool Undo, char *pError, int ErrorSize) = 0;
+
 private:
 	char m_aPrefix[64];
 
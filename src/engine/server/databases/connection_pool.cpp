@@ -6,6 +6,7 @@
 #include <cstring>
 #include <engine/console.h>
 
+#include <algorithm>
 #include <chrono>
 #include <iterator>
 #include <memory>
@@ -14,6 +15,10 @@
 
 using namespace std::chrono_literals;
 
+// a write transaction holds the write lock of the database, commit at least
+// this often even if more queries are waiting
+static constexpr auto MAX_BATCH_TIME = 100ms;
+
 // helper struct to hold thread data
 struct CSqlExecData
 {
@@ -65,6 +70,7 @@ struct CSqlExecData
 
 	std::unique_ptr<const ISqlData> m_pThreadData;
 	const char *m_pName;
+	int64_t m_QueuedTime = time_get_nanoseconds().count();
 };
 
 CSqlExecData::CSqlExecData(
@@ -118,15 +124,78 @@ CSqlExecData::CSqlExecData(IConsole *pConsole, CDbConnectionPool::Mode m) :
 	m_Ptr.m_Print.m_Mode = m;
 }
 
+static void AddQueryStats(CDbConnectionPool::CQueryStats &Stats, int64_t WaitTime, int64_t RunTime)
+{
+	Stats.m_NumQueries++;
+	Stats.m_TotalWaitTime += WaitTime;
+	Stats.m_MaxWaitTime = std::max(Stats.m_MaxWaitTime, WaitTime);
+	Stats.m_TotalRunTime += RunTime;
+	Stats.m_MaxRunTime = std::max(Stats.m_MaxRunTime, RunTime);
+}
+
 void CDbConnectionPool::Print(IConsole *pConsole, Mode DatabaseMode)
 {
+	PrintStats(pConsole, DatabaseMode);
+	if(DatabaseMode == Mode::READ)
+	{
+		StartReadWorkers();
+		{
+			const CLockScope LockScope(m_pShared->m_ReadLock);
+			m_pShared->m_vpReadQueries.push_back(std::make_unique<CSqlExecData>(pConsole, DatabaseMode));
+		}
+		m_pShared->m_NumReads.Signal();
+		return;
+	}
 	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pConsole, DatabaseMode);
 	m_InsertIdx %= std::size(m_pShared->m_aQueries);
 	m_pShared->m_NumBackup.Signal();
 }
 
+void CDbConnectionPool::PrintStats(IConsole *pConsole, Mode DatabaseMode)
+{
+	int NumPending;
+	int MaxPending;
+	if(DatabaseMode == Mode::READ)
+	{
+		const CLockScope LockScope(m_pShared->m_ReadLock);
+		NumPending = m_pShared->m_vpReadQueries.size();
+		MaxPending = m_MaxPendingReads;
+	}
+	else if(DatabaseMode == Mode::WRITE)
+	{
+		NumPending = m_pShared->m_NumPendingWrites.load();
+		MaxPending = m_MaxPendingWrites;
+	}
+	else
+	{
+		return;
+	}
+
+	char aBuf[256];
+	const char *pLane = DatabaseMode == Mode::READ ? "Read" : "Write";
+	str_format(aBuf, sizeof(aBuf), "%s queue: pending=%d max=%d", pLane, NumPending, MaxPending);
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+
+	const CLockScope LockScope(m_pShared->m_StatsLock);
+	for(const auto &[Name, Stats] : DatabaseMode == Mode::READ ? m_pShared->m_ReadStats : m_pShared->m_WriteStats)
+	{
+		str_format(aBuf, sizeof(aBuf), "  %s: queries=%" PRId64 " wait avg=%.3fms max=%.3fms run avg=%.3fms max=%.3fms",
+			Name.c_str(), Stats.m_NumQueries,
+			Stats.m_TotalWaitTime / Stats.m_NumQueries / 1e6, Stats.m_MaxWaitTime / 1e6,
+			Stats.m_TotalRunTime / Stats.m_NumQueries / 1e6, Stats.m_MaxRunTime / 1e6);
+		pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	}
+}
+
 void CDbConnectionPool::RegisterSqliteDatabase(Mode DatabaseMode, const char aFileName[64])
 {
+	if(DatabaseMode == Mode::READ)
+	{
+		StartReadWorkers();
+		const CLockScope LockScope(m_pShared->m_ReadLock);
+		m_pShared->m_vpReadServers.push_back(std::make_unique<CSqlExecData>(DatabaseMode, aFileName));
+		return;
+	}
 	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(DatabaseMode, aFileName);
 	m_InsertIdx %= std::size(m_pShared->m_aQueries);
 	m_pShared->m_NumBackup.Signal();
@@ -134,6 +203,13 @@ void CDbConnectionPool::RegisterSqliteDatabase(Mode DatabaseMode, const char aFi
 
 void CDbConnectionPool::RegisterMysqlDatabase(Mode DatabaseMode, const CMysqlConfig *pMysqlConfig)
 {
+	if(DatabaseMode == Mode::READ)
+	{
+		StartReadWorkers();
+		const CLockScope LockScope(m_pShared->m_ReadLock);
+		m_pShared->m_vpReadServers.push_back(std::make_unique<CSqlExecData>(DatabaseMode, pMysqlConfig));
+		return;
+	}
 	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(DatabaseMode, pMysqlConfig);
 	m_InsertIdx %= std::size(m_pShared->m_aQueries);
 	m_pShared->m_NumBackup.Signal();
@@ -144,9 +220,15 @@ void CDbConnectionPool::Execute(
 	std::unique_ptr<const ISqlData> pSqlRequestData,
 	const char *pName)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	StartReadWorkers();
+	int NumPending;
+	{
+		const CLockScope LockScope(m_pShared->m_ReadLock);
+		m_pShared->m_vpReadQueries.push_back(std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName));
+		NumPending = m_pShared->m_vpReadQueries.size();
+	}
+	m_MaxPendingReads = std::max(m_MaxPendingReads, NumPending);
+	m_pShared->m_NumReads.Signal();
 }
 
 void CDbConnectionPool::ExecuteWrite(
@@ -156,6 +238,7 @@ void CDbConnectionPool::ExecuteWrite(
 {
 	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName);
 	m_InsertIdx %= std::size(m_pShared->m_aQueries);
+	m_MaxPendingWrites = std::max(m_MaxPendingWrites, ++m_pShared->m_NumPendingWrites);
 	m_pShared->m_NumBackup.Signal();
 }
 
@@ -165,6 +248,20 @@ void CDbConnectionPool::OnShutdown()
 		return;
 	m_Shutdown = true;
 	m_pShared->m_Shutdown.store(true);
+	{
+		// reads still in the queue are of no use anymore, the read workers
+		// only finish their current query
+		const CLockScope LockScope(m_pShared->m_ReadLock);
+		for(auto &pThreadData : m_pShared->m_vpReadQueries)
+		{
+			dbg_msg("sql", "%s dismissed read request during shutdown", pThreadData->m_pName);
+			CompleteQuery(pThreadData.get(), false);
+		}
+		m_pShared->m_vpReadQueries.clear();
+		m_pShared->m_vpReadQueries.resize(m_vpReadWorkerThreads.size());
+	}
+	for(size_t i = 0; i < m_vpReadWorkerThreads.size(); i++)
+		m_pShared->m_NumReads.Signal();
 	m_pShared->m_NumBackup.Signal();
 	int i = 0;
 	while(m_pShared->m_Shutdown.load())
@@ -180,7 +277,7 @@ void CDbConnectionPool::OnShutdown()
 }
 
 // The backup worker thread looks at write queries and stores them
-// in the sqlite database (WRITE_BACKUP). It skips over read queries.
+// in the sqlite database (WRITE_BACKUP).
 // After processing the query, it gets passed on to the Worker thread.
 // This is done to not loose ranks when the server shuts down before all
 // queries are executed on the mysql server
@@ -230,18 +327,33 @@ void CBackup::ProcessQueries()
 		}
 		else if(pThreadData->m_Mode == CSqlExecData::WRITE_ACCESS && m_pWriteBackup.get())
 		{
-			bool Success = CDbConnectionPool::ExecSqlFunc(m_pWriteBackup.get(), pThreadData, Write::BACKUP_FIRST);
-			if(m_DebugSql || !Success)
-				dbg_msg("sql", "[%i] %s done on write backup database, Success=%i", JobNum, pThreadData->m_pName, Success);
+			const int Num = CDbConnectionPool::TakeWriteBatch(m_pShared.get(), &m_pShared->m_NumBackup, JobNum);
+			CSqlExecData *apBatch[CDbConnectionPool::MAX_BATCH_QUERIES];
+			Write aWrite[CDbConnectionPool::MAX_BATCH_QUERIES];
+			bool aSuccess[CDbConnectionPool::MAX_BATCH_QUERIES];
+			for(int i = 0; i < Num; i++)
+			{
+				apBatch[i] = m_pShared->m_aQueries[(JobNum + i) % std::size(m_pShared->m_aQueries)].get();
+				aWrite[i] = Write::BACKUP_FIRST;
+			}
+			CDbConnectionPool::ExecSqlBatch(m_pWriteBackup.get(), apBatch, Num, aWrite, aSuccess);
+			for(int i = 0; i < Num; i++)
+			{
+				if(m_DebugSql || !aSuccess[i])
+					dbg_msg("sql", "[%i] %s done on write backup database, Success=%i", JobNum + i, apBatch[i]->m_pName, aSuccess[i]);
+				m_pShared->m_NumWorker.Signal();
+			}
+			JobNum += Num - 1;
+			continue;
 		}
 		m_pShared->m_NumWorker.Signal();
 	}
 }
 
-// the worker threads executes queries on mysql or sqlite. If we write on
-// a mysql server and have a backup server configured, we'll remove the
-// entry from the backup server after completing it on the write server.
-// static void Worker(void *pUser);
+// the worker thread executes write queries on mysql or sqlite in the order
+// they were added. If we write on a mysql server and have a backup server
+// configured, we'll remove the entry from the backup server after completing
+// it on the write server.
 class CWorker
 {
 public:
@@ -251,6 +363,7 @@ public:
 	void ProcessQueries();
 
 private:
+	void ProcessWrites(int JobNum, std::unique_ptr<CSqlExecData> *ppBatch, int Num, bool *pFailMode);
 	void Print(IConsole *pConsole, CDbConnectionPool::Mode DatabaseMode);
 
 	bool m_DebugSql;
@@ -262,8 +375,7 @@ private:
 	//                most one WRITE server. The WRITE server for all DDNet
 	//                Servers must be the same (to counteract double loads).
 	//                There may be one WRITE_BACKUP sqlite server.
-	// This variable should only change, before the worker threads
-	std::vector<std::unique_ptr<IDbConnection>> m_vpReadConnections;
+	// The READ servers are connected to by the read workers.
 	std::unique_ptr<IDbConnection> m_pWriteConnection;
 	std::unique_ptr<IDbConnection> m_pWriteBackup;
 
@@ -280,10 +392,8 @@ void CWorker::Start(void *pUser)
 
 void CWorker::ProcessQueries()
 {
-	// remember last working server and try to connect to it first
-	int ReadServer = 0;
-	// enter fail mode when a sql request fails, skip read request during it and
-	// write to the backup database until all requests are handled
+	// enter fail mode when a sql request fails, write to the backup database
+	// until all requests are handled
 	bool FailMode = false;
 	for(int JobNum = 0;; JobNum++)
 	{
@@ -299,73 +409,32 @@ void CWorker::ProcessQueries()
 			m_pShared->m_Shutdown.store(false);
 			return;
 		}
+		if(pThreadData->m_Mode == CSqlExecData::WRITE_ACCESS)
+		{
+			const int Num = CDbConnectionPool::TakeWriteBatch(m_pShared.get(), &m_pShared->m_NumWorker, JobNum);
+			std::unique_ptr<CSqlExecData> apBatch[CDbConnectionPool::MAX_BATCH_QUERIES];
+			apBatch[0] = std::move(pThreadData);
+			for(int i = 1; i < Num; i++)
+				apBatch[i] = std::move(m_pShared->m_aQueries[(JobNum + i) % std::size(m_pShared->m_aQueries)]);
+			ProcessWrites(JobNum, apBatch, Num, &FailMode);
+			JobNum += Num - 1;
+			continue;
+		}
 		bool Success = false;
 		switch(pThreadData->m_Mode)
 		{
 		case CSqlExecData::READ_ACCESS:
-		{
-			for(size_t i = 0; i < m_vpReadConnections.size(); i++)
-			{
-				if(m_pShared->m_Shutdown)
-				{
-					dbg_msg("sql", "[%i] %s dismissed read request during shutdown", JobNum, pThreadData->m_pName);
-					break;
-				}
-				if(FailMode)
-				{
-					dbg_msg("sql", "[%i] %s dismissed read request during FailMode", JobNum, pThreadData->m_pName);
-					break;
-				}
-				int CurServer = (ReadServer + i) % (int)m_vpReadConnections.size();
-				if(CDbConnectionPool::ExecSqlFunc(m_vpReadConnections[CurServer].get(), pThreadData.get(), Write::NORMAL))
-				{
-					ReadServer = CurServer;
-					if(m_DebugSql)
-						dbg_msg("sql", "[%i] %s done on read database %d", JobNum, pThreadData->m_pName, CurServer);
-					Success = true;
-					break;
-				}
-			}
-			if(!Success)
-			{
-				FailMode = true;
-			}
-		}
-		break;
+			dbg_assert(false, "read queries are executed by the read workers");
+			break;
 		case CSqlExecData::WRITE_ACCESS:
-		{
-			if(m_pShared->m_Shutdown && m_pWriteBackup != nullptr)
-			{
-				dbg_msg("sql", "[%i] %s skipped to backup database during shutdown", JobNum, pThreadData->m_pName);
-			}
-			else if(FailMode && m_pWriteBackup != nullptr)
-			{
-				dbg_msg("sql", "[%i] %s skipped to backup database during FailMode", JobNum, pThreadData->m_pName);
-			}
-			else if(CDbConnectionPool::ExecSqlFunc(m_pWriteConnection.get(), pThreadData.get(), Write::NORMAL))
-			{
-				if(m_DebugSql)
-					dbg_msg("sql", "[%i] %s done on write database", JobNum, pThreadData->m_pName);
-				Success = true;
-			}
-			// enter fail mode if not successful
-			FailMode = FailMode || !Success;
-			const Write w = Success ? Write::NORMAL_SUCCEEDED : Write::NORMAL_FAILED;
-			if(m_pWriteBackup && CDbConnectionPool::ExecSqlFunc(m_pWriteBackup.get(), pThreadData.get(), w))
-			{
-				if(m_DebugSql)
-					dbg_msg("sql", "[%i] %s done move write on backup database to non-backup table", JobNum, pThreadData->m_pName);
-				Success = true;
-			}
-		}
-		break;
+			dbg_assert(false, "write queries are executed in batches");
+			break;
 		case CSqlExecData::ADD_MYSQL:
 		{
 			auto pMysql = CreateMysqlConnection(pThreadData->m_Ptr.m_Mysql.m_Config);
 			switch(pThreadData->m_Ptr.m_Mysql.m_Mode)
 			{
 			case CDbConnectionPool::Mode::READ:
-				m_vpReadConnections.push_back(std::move(pMysql));
 				break;
 			case CDbConnectionPool::Mode::WRITE:
 				m_pWriteConnection = std::move(pMysql);
@@ -385,7 +454,6 @@ void CWorker::ProcessQueries()
 			switch(pThreadData->m_Ptr.m_Sqlite.m_Mode)
 			{
 			case CDbConnectionPool::Mode::READ:
-				m_vpReadConnections.push_back(std::move(pSqlite));
 				break;
 			case CDbConnectionPool::Mode::WRITE:
 				m_pWriteConnection = std::move(pSqlite);
@@ -406,24 +474,86 @@ void CWorker::ProcessQueries()
 		}
 		if(!Success)
 			dbg_msg("sql", "[%i] %s failed on all databases", JobNum, pThreadData->m_pName);
-		if(pThreadData->m_pThreadData != nullptr && pThreadData->m_pThreadData->m_pResult != nullptr)
+		CDbConnectionPool::CompleteQuery(pThreadData.get(), Success);
+	}
+}
+
+void CWorker::ProcessWrites(int JobNum, std::unique_ptr<CSqlExecData> *ppBatch, int Num, bool *pFailMode)
+{
+	m_pShared->m_NumPendingWrites -= Num;
+	const int64_t StartTime = time_get_nanoseconds().count();
+
+	CSqlExecData *apBatch[CDbConnectionPool::MAX_BATCH_QUERIES];
+	Write aWrite[CDbConnectionPool::MAX_BATCH_QUERIES];
+	bool aSuccess[CDbConnectionPool::MAX_BATCH_QUERIES] = {};
+	for(int i = 0; i < Num; i++)
+		apBatch[i] = ppBatch[i].get();
+
+	if(m_pShared->m_Shutdown && m_pWriteBackup != nullptr)
+	{
+		for(int i = 0; i < Num; i++)
+			dbg_msg("sql", "[%i] %s skipped to backup database during shutdown", JobNum + i, apBatch[i]->m_pName);
+	}
+	else if(*pFailMode && m_pWriteBackup != nullptr)
+	{
+		for(int i = 0; i < Num; i++)
+			dbg_msg("sql", "[%i] %s skipped to backup database during FailMode", JobNum + i, apBatch[i]->m_pName);
+	}
+	else
+	{
+		std::fill(aWrite, aWrite + Num, Write::NORMAL);
+		CDbConnectionPool::ExecSqlBatch(m_pWriteConnection.get(), apBatch, Num, aWrite, aSuccess);
+		for(int i = 0; i < Num; i++)
+			if(m_DebugSql && aSuccess[i])
+				dbg_msg("sql", "[%i] %s done on write database", JobNum + i, apBatch[i]->m_pName);
+	}
+
+	if(m_pWriteBackup)
+	{
+		bool aBackupSuccess[CDbConnectionPool::MAX_BATCH_QUERIES];
+		for(int i = 0; i < Num; i++)
 		{
-			pThreadData->m_pThreadData->m_pResult->m_Success = Success;
-			pThreadData->m_pThreadData->m_pResult->m_Completed.store(true);
+			// enter fail mode if not successful
+			*pFailMode = *pFailMode || !aSuccess[i];
+			aWrite[i] = aSuccess[i] ? Write::NORMAL_SUCCEEDED : Write::NORMAL_FAILED;
+		}
+		CDbConnectionPool::ExecSqlBatch(m_pWriteBackup.get(), apBatch, Num, aWrite, aBackupSuccess);
+		for(int i = 0; i < Num; i++)
+		{
+			if(aBackupSuccess[i])
+			{
+				if(m_DebugSql)
+					dbg_msg("sql", "[%i] %s done move write on backup database to non-backup table", JobNum + i, apBatch[i]->m_pName);
+				aSuccess[i] = true;
+			}
 		}
 	}
+	else
+	{
+		for(int i = 0; i < Num; i++)
+			*pFailMode = *pFailMode || !aSuccess[i];
+	}
+
+	// the queries of a batch share the time spent executing them
+	const int64_t RunTime = (time_get_nanoseconds().count() - StartTime) / Num;
+	{
+		const CLockScope LockScope(m_pShared->m_StatsLock);
+		for(int i = 0; i < Num; i++)
+			AddQueryStats(m_pShared->m_WriteStats[apBatch[i]->m_pName], StartTime - apBatch[i]->m_QueuedTime, RunTime);
+	}
+	for(int i = 0; i < Num; i++)
+	{
+		if(!aSuccess[i])
+			dbg_msg("sql", "[%i] %s failed on all databases", JobNum + i, apBatch[i]->m_pName);
+		else if(apBatch[i]->m_pThreadData != nullptr)
+			apBatch[i]->m_pThreadData->OnCommitted();
+		CDbConnectionPool::CompleteQuery(apBatch[i], aSuccess[i]);
+	}
 }
 
 void CWorker::Print(IConsole *pConsole, CDbConnectionPool::Mode DatabaseMode)
 {
-	if(DatabaseMode == CDbConnectionPool::Mode::READ)
-	{
-		for(auto &pReadConnection : m_vpReadConnections)
-			pReadConnection->Print(pConsole, "Read");
-		if(m_vpReadConnections.empty())
-			pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "There are no read databases");
-	}
-	else if(DatabaseMode == CDbConnectionPool::Mode::WRITE)
+	if(DatabaseMode == CDbConnectionPool::Mode::WRITE)
 	{
 		if(m_pWriteConnection)
 			m_pWriteConnection->Print(pConsole, "Write");
@@ -439,6 +569,137 @@ void CWorker::Print(IConsole *pConsole, CDbConnectionPool::Mode DatabaseMode)
 	}
 }
 
+// Read workers execute read queries concurrently, each one on its own
+// connections to the READ servers.
+class CReadWorker
+{
+public:
+	CReadWorker(std::shared_ptr<CDbConnectionPool::CSharedData> pShared, int DebugSql, int Index) :
+		m_DebugSql(DebugSql), m_Index(Index), m_pShared(std::move(pShared)) {}
+	static void Start(void *pUser);
+	void ProcessQueries();
+
+private:
+	void AddNewServers() REQUIRES(m_pShared->m_ReadLock);
+	void Print(IConsole *pConsole);
+
+	bool m_DebugSql;
+	int m_Index;
+
+	std::vector<std::unique_ptr<IDbConnection>> m_vpReadConnections;
+
+	std::shared_ptr<CDbConnectionPool::CSharedData> m_pShared;
+};
+
+/* static */
+void CReadWorker::Start(void *pUser)
+{
+	CReadWorker *pThis = (CReadWorker *)pUser;
+	pThis->ProcessQueries();
+	delete pThis;
+}
+
+void CReadWorker::AddNewServers()
+{
+	while(m_vpReadConnections.size() < m_pShared->m_vpReadServers.size())
+	{
+		const CSqlExecData *pServer = m_pShared->m_vpReadServers[m_vpReadConnections.size()].get();
+		if(pServer->m_Mode == CSqlExecData::ADD_MYSQL)
+			m_vpReadConnections.push_back(CreateMysqlConnection(pServer->m_Ptr.m_Mysql.m_Config));
+		else
+			m_vpReadConnections.push_back(CreateSqliteConnection(pServer->m_Ptr.m_Sqlite.m_FileName, true));
+	}
+}
+
+void CReadWorker::ProcessQueries()
+{
+	// remember last working server and try to connect to it first
+	int ReadServer = 0;
+	// enter fail mode when no read server could be reached, skip read
+	// requests until all queued ones are handled
+	bool FailMode = false;
+	for(int JobNum = 0;; JobNum++)
+	{
+		if(FailMode && m_pShared->m_NumReads.GetApproximateValue() == 0)
+		{
+			FailMode = false;
+		}
+		m_pShared->m_NumReads.Wait();
+		std::unique_ptr<CSqlExecData> pThreadData;
+		{
+			const CLockScope LockScope(m_pShared->m_ReadLock);
+			// queries dismissed during shutdown leave their signal behind
+			if(m_pShared->m_vpReadQueries.empty())
+				continue;
+			pThreadData = std::move(m_pShared->m_vpReadQueries.front());
+			m_pShared->m_vpReadQueries.pop_front();
+			if(pThreadData == nullptr)
+				return;
+			AddNewServers();
+		}
+
+		if(pThreadData->m_Mode == CSqlExecData::PRINT)
+		{
+			Print(pThreadData->m_Ptr.m_Print.m_pConsole);
+			continue;
+		}
+		dbg_assert(pThreadData->m_Mode == CSqlExecData::READ_ACCESS, "only read queries are executed by the read workers");
+
+		bool Success = false;
+		const int64_t StartTime = time_get_nanoseconds().count();
+		for(size_t i = 0; i < m_vpReadConnections.size(); i++)
+		{
+			if(m_pShared->m_Shutdown)
+			{
+				dbg_msg("sql", "[%d:%i] %s dismissed read request during shutdown", m_Index, JobNum, pThreadData->m_pName);
+				break;
+			}
+			if(FailMode)
+			{
+				dbg_msg("sql", "[%d:%i] %s dismissed read request during FailMode", m_Index, JobNum, pThreadData->m_pName);
+				break;
+			}
+			int CurServer = (ReadServer + i) % (int)m_vpReadConnections.size();
+			if(CDbConnectionPool::ExecSqlFunc(m_vpReadConnections[CurServer].get(), pThreadData.get(), Write::NORMAL))
+			{
+				ReadServer = CurServer;
+				if(m_DebugSql)
+					dbg_msg("sql", "[%d:%i] %s done on read database %d", m_Index, JobNum, pThreadData->m_pName, CurServer);
+				Success = true;
+				break;
+			}
+		}
+		if(!Success)
+		{
+			FailMode = true;
+			dbg_msg("sql", "[%d:%i] %s failed on all databases", m_Index, JobNum, pThreadData->m_pName);
+		}
+		{
+			const CLockScope LockScope(m_pShared->m_StatsLock);
+			AddQueryStats(m_pShared->m_ReadStats[pThreadData->m_pName], StartTime - pThreadData->m_QueuedTime, time_get_nanoseconds().count() - StartTime);
+		}
+		CDbConnectionPool::CompleteQuery(pThreadData.get(), Success);
+	}
+}
+
+void CReadWorker::Print(IConsole *pConsole)
+{
+	for(auto &pReadConnection : m_vpReadConnections)
+		pReadConnection->Print(pConsole, "Read");
+	if(m_vpReadConnections.empty())
+		pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "There are no read databases");
+}
+
+/* static */
+void CDbConnectionPool::CompleteQuery(CSqlExecData *pData, bool Success)
+{
+	if(pData->m_pThreadData != nullptr && pData->m_pThreadData->m_pResult != nullptr)
+	{
+		pData->m_pThreadData->m_pResult->m_Success = Success;
+		pData->m_pThreadData->m_pResult->m_Completed.store(true);
+	}
+}
+
 /* static */
 bool CDbConnectionPool::ExecSqlFunc(IDbConnection *pConnection, CSqlExecData *pData, Write w)
 {
@@ -473,6 +734,92 @@ bool CDbConnectionPool::ExecSqlFunc(IDbConnection *pConnection, CSqlExecData *pD
 	return Success;
 }
 
+/* static */
+void CDbConnectionPool::ExecSqlBatch(IDbConnection *pConnection, CSqlExecData *const *ppData, int Num, const Write *pWrite, bool *pSuccess)
+{
+	if(Num == 1 || pConnection == nullptr)
+	{
+		for(int i = 0; i < Num; i++)
+			pSuccess[i] = ExecSqlFunc(pConnection, ppData[i], pWrite[i]);
+		return;
+	}
+	char aError[256] = "unknown error";
+	if(!pConnection->Connect(aError, sizeof(aError)))
+	{
+		dbg_msg("sql", "failed connecting to db: %s", aError);
+		std::fill(pSuccess, pSuccess + Num, false);
+		return;
+	}
+	int Done = 0;
+	while(Done < Num)
+	{
+		if(!pConnection->BeginTransaction(aError, sizeof(aError)))
+		{
+			dbg_msg("sql", "failed starting transaction: %s", aError);
+			break;
+		}
+		const auto StartTime = time_get_nanoseconds();
+		const int First = Done;
+		bool Abort = false;
+		do
+		{
+			CSqlExecData *pData = ppData[Done];
+			bool Success = pConnection->AddSavepoint(aError, sizeof(aError));
+			if(Success)
+				Success = pData->m_Ptr.m_pWriteFunc(pConnection, pData->m_pThreadData.get(), pWrite[Done], aError, sizeof(aError));
+			if(!Success)
+				dbg_msg("sql", "%s failed: %s", pData->m_pName, aError);
+			if(!pConnection->ReleaseSavepoint(!Success, aError, sizeof(aError)))
+			{
+				dbg_msg("sql", "failed ending savepoint: %s", aError);
+				Abort = true;
+			}
+			pSuccess[Done++] = Success;
+		} while(!Abort && Done < Num && time_get_nanoseconds() - StartTime < MAX_BATCH_TIME);
+
+		if(Abort || !pConnection->CommitTransaction(aError, sizeof(aError)))
+		{
+			if(!Abort)
+				dbg_msg("sql", "failed committing %d queries: %s", Done - First, aError);
+			if(!pConnection->RollbackTransaction(aError, sizeof(aError)))
+				dbg_msg("sql", "failed rolling back: %s", aError);
+			std::fill(pSuccess + First, pSuccess + Done, false);
+		}
+	}
+	pConnection->Disconnect();
+
+	// without transactions, one at a time
+	for(; Done < Num; Done++)
+		pSuccess[Done] = ExecSqlFunc(pConnection, ppData[Done], pWrite[Done]);
+}
+
+/* static */
+int CDbConnectionPool::TakeWriteBatch(CSharedData *pShared, CSemaphore *pNumAvailable, int JobNum)
+{
+	const int MaxBatch = std::clamp<int>(g_Config.m_SvSqlWriteBatch, 1, MAX_BATCH_QUERIES);
+	int Num = 1;
+	while(Num < MaxBatch && pNumAvailable->GetApproximateValue() > 0)
+	{
+		const CSqlExecData *pNext = pShared->m_aQueries[(JobNum + Num) % std::size(pShared->m_aQueries)].get();
+		if(pNext == nullptr || pNext->m_Mode != CSqlExecData::WRITE_ACCESS)
+			break;
+		// the calling thread is the only one waiting, this doesn't block
+		pNumAvailable->Wait();
+		Num++;
+	}
+	return Num;
+}
+
+void CDbConnectionPool::StartReadWorkers()
+{
+	// the number of workers is only known once the config is loaded
+	if(!m_vpReadWorkerThreads.empty() || m_Shutdown)
+		return;
+	const int NumWorkers = std::max(g_Config.m_SvSqlReadWorkers, 1);
+	for(int i = 0; i < NumWorkers; i++)
+		m_vpReadWorkerThreads.push_back(thread_init(CReadWorker::Start, new CReadWorker(m_pShared, g_Config.m_DbgSql, i), "database read worker thread"));
+}
+
 CDbConnectionPool::CDbConnectionPool()
 {
 	m_pShared = std::make_shared<CSharedData>();
@@ -487,4 +834,6 @@ CDbConnectionPool::~CDbConnectionPool()
 		thread_wait(m_pWorkerThread);
 	if(m_pBackupThread)
 		thread_wait(m_pBackupThread);
+	for(void *pThread : m_vpReadWorkerThreads)
+		thread_wait(pThread);
 }
@@ -2,8 +2,12 @@
 #define ENGINE_SERVER_DATABASES_CONNECTION_POOL_H
 
 #include <atomic>
+#include <base/lock.h>
 #include <base/tl/threading.h>
+#include <deque>
+#include <map>
 #include <memory>
+#include <string>
 #include <vector>
 
 class IDbConnection;
@@ -28,6 +32,10 @@ struct ISqlData
 	}
 	virtual ~ISqlData() = default;
 
+	// Called by the write worker once the changes of a successful write
+	// are committed to the non-backup tables.
+	virtual void OnCommitted() const {}
+
 	mutable std::shared_ptr<ISqlResult> m_pResult;
 };
 
@@ -76,6 +84,16 @@ public:
 		NUM_MODES,
 	};
 
+	// queue wait and execution times of one kind of query, in nanoseconds
+	struct CQueryStats
+	{
+		int64_t m_NumQueries = 0;
+		int64_t m_TotalWaitTime = 0;
+		int64_t m_MaxWaitTime = 0;
+		int64_t m_TotalRunTime = 0;
+		int64_t m_MaxRunTime = 0;
+	};
+
 	void Print(IConsole *pConsole, Mode DatabaseMode);
 
 	void RegisterSqliteDatabase(Mode DatabaseMode, const char FileName[64]);
@@ -95,10 +113,25 @@ public:
 	void OnShutdown();
 
 	friend class CWorker;
+	friend class CReadWorker;
 	friend class CBackup;
 
 private:
+	enum
+	{
+		// upper bound of sv_sql_write_batch
+		MAX_BATCH_QUERIES = 64,
+	};
+
 	static bool ExecSqlFunc(IDbConnection *pConnection, struct CSqlExecData *pData, Write w);
+	// Executes the write queries in as few transactions as possible, each
+	// one in its own savepoint so that a failing query doesn't take the
+	// others with it.
+	static void ExecSqlBatch(IDbConnection *pConnection, struct CSqlExecData *const *ppData, int Num, const Write *pWrite, bool *pSuccess);
+	static void CompleteQuery(struct CSqlExecData *pData, bool Success);
+
+	void StartReadWorkers();
+	void PrintStats(IConsole *pConsole, Mode DatabaseMode);
 
 	// Only the main thread accesses this variable. It points to the index,
 	// where the next query is added to the queue.
@@ -122,12 +155,37 @@ private:
 		CSemaphore m_NumWorker;
 
 		// spsc queue with additional backup worker to look at queries first.
+		// Only write queries go through here, in the order they were added.
 		std::unique_ptr<struct CSqlExecData> m_aQueries[512];
+		// number of write queries added but not completed by the worker yet
+		std::atomic_int m_NumPendingWrites{0};
+
+		// Read queries don't depend on each other and are taken by whichever
+		// read worker is idle first. A nullptr entry stops one read worker.
+		CLock m_ReadLock;
+		std::deque<std::unique_ptr<struct CSqlExecData>> m_vpReadQueries GUARDED_BY(m_ReadLock);
+		// configurations of the READ servers, each read worker opens its own
+		// connection to every one of them
+		std::vector<std::unique_ptr<struct CSqlExecData>> m_vpReadServers GUARDED_BY(m_ReadLock);
+		CSemaphore m_NumReads;
+
+		CLock m_StatsLock;
+		std::map<std::string, CQueryStats> m_ReadStats GUARDED_BY(m_StatsLock);
+		std::map<std::string, CQueryStats> m_WriteStats GUARDED_BY(m_StatsLock);
 	};
 
+	// Takes the write queries following the one at JobNum from the queue
+	// as long as they are already available through pNumAvailable.
+	// Returns the size of the batch including the first query.
+	static int TakeWriteBatch(CSharedData *pShared, CSemaphore *pNumAvailable, int JobNum);
+
+	int m_MaxPendingReads = 0;
+	int m_MaxPendingWrites = 0;
+
 	std::shared_ptr<CSharedData> m_pShared;
 	void *m_pWorkerThread = nullptr;
 	void *m_pBackupThread = nullptr;
+	std::vector<void *> m_vpReadWorkerThreads;
 };
 
 #endif // ENGINE_SERVER_DATABASES_CONNECTION_POOL_H
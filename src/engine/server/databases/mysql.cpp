@@ -104,6 +104,12 @@ public:
 
 	bool AddPoints(const char *pPlayer, int Points, char *pError, int ErrorSize) override;
 
+	bool BeginTransaction(char *pError, int ErrorSize) override;
+	bool CommitTransaction(char *pError, int ErrorSize) override;
+	bool RollbackTransaction(char *pError, int ErrorSize) override;
+	bool AddSavepoint(char *pError, int ErrorSize) override;
+	bool ReleaseSavepoint(bool Undo, char *pError, int ErrorSize) override;
+
 private:
 	class CStmtDeleter
 	{
@@ -116,6 +122,8 @@ private:
 	void StoreErrorStmt(const char *pContext);
 	bool ConnectImpl();
 	bool PrepareAndExecuteStatement(const char *pStmt);
+	// for statements the binary protocol doesn't support
+	bool ExecuteQuery(const char *pQuery, char *pError, int ErrorSize);
 	//static void DeleteResult(MYSQL_RES *pResult);
 
 	union UParameterExtra
@@ -705,6 +713,51 @@ bool CMysqlConnection::AddPoints(const char *pPlayer, int Points, char *pError,
 	return ExecuteUpdate(&NumUpdated, pError, ErrorSize);
 }
 
+bool CMysqlConnection::ExecuteQuery(const char *pQuery, char *pError, int ErrorSize)
+{
+	if(m_pStmt && mysql_stmt_free_result(m_pStmt.get()))
+	{
+		StoreErrorStmt("free_result");
+		str_copy(pError, m_aErrorDetail, ErrorSize);
+		return false;
+	}
+	if(mysql_real_query(&m_Mysql, pQuery, str_length(pQuery)))
+	{
+		StoreErrorMysql("query");
+		str_copy(pError, m_aErrorDetail, ErrorSize);
+		return false;
+	}
+	return true;
+}
+
+bool CMysqlConnection::BeginTransaction(char *pError, int ErrorSize)
+{
+	return ExecuteQuery("START TRANSACTION", pError, ErrorSize);
+}
+
+bool CMysqlConnection::CommitTransaction(char *pError, int ErrorSize)
+{
+	return ExecuteQuery("COMMIT", pError, ErrorSize);
+}
+
+bool CMysqlConnection::RollbackTransaction(char *pError, int ErrorSize)
+{
+	return ExecuteQuery("ROLLBACK", pError, ErrorSize);
+}
+
+bool CMysqlConnection::AddSavepoint(char *pError, int ErrorSize)
+{
+	return ExecuteQuery("SAVEPOINT query", pError, ErrorSize);
+}
+
+bool CMysqlConnection::ReleaseSavepoint(bool Undo, char *pError, int ErrorSize)
+{
+	// fails if an error already rolled back the whole transaction
+	if(Undo && !ExecuteQuery("ROLLBACK TO SAVEPOINT query", pError, ErrorSize))
+		return false;
+	return ExecuteQuery("RELEASE SAVEPOINT query", pError, ErrorSize);
+}
+
 std::unique_ptr<IDbConnection> CreateMysqlConnection(CMysqlConfig Config)
 {
 	return std::make_unique<CMysqlConnection>(Config);
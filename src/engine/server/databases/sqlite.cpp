@@ -2,10 +2,12 @@
 
 #include <sqlite3.h>
 
+#include <base/lock.h>
 #include <base/math.h>
 #include <engine/console.h>
 
 #include <atomic>
+#include <limits>
 
 class CSqliteConnection : public IDbConnection
 {
@@ -53,6 +55,12 @@ public:
 
 	bool AddPoints(const char *pPlayer, int Points, char *pError, int ErrorSize) override;
 
+	bool BeginTransaction(char *pError, int ErrorSize) override;
+	bool CommitTransaction(char *pError, int ErrorSize) override;
+	bool RollbackTransaction(char *pError, int ErrorSize) override;
+	bool AddSavepoint(char *pError, int ErrorSize) override;
+	bool ReleaseSavepoint(bool Undo, char *pError, int ErrorSize) override;
+
 	// fail safe
 	bool CreateFailsafeTables();
 
@@ -142,11 +150,16 @@ bool CSqliteConnection::ConnectImpl(char *pError, int ErrorSize)
 		return false;
 	}
 
-	// wait for database to unlock so we don't have to handle SQLITE_BUSY errors
-	sqlite3_busy_timeout(m_pDb, -1);
+	// wait for database to unlock so we don't have to handle SQLITE_BUSY errors,
+	// a negative timeout would disable waiting instead
+	sqlite3_busy_timeout(m_pDb, std::numeric_limits<int>::max());
 
 	if(m_Setup)
 	{
+		// switching the journal mode doesn't wait for other connections
+		// of this process setting up the same file, do it one at a time
+		static CLock s_SetupLock;
+		const CLockScope LockScope(s_SetupLock);
 		if(!Execute("PRAGMA journal_mode=WAL", pError, ErrorSize))
 			return false;
 		char aBuf[1024];
@@ -412,6 +425,45 @@ bool CSqliteConnection::AddPoints(const char *pPlayer, int Points, char *pError,
 	return Step(&End, pError, ErrorSize);
 }
 
+bool CSqliteConnection::BeginTransaction(char *pError, int ErrorSize)
+{
+	// take the write lock right away, a deferred transaction that read
+	// before writing fails instead of waiting if another connection wrote
+	return Execute("BEGIN IMMEDIATE", pError, ErrorSize);
+}
+
+bool CSqliteConnection::CommitTransaction(char *pError, int ErrorSize)
+{
+	// statements still in progress keep the transaction from ending
+	if(m_pStmt != nullptr)
+		sqlite3_finalize(m_pStmt);
+	m_pStmt = nullptr;
+	return Execute("COMMIT", pError, ErrorSize);
+}
+
+bool CSqliteConnection::RollbackTransaction(char *pError, int ErrorSize)
+{
+	if(m_pStmt != nullptr)
+		sqlite3_finalize(m_pStmt);
+	m_pStmt = nullptr;
+	return Execute("ROLLBACK", pError, ErrorSize);
+}
+
+bool CSqliteConnection::AddSavepoint(char *pError, int ErrorSize)
+{
+	return Execute("SAVEPOINT query", pError, ErrorSize);
+}
+
+bool CSqliteConnection::ReleaseSavepoint(bool Undo, char *pError, int ErrorSize)
+{
+	if(m_pStmt != nullptr)
+		sqlite3_finalize(m_pStmt);
+	m_pStmt = nullptr;
+	if(Undo && !Execute("ROLLBACK TO SAVEPOINT query", pError, ErrorSize))
+		return false;
+	return Execute("RELEASE SAVEPOINT query", pError, ErrorSize);
+}
+
 std::unique_ptr<IDbConnection> CreateSqliteConnection(const char *pFilename, bool Setup)
 {
 	return std::make_unique<CSqliteConnection>(pFilename, Setup);
@@ -23,6 +23,7 @@
 #include <engine/shared/filecollection.h>
 #include <engine/shared/host_lookup.h>
 #include <engine/shared/http.h>
+#include <engine/shared/jobs.h>
 #include <engine/shared/json.h>
 #include <engine/shared/jsonwriter.h>
 #include <engine/shared/masterserver.h>
@@ -38,6 +39,7 @@
 
 // DDRace
 #include <engine/shared/linereader.h>
+#include <atomic>
 #include <vector>
 #include <zlib.h>
 
@@ -231,6 +233,8 @@ CServer::CServer()
 		m_aDemoRecorder[i] = CDemoRecorder(&m_SnapshotDelta, true);
 	m_aDemoRecorder[RECORDER_MANUAL] = CDemoRecorder(&m_SnapshotDelta, false);
 	m_aDemoRecorder[RECORDER_AUTO] = CDemoRecorder(&m_SnapshotDelta, false);
+	m_SnapshotDeltaSixup.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, true);
+	m_SnapshotDeltaSixup.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, true);
 
 	m_pGameServer = nullptr;
 
@@ -924,6 +928,50 @@ void CServer::SendMsgRaw(int ClientId, const void *pData, int Size, int Flags)
 	m_NetServer.Send(&Packet);
 }
 
+class CServer::CSnapshotFanOut
+{
+public:
+	class CJob : public IJob
+	{
+		std::shared_ptr<CSnapshotFanOut> m_pFanOut;
+
+		void Run() override { m_pFanOut->Work(); }
+
+	public:
+		CJob(std::shared_ptr<CSnapshotFanOut> pFanOut) :
+			m_pFanOut(std::move(pFanOut))
+		{
+			// the main thread is waiting for the snapshots
+			SetPriority(PRIORITY_HIGH);
+		}
+	};
+
+	CServer *m_pServer = nullptr;
+	CSnapshotWork *m_apWork[MAX_CLIENTS];
+	int m_NumWork = 0;
+	std::atomic<int> m_NextWork = 0;
+	std::atomic<int> m_NumDone = 0;
+	// signaled once all snapshots are done
+	SEMAPHORE m_Done;
+
+	CSnapshotFanOut() { sphore_init(&m_Done); }
+	~CSnapshotFanOut() { sphore_destroy(&m_Done); }
+
+	void Work()
+	{
+		// jobs that start late find no work left and don't touch the server
+		while(true)
+		{
+			const int Index = m_NextWork.fetch_add(1);
+			if(Index >= m_NumWork)
+				break;
+			m_pServer->DeltaClientSnapshot(m_apWork[Index]);
+			if(m_NumDone.fetch_add(1) + 1 == m_NumWork)
+				sphore_signal(&m_Done);
+		}
+	}
+};
+
 void CServer::DoSnapshot()
 {
 	GameServer()->OnPreSnap();
@@ -945,7 +993,9 @@ void CServer::DoSnapshot()
 			m_aDemoRecorder[RECORDER_AUTO].RecordSnapshot(Tick(), aData, SnapshotSize);
 	}
 
-	// create snapshots for all clients
+	// collect clients that receive a snapshot this tick
+	int aSnapClients[MAX_CLIENTS];
+	int NumSnapClients = 0;
 	for(int i = 0; i < MaxClients(); i++)
 	{
 		// client must be ingame to receive snapshots
@@ -960,101 +1010,173 @@ void CServer::DoSnapshot()
 		if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_INIT && (Tick() % 10) != 0)
 			continue;
 
+		aSnapClients[NumSnapClients++] = i;
+	}
+
+	m_SnapDeltaCache.Reset();
+
+	const int NumJobs = minimum(Config()->m_SvSnapThreads, NumSnapClients - 1);
+	if(NumJobs <= 0)
+	{
+		// create snapshots for all clients on the main thread
+		CSnapshotWork *pWork = SnapshotWork(0);
+		for(int i = 0; i < NumSnapClients; i++)
 		{
-			m_SnapshotBuilder.Init(m_aClients[i].m_Sixup);
+			pWork->m_ClientId = aSnapClients[i];
+			BuildClientSnapshot(pWork);
+			DeltaClientSnapshot(pWork);
+			SendClientSnapshot(pWork);
+		}
+	}
+	else
+	{
+		// the game snap is not thread-safe, so build all snapshots first:
+		// entity Snap functions write through the single snapshot builder
+		// and change shared state, like the world's traversal cursor, the
+		// shared snap item pool and the players' sent snap counters
+		std::shared_ptr<CSnapshotFanOut> pFanOut = std::make_shared<CSnapshotFanOut>();
+		for(int i = 0; i < NumSnapClients; i++)
+		{
+			CSnapshotWork *pWork = SnapshotWork(i);
+			pWork->m_ClientId = aSnapClients[i];
+			BuildClientSnapshot(pWork);
+			pFanOut->m_apWork[i] = pWork;
+		}
+		pFanOut->m_pServer = this;
+		pFanOut->m_NumWork = NumSnapClients;
 
-			GameServer()->OnSnap(i);
+		// delta and compress them on the job pool, the main thread helps out
+		// so that snapshots are still sent if no worker is available
+		for(int i = 0; i < NumJobs; i++)
+			Engine()->AddJob(std::make_shared<CSnapshotFanOut::CJob>(pFanOut));
+		pFanOut->Work();
+		sphore_wait(&pFanOut->m_Done);
 
-			// finish snapshot
-			char aData[CSnapshot::MAX_SIZE];
-			CSnapshot *pData = (CSnapshot *)aData; // Fix compiler warning for strict-aliasing
-			int SnapshotSize = m_SnapshotBuilder.Finish(pData);
+		for(int i = 0; i < NumSnapClients; i++)
+			SendClientSnapshot(pFanOut->m_apWork[i]);
+	}
 
-			if(m_aDemoRecorder[i].IsRecording())
-			{
-				// write snapshot
-				m_aDemoRecorder[i].RecordSnapshot(Tick(), aData, SnapshotSize);
-			}
+	GameServer()->OnPostSnap();
+}
 
-			int Crc = pData->Crc();
+CServer::CSnapshotWork *CServer::SnapshotWork(int Index)
+{
+	if((int)m_vpSnapshotWork.size() <= Index)
+		m_vpSnapshotWork.resize(Index + 1);
+	if(!m_vpSnapshotWork[Index])
+		m_vpSnapshotWork[Index] = std::make_unique<CSnapshotWork>();
+	return m_vpSnapshotWork[Index].get();
+}
 
-			// remove old snapshots
-			// keep 3 seconds worth of snapshots
-			m_aClients[i].m_Snapshots.PurgeUntil(m_CurrentGameTick - TickSpeed() * 3);
+void CServer::BuildClientSnapshot(CSnapshotWork *pWork)
+{
+	const int ClientId = pWork->m_ClientId;
+	m_SnapshotBuilder.Init(m_aClients[ClientId].m_Sixup);
 
-			// save the snapshot
-			m_aClients[i].m_Snapshots.Add(m_CurrentGameTick, time_get(), SnapshotSize, pData, 0, nullptr);
+	GameServer()->OnSnap(ClientId);
 
-			// find snapshot that we can perform delta against
-			int DeltaTick = -1;
-			const CSnapshot *pDeltashot = CSnapshot::EmptySnapshot();
-			{
-				int DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, nullptr, &pDeltashot, nullptr);
-				if(DeltashotSize >= 0)
-					DeltaTick = m_aClients[i].m_LastAckedSnapshot;
-				else
-				{
-					// no acked package found, force client to recover rate
-					if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_FULL)
-						m_aClients[i].m_SnapRate = CClient::SNAPRATE_RECOVER;
-				}
-			}
+	// finish snapshot
+	pWork->m_SnapshotSize = m_SnapshotBuilder.Finish(pWork->m_aData);
+
+	if(m_aDemoRecorder[ClientId].IsRecording())
+	{
+		// write snapshot
+		m_aDemoRecorder[ClientId].RecordSnapshot(Tick(), pWork->m_aData, pWork->m_SnapshotSize);
+	}
+}
 
-			// create delta
-			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, m_aClients[i].m_Sixup);
-			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, m_aClients[i].m_Sixup);
-			char aDeltaData[CSnapshot::MAX_SIZE];
-			int DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
+void CServer::DeltaClientSnapshot(CSnapshotWork *pWork)
+{
+	// only touches the state of a single client, may run on a job pool worker
+	CClient &Client = m_aClients[pWork->m_ClientId];
+	const CSnapshot *pData = (const CSnapshot *)pWork->m_aData;
+	pWork->m_Crc = pData->Crc();
 
-			if(DeltaSize)
-			{
-				// compress it
-				const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
+	// remove old snapshots
+	// keep 3 seconds worth of snapshots
+	Client.m_Snapshots.PurgeUntil(m_CurrentGameTick - TickSpeed() * 3);
 
-				char aCompData[CSnapshot::MAX_SIZE];
-				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData, sizeof(aCompData));
-				int NumPackets = (SnapshotSize + MaxSize - 1) / MaxSize;
+	// save the snapshot
+	Client.m_Snapshots.Add(m_CurrentGameTick, time_get(), pWork->m_SnapshotSize, pData, 0, nullptr);
 
-				for(int n = 0, Left = SnapshotSize; Left > 0; n++)
-				{
-					int Chunk = Left < MaxSize ? Left : MaxSize;
-					Left -= Chunk;
+	// find snapshot that we can perform delta against
+	pWork->m_DeltaTick = -1;
+	const CSnapshot *pDeltashot = CSnapshot::EmptySnapshot();
+	int DeltashotSize = Client.m_Snapshots.Get(Client.m_LastAckedSnapshot, nullptr, &pDeltashot, nullptr);
+	if(DeltashotSize >= 0)
+		pWork->m_DeltaTick = Client.m_LastAckedSnapshot;
+	else
+	{
+		DeltashotSize = 0;
+		// no acked package found, force client to recover rate
+		if(Client.m_SnapRate == CClient::SNAPRATE_FULL)
+			Client.m_SnapRate = CClient::SNAPRATE_RECOVER;
+	}
 
-					if(NumPackets == 1)
-					{
-						CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-					else
-					{
-						CMsgPacker Msg(NETMSG_SNAP, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(NumPackets);
-						Msg.AddInt(n);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-				}
+	// reuse the delta of another client with the same snapshots, compare
+	// against the stored copy because the work buffer may be reused
+	const bool UseDeltaCache = Config()->m_SvSnapDeltaCache;
+	const CSnapshot *pStored = Client.m_Snapshots.m_pLast->m_pSnap;
+	if(UseDeltaCache && m_SnapDeltaCache.Find(pDeltashot, DeltashotSize, pStored, pWork->m_SnapshotSize, pWork->m_Crc, Client.m_Sixup, pWork->m_aCompData, &pWork->m_CompressedSize))
+		return;
+
+	// create delta
+	CSnapshotDelta &SnapshotDelta = Client.m_Sixup ? m_SnapshotDeltaSixup : m_SnapshotDelta;
+	char aDeltaData[CSnapshot::MAX_SIZE];
+	int DeltaSize = SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
+
+	// compress it
+	pWork->m_CompressedSize = DeltaSize ? CVariableInt::Compress(aDeltaData, DeltaSize, pWork->m_aCompData, sizeof(pWork->m_aCompData)) : 0;
+
+	if(UseDeltaCache)
+		m_SnapDeltaCache.Add(pDeltashot, DeltashotSize, pStored, pWork->m_SnapshotSize, pWork->m_Crc, Client.m_Sixup, pWork->m_aCompData, pWork->m_CompressedSize);
+}
+
+void CServer::SendClientSnapshot(const CSnapshotWork *pWork)
+{
+	const int ClientId = pWork->m_ClientId;
+	const int DeltaTick = pWork->m_DeltaTick;
+	if(pWork->m_CompressedSize)
+	{
+		const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
+		const int NumPackets = (pWork->m_CompressedSize + MaxSize - 1) / MaxSize;
+
+		for(int n = 0, Left = pWork->m_CompressedSize; Left > 0; n++)
+		{
+			int Chunk = Left < MaxSize ? Left : MaxSize;
+			Left -= Chunk;
+
+			if(NumPackets == 1)
+			{
+				CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
+				Msg.AddInt(m_CurrentGameTick);
+				Msg.AddInt(m_CurrentGameTick - DeltaTick);
+				Msg.AddInt(pWork->m_Crc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&pWork->m_aCompData[n * MaxSize], Chunk);
+				SendMsg(&Msg, MSGFLAG_FLUSH, ClientId);
 			}
 			else
 			{
-				CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
+				CMsgPacker Msg(NETMSG_SNAP, true);
 				Msg.AddInt(m_CurrentGameTick);
 				Msg.AddInt(m_CurrentGameTick - DeltaTick);
-				SendMsg(&Msg, MSGFLAG_FLUSH, i);
+				Msg.AddInt(NumPackets);
+				Msg.AddInt(n);
+				Msg.AddInt(pWork->m_Crc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&pWork->m_aCompData[n * MaxSize], Chunk);
+				SendMsg(&Msg, MSGFLAG_FLUSH, ClientId);
 			}
 		}
 	}
-
-	GameServer()->OnPostSnap();
+	else
+	{
+		CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
+		Msg.AddInt(m_CurrentGameTick);
+		Msg.AddInt(m_CurrentGameTick - DeltaTick);
+		SendMsg(&Msg, MSGFLAG_FLUSH, ClientId);
+	}
 }
 
 int CServer::ClientRejoinCallback(int ClientId, void *pUser)
@@ -2959,6 +3081,9 @@ int CServer::Run()
 	if(Port == 0)
 		log_info("server", "using port %d", BindAddr.port);
 
+	// packets are flushed once per main loop iteration, before waiting for new ones
+	net_udp_set_send_batching(m_NetServer.Socket(), Config()->m_SvSendBatching);
+
 #if defined(CONF_UPNP)
 	m_UPnP.Open(BindAddr);
 #endif
@@ -3261,6 +3386,8 @@ int CServer::Run()
 				m_ReloadedWhenEmpty = false;
 			}
 
+			net_udp_flush(m_NetServer.Socket());
+
 			// wait for incoming data
 			if(NonActive &&
 				!m_aDemoRecorder[RECORDER_MANUAL].IsRecording() &&
@@ -3384,6 +3511,15 @@ void CServer::ConStatus(IConsole::IResult *pResult, void *pUser)
 		}
 		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 	}
+
+	if(pThis->Config()->m_SvSnapDeltaCache)
+	{
+		const uint64_t Hits = pThis->m_SnapDeltaCache.Hits();
+		const uint64_t Lookups = Hits + pThis->m_SnapDeltaCache.Misses();
+		str_format(aBuf, sizeof(aBuf), "snapshot delta cache: hits=%" PRIu64 " lookups=%" PRIu64 " hitrate=%.1f%%",
+			Hits, Lookups, Lookups ? 100.0 * Hits / Lookups : 0.0);
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	}
 }
 
 static int GetAuthLevel(const char *pLevel)
@@ -4215,6 +4351,7 @@ void *CServer::SnapNewItem(int Type, int Id, int Size)
 void CServer::SnapSetStaticsize(int ItemType, int Size)
 {
 	m_SnapshotDelta.SetStaticsize(ItemType, Size);
+	m_SnapshotDeltaSixup.SetStaticsize(ItemType, Size);
 }
 
 CServer *CreateServer() { return new CServer(); }
@@ -25,6 +25,7 @@
 #include "antibot.h"
 #include "authmanager.h"
 #include "name_ban.h"
+#include "snap_delta_cache.h"
 #include "snap_id_pool.h"
 
 #if defined(CONF_UPNP)
@@ -211,7 +212,25 @@ public:
 	int m_aIdMap[MAX_CLIENTS * VANILLA_MAX_CLIENTS];
 
 	CSnapshotDelta m_SnapshotDelta;
+	CSnapshotDelta m_SnapshotDeltaSixup;
 	CSnapshotBuilder m_SnapshotBuilder;
+
+	// per-client snapshot that is built on the main thread and then
+	// delta-encoded and compressed, possibly on a job pool worker
+	class CSnapshotWork
+	{
+	public:
+		int m_ClientId;
+		int m_SnapshotSize;
+		int m_Crc;
+		int m_DeltaTick;
+		int m_CompressedSize;
+		char m_aData[CSnapshot::MAX_SIZE];
+		char m_aCompData[CSnapshot::MAX_SIZE];
+	};
+	class CSnapshotFanOut;
+	CSnapDeltaCache m_SnapDeltaCache;
+	std::vector<std::unique_ptr<CSnapshotWork>> m_vpSnapshotWork;
 	CSnapIdPool m_IdPool;
 	CNetServer m_NetServer;
 	CEcon m_Econ;
@@ -332,6 +351,10 @@ public:
 	int SendMsg(CMsgPacker *pMsg, int Flags, int ClientId) override;
 
 	void DoSnapshot();
+	CSnapshotWork *SnapshotWork(int Index);
+	void BuildClientSnapshot(CSnapshotWork *pWork);
+	void DeltaClientSnapshot(CSnapshotWork *pWork);
+	void SendClientSnapshot(const CSnapshotWork *pWork);
 
 	static int NewClientCallback(int ClientId, void *pUser, bool Sixup);
 	static int NewClientNoAuthCallback(int ClientId, void *pUser);
@@ -0,0 +1,48 @@
+#include "snap_delta_cache.h"
+
+#include <base/system.h>
+
+void CSnapDeltaCache::Reset()
+{
+	const CLockScope LockScope(m_Lock);
+	m_NumEntries = 0;
+}
+
+bool CSnapDeltaCache::Find(const CSnapshot *pFrom, int FromSize, const CSnapshot *pTo, int ToSize, unsigned ToCrc, bool Sixup, char *pCompData, int *pCompSize)
+{
+	{
+		const CLockScope LockScope(m_Lock);
+		for(int i = 0; i < m_NumEntries; i++)
+		{
+			const CEntry &Entry = m_aEntries[i];
+			if(Entry.m_ToCrc != ToCrc || Entry.m_ToSize != ToSize || Entry.m_FromSize != FromSize || Entry.m_Sixup != Sixup)
+				continue;
+			if(mem_comp(Entry.m_pTo, pTo, ToSize) != 0 || mem_comp(Entry.m_pFrom, pFrom, FromSize) != 0)
+				continue;
+
+			*pCompSize = Entry.m_vCompData.size();
+			if(*pCompSize)
+				mem_copy(pCompData, Entry.m_vCompData.data(), *pCompSize);
+			m_Hits++;
+			return true;
+		}
+	}
+	m_Misses++;
+	return false;
+}
+
+void CSnapDeltaCache::Add(const CSnapshot *pFrom, int FromSize, const CSnapshot *pTo, int ToSize, unsigned ToCrc, bool Sixup, const char *pCompData, int CompSize)
+{
+	const CLockScope LockScope(m_Lock);
+	if(m_NumEntries == MAX_ENTRIES)
+		return;
+
+	CEntry &Entry = m_aEntries[m_NumEntries++];
+	Entry.m_pFrom = pFrom;
+	Entry.m_FromSize = FromSize;
+	Entry.m_pTo = pTo;
+	Entry.m_ToSize = ToSize;
+	Entry.m_ToCrc = ToCrc;
+	Entry.m_Sixup = Sixup;
+	Entry.m_vCompData.assign(pCompData, pCompData + CompSize);
+}
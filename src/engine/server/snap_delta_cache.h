@@ -0,0 +1,66 @@
+#ifndef ENGINE_SERVER_SNAP_DELTA_CACHE_H
+#define ENGINE_SERVER_SNAP_DELTA_CACHE_H
+
+#include <base/lock.h>
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+class CSnapshot;
+
+/**
+ * Caches the compressed snapshot deltas of the current snap tick, so that
+ * clients with byte-identical base and target snapshots reuse the delta
+ * of the first client instead of creating and compressing it again.
+ *
+ * Entries are keyed by the snapshot sizes and the CRC of the target
+ * snapshot and verified by comparing the snapshot contents, because the
+ * snapshot CRC is a plain sum. All functions are thread-safe.
+ */
+class CSnapDeltaCache
+{
+	enum
+	{
+		MAX_ENTRIES = 16,
+	};
+
+	class CEntry
+	{
+	public:
+		const CSnapshot *m_pFrom;
+		int m_FromSize;
+		const CSnapshot *m_pTo;
+		int m_ToSize;
+		unsigned m_ToCrc;
+		bool m_Sixup;
+		std::vector<char> m_vCompData;
+	};
+
+	CLock m_Lock;
+	CEntry m_aEntries[MAX_ENTRIES] GUARDED_BY(m_Lock);
+	int m_NumEntries GUARDED_BY(m_Lock) = 0;
+
+	std::atomic<uint64_t> m_Hits = 0;
+	std::atomic<uint64_t> m_Misses = 0;
+
+public:
+	/**
+	 * Forgets all entries. Must be called before each snap tick, the
+	 * snapshots of the entries must stay valid until then.
+	 */
+	void Reset() REQUIRES(!m_Lock);
+
+	/**
+	 * Looks up the compressed delta between two snapshots.
+	 *
+	 * @return `true` and the delta in `pCompData`/`pCompSize` if it is cached.
+	 */
+	bool Find(const CSnapshot *pFrom, int FromSize, const CSnapshot *pTo, int ToSize, unsigned ToCrc, bool Sixup, char *pCompData, int *pCompSize) REQUIRES(!m_Lock);
+	void Add(const CSnapshot *pFrom, int FromSize, const CSnapshot *pTo, int ToSize, unsigned ToCrc, bool Sixup, const char *pCompData, int CompSize) REQUIRES(!m_Lock);
+
+	uint64_t Hits() const { return m_Hits; }
+	uint64_t Misses() const { return m_Misses; }
+};
+
+#endif
@@ -8,12 +8,17 @@
 #include <base/math.h>
 #include <base/system.h>
 
+#include <base/tl/threading.h>
+
+#include <engine/engine.h>
 #include <engine/storage.h>
 
+#include "jobs.h"
 #include "uuid_manager.h"
 
 #include <cstdlib>
 #include <limits>
+#include <thread>
 #include <unordered_set>
 
 #include <zlib.h>
@@ -22,6 +27,12 @@ static constexpr int MAX_ITEM_TYPE = 0xFFFF;
 static constexpr int MAX_ITEM_ID = 0xFFFF;
 static constexpr int OFFSET_UUID_TYPE = 0x8000;
 
+#if defined(CONF_ARCH_ENDIAN_BIG)
+static constexpr bool SWAP_ENDIAN = true;
+#else
+static constexpr bool SWAP_ENDIAN = false;
+#endif
+
 inline void SwapEndianInPlace(void *pObj, size_t Size)
 {
 #if defined(CONF_ARCH_ENDIAN_BIG)
@@ -42,6 +53,90 @@ inline int SwapEndianInt(int Number)
 	return Number;
 }
 
+// Returns the uncompressed data allocated with malloc, or nullptr on failure.
+static void *UncompressData(int Index, const void *pCompressedData, unsigned CompressedSize, unsigned UncompressedSize)
+{
+	void *pData = malloc(UncompressedSize);
+	if(pData == nullptr)
+	{
+		log_error("datafile", "out of memory. could not allocate memory for uncompressed data. index=%d size=%d", Index, UncompressedSize);
+		return nullptr;
+	}
+	unsigned long ActualSize = UncompressedSize;
+	const int Result = uncompress(static_cast<Bytef *>(pData), &ActualSize, static_cast<const Bytef *>(pCompressedData), CompressedSize);
+	if(Result != Z_OK || ActualSize != UncompressedSize)
+	{
+		log_error("datafile", "failed to uncompress data. index=%d result=%d wanted=%d got=%ld", Index, Result, UncompressedSize, ActualSize);
+		free(pData);
+		return nullptr;
+	}
+	return pData;
+}
+
+// Decompresses one data item of a mapped datafile in advance. Whichever of
+// the worker thread and the reader gets to it first does the work, so the
+// reader never waits for a job that is still queued.
+class CDataDecompressJob : public IJob
+{
+	enum
+	{
+		PROGRESS_PENDING,
+		PROGRESS_STARTED,
+		PROGRESS_CANCELED,
+	};
+
+	std::atomic<int> m_Progress{PROGRESS_PENDING};
+	CSemaphore m_Finished;
+
+	int m_Index;
+	const void *m_pCompressedData;
+	unsigned m_CompressedSize;
+	unsigned m_UncompressedSize;
+	void *m_pData = nullptr;
+
+	bool Decompress()
+	{
+		int Expected = PROGRESS_PENDING;
+		if(!m_Progress.compare_exchange_strong(Expected, PROGRESS_STARTED))
+			return false;
+		m_pData = UncompressData(m_Index, m_pCompressedData, m_CompressedSize, m_UncompressedSize);
+		m_Finished.Signal();
+		return true;
+	}
+
+	void Run() override
+	{
+		Decompress();
+	}
+
+public:
+	CDataDecompressJob(int Index, const void *pCompressedData, unsigned CompressedSize, unsigned UncompressedSize) :
+		m_Index(Index), m_pCompressedData(pCompressedData), m_CompressedSize(CompressedSize), m_UncompressedSize(UncompressedSize)
+	{
+		SetPriority(PRIORITY_HIGH);
+	}
+
+	// Returns the data allocated with malloc, or nullptr on failure.
+	void *Finish()
+	{
+		if(!Decompress())
+			m_Finished.Wait();
+		return m_pData;
+	}
+
+	// Stops the job from accessing the compressed data and frees its result.
+	void Cancel()
+	{
+		int Expected = PROGRESS_PENDING;
+		if(!m_Progress.compare_exchange_strong(Expected, PROGRESS_CANCELED))
+		{
+			m_Finished.Wait();
+			free(m_pData);
+			m_pData = nullptr;
+		}
+	}
+};
+
 class CItemEx
 {
 public:
@@ -138,6 +233,22 @@ public:
 	void **m_ppDataPtrs;
 	int *m_pDataSizes;
 	char *m_pData;
+	// content of the whole file if it was opened mapped, nullptr otherwise
+	unsigned char *m_pMapping;
+
+	bool IsMapped(const void *pData) const
+	{
+		return m_pMapping != nullptr && pData >= m_pMapping && pData < m_pMapping + m_FileSize;
+	}
+
+	void FreeData(int Index)
+	{
+		if(!IsMapped(m_ppDataPtrs[Index]))
+		{
+			free(m_ppDataPtrs[Index]);
+		}
+		m_ppDataPtrs[Index] = nullptr;
+	}
 
 	int GetFileDataSize(int Index) const
 	{
@@ -206,51 +317,58 @@ public:
 			const unsigned OriginalUncompressedSize = m_Info.m_pDataSizes[Index];
 			log_trace("datafile", "loading data. index=%d size=%d uncompressed=%d", Index, DataSize, OriginalUncompressedSize);
 
-			// read the compressed data
-			void *pCompressedData = malloc(DataSize);
-			if(pCompressedData == nullptr)
-			{
-				log_error("datafile", "out of memory. could not allocate memory for compressed data. index=%d size=%d", Index, DataSize);
-				m_ppDataPtrs[Index] = nullptr;
-				m_pDataSizes[Index] = -1;
-				return nullptr;
-			}
-			unsigned ActualDataSize = 0;
-			if(io_seek(m_File, m_DataStartOffset + m_Info.m_pDataOffsets[Index], IOSEEK_START) == 0)
+			// read the compressed data, unless it is mapped already
+			const void *pCompressedData;
+			void *pReadData = nullptr;
+			if(m_pMapping != nullptr)
 			{
-				ActualDataSize = io_read(m_File, pCompressedData, DataSize);
+				pCompressedData = m_pMapping + m_DataStartOffset + m_Info.m_pDataOffsets[Index];
 			}
-			if(DataSize != ActualDataSize)
+			else
 			{
-				log_error("datafile", "truncation error. could not read all compressed data. index=%d wanted=%d got=%d", Index, DataSize, ActualDataSize);
-				free(pCompressedData);
-				m_ppDataPtrs[Index] = nullptr;
-				m_pDataSizes[Index] = -1;
-				return nullptr;
+				pReadData = malloc(DataSize);
+				if(pReadData == nullptr)
+				{
+					log_error("datafile", "out of memory. could not allocate memory for compressed data. index=%d size=%d", Index, DataSize);
+					m_ppDataPtrs[Index] = nullptr;
+					m_pDataSizes[Index] = -1;
+					return nullptr;
+				}
+				unsigned ActualDataSize = 0;
+				if(io_seek(m_File, m_DataStartOffset + m_Info.m_pDataOffsets[Index], IOSEEK_START) == 0)
+				{
+					ActualDataSize = io_read(m_File, pReadData, DataSize);
+				}
+				if(DataSize != ActualDataSize)
+				{
+					log_error("datafile", "truncation error. could not read all compressed data. index=%d wanted=%d got=%d", Index, DataSize, ActualDataSize);
+					free(pReadData);
+					m_ppDataPtrs[Index] = nullptr;
+					m_pDataSizes[Index] = -1;
+					return nullptr;
+				}
+				pCompressedData = pReadData;
 			}
 
 			// decompress the data
-			m_ppDataPtrs[Index] = static_cast<char *>(malloc(OriginalUncompressedSize));
+			m_ppDataPtrs[Index] = UncompressData(Index, pCompressedData, DataSize, OriginalUncompressedSize);
+			free(pReadData);
 			if(m_ppDataPtrs[Index] == nullptr)
 			{
-				free(pCompressedData);
-				log_error("datafile", "out of memory. could not allocate memory for uncompressed data. index=%d size=%d", Index, OriginalUncompressedSize);
-				m_pDataSizes[Index] = -1;
-				return nullptr;
-			}
-			unsigned long UncompressedSize = OriginalUncompressedSize;
-			const int Result = uncompress(static_cast<Bytef *>(m_ppDataPtrs[Index]), &UncompressedSize, static_cast<Bytef *>(pCompressedData), DataSize);
-			free(pCompressedData);
-			if(Result != Z_OK || UncompressedSize != OriginalUncompressedSize)
-			{
-				log_error("datafile", "failed to uncompress data. index=%d result=%d wanted=%d got=%ld", Index, Result, OriginalUncompressedSize, UncompressedSize);
-				free(m_ppDataPtrs[Index]);
-				m_ppDataPtrs[Index] = nullptr;
 				m_pDataSizes[Index] = -1;
 				return nullptr;
 			}
 			m_pDataSizes[Index] = OriginalUncompressedSize;
 		}
+		else if(m_pMapping != nullptr && !(Swap && SWAP_ENDIAN) && (m_DataStartOffset + m_Info.m_pDataOffsets[Index]) % sizeof(int) == 0)
+		{
+			// use uncompressed data in place, unless it is misaligned for
+			// the arrays stored in it or swapping it would change the mapping
+			// for the next load after unloading it
+			log_trace("datafile", "mapping data. index=%d size=%d", Index, DataSize);
+			m_ppDataPtrs[Index] = m_pMapping + m_DataStartOffset + m_Info.m_pDataOffsets[Index];
+			m_pDataSizes[Index] = DataSize;
+		}
 		else
 		{
 			log_trace("datafile", "loading data. index=%d size=%d", Index, DataSize);
@@ -426,10 +544,12 @@ CDataFileReader &CDataFileReader::operator=(CDataFileReader &&Other)
 {
 	m_pDataFile = Other.m_pDataFile;
 	Other.m_pDataFile = nullptr;
+	m_vpDecompressJobs = std::move(Other.m_vpDecompressJobs);
+	Other.m_vpDecompressJobs.clear();
 	return *this;
 }
 
-bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType)
+bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType, bool Mapped)
 {
 	dbg_assert(m_pDataFile == nullptr, "File already open");
 
@@ -442,10 +562,32 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		return false;
 	}
 
+	unsigned char *pMapping = nullptr;
+	int64_t MappingSize = 0;
+	if(Mapped)
+	{
+		MappingSize = io_length(File);
+		pMapping = static_cast<unsigned char *>(io_map(File, MappingSize));
+		if(pMapping == nullptr)
+		{
+			log_warn("datafile", "failed to map file '%s', reading it instead", pFilename);
+		}
+	}
+
 	// determine size and hashes of the file and store them
 	int64_t FileSize = 0;
 	unsigned Crc = 0;
 	SHA256_DIGEST Sha256;
+	if(pMapping != nullptr)
+	{
+		FileSize = MappingSize;
+		Crc = crc32(0, pMapping, MappingSize);
+		SHA256_CTX Sha256Ctxt;
+		sha256_init(&Sha256Ctxt);
+		sha256_update(&Sha256Ctxt, pMapping, MappingSize);
+		Sha256 = sha256_finish(&Sha256Ctxt);
+	}
+	else
 	{
 		SHA256_CTX Sha256Ctxt;
 		sha256_init(&Sha256Ctxt);
@@ -468,11 +610,24 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		}
 	}
 
+	// closes the file and releases the mapping when opening fails
+	const auto &&CloseFile = [&]() {
+		if(pMapping != nullptr)
+		{
+			io_unmap(pMapping, MappingSize);
+		}
+		io_close(File);
+	};
+
 	// read header
 	CDatafileHeader Header;
-	if(io_read(File, &Header, sizeof(Header)) != sizeof(Header))
+	if(pMapping != nullptr && FileSize >= (int64_t)sizeof(Header))
 	{
-		io_close(File);
+		mem_copy(&Header, pMapping, sizeof(Header));
+	}
+	else if(pMapping != nullptr || io_read(File, &Header, sizeof(Header)) != sizeof(Header))
+	{
+		CloseFile();
 		log_error("datafile", "could not read file header. file truncated or not a datafile.");
 		return false;
 	}
@@ -481,7 +636,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	if((Header.m_aId[0] != 'A' || Header.m_aId[1] != 'T' || Header.m_aId[2] != 'A' || Header.m_aId[3] != 'D') &&
 		(Header.m_aId[0] != 'D' || Header.m_aId[1] != 'A' || Header.m_aId[2] != 'T' || Header.m_aId[3] != 'A'))
 	{
-		io_close(File);
+		CloseFile();
 		log_error("datafile", "wrong header magic. magic=%x%x%x%x", Header.m_aId[0], Header.m_aId[1], Header.m_aId[2], Header.m_aId[3]);
 		return false;
 	}
@@ -491,7 +646,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	// check header version
 	if(Header.m_Version != 3 && Header.m_Version != 4)
 	{
-		io_close(File);
+		CloseFile();
 		log_error("datafile", "unsupported header version. version=%d", Header.m_Version);
 		return false;
 	}
@@ -505,7 +660,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		Header.m_ItemSize % sizeof(int) != 0 ||
 		Header.m_DataSize < 0)
 	{
-		io_close(File);
+		CloseFile();
 		log_error("datafile", "invalid header information. num_types=%d num_items=%d num_data=%d item_size=%d data_size=%d",
 			Header.m_NumItemTypes, Header.m_NumItems, Header.m_NumRawData, Header.m_ItemSize, Header.m_DataSize);
 		return false;
@@ -531,7 +686,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 
 	if((int64_t)sizeof(Header) + Size + (int64_t)Header.m_DataSize != FileSize)
 	{
-		io_close(File);
+		CloseFile();
 		log_error("datafile", "invalid header data size or truncated file. data_size=%" PRId64 " file_size=%" PRId64, Header.m_DataSize, FileSize);
 		return false;
 	}
@@ -546,7 +701,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		}
 		else
 		{
-			io_close(File);
+			CloseFile();
 			log_error("datafile", "invalid header size or truncated file. size=%" PRId64 " actual=%" PRId64, HeaderFileSize, FileSize);
 			return false;
 		}
@@ -563,20 +718,21 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		}
 		else
 		{
-			io_close(File);
+			CloseFile();
 			log_error("datafile", "invalid header swaplen or truncated file. swaplen=%" PRId64 " actual=%" PRId64, HeaderSwaplen, FileSizeSwaplen);
 			return false;
 		}
 	}
 
 	constexpr int64_t MaxAllocSize = (int64_t)2 * 1024 * 1024 * 1024;
-	int64_t AllocSize = Size;
+	// the item data is used in place from the mapping
+	int64_t AllocSize = pMapping != nullptr ? 0 : Size;
 	AllocSize += sizeof(CDatafile); // add space for info structure
 	AllocSize += (int64_t)Header.m_NumRawData * sizeof(void *); // add space for data pointers
 	AllocSize += (int64_t)Header.m_NumRawData * sizeof(int); // add space for data sizes
 	if(AllocSize > MaxAllocSize)
 	{
-		io_close(File);
+		CloseFile();
 		log_error("datafile", "file too large. alloc_size=%" PRId64 " max=%" PRId64, AllocSize, MaxAllocSize);
 		return false;
 	}
@@ -584,7 +740,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	CDatafile *pTmpDataFile = static_cast<CDatafile *>(malloc(AllocSize));
 	if(pTmpDataFile == nullptr)
 	{
-		io_close(File);
+		CloseFile();
 		log_error("datafile", "out of memory. could not allocate memory for datafile. alloc_size=%" PRId64, AllocSize);
 		return false;
 	}
@@ -592,7 +748,8 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	pTmpDataFile->m_DataStartOffset = sizeof(CDatafileHeader) + Size;
 	pTmpDataFile->m_ppDataPtrs = (void **)(pTmpDataFile + 1);
 	pTmpDataFile->m_pDataSizes = (int *)(pTmpDataFile->m_ppDataPtrs + Header.m_NumRawData);
-	pTmpDataFile->m_pData = (char *)(pTmpDataFile->m_pDataSizes + Header.m_NumRawData);
+	pTmpDataFile->m_pData = pMapping != nullptr ? (char *)(pMapping + sizeof(CDatafileHeader)) : (char *)(pTmpDataFile->m_pDataSizes + Header.m_NumRawData);
+	pTmpDataFile->m_pMapping = pMapping;
 	pTmpDataFile->m_File = File;
 	pTmpDataFile->m_FileSize = FileSize;
 	pTmpDataFile->m_Sha256 = Sha256;
@@ -603,10 +760,10 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	mem_zero(pTmpDataFile->m_pDataSizes, Header.m_NumRawData * sizeof(int));
 
 	// read types, offsets, sizes and item data
-	const unsigned ReadSize = io_read(pTmpDataFile->m_File, pTmpDataFile->m_pData, Size);
+	const unsigned ReadSize = pMapping != nullptr ? Size : io_read(pTmpDataFile->m_File, pTmpDataFile->m_pData, Size);
 	if((int64_t)ReadSize != Size)
 	{
-		io_close(pTmpDataFile->m_File);
+		CloseFile();
 		free(pTmpDataFile);
 		log_error("datafile", "truncation error. could not read all item data. wanted=%" PRIzu " got=%d", Size, ReadSize);
 		return false;
@@ -631,7 +788,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 
 	if(!pTmpDataFile->Validate())
 	{
-		io_close(pTmpDataFile->m_File);
+		CloseFile();
 		free(pTmpDataFile);
 		return false;
 	}
@@ -649,11 +806,21 @@ void CDataFileReader::Close()
 		return;
 	}
 
+	for(int i = 0; i < (int)m_vpDecompressJobs.size(); i++)
+	{
+		CancelDecompression(i);
+	}
+	m_vpDecompressJobs.clear();
+
 	for(int i = 0; i < m_pDataFile->m_Header.m_NumRawData; i++)
 	{
-		free(m_pDataFile->m_ppDataPtrs[i]);
+		m_pDataFile->FreeData(i);
 	}
 
+	if(m_pDataFile->m_pMapping != nullptr)
+	{
+		io_unmap(m_pDataFile->m_pMapping, m_pDataFile->m_FileSize);
+	}
 	io_close(m_pDataFile->m_File);
 	free(m_pDataFile);
 	m_pDataFile = nullptr;
@@ -682,6 +849,7 @@ void *CDataFileReader::GetData(int Index)
 {
 	dbg_assert(m_pDataFile != nullptr, "File not open");
 
+	FinishDecompression(Index, false);
 	return m_pDataFile->GetData(Index, false);
 }
 
@@ -689,9 +857,74 @@ void *CDataFileReader::GetDataSwapped(int Index)
 {
 	dbg_assert(m_pDataFile != nullptr, "File not open");
 
+	FinishDecompression(Index, true);
 	return m_pDataFile->GetData(Index, true);
 }
 
+void CDataFileReader::StartDecompression(IEngine *pEngine, int Index)
+{
+	dbg_assert(m_pDataFile != nullptr, "File not open");
+
+	// worker threads can only access the file through the mapping
+	if(m_pDataFile->m_pMapping == nullptr || m_pDataFile->m_Info.m_pDataSizes == nullptr)
+	{
+		return;
+	}
+
+	// Invalid data indices may appear in map items
+	if(Index < 0 || Index >= m_pDataFile->m_Header.m_NumRawData)
+	{
+		return;
+	}
+
+	if(m_vpDecompressJobs.empty())
+	{
+		m_vpDecompressJobs.resize(m_pDataFile->m_Header.m_NumRawData);
+	}
+	if(m_vpDecompressJobs[Index] != nullptr || m_pDataFile->m_ppDataPtrs[Index] != nullptr || m_pDataFile->m_pDataSizes[Index] < 0)
+	{
+		return;
+	}
+
+	m_vpDecompressJobs[Index] = std::make_shared<CDataDecompressJob>(Index,
+		m_pDataFile->m_pMapping + m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index],
+		m_pDataFile->GetFileDataSize(Index), m_pDataFile->m_Info.m_pDataSizes[Index]);
+	pEngine->AddJob(m_vpDecompressJobs[Index]);
+}
+
+void CDataFileReader::FinishDecompression(int Index, bool Swap)
+{
+	if(Index < 0 || Index >= (int)m_vpDecompressJobs.size() || m_vpDecompressJobs[Index] == nullptr)
+	{
+		return;
+	}
+
+	void *pData = m_vpDecompressJobs[Index]->Finish();
+	m_vpDecompressJobs[Index] = nullptr;
+	m_pDataFile->m_ppDataPtrs[Index] = pData;
+	if(pData == nullptr)
+	{
+		m_pDataFile->m_pDataSizes[Index] = -1;
+		return;
+	}
+	m_pDataFile->m_pDataSizes[Index] = m_pDataFile->m_Info.m_pDataSizes[Index];
+	if(Swap)
+	{
+		SwapEndianInPlace(pData, m_pDataFile->m_pDataSizes[Index]);
+	}
+}
+
+void CDataFileReader::CancelDecompression(int Index)
+{
+	if(Index < 0 || Index >= (int)m_vpDecompressJobs.size() || m_vpDecompressJobs[Index] == nullptr)
+	{
+		return;
+	}
+
+	m_vpDecompressJobs[Index]->Cancel();
+	m_vpDecompressJobs[Index] = nullptr;
+}
+
 const char *CDataFileReader::GetDataString(int Index)
 {
 	dbg_assert(m_pDataFile != nullptr, "File not open");
@@ -720,7 +953,8 @@ void CDataFileReader::ReplaceData(int Index, char *pData, size_t Size)
 	dbg_assert(m_pDataFile != nullptr, "File not open");
 	dbg_assert(Index >= 0 && Index < m_pDataFile->m_Header.m_NumRawData, "Index invalid: %d", Index);
 
-	free(m_pDataFile->m_ppDataPtrs[Index]);
+	CancelDecompression(Index);
+	m_pDataFile->FreeData(Index);
 	m_pDataFile->m_ppDataPtrs[Index] = pData;
 	m_pDataFile->m_pDataSizes[Index] = Size;
 }
@@ -732,8 +966,8 @@ void CDataFileReader::UnloadData(int Index)
 	if(Index < 0 || Index >= m_pDataFile->m_Header.m_NumRawData)
 		return;
 
-	free(m_pDataFile->m_ppDataPtrs[Index]);
-	m_pDataFile->m_ppDataPtrs[Index] = nullptr;
+	CancelDecompression(Index);
+	m_pDataFile->FreeData(Index);
 	m_pDataFile->m_pDataSizes[Index] = 0;
 }
 
@@ -1089,14 +1323,17 @@ static int CompressionLevelToZlib(CDataFileWriter::ECompressionLevel Compression
 	}
 }
 
-void CDataFileWriter::Finish()
+void CDataFileWriter::CompressData()
 {
-	dbg_assert((bool)m_File, "File not open");
-
-	// Compress data. This takes the majority of the time when saving a datafile,
-	// so it's delayed until the end so it can be off-loaded to another thread.
-	for(CDataInfo &DataInfo : m_vDatas)
+	while(true)
 	{
+		const size_t Index = m_NextCompressData.fetch_add(1, std::memory_order_relaxed);
+		if(Index >= m_vDatas.size())
+		{
+			break;
+		}
+
+		CDataInfo &DataInfo = m_vDatas[Index];
 		unsigned long CompressedSize = compressBound(DataInfo.m_UncompressedSize);
 		DataInfo.m_pCompressedData = malloc(CompressedSize);
 		const int Result = compress2(static_cast<Bytef *>(DataInfo.m_pCompressedData), &CompressedSize, static_cast<Bytef *>(DataInfo.m_pUncompressedData), DataInfo.m_UncompressedSize, CompressionLevelToZlib(DataInfo.m_CompressionLevel));
@@ -1105,6 +1342,49 @@ void CDataFileWriter::Finish()
 		DataInfo.m_pUncompressedData = nullptr;
 		dbg_assert(Result == Z_OK, "datafile zlib compression failed with error %d", Result);
 	}
+}
+
+void CDataFileWriter::CompressThread(void *pUser)
+{
+	static_cast<CDataFileWriter *>(pUser)->CompressData();
+}
+
+void CDataFileWriter::Finish()
+{
+	dbg_assert((bool)m_File, "File not open");
+
+	// Compress data. This takes the majority of the time when saving a datafile,
+	// so it's delayed until the end so it can be off-loaded to another thread.
+	// Large files are compressed by several threads. Every data is compressed
+	// on its own, so the output doesn't depend on which thread compressed it.
+	int64_t UncompressedSize = 0;
+	for(const CDataInfo &DataInfo : m_vDatas)
+	{
+		UncompressedSize += DataInfo.m_UncompressedSize;
+	}
+	int NumThreads = 1;
+#if !defined(CONF_PLATFORM_EMSCRIPTEN)
+	if(m_CompressionThreads > 0)
+	{
+		NumThreads = minimum<int>(m_CompressionThreads, MAX_COMPRESSION_THREADS);
+	}
+	else if(UncompressedSize >= PARALLEL_COMPRESSION_MIN_SIZE)
+	{
+		NumThreads = clamp<int>(std::thread::hardware_concurrency(), 1, MAX_COMPRESSION_THREADS);
+	}
+	NumThreads = clamp<int>(NumThreads, 1, maximum<int>(m_vDatas.size(), 1));
+#endif
+	m_NextCompressData.store(0, std::memory_order_relaxed);
+	std::vector<void *> vpThreads;
+	for(int i = 1; i < NumThreads; i++)
+	{
+		vpThreads.push_back(thread_init(CompressThread, this, "datafile compression"));
+	}
+	CompressData();
+	for(void *pThread : vpThreads)
+	{
+		thread_wait(pThread);
+	}
 
 	// Calculate total size of items
 	int64_t ItemSize = 0;
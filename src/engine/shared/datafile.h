@@ -10,8 +10,10 @@
 
 #include "uuid_manager.h"
 
+#include <atomic>
 #include <cstdint>
 #include <map>
+#include <memory>
 #include <vector>
 
 enum
@@ -23,19 +25,31 @@ enum
 class CDataFileReader
 {
 	class CDatafile *m_pDataFile = nullptr;
+	// data being decompressed in advance, indexed like the data
+	std::vector<std::shared_ptr<class CDataDecompressJob>> m_vpDecompressJobs;
 
 	int GetExternalItemType(int InternalType, CUuid *pUuid);
 	int GetInternalItemType(int ExternalType);
+	void FinishDecompression(int Index, bool Swap);
+	void CancelDecompression(int Index);
 
 public:
 	~CDataFileReader();
 	CDataFileReader &operator=(CDataFileReader &&Other);
 
-	bool Open(class IStorage *pStorage, const char *pFilename, int StorageType);
+	// Mapped files serve items and uncompressed data straight from a memory
+	// mapping, and only compressed data is copied when it is decompressed.
+	// The file must not be truncated while it is open.
+	bool Open(class IStorage *pStorage, const char *pFilename, int StorageType, bool Mapped = false);
 	void Close();
 	bool IsOpen() const;
 	IOHANDLE File() const;
 
+	// Decompresses data of a mapped file in the job pool of the engine, so
+	// that several data items can be decompressed at once. GetData waits
+	// for the job, or does the work itself if no worker started it yet.
+	void StartDecompression(class IEngine *pEngine, int Index);
+
 	int GetDataSize(int Index) const;
 	void *GetData(int Index);
 	void *GetDataSwapped(int Index); // makes sure that the data is 32bit LE ints when saved
@@ -67,6 +81,13 @@ public:
 	};
 
 private:
+	enum
+	{
+		// smaller files are compressed on the calling thread only
+		PARALLEL_COMPRESSION_MIN_SIZE = 1024 * 1024,
+		MAX_COMPRESSION_THREADS = 8,
+	};
+
 	class CDataInfo
 	{
 	public:
@@ -108,9 +129,14 @@ private:
 	std::vector<CItemInfo> m_vItems;
 	std::vector<CDataInfo> m_vDatas;
 	std::vector<CExtendedItemType> m_vExtendedItemTypes;
+	// next data to compress, shared by the threads in Finish
+	std::atomic<size_t> m_NextCompressData{0};
+	int m_CompressionThreads = 0;
 
 	int GetTypeFromIndex(int Index) const;
 	int GetExtendedItemTypeIndex(int Type, const CUuid *pUuid);
+	void CompressData();
+	static void CompressThread(void *pUser);
 
 public:
 	CDataFileWriter();
@@ -122,6 +148,7 @@ public:
 		m_vItems = std::move(Other.m_vItems);
 		m_vDatas = std::move(Other.m_vDatas);
 		m_vExtendedItemTypes = std::move(Other.m_vExtendedItemTypes);
+		m_CompressionThreads = Other.m_CompressionThreads;
 	}
 	~CDataFileWriter();
 
@@ -130,6 +157,9 @@ public:
 	int AddData(size_t Size, const void *pData, ECompressionLevel CompressionLevel = COMPRESSION_DEFAULT);
 	int AddDataSwapped(size_t Size, const void *pData);
 	int AddDataString(const char *pStr);
+	// Sets the number of threads Finish compresses the data on. The default
+	// of 0 uses several threads for large files only.
+	void SetCompressionThreads(int NumThreads) { m_CompressionThreads = NumThreads; }
 	void Finish();
 };
 
@@ -11,6 +11,7 @@
 #include <engine/shared/network.h>
 #include <engine/storage.h>
 
+#include <iterator>
 #include <thread>
 
 class CEngine : public IEngine
@@ -47,6 +48,35 @@ class CEngine : public IEngine
 		}
 	}
 
+	static void Con_DbgJobs(IConsole::IResult *pResult, void *pUserData)
+	{
+		CEngine *pEngine = static_cast<CEngine *>(pUserData);
+
+		static const char *s_apPriorityNames[] = {"high", "normal", "low"};
+		static_assert(std::size(s_apPriorityNames) == IJob::NUM_PRIORITIES);
+		for(int Priority = IJob::PRIORITY_HIGH; Priority < IJob::NUM_PRIORITIES; Priority++)
+		{
+			const CJobPool::CStats Stats = pEngine->m_JobPool.Stats((IJob::EJobPriority)Priority);
+			const int64_t NumJobs = std::max<int64_t>(Stats.m_NumJobs, 1);
+			log_info("jobs", "%s: jobs=%" PRId64 " wait avg=%.3fms max=%.3fms run avg=%.3fms max=%.3fms",
+				s_apPriorityNames[Priority], Stats.m_NumJobs,
+				Stats.m_TotalWaitTime / NumJobs / 1e6, Stats.m_MaxWaitTime / 1e6,
+				Stats.m_TotalRunTime / NumJobs / 1e6, Stats.m_MaxRunTime / 1e6);
+		}
+	}
+
+	static void Con_DbgNetstats(IConsole::IResult *pResult, void *pUserData)
+	{
+		NETSTATS Stats;
+		net_stats(&Stats);
+		log_info("net", "sent packets=%" PRIu64 " bytes=%" PRIu64 " syscalls=%" PRIu64 " packets/syscall=%.2f",
+			Stats.sent_packets, Stats.sent_bytes, Stats.send_syscalls,
+			Stats.sent_packets / (double)std::max<uint64_t>(Stats.send_syscalls, 1));
+		log_info("net", "recv packets=%" PRIu64 " bytes=%" PRIu64 " syscalls=%" PRIu64 " packets/syscall=%.2f",
+			Stats.recv_packets, Stats.recv_bytes, Stats.recv_syscalls,
+			Stats.recv_packets / (double)std::max<uint64_t>(Stats.recv_syscalls, 1));
+	}
+
 public:
 	CEngine(bool Test, const char *pAppname, std::shared_ptr<CFutureLogger> pFutureLogger) :
 		m_pFutureLogger(std::move(pFutureLogger))
@@ -94,6 +124,8 @@ public:
 			return;
 
 		m_pConsole->Register("dbg_lognetwork", "", CFGFLAG_SERVER | CFGFLAG_CLIENT, Con_DbgLognetwork, this, "Log the network");
+		m_pConsole->Register("dbg_jobs", "", CFGFLAG_SERVER | CFGFLAG_CLIENT, Con_DbgJobs, this, "Print queue wait and run times of the job pool per priority");
+		m_pConsole->Register("dbg_netstats", "", CFGFLAG_SERVER | CFGFLAG_CLIENT, Con_DbgNetstats, this, "Print the number of sent and received packets and the system calls used for them");
 	}
 
 	void AddJob(std::shared_ptr<IJob> pJob) override
@@ -101,6 +133,16 @@ public:
 		m_JobPool.Add(std::move(pJob));
 	}
 
+	void AddJobGroup(std::shared_ptr<CJobGroup> pGroup) override
+	{
+		m_JobPool.AddGroup(std::move(pGroup));
+	}
+
+	void RunJobCompletions() override
+	{
+		m_JobPool.RunCompletions();
+	}
+
 	void ShutdownJobs() override
 	{
 		m_JobPool.Shutdown();
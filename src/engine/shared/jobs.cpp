@@ -4,9 +4,10 @@
 #include <algorithm>
 
 IJob::IJob() :
-	m_pNext(nullptr),
 	m_State(STATE_QUEUED),
-	m_Abortable(false)
+	m_Abortable(false),
+	m_Priority(PRIORITY_NORMAL),
+	m_QueuedTime(0)
 {
 }
 
@@ -42,6 +43,47 @@ bool IJob::IsAbortable() const
 	return m_Abortable;
 }
 
+void IJob::SetPriority(EJobPriority Priority)
+{
+	dbg_assert(Priority >= PRIORITY_HIGH && Priority < NUM_PRIORITIES, "Job priority invalid");
+	m_Priority = Priority;
+}
+
+IJob::EJobPriority IJob::Priority() const
+{
+	return m_Priority;
+}
+
+CJobGroup::CJobGroup() :
+	m_NumPending(0),
+	m_Started(false),
+	m_Done(false)
+{
+}
+
+void CJobGroup::Add(std::shared_ptr<IJob> pJob)
+{
+	dbg_assert(!m_Started, "Job group already started");
+	m_vpJobs.push_back(std::move(pJob));
+}
+
+void CJobGroup::Then(std::shared_ptr<IJob> pJob)
+{
+	dbg_assert(!m_Started, "Job group already started");
+	m_vpContinuations.push_back(std::move(pJob));
+}
+
+void CJobGroup::OnCompletion(std::function<void()> &&Completion)
+{
+	dbg_assert(!m_Started, "Job group already started");
+	m_Completion = std::move(Completion);
+}
+
+bool CJobGroup::Done() const
+{
+	return m_Done;
+}
+
 CJobPool::CJobPool()
 {
 	m_Shutdown = true;
@@ -57,68 +99,141 @@ CJobPool::~CJobPool()
 
 void CJobPool::WorkerThread(void *pUser)
 {
-	static_cast<CJobPool *>(pUser)->RunLoop();
+	CWorker *pWorker = static_cast<CWorker *>(pUser);
+	pWorker->m_pPool->RunLoop(pWorker->m_Index);
 }
 
-void CJobPool::RunLoop()
+std::shared_ptr<IJob> CJobPool::FetchJob(size_t WorkerIndex)
+{
+	// higher priorities first, for each take from our own queue and
+	// otherwise steal from the back of the other workers' queues
+	const size_t NumWorkers = m_vpWorkers.size();
+	for(int Priority = IJob::PRIORITY_HIGH; Priority < IJob::NUM_PRIORITIES; Priority++)
+	{
+		for(size_t i = 0; i < NumWorkers; i++)
+		{
+			CWorker *pWorker = m_vpWorkers[(WorkerIndex + i) % NumWorkers].get();
+			const CLockScope LockScope(pWorker->m_Lock);
+			std::deque<std::shared_ptr<IJob>> &Queue = pWorker->m_apJobs[Priority];
+			if(Queue.empty())
+				continue;
+			std::shared_ptr<IJob> pJob;
+			if(i == 0)
+			{
+				pJob = std::move(Queue.front());
+				Queue.pop_front();
+			}
+			else
+			{
+				pJob = std::move(Queue.back());
+				Queue.pop_back();
+			}
+			return pJob;
+		}
+	}
+	return nullptr;
+}
+
+void CJobPool::RunJob(const std::shared_ptr<IJob> &pJob)
+{
+	IJob::EJobState OldStateQueued = IJob::STATE_QUEUED;
+	if(!pJob->m_State.compare_exchange_strong(OldStateQueued, IJob::STATE_RUNNING))
+	{
+		if(OldStateQueued == IJob::STATE_ABORTED)
+		{
+			// job was aborted before it was started
+			pJob->m_State = IJob::STATE_ABORTED;
+			FinishJob(pJob.get());
+			return;
+		}
+		dbg_assert(false, "Job state invalid. Job was reused or uninitialized.");
+		dbg_break();
+	}
+
+	// remember running jobs so we can abort them
+	{
+		const CLockScope LockScope(m_LockRunning);
+		m_RunningJobs.push_back(pJob);
+	}
+	const int64_t StartTime = time_get_nanoseconds().count();
+	pJob->Run();
+	const int64_t EndTime = time_get_nanoseconds().count();
+	{
+		const CLockScope LockScope(m_LockRunning);
+		m_RunningJobs.erase(std::find(m_RunningJobs.begin(), m_RunningJobs.end(), pJob));
+	}
+
+	{
+		const int64_t WaitTime = StartTime - pJob->m_QueuedTime;
+		const int64_t RunTime = EndTime - StartTime;
+		const CLockScope LockScope(m_LockStats);
+		CStats &Stats = m_aStats[pJob->m_Priority];
+		Stats.m_NumJobs++;
+		Stats.m_TotalWaitTime += WaitTime;
+		Stats.m_MaxWaitTime = std::max(Stats.m_MaxWaitTime, WaitTime);
+		Stats.m_TotalRunTime += RunTime;
+		Stats.m_MaxRunTime = std::max(Stats.m_MaxRunTime, RunTime);
+	}
+
+	// do not change state to done if job was not completed successfully
+	IJob::EJobState OldStateRunning = IJob::STATE_RUNNING;
+	if(!pJob->m_State.compare_exchange_strong(OldStateRunning, IJob::STATE_DONE))
+	{
+		if(OldStateRunning != IJob::STATE_ABORTED)
+		{
+			dbg_assert(false, "Job state invalid, must be either running or aborted");
+		}
+	}
+
+	FinishJob(pJob.get());
+}
+
+void CJobPool::FinishJob(IJob *pJob)
+{
+	// drop the reference so the group does not outlive its jobs
+	std::shared_ptr<CJobGroup> pGroup = std::move(pJob->m_pGroup);
+	if(pGroup)
+		FinishGroupJob(pGroup);
+}
+
+void CJobPool::FinishGroupJob(const std::shared_ptr<CJobGroup> &pGroup)
+{
+	if(pGroup->m_NumPending.fetch_sub(1) != 1)
+		return;
+
+	// this was the last job of the group
+	pGroup->m_Done = true;
+	for(std::shared_ptr<IJob> &pContinuation : pGroup->m_vpContinuations)
+		Add(std::move(pContinuation));
+	pGroup->m_vpContinuations.clear();
+	if(pGroup->m_Completion)
+	{
+		const CLockScope LockScope(m_LockCompletions);
+		m_vCompletions.push_back(std::move(pGroup->m_Completion));
+	}
+}
+
+void CJobPool::RunLoop(size_t WorkerIndex)
 {
 	while(true)
 	{
 		// wait for job to become available
 		sphore_wait(&m_Semaphore);
 
-		// fetch job from queue
-		std::shared_ptr<IJob> pJob = nullptr;
+		// every signal belongs to one queued job, but another worker may
+		// take ours while we look through the queues, so keep looking
+		std::shared_ptr<IJob> pJob = FetchJob(WorkerIndex);
+		while(!pJob && !m_Shutdown)
 		{
-			const CLockScope LockScope(m_Lock);
-			if(m_pFirstJob)
-			{
-				pJob = m_pFirstJob;
-				m_pFirstJob = m_pFirstJob->m_pNext;
-				// allow remaining objects in list to destruct, even when current object stays alive
-				pJob->m_pNext = nullptr;
-				if(!m_pFirstJob)
-					m_pLastJob = nullptr;
-			}
+			thread_yield();
+			pJob = FetchJob(WorkerIndex);
 		}
 
 		if(pJob)
 		{
-			IJob::EJobState OldStateQueued = IJob::STATE_QUEUED;
-			if(!pJob->m_State.compare_exchange_strong(OldStateQueued, IJob::STATE_RUNNING))
-			{
-				if(OldStateQueued == IJob::STATE_ABORTED)
-				{
-					// job was aborted before it was started
-					pJob->m_State = IJob::STATE_ABORTED;
-					continue;
-				}
-				dbg_assert(false, "Job state invalid. Job was reused or uninitialized.");
-				dbg_break();
-			}
-
-			// remember running jobs so we can abort them
-			{
-				const CLockScope LockScope(m_LockRunning);
-				m_RunningJobs.push_back(pJob);
-			}
-			pJob->Run();
-			{
-				const CLockScope LockScope(m_LockRunning);
-				m_RunningJobs.erase(std::find(m_RunningJobs.begin(), m_RunningJobs.end(), pJob));
-			}
-
-			// do not change state to done if job was not completed successfully
-			IJob::EJobState OldStateRunning = IJob::STATE_RUNNING;
-			if(!pJob->m_State.compare_exchange_strong(OldStateRunning, IJob::STATE_DONE))
-			{
-				if(OldStateRunning != IJob::STATE_ABORTED)
-				{
-					dbg_assert(false, "Job state invalid, must be either running or aborted");
-				}
-			}
+			RunJob(pJob);
 		}
-		else if(m_Shutdown)
+		else
 		{
 			// shut down worker thread when pool is shutting down and no more jobs are left
 			break;
@@ -129,20 +244,27 @@ void CJobPool::RunLoop()
 void CJobPool::Init(int NumThreads)
 {
 	dbg_assert(m_Shutdown, "Job pool already running");
+	dbg_assert(NumThreads > 0, "Job pool needs at least one worker thread");
 	m_Shutdown = false;
 
-	const CLockScope LockScope(m_Lock);
 	sphore_init(&m_Semaphore);
-	m_pFirstJob = nullptr;
-	m_pLastJob = nullptr;
+	m_NextWorker = 0;
+
+	// create all queues before any worker starts stealing from them
+	m_vpWorkers.reserve(NumThreads);
+	for(int i = 0; i < NumThreads; i++)
+	{
+		m_vpWorkers.push_back(std::make_unique<CWorker>());
+		m_vpWorkers.back()->m_pPool = this;
+		m_vpWorkers.back()->m_Index = i;
+	}
 
 	// start worker threads
 	char aName[16]; // unix kernel length limit
-	m_vpThreads.reserve(NumThreads);
 	for(int i = 0; i < NumThreads; i++)
 	{
 		str_format(aName, sizeof(aName), "CJobPool W%d", i);
-		m_vpThreads.push_back(thread_init(WorkerThread, this, aName));
+		m_vpWorkers[i]->m_pThread = thread_init(WorkerThread, m_vpWorkers[i].get(), aName);
 	}
 }
 
@@ -151,35 +273,25 @@ void CJobPool::Shutdown()
 	dbg_assert(!m_Shutdown, "Job pool already shut down");
 	m_Shutdown = true;
 
-	// abort queued jobs
+	// abort queued jobs, only remove abortable jobs from queue
+	std::vector<std::shared_ptr<IJob>> vpAborted;
+	for(const std::unique_ptr<CWorker> &pWorker : m_vpWorkers)
 	{
-		const CLockScope LockScope(m_Lock);
-		std::shared_ptr<IJob> pJob = m_pFirstJob;
-		std::shared_ptr<IJob> pPrev = nullptr;
-		while(pJob != nullptr)
+		const CLockScope LockScope(pWorker->m_Lock);
+		for(std::deque<std::shared_ptr<IJob>> &Queue : pWorker->m_apJobs)
 		{
-			std::shared_ptr<IJob> pNext = pJob->m_pNext;
-			if(pJob->Abort())
-			{
-				// only remove abortable jobs from queue
-				pJob->m_pNext = nullptr;
-				if(pPrev)
-				{
-					pPrev->m_pNext = pNext;
-				}
-				else
-				{
-					m_pFirstJob = pNext;
-				}
-			}
-			else
-			{
-				pPrev = pJob;
-			}
-			pJob = pNext;
+			Queue.erase(std::remove_if(Queue.begin(), Queue.end(), [&](const std::shared_ptr<IJob> &pJob) {
+				if(!pJob->Abort())
+					return false;
+				vpAborted.push_back(pJob);
+				return true;
+			}),
+				Queue.end());
 		}
-		m_pLastJob = pPrev;
 	}
+	// outside of the queue locks, as this may queue continuations
+	for(const std::shared_ptr<IJob> &pJob : vpAborted)
+		FinishJob(pJob.get());
 
 	// abort running jobs
 	{
@@ -191,18 +303,18 @@ void CJobPool::Shutdown()
 	}
 
 	// wake up all worker threads
-	for(size_t i = 0; i < m_vpThreads.size(); i++)
+	for(size_t i = 0; i < m_vpWorkers.size(); i++)
 	{
 		sphore_signal(&m_Semaphore);
 	}
 
 	// wait for all worker threads to finish
-	for(void *pThread : m_vpThreads)
+	for(const std::unique_ptr<CWorker> &pWorker : m_vpWorkers)
 	{
-		thread_wait(pThread);
+		thread_wait(pWorker->m_pThread);
 	}
 
-	m_vpThreads.clear();
+	m_vpWorkers.clear();
 	sphore_destroy(&m_Semaphore);
 }
 
@@ -212,19 +324,55 @@ void CJobPool::Add(std::shared_ptr<IJob> pJob)
 	{
 		// no jobs are accepted when the job pool is already shutting down
 		pJob->Abort();
+		FinishJob(pJob.get());
 		return;
 	}
 
-	// add job to queue
+	// add job to the queue of the next worker
+	pJob->m_QueuedTime = time_get_nanoseconds().count();
+	CWorker *pWorker = m_vpWorkers[m_NextWorker.fetch_add(1) % m_vpWorkers.size()].get();
 	{
-		const CLockScope LockScope(m_Lock);
-		if(m_pLastJob)
-			m_pLastJob->m_pNext = pJob;
-		m_pLastJob = std::move(pJob);
-		if(!m_pFirstJob)
-			m_pFirstJob = m_pLastJob;
+		const CLockScope LockScope(pWorker->m_Lock);
+		pWorker->m_apJobs[pJob->m_Priority].push_back(std::move(pJob));
 	}
 
 	// signal a worker thread that a job is available
 	sphore_signal(&m_Semaphore);
 }
+
+void CJobPool::AddGroup(std::shared_ptr<CJobGroup> pGroup)
+{
+	const bool WasStarted = pGroup->m_Started.exchange(true);
+	dbg_assert(!WasStarted, "Job group already started");
+
+	// the extra pending count keeps the group from completing while its
+	// jobs are still being added
+	std::vector<std::shared_ptr<IJob>> vpJobs = std::move(pGroup->m_vpJobs);
+	pGroup->m_vpJobs.clear();
+	pGroup->m_NumPending = vpJobs.size() + 1;
+	for(std::shared_ptr<IJob> &pJob : vpJobs)
+	{
+		dbg_assert(!pJob->m_pGroup, "Job already belongs to a group");
+		pJob->m_pGroup = pGroup;
+		Add(std::move(pJob));
+	}
+	FinishGroupJob(pGroup);
+}
+
+void CJobPool::RunCompletions()
+{
+	std::vector<std::function<void()>> vCompletions;
+	{
+		const CLockScope LockScope(m_LockCompletions);
+		std::swap(vCompletions, m_vCompletions);
+	}
+	for(std::function<void()> &Completion : vCompletions)
+		Completion();
+}
+
+CJobPool::CStats CJobPool::Stats(IJob::EJobPriority Priority)
+{
+	dbg_assert(Priority >= IJob::PRIORITY_HIGH && Priority < IJob::NUM_PRIORITIES, "Job priority invalid");
+	const CLockScope LockScope(m_LockStats);
+	return m_aStats[Priority];
+}
@@ -8,9 +8,12 @@
 
 #include <atomic>
 #include <deque>
+#include <functional>
 #include <memory>
 #include <vector>
 
+class CJobGroup;
+
 /**
  * A job which runs in a worker thread of a job pool.
  *
@@ -50,10 +53,36 @@ public:
 		STATE_ABORTED,
 	};
 
+	/**
+	 * The priority class of a job. Queued jobs are always started before
+	 * queued jobs of a lower priority.
+	 */
+	enum EJobPriority
+	{
+		/**
+		 * Latency sensitive work which something is waiting for.
+		 */
+		PRIORITY_HIGH = 0,
+
+		/**
+		 * Default priority.
+		 */
+		PRIORITY_NORMAL,
+
+		/**
+		 * Bulk work like loading assets, which may be delayed.
+		 */
+		PRIORITY_LOW,
+
+		NUM_PRIORITIES,
+	};
+
 private:
-	std::shared_ptr<IJob> m_pNext;
 	std::atomic<EJobState> m_State;
 	std::atomic<bool> m_Abortable;
+	EJobPriority m_Priority;
+	int64_t m_QueuedTime;
+	std::shared_ptr<CJobGroup> m_pGroup;
 
 protected:
 	/**
@@ -70,6 +99,15 @@ protected:
 	 */
 	void Abortable(bool Abortable);
 
+	/**
+	 * Sets the priority class of this job.
+	 *
+	 * @remark Must be called before the job is added to a job pool.
+	 *
+	 * @see Priority
+	 */
+	void SetPriority(EJobPriority Priority);
+
 public:
 	IJob();
 	virtual ~IJob();
@@ -117,28 +155,136 @@ public:
 	 * @return `true` if the job can be aborted, `false` otherwise.
 	 */
 	bool IsAbortable() const;
+
+	/**
+	 * Returns the priority class of the job, @link PRIORITY_NORMAL @endlink
+	 * unless set otherwise.
+	 *
+	 * @return Priority of the job.
+	 */
+	EJobPriority Priority() const;
+};
+
+/**
+ * A group of jobs which run in parallel. Once all of them are done,
+ * the continuation jobs are added to the job pool and the completion
+ * callback is handed to the thread which calls
+ * @link CJobPool::RunCompletions @endlink.
+ *
+ * Jobs which are aborted count as done.
+ *
+ * @see CJobPool::AddGroup
+ */
+class CJobGroup
+{
+	friend class CJobPool;
+
+	std::vector<std::shared_ptr<IJob>> m_vpJobs;
+	std::vector<std::shared_ptr<IJob>> m_vpContinuations;
+	std::function<void()> m_Completion;
+	std::atomic<size_t> m_NumPending;
+	std::atomic<bool> m_Started;
+	std::atomic<bool> m_Done;
+
+public:
+	CJobGroup();
+
+	/**
+	 * Adds a job to the group.
+	 *
+	 * @param pJob The job, which must not have been added to a job pool.
+	 *
+	 * @remark Must be called before the group is added to a job pool.
+	 */
+	void Add(std::shared_ptr<IJob> pJob);
+
+	/**
+	 * Adds a job which is only started after all jobs of the group are done.
+	 *
+	 * @param pJob The continuation job.
+	 *
+	 * @remark Must be called before the group is added to a job pool.
+	 */
+	void Then(std::shared_ptr<IJob> pJob);
+
+	/**
+	 * Sets a callback which runs once all jobs of the group are done.
+	 *
+	 * @param Completion The callback, which runs in
+	 * @link CJobPool::RunCompletions @endlink.
+	 *
+	 * @remark Must be called before the group is added to a job pool.
+	 */
+	void OnCompletion(std::function<void()> &&Completion);
+
+	/**
+	 * Returns whether all jobs of the group are done. The continuations
+	 * may still be queued or running.
+	 *
+	 * @return `true` if the group is done, `false` otherwise.
+	 */
+	bool Done() const;
 };
 
 /**
  * A job pool which runs jobs in one or more worker threads.
  *
+ * Every worker thread has its own queues, one per priority. Jobs are
+ * distributed round-robin over the workers and idle workers steal jobs
+ * from the others, so adding and fetching jobs rarely contend on a lock.
+ *
  * @see IJob
  */
 class CJobPool
 {
-	std::vector<void *> m_vpThreads;
+public:
+	/**
+	 * Timing statistics of the jobs of one priority which have been run.
+	 * Times are in nanoseconds.
+	 */
+	class CStats
+	{
+	public:
+		int64_t m_NumJobs = 0;
+		int64_t m_TotalWaitTime = 0;
+		int64_t m_MaxWaitTime = 0;
+		int64_t m_TotalRunTime = 0;
+		int64_t m_MaxRunTime = 0;
+	};
+
+private:
+	class CWorker
+	{
+	public:
+		CJobPool *m_pPool;
+		size_t m_Index;
+		void *m_pThread;
+
+		CLock m_Lock;
+		std::deque<std::shared_ptr<IJob>> m_apJobs[IJob::NUM_PRIORITIES] GUARDED_BY(m_Lock);
+	};
+
+	std::vector<std::unique_ptr<CWorker>> m_vpWorkers;
+	std::atomic<size_t> m_NextWorker;
 	std::atomic<bool> m_Shutdown;
 
-	CLock m_Lock;
 	SEMAPHORE m_Semaphore;
-	std::shared_ptr<IJob> m_pFirstJob GUARDED_BY(m_Lock);
-	std::shared_ptr<IJob> m_pLastJob GUARDED_BY(m_Lock);
 
 	CLock m_LockRunning;
 	std::deque<std::shared_ptr<IJob>> m_RunningJobs GUARDED_BY(m_LockRunning);
 
+	CLock m_LockStats;
+	CStats m_aStats[IJob::NUM_PRIORITIES] GUARDED_BY(m_LockStats);
+
+	CLock m_LockCompletions;
+	std::vector<std::function<void()>> m_vCompletions GUARDED_BY(m_LockCompletions);
+
 	static void WorkerThread(void *pUser) NO_THREAD_SAFETY_ANALYSIS;
-	void RunLoop() NO_THREAD_SAFETY_ANALYSIS;
+	void RunLoop(size_t WorkerIndex) NO_THREAD_SAFETY_ANALYSIS;
+	std::shared_ptr<IJob> FetchJob(size_t WorkerIndex);
+	void RunJob(const std::shared_ptr<IJob> &pJob) REQUIRES(!m_LockRunning) REQUIRES(!m_LockStats) REQUIRES(!m_LockCompletions);
+	void FinishJob(IJob *pJob) REQUIRES(!m_LockCompletions);
+	void FinishGroupJob(const std::shared_ptr<CJobGroup> &pGroup) REQUIRES(!m_LockCompletions);
 
 public:
 	CJobPool();
@@ -151,7 +297,7 @@ public:
 	 *
 	 * @remark Must be called on the main thread.
 	 */
-	void Init(int NumThreads) REQUIRES(!m_Lock);
+	void Init(int NumThreads);
 
 	/**
 	 * Shuts down the job pool. Aborts all abortable jobs. Then waits for all
@@ -159,7 +305,7 @@ public:
 	 *
 	 * @remark Must be called on the main thread.
 	 */
-	void Shutdown() REQUIRES(!m_Lock) REQUIRES(!m_LockRunning);
+	void Shutdown() REQUIRES(!m_LockRunning) REQUIRES(!m_LockCompletions);
 
 	/**
 	 * Adds a job to the queue of the job pool.
@@ -169,6 +315,35 @@ public:
 	 * @remark If the job pool is already shutting down, no additional jobs
 	 * will be enqueue anymore. Abortable jobs will immediately be aborted.
 	 */
-	void Add(std::shared_ptr<IJob> pJob) REQUIRES(!m_Lock);
+	void Add(std::shared_ptr<IJob> pJob) REQUIRES(!m_LockCompletions);
+
+	/**
+	 * Adds all jobs of a group to the queue of the job pool.
+	 *
+	 * @param pGroup The group to start.
+	 *
+	 * @remark A group can only be added once. If the job pool is already
+	 * shutting down, the group completes without running its jobs.
+	 *
+	 * @see Add
+	 */
+	void AddGroup(std::shared_ptr<CJobGroup> pGroup) REQUIRES(!m_LockCompletions);
+
+	/**
+	 * Runs the completion callbacks of the job groups which are done.
+	 *
+	 * @remark Callbacks run on the calling thread, which should be the main thread.
+	 */
+	void RunCompletions() REQUIRES(!m_LockCompletions);
+
+	/**
+	 * Returns the timing statistics of all jobs of a priority which have
+	 * been run so far.
+	 *
+	 * @param Priority The priority class.
+	 *
+	 * @return The statistics.
+	 */
+	CStats Stats(IJob::EJobPriority Priority) REQUIRES(!m_LockStats);
 };
 #endif
@@ -4,6 +4,7 @@
 
 #include <base/log.h>
 
+#include <engine/engine.h>
 #include <engine/storage.h>
 
 #include <game/mapitems.h>
@@ -40,6 +41,11 @@ int CMap::NumData() const
 	return m_DataFile.NumData();
 }
 
+void CMap::StartDecompression(int Index)
+{
+	m_DataFile.StartDecompression(Kernel()->RequestInterface<IEngine>(), Index);
+}
+
 int CMap::GetItemSize(int Index)
 {
 	return m_DataFile.GetItemSize(Index);
@@ -79,7 +85,7 @@ bool CMap::Load(const char *pMapName)
 	// Ensure current datafile is not left in an inconsistent state if loading fails,
 	// by loading the new datafile separately first.
 	CDataFileReader NewDataFile;
-	if(!NewDataFile.Open(pStorage, pMapName, IStorage::TYPE_ALL))
+	if(!NewDataFile.Open(pStorage, pMapName, IStorage::TYPE_ALL, true))
 		return false;
 
 	// Check version
@@ -91,10 +97,22 @@ bool CMap::Load(const char *pMapName)
 		return false;
 	}
 
+	// Decompress the tile layers in parallel, they are all used right away
+	int LayersStart, LayersNum;
+	NewDataFile.GetType(MAPITEMTYPE_LAYER, &LayersStart, &LayersNum);
+	IEngine *pEngine = Kernel()->RequestInterface<IEngine>();
+	for(int l = 0; l < LayersNum; l++)
+	{
+		const CMapItemLayer *pLayer = static_cast<CMapItemLayer *>(NewDataFile.GetItem(LayersStart + l));
+		if(pLayer->m_Type == LAYERTYPE_TILES)
+		{
+			NewDataFile.StartDecompression(pEngine, reinterpret_cast<const CMapItemLayerTilemap *>(pLayer)->m_Data);
+		}
+	}
+
 	// Replace compressed tile layers with uncompressed ones
-	int GroupsStart, GroupsNum, LayersStart, LayersNum;
+	int GroupsStart, GroupsNum;
 	NewDataFile.GetType(MAPITEMTYPE_GROUP, &GroupsStart, &GroupsNum);
-	NewDataFile.GetType(MAPITEMTYPE_LAYER, &LayersStart, &LayersNum);
 	for(int g = 0; g < GroupsNum; g++)
 	{
 		const CMapItemGroup *pGroup = static_cast<CMapItemGroup *>(NewDataFile.GetItem(GroupsStart + g));
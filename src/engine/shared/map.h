@@ -23,6 +23,7 @@ public:
 	const char *GetDataString(int Index) override;
 	void UnloadData(int Index) override;
 	int NumData() const override;
+	void StartDecompression(int Index) override;
 
 	int GetItemSize(int Index) override;
 	void *GetItem(int Index, int *pType = nullptr, int *pId = nullptr) override;
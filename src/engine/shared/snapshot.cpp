@@ -4,8 +4,10 @@
 #include "compression.h"
 #include "uuid_manager.h"
 
+#include <cstddef>
 #include <cstdlib>
 #include <limits>
+#include <new>
 
 #include <base/math.h>
 #include <base/system.h>
@@ -13,6 +15,16 @@
 #include <game/generated/protocol7.h>
 #include <game/generated/protocolglue.h>
 
+// SSE2 and NEON are part of the baseline of these architectures, so they
+// need no runtime detection. Other architectures use the scalar loops.
+#if defined(CONF_ARCH_AMD64) || (defined(CONF_ARCH_IA32) && defined(__SSE2__))
+#define SNAPSHOT_SSE2 1
+#include <emmintrin.h>
+#elif defined(CONF_ARCH_ARM64) || (defined(CONF_ARCH_ARM) && defined(__ARM_NEON))
+#define SNAPSHOT_NEON 1
+#include <arm_neon.h>
+#endif
+
 // CSnapshot
 
 const CSnapshotItem *CSnapshot::GetItem(int Index) const
@@ -57,7 +69,7 @@ int CSnapshot::GetExternalItemType(int InternalType) const
 
 int CSnapshot::GetItemIndex(int Key) const
 {
-	// TODO: OPT: this should not be a linear search. very bad
+	// use a CSnapshotIndex for repeated lookups
 	for(int i = 0; i < m_NumItems; i++)
 	{
 		if(GetItem(i)->Key() == Key)
@@ -71,7 +83,7 @@ void CSnapshot::InvalidateItem(int Index)
 	((CSnapshotItem *)(DataStart() + Offsets()[Index]))->Invalidate();
 }
 
-const void *CSnapshot::FindItem(int Type, int Id) const
+const void *CSnapshot::FindItem(int Type, int Id, const CSnapshotIndex *pIndex) const
 {
 	int InternalType = Type;
 	if(Type >= OFFSET_UUID)
@@ -100,7 +112,8 @@ const void *CSnapshot::FindItem(int Type, int Id) const
 			return nullptr;
 		}
 	}
-	int Index = GetItemIndex((InternalType << 16) | Id);
+	const int Key = (InternalType << 16) | Id;
+	const int Index = pIndex ? pIndex->Find(Key) : GetItemIndex(Key);
 	return Index < 0 ? nullptr : GetItem(Index)->Data();
 }
 
@@ -159,63 +172,92 @@ bool CSnapshot::IsValid(size_t ActualSize) const
 	return true;
 }
 
-// CSnapshotDelta
+// CSnapshotIndex
 
-enum
+unsigned CSnapshotIndex::Hash(int Key)
 {
-	HASHLIST_SIZE = 256,
-	HASHLIST_BUCKET_SIZE = 64,
-};
+	// keys are (type << 16) | id, mix the type into the low bits
+	const unsigned Hash = (unsigned)Key * 0x9e3779b1u;
+	return Hash ^ (Hash >> 16);
+}
 
-struct CItemList
+void CSnapshotIndex::Clear(int NumItems)
 {
-	int m_Num;
-	int m_aKeys[HASHLIST_BUCKET_SIZE];
-	int m_aIndex[HASHLIST_BUCKET_SIZE];
-};
+	dbg_assert(NumItems >= 0 && NumItems <= CSnapshot::MAX_ITEMS, "too many items for snapshot index");
+	// keep the load factor at or below one half
+	unsigned Size = MIN_SIZE;
+	while(Size < 2 * (unsigned)NumItems)
+		Size *= 2;
+	m_Mask = Size - 1;
+	for(unsigned i = 0; i < Size; i++)
+		m_aIndices[i] = -1;
+}
 
-inline size_t CalcHashId(int Key)
+void CSnapshotIndex::Build(const CSnapshot *pSnapshot)
 {
-	// djb2 (http://www.cse.yorku.ca/~oz/hash.html)
-	unsigned Hash = 5381;
-	for(unsigned Shift = 0; Shift < sizeof(int); Shift++)
-		Hash = ((Hash << 5) + Hash) + ((Key >> (Shift * 8)) & 0xFF);
-	return Hash % HASHLIST_SIZE;
+	Clear(pSnapshot->NumItems());
+	for(int i = 0; i < pSnapshot->NumItems(); i++)
+		Add(pSnapshot->GetItem(i)->Key(), i);
 }
 
-static void GenerateHash(CItemList *pHashlist, const CSnapshot *pSnapshot)
+void CSnapshotIndex::Add(int Key, int Index)
 {
-	for(int i = 0; i < HASHLIST_SIZE; i++)
-		pHashlist[i].m_Num = 0;
-
-	for(int i = 0; i < pSnapshot->NumItems(); i++)
+	for(unsigned Slot = Hash(Key) & m_Mask;; Slot = (Slot + 1) & m_Mask)
 	{
-		int Key = pSnapshot->GetItem(i)->Key();
-		size_t HashId = CalcHashId(Key);
-		if(pHashlist[HashId].m_Num < HASHLIST_BUCKET_SIZE)
+		if(m_aIndices[Slot] == -1)
 		{
-			pHashlist[HashId].m_aIndex[pHashlist[HashId].m_Num] = i;
-			pHashlist[HashId].m_aKeys[pHashlist[HashId].m_Num] = Key;
-			pHashlist[HashId].m_Num++;
+			m_aKeys[Slot] = Key;
+			m_aIndices[Slot] = Index;
+			return;
 		}
+		if(m_aKeys[Slot] == Key)
+			return;
 	}
 }
 
-static int GetItemIndexHashed(int Key, const CItemList *pHashlist)
+int CSnapshotIndex::Find(int Key) const
 {
-	size_t HashId = CalcHashId(Key);
-	for(int i = 0; i < pHashlist[HashId].m_Num; i++)
+	for(unsigned Slot = Hash(Key) & m_Mask;; Slot = (Slot + 1) & m_Mask)
 	{
-		if(pHashlist[HashId].m_aKeys[i] == Key)
-			return pHashlist[HashId].m_aIndex[i];
+		if(m_aIndices[Slot] == -1)
+			return -1;
+		if(m_aKeys[Slot] == Key)
+			return m_aIndices[Slot];
 	}
-
-	return -1;
 }
 
+// CSnapshotDelta
+
 int CSnapshotDelta::DiffItem(const int *pPast, const int *pCurrent, int *pOut, int Size)
 {
 	int Needed = 0;
+#if defined(SNAPSHOT_SSE2)
+	__m128i Needed4 = _mm_setzero_si128();
+	for(; Size >= 4; Size -= 4)
+	{
+		const __m128i Diff = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)pCurrent), _mm_loadu_si128((const __m128i *)pPast));
+		_mm_storeu_si128((__m128i *)pOut, Diff);
+		Needed4 = _mm_or_si128(Needed4, Diff);
+		pOut += 4;
+		pPast += 4;
+		pCurrent += 4;
+	}
+	Needed4 = _mm_or_si128(Needed4, _mm_shuffle_epi32(Needed4, _MM_SHUFFLE(1, 0, 3, 2)));
+	Needed4 = _mm_or_si128(Needed4, _mm_shuffle_epi32(Needed4, _MM_SHUFFLE(2, 3, 0, 1)));
+	Needed = _mm_cvtsi128_si32(Needed4);
+#elif defined(SNAPSHOT_NEON)
+	int32x4_t Needed4 = vdupq_n_s32(0);
+	for(; Size >= 4; Size -= 4)
+	{
+		const int32x4_t Diff = vsubq_s32(vld1q_s32(pCurrent), vld1q_s32(pPast));
+		vst1q_s32(pOut, Diff);
+		Needed4 = vorrq_s32(Needed4, Diff);
+		pOut += 4;
+		pPast += 4;
+		pCurrent += 4;
+	}
+	Needed = vgetq_lane_s32(Needed4, 0) | vgetq_lane_s32(Needed4, 1) | vgetq_lane_s32(Needed4, 2) | vgetq_lane_s32(Needed4, 3);
+#endif
 	while(Size)
 	{
 		// subtraction with wrapping by casting to unsigned
@@ -230,27 +272,66 @@ int CSnapshotDelta::DiffItem(const int *pPast, const int *pCurrent, int *pOut, i
 	return Needed;
 }
 
+// number of bytes CVariableInt::Pack needs for a value
+static inline int PackedSize(int Value)
+{
+	const unsigned Magnitude = Value < 0 ? ~(unsigned)Value : (unsigned)Value;
+	return 1 + (Magnitude >= (1u << 6)) + (Magnitude >= (1u << 13)) + (Magnitude >= (1u << 20)) + (Magnitude >= (1u << 27));
+}
+
+// bits UnpackDelta accounts for the diffed ints, unchanged ints count as one
+static inline uint64_t DataRateOf(const int *pDiff, int Size)
+{
+	uint64_t DataRate = 0;
+	for(int i = 0; i < Size; i++)
+		DataRate += pDiff[i] == 0 ? 1 : PackedSize(pDiff[i]) * 8;
+	return DataRate;
+}
+
 void CSnapshotDelta::UndiffItem(const int *pPast, const int *pDiff, int *pOut, int Size, uint64_t *pDataRate)
 {
+	uint64_t DataRate = 0;
+#if defined(SNAPSHOT_SSE2)
+	for(; Size >= 4; Size -= 4)
+	{
+		const __m128i Diff = _mm_loadu_si128((const __m128i *)pDiff);
+		_mm_storeu_si128((__m128i *)pOut, _mm_add_epi32(_mm_loadu_si128((const __m128i *)pPast), Diff));
+		// most ints don't change between snapshots and count one bit each
+		if(_mm_movemask_epi8(_mm_cmpeq_epi32(Diff, _mm_setzero_si128())) == 0xffff)
+			DataRate += 4;
+		else
+			DataRate += DataRateOf(pDiff, 4);
+		pOut += 4;
+		pPast += 4;
+		pDiff += 4;
+	}
+#elif defined(SNAPSHOT_NEON)
+	for(; Size >= 4; Size -= 4)
+	{
+		const int32x4_t Diff = vld1q_s32(pDiff);
+		vst1q_s32(pOut, vaddq_s32(vld1q_s32(pPast), Diff));
+		// most ints don't change between snapshots and count one bit each
+		const int32x2_t Any = vorr_s32(vget_low_s32(Diff), vget_high_s32(Diff));
+		if((vget_lane_s32(Any, 0) | vget_lane_s32(Any, 1)) == 0)
+			DataRate += 4;
+		else
+			DataRate += DataRateOf(pDiff, 4);
+		pOut += 4;
+		pPast += 4;
+		pDiff += 4;
+	}
+#endif
+	DataRate += DataRateOf(pDiff, Size);
 	while(Size)
 	{
 		// addition with wrapping by casting to unsigned
 		*pOut = (unsigned)*pPast + (unsigned)*pDiff;
-
-		if(*pDiff == 0)
-			*pDataRate += 1;
-		else
-		{
-			unsigned char aBuf[CVariableInt::MAX_BYTES_PACKED];
-			unsigned char *pEnd = CVariableInt::Pack(aBuf, *pDiff, sizeof(aBuf));
-			*pDataRate += (uint64_t)(pEnd - (unsigned char *)aBuf) * 8;
-		}
-
 		pOut++;
 		pPast++;
 		pDiff++;
 		Size--;
 	}
+	*pDataRate += DataRate;
 }
 
 CSnapshotDelta::CSnapshotDelta()
@@ -290,7 +371,6 @@ const CSnapshotDelta::CData *CSnapshotDelta::EmptyDelta() const
 	return &m_Empty;
 }
 
-// TODO: OPT: this should be made much faster
 int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, const CSnapshot *pTo, void *pDstData)
 {
 	CData *pDelta = (CData *)pDstData;
@@ -300,14 +380,14 @@ int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, const CSnapshot *pTo, vo
 	pDelta->m_NumUpdateItems = 0;
 	pDelta->m_NumTempItems = 0;
 
-	CItemList aHashlist[HASHLIST_SIZE];
-	GenerateHash(aHashlist, pTo);
+	CSnapshotIndex Index;
+	Index.Build(pTo);
 
 	// pack deleted stuff
 	for(int i = 0; i < pFrom->NumItems(); i++)
 	{
 		const CSnapshotItem *pFromItem = pFrom->GetItem(i);
-		if(GetItemIndexHashed(pFromItem->Key(), aHashlist) == -1)
+		if(Index.Find(pFromItem->Key()) == -1)
 		{
 			// deleted
 			pDelta->m_NumDeletedItems++;
@@ -316,7 +396,7 @@ int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, const CSnapshot *pTo, vo
 		}
 	}
 
-	GenerateHash(aHashlist, pFrom);
+	Index.Build(pFrom);
 
 	// fetch previous indices
 	// we do this as a separate pass because it helps the cache
@@ -324,15 +404,15 @@ int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, const CSnapshot *pTo, vo
 	const int NumItems = pTo->NumItems();
 	for(int i = 0; i < NumItems; i++)
 	{
-		const CSnapshotItem *pCurItem = pTo->GetItem(i); // O(1) .. O(n)
-		aPastIndices[i] = GetItemIndexHashed(pCurItem->Key(), aHashlist); // O(n) .. O(n^n)
+		const CSnapshotItem *pCurItem = pTo->GetItem(i);
+		aPastIndices[i] = Index.Find(pCurItem->Key());
 	}
 
 	for(int i = 0; i < NumItems; i++)
 	{
 		// do delta
-		const int ItemSize = pTo->GetItemSize(i); // O(1) .. O(n)
-		const CSnapshotItem *pCurItem = pTo->GetItem(i); // O(1) .. O(n)
+		const int ItemSize = pTo->GetItemSize(i);
+		const CSnapshotItem *pCurItem = pTo->GetItem(i);
 		const int PastIndex = aPastIndices[i];
 		const bool IncludeSize = pCurItem->Type() >= MAX_NETOBJSIZES || !m_aItemSizes[pCurItem->Type()];
 
@@ -515,6 +595,9 @@ int CSnapshotDelta::UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const vo
 	CSnapshotBuilder Builder;
 	Builder.Init();
 
+	CSnapshotIndex FromItems;
+	FromItems.Build(pFrom);
+
 	// unpack deleted stuff
 	int *pDeleted = pData;
 	if(pDelta->m_NumDeletedItems < 0)
@@ -523,22 +606,21 @@ int CSnapshotDelta::UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const vo
 	if(pData > pEnd)
 		return -101;
 
+	bool aDeleted[CSnapshot::MAX_ITEMS] = {};
+	for(int d = 0; d < pDelta->m_NumDeletedItems; d++)
+	{
+		const int Index = FromItems.Find(pDeleted[d]);
+		if(Index != -1)
+			aDeleted[Index] = true;
+	}
+
 	// copy all non deleted stuff
 	for(int i = 0; i < pFrom->NumItems(); i++)
 	{
 		const CSnapshotItem *pFromItem = pFrom->GetItem(i);
 		const int ItemSize = pFrom->GetItemSize(i);
-		bool Keep = true;
-		for(int d = 0; d < pDelta->m_NumDeletedItems; d++)
-		{
-			if(pDeleted[d] == pFromItem->Key())
-			{
-				Keep = false;
-				break;
-			}
-		}
-
-		if(Keep)
+		// the index holds the first item of each key, so duplicates share its fate
+		if(!aDeleted[FromItems.Find(pFromItem->Key())])
 		{
 			void *pObj = Builder.NewItem(pFromItem->Type(), pFromItem->Id(), ItemSize);
 			if(!pObj)
@@ -589,7 +671,7 @@ int CSnapshotDelta::UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const vo
 		if(!pNewData)
 			return -302;
 
-		const int FromIndex = pFrom->GetItemIndex(Key);
+		const int FromIndex = FromItems.Find(Key);
 		if(FromIndex != -1)
 		{
 			// we got an update so we need to apply the diff
@@ -611,10 +693,68 @@ int CSnapshotDelta::UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const vo
 
 // CSnapshotStorage
 
+static size_t AlignStorageSize(size_t Size)
+{
+	return (Size + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+}
+
 void CSnapshotStorage::Init()
 {
 	m_pFirst = nullptr;
 	m_pLast = nullptr;
+	m_pCurrentChunk = nullptr;
+	m_pFreeChunks = nullptr;
+	m_NumAllocations = 0;
+}
+
+void *CSnapshotStorage::Allocate(size_t Size, CChunk **ppChunk)
+{
+	const size_t HeaderSize = AlignStorageSize(sizeof(CChunk));
+	Size = AlignStorageSize(Size);
+	dbg_assert(HeaderSize + Size <= (size_t)CHUNK_SIZE, "Snapshot holder too large for chunk");
+
+	if(!m_pCurrentChunk || m_pCurrentChunk->m_Used + Size > (size_t)CHUNK_SIZE)
+	{
+		if(m_pCurrentChunk && m_pCurrentChunk->m_NumHolders == 0)
+		{
+			// everything in it was purged already, start over
+			m_pCurrentChunk->m_Used = HeaderSize;
+		}
+		else
+		{
+			// the previous chunk is released once its last holder is purged
+			CChunk *pChunk = m_pFreeChunks;
+			if(pChunk)
+			{
+				m_pFreeChunks = pChunk->m_pNext;
+			}
+			else
+			{
+				pChunk = static_cast<CChunk *>(malloc(CHUNK_SIZE));
+				m_NumAllocations++;
+			}
+			pChunk->m_pNext = nullptr;
+			pChunk->m_Used = HeaderSize;
+			pChunk->m_NumHolders = 0;
+			m_pCurrentChunk = pChunk;
+		}
+	}
+
+	void *pData = (char *)m_pCurrentChunk + m_pCurrentChunk->m_Used;
+	m_pCurrentChunk->m_Used += Size;
+	m_pCurrentChunk->m_NumHolders++;
+	*ppChunk = m_pCurrentChunk;
+	return pData;
+}
+
+void CSnapshotStorage::Release(CChunk *pChunk)
+{
+	pChunk->m_NumHolders--;
+	if(pChunk->m_NumHolders == 0 && pChunk != m_pCurrentChunk)
+	{
+		pChunk->m_pNext = m_pFreeChunks;
+		m_pFreeChunks = pChunk;
+	}
 }
 
 void CSnapshotStorage::PurgeAll()
@@ -622,12 +762,20 @@ void CSnapshotStorage::PurgeAll()
 	while(m_pFirst)
 	{
 		CHolder *pNext = m_pFirst->m_pNext;
-		free(m_pFirst->m_pSnap);
-		free(m_pFirst->m_pAltSnap);
-		free(m_pFirst);
+		Release(m_pFirst->m_pChunk);
 		m_pFirst = pNext;
 	}
 	m_pLast = nullptr;
+
+	// give the memory back, this is not part of the steady state
+	while(m_pFreeChunks)
+	{
+		CChunk *pNext = m_pFreeChunks->m_pNext;
+		free(m_pFreeChunks);
+		m_pFreeChunks = pNext;
+	}
+	free(m_pCurrentChunk);
+	m_pCurrentChunk = nullptr;
 }
 
 void CSnapshotStorage::PurgeUntil(int Tick)
@@ -639,9 +787,7 @@ void CSnapshotStorage::PurgeUntil(int Tick)
 		CHolder *pNext = pHolder->m_pNext;
 		if(pHolder->m_Tick >= Tick)
 			return; // no more to remove
-		free(pHolder->m_pSnap);
-		free(pHolder->m_pAltSnap);
-		free(pHolder);
+		Release(pHolder->m_pChunk);
 
 		// did we come to the end of the list?
 		if(!pNext)
@@ -662,24 +808,36 @@ void CSnapshotStorage::Add(int Tick, int64_t Tagtime, size_t DataSize, const voi
 	dbg_assert(DataSize <= (size_t)CSnapshot::MAX_SIZE, "Snapshot data size invalid");
 	dbg_assert(AltDataSize <= (size_t)CSnapshot::MAX_SIZE, "Alt snapshot data size invalid");
 
-	CHolder *pHolder = static_cast<CHolder *>(malloc(sizeof(CHolder)));
+	// holder, snapshot, alt snapshot and its index share one allocation
+	const size_t HolderSize = AlignStorageSize(sizeof(CHolder));
+	const size_t SnapSize = AlignStorageSize(DataSize);
+	const size_t AltSnapSize = AlignStorageSize(AltDataSize);
+	const size_t TotalSize = HolderSize + SnapSize + (AltDataSize ? AltSnapSize + sizeof(CSnapshotIndex) : 0);
+	CChunk *pChunk;
+	char *pBlock = static_cast<char *>(Allocate(TotalSize, &pChunk));
+
+	CHolder *pHolder = reinterpret_cast<CHolder *>(pBlock);
+	pHolder->m_pChunk = pChunk;
 	pHolder->m_Tick = Tick;
 	pHolder->m_Tagtime = Tagtime;
 
-	pHolder->m_pSnap = static_cast<CSnapshot *>(malloc(DataSize));
+	pHolder->m_pSnap = reinterpret_cast<CSnapshot *>(pBlock + HolderSize);
 	mem_copy(pHolder->m_pSnap, pData, DataSize);
 	pHolder->m_SnapSize = DataSize;
 
 	if(AltDataSize) // create alternative if wanted
 	{
-		pHolder->m_pAltSnap = static_cast<CSnapshot *>(malloc(AltDataSize));
+		pHolder->m_pAltSnap = reinterpret_cast<CSnapshot *>(pBlock + HolderSize + SnapSize);
 		mem_copy(pHolder->m_pAltSnap, pAltData, AltDataSize);
 		pHolder->m_AltSnapSize = AltDataSize;
+		pHolder->m_pAltIndex = new(pBlock + HolderSize + SnapSize + AltSnapSize) CSnapshotIndex();
+		pHolder->m_pAltIndex->Build(pHolder->m_pAltSnap);
 	}
 	else
 	{
 		pHolder->m_pAltSnap = nullptr;
 		pHolder->m_AltSnapSize = 0;
+		pHolder->m_pAltIndex = nullptr;
 	}
 
 	// link
@@ -725,6 +883,7 @@ void CSnapshotBuilder::Init(bool Sixup)
 {
 	m_DataSize = 0;
 	m_NumItems = 0;
+	m_Index.Clear(CSnapshot::MAX_ITEMS);
 	m_Sixup = Sixup;
 
 	for(int i = 0; i < m_NumExtendedItemTypes; i++)
@@ -740,15 +899,8 @@ CSnapshotItem *CSnapshotBuilder::GetItem(int Index)
 
 int *CSnapshotBuilder::GetItemData(int Key)
 {
-	for(int i = 0; i < m_NumItems; i++)
-	{
-		CSnapshotItem *pItem = GetItem(i);
-		if(pItem->Key() == Key)
-		{
-			return pItem->Data();
-		}
-	}
-	return nullptr;
+	const int Index = m_Index.Find(Key);
+	return Index < 0 ? nullptr : GetItem(Index)->Data();
 }
 
 int CSnapshotBuilder::Finish(void *pSnapData)
@@ -855,6 +1007,7 @@ void *CSnapshotBuilder::NewItem(int Type, int Id, int Size)
 		return nullptr;
 
 	pObj->m_TypeAndId = (Type << 16) | Id;
+	m_Index.Add(pObj->m_TypeAndId, m_NumItems);
 	m_aOffsets[m_NumItems] = m_DataSize;
 	m_DataSize += ItemSize;
 	m_NumItems++;
@@ -59,7 +59,7 @@ public:
 	void InvalidateItem(int Index);
 	int GetItemType(int Index) const;
 	int GetExternalItemType(int InternalType) const;
-	const void *FindItem(int Type, int Id) const;
+	const void *FindItem(int Type, int Id, const class CSnapshotIndex *pIndex = nullptr) const;
 
 	unsigned Crc() const;
 	void DebugDump() const;
@@ -68,6 +68,34 @@ public:
 	static const CSnapshot *EmptySnapshot() { return &ms_EmptySnapshot; }
 };
 
+// CSnapshotIndex
+
+// Open addressing table from item keys to item indices, so repeated key
+// lookups in one snapshot don't have to scan all items.
+class CSnapshotIndex
+{
+	enum
+	{
+		MIN_SIZE = 16,
+		MAX_SIZE = 2 * CSnapshot::MAX_ITEMS,
+	};
+
+	int m_aKeys[MAX_SIZE];
+	short m_aIndices[MAX_SIZE];
+	unsigned m_Mask;
+
+	static unsigned Hash(int Key);
+
+public:
+	CSnapshotIndex() { Clear(0); }
+
+	void Clear(int NumItems);
+	void Build(const CSnapshot *pSnapshot);
+	// keeps the first index if the key is already present, like a linear search would
+	void Add(int Key, int Index);
+	int Find(int Key) const;
+};
+
 // CSnapshotDelta
 
 class CSnapshotDelta
@@ -93,10 +121,9 @@ private:
 	uint64_t m_aSnapshotDataUpdates[CSnapshot::MAX_TYPE + 1];
 	CData m_Empty;
 
-	static void UndiffItem(const int *pPast, const int *pDiff, int *pOut, int Size, uint64_t *pDataRate);
-
 public:
 	static int DiffItem(const int *pPast, const int *pCurrent, int *pOut, int Size);
+	static void UndiffItem(const int *pPast, const int *pDiff, int *pOut, int Size, uint64_t *pDataRate);
 	CSnapshotDelta();
 	CSnapshotDelta(const CSnapshotDelta &Old);
 	uint64_t GetDataRate(int Index) const { return m_aSnapshotDataRate[Index]; }
@@ -111,12 +138,37 @@ public:
 
 // CSnapshotStorage
 
+// Snapshots are added in tick order and purged from the front, so they
+// are carved out of recycled chunks like a ring buffer instead of being
+// allocated one by one.
 class CSnapshotStorage
 {
+	class CChunk
+	{
+	public:
+		CChunk *m_pNext;
+		size_t m_Used;
+		int m_NumHolders;
+	};
+
+	enum
+	{
+		CHUNK_SIZE = 4 * CSnapshot::MAX_SIZE,
+	};
+
+	CChunk *m_pCurrentChunk;
+	CChunk *m_pFreeChunks;
+	int64_t m_NumAllocations;
+
+	void *Allocate(size_t Size, CChunk **ppChunk);
+	void Release(CChunk *pChunk);
+
 public:
 	class CHolder
 	{
 	public:
+		CChunk *m_pChunk;
+
 		CHolder *m_pPrev;
 		CHolder *m_pNext;
 
@@ -128,6 +180,7 @@ public:
 
 		CSnapshot *m_pSnap;
 		CSnapshot *m_pAltSnap;
+		CSnapshotIndex *m_pAltIndex;
 	};
 
 	CHolder *m_pFirst;
@@ -140,6 +193,8 @@ public:
 	void PurgeUntil(int Tick);
 	void Add(int Tick, int64_t Tagtime, size_t DataSize, const void *pData, size_t AltDataSize, const void *pAltData);
 	int Get(int Tick, int64_t *pTagtime, const CSnapshot **ppData, const CSnapshot **ppAltData) const;
+	// number of chunks allocated from the heap so far
+	int64_t NumAllocations() const { return m_NumAllocations; }
 };
 
 class CSnapshotBuilder
@@ -154,6 +209,7 @@ class CSnapshotBuilder
 
 	int m_aOffsets[CSnapshot::MAX_ITEMS];
 	int m_NumItems;
+	CSnapshotIndex m_Index;
 
 	int m_aExtendedItemTypes[MAX_EXTENDED_ITEM_TYPES];
 	int m_NumExtendedItemTypes;
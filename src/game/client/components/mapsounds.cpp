@@ -3,6 +3,8 @@
 #include <base/log.h>
 
 #include <engine/demo.h>
+#include <engine/engine.h>
+#include <engine/shared/jobs.h>
 #include <engine/sound.h>
 
 #include <game/client/components/camera.h>
@@ -12,9 +14,42 @@
 #include <game/localization.h>
 #include <game/mapitems.h>
 
+// Loads one map sound on the job pool. Embedded sounds are copied, the map
+// data may be unloaded before the job runs.
+class CMapSoundLoadJob : public IJob
+{
+	ISound *m_pSound;
+	char m_aPath[IO_MAX_PATH_LENGTH] = "";
+	std::vector<unsigned char> m_vData;
+
+	void Run() override
+	{
+		if(m_aPath[0] != '\0')
+			m_SampleId = m_pSound->LoadOpus(m_aPath);
+		else
+			m_SampleId = m_pSound->LoadOpusFromMem(m_vData.data(), m_vData.size());
+	}
+
+public:
+	int m_SampleId = -1;
+
+	CMapSoundLoadJob(ISound *pSound, const char *pPath) :
+		m_pSound(pSound)
+	{
+		str_copy(m_aPath, pPath);
+	}
+
+	CMapSoundLoadJob(ISound *pSound, const void *pData, int DataSize) :
+		m_pSound(pSound),
+		m_vData((const unsigned char *)pData, (const unsigned char *)pData + DataSize)
+	{
+	}
+};
+
 CMapSounds::CMapSounds()
 {
 	m_Count = 0;
+	m_LoadSerial = 0;
 }
 
 void CMapSounds::Play(int Channel, int SoundId)
@@ -43,14 +78,17 @@ void CMapSounds::OnMapLoad()
 		return;
 
 	// load samples
-	int Start;
-	pMap->GetType(MAPITEMTYPE_SOUND, &Start, &m_Count);
+	int Start, Count;
+	pMap->GetType(MAPITEMTYPE_SOUND, &Start, &Count);
 
-	m_Count = clamp<int>(m_Count, 0, MAX_MAPSOUNDS);
+	Count = clamp<int>(Count, 0, MAX_MAPSOUNDS);
 
-	// load new samples
+	// decode the new samples in parallel, the sources start playing once
+	// all of them are loaded
+	std::shared_ptr<CJobGroup> pGroup = std::make_shared<CJobGroup>();
+	std::vector<std::shared_ptr<CMapSoundLoadJob>> vpJobs(Count);
 	bool ShowWarning = false;
-	for(int i = 0; i < m_Count; i++)
+	for(int i = 0; i < Count; i++)
 	{
 		CMapItemSound *pSound = (CMapItemSound *)pMap->GetItem(Start + i);
 		if(pSound->m_External)
@@ -65,7 +103,7 @@ void CMapSounds::OnMapLoad()
 
 			char aBuf[IO_MAX_PATH_LENGTH];
 			str_format(aBuf, sizeof(aBuf), "mapres/%s.opus", pName);
-			m_aSounds[i] = Sound()->LoadOpus(aBuf);
+			vpJobs[i] = std::make_shared<CMapSoundLoadJob>(Sound(), aBuf);
 			pMap->UnloadData(pSound->m_SoundName);
 		}
 		else
@@ -78,10 +116,35 @@ void CMapSounds::OnMapLoad()
 				continue;
 			}
 			const int SoundDataSize = pMap->GetDataSize(pSound->m_SoundData);
-			m_aSounds[i] = Sound()->LoadOpusFromMem(pData, SoundDataSize);
+			vpJobs[i] = std::make_shared<CMapSoundLoadJob>(Sound(), pData, SoundDataSize);
 			pMap->UnloadData(pSound->m_SoundData);
 		}
-		ShowWarning = ShowWarning || m_aSounds[i] == -1;
+		pGroup->Add(vpJobs[i]);
+	}
+
+	const int LoadSerial = m_LoadSerial;
+	pGroup->OnCompletion([this, LoadSerial, vpJobs = std::move(vpJobs), ShowWarning]() {
+		OnSoundsLoaded(LoadSerial, vpJobs, ShowWarning);
+	});
+	Engine()->AddJobGroup(std::move(pGroup));
+}
+
+void CMapSounds::OnSoundsLoaded(int LoadSerial, const std::vector<std::shared_ptr<CMapSoundLoadJob>> &vpJobs, bool ShowWarning)
+{
+	if(LoadSerial != m_LoadSerial)
+	{
+		// the samples were cleared while loading
+		for(const auto &pJob : vpJobs)
+			if(pJob)
+				Sound()->UnloadSample(pJob->m_SampleId);
+		return;
+	}
+
+	m_Count = (int)vpJobs.size();
+	for(int i = 0; i < m_Count; i++)
+	{
+		m_aSounds[i] = vpJobs[i] ? vpJobs[i]->m_SampleId : -1;
+		ShowWarning = ShowWarning || (vpJobs[i] && m_aSounds[i] == -1);
 	}
 	if(ShowWarning)
 	{
@@ -219,7 +282,8 @@ void CMapSounds::OnRender()
 
 void CMapSounds::Clear()
 {
-	// unload all samples
+	// unload all samples, the ones still loading are unloaded when done
+	m_LoadSerial++;
 	m_vSourceQueue.clear();
 	for(int i = 0; i < m_Count; i++)
 	{
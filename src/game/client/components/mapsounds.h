@@ -6,12 +6,15 @@
 #include <game/client/component.h>
 #include <game/mapitems.h>
 
+#include <memory>
 #include <vector>
 
 class CMapSounds : public CComponent
 {
 	int m_aSounds[MAX_MAPSOUNDS];
 	int m_Count;
+	// changes whenever the samples are cleared, to drop loads of earlier maps
+	int m_LoadSerial;
 
 	class CSourceQueueEntry
 	{
@@ -24,6 +27,7 @@ class CMapSounds : public CComponent
 	};
 	std::vector<CSourceQueueEntry> m_vSourceQueue;
 	void Clear();
+	void OnSoundsLoaded(int LoadSerial, const std::vector<std::shared_ptr<class CMapSoundLoadJob>> &vpJobs, bool ShowWarning);
 
 public:
 	CMapSounds();
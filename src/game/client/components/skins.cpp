@@ -25,6 +25,7 @@ CSkins::CAbstractSkinLoadJob::CAbstractSkinLoadJob(CSkins *pSkins, const char *p
 {
 	str_copy(m_aName, pName);
 	Abortable(true);
+	SetPriority(PRIORITY_LOW);
 }
 
 CSkins::CAbstractSkinLoadJob::~CAbstractSkinLoadJob()
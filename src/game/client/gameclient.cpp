@@ -3,6 +3,7 @@
 
 #include <chrono>
 #include <limits>
+#include <tuple>
 
 #include <engine/client/checksum.h>
 #include <engine/client/enums.h>
@@ -678,6 +679,7 @@ void CGameClient::OnReset()
 	m_GameWorld.m_WorldConfig.m_InfiniteAmmo = true;
 	m_PredictedWorld.CopyWorld(&m_GameWorld);
 	m_PrevPredictedWorld.CopyWorld(&m_PredictedWorld);
+	m_PredictionCache.m_Tick = -1;
 
 	m_vSnapEntities.clear();
 
@@ -2300,6 +2302,123 @@ void CGameClient::OnNewSnapshot()
 		UpdatePrediction();
 }
 
+bool CGameClient::CanContinuePrediction(int DummyId)
+{
+	const CPredictionCache &Cache = m_PredictionCache;
+	// partial freeze prediction depends on the final tick, it changes the earlier ticks
+	if(Cache.m_Tick < 0 || g_Config.m_ClPredictFreeze == 2)
+		return false;
+	if(Cache.m_GameTick != Client()->GameTick(g_Config.m_ClDummy) ||
+		Cache.m_Dummy != g_Config.m_ClDummy ||
+		Cache.m_IsDummySwapping != m_IsDummySwapping ||
+		Cache.m_LocalClientId != m_Snap.m_LocalClientId ||
+		Cache.m_DummyId != DummyId)
+		return false;
+	// the predicted characters are fetched from the ticks after the cached one
+	if(Cache.m_Tick >= Client()->PredGameTick(g_Config.m_ClDummy))
+		return false;
+	if(Cache.m_Tick - Cache.m_GameTick >= (int)std::size(Cache.m_aTicks))
+		return false;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+		if(Cache.m_aOtherTeam[i] != IsOtherTeam(i))
+			return false;
+
+	// inputs of ticks ahead of the last sent one are filled in with the latest
+	// input and change once the input for that tick is sent
+	for(int Tick = Cache.m_GameTick + 1; Tick <= Cache.m_Tick; Tick++)
+	{
+		const CPredictionCache::CPredictedTick &Inputs = Cache.m_aTicks[Tick % std::size(Cache.m_aTicks)];
+		if(Inputs.m_Tick != Tick)
+			return false;
+		const CNetObj_PlayerInput *pInput = (CNetObj_PlayerInput *)Client()->GetInput(Tick, m_IsDummySwapping);
+		if(Inputs.m_HasInput != (pInput != nullptr) || (pInput && mem_comp(&Inputs.m_Input, pInput, sizeof(*pInput)) != 0))
+			return false;
+		if(DummyId >= 0)
+		{
+			const CNetObj_PlayerInput *pDummyInput = (CNetObj_PlayerInput *)Client()->GetInput(Tick, m_IsDummySwapping ^ 1);
+			if(Inputs.m_HasDummyInput != (pDummyInput != nullptr) || (pDummyInput && mem_comp(&Inputs.m_DummyInput, pDummyInput, sizeof(*pDummyInput)) != 0))
+				return false;
+		}
+	}
+	return true;
+}
+
+void CGameClient::StorePredictionCache(int Tick, int DummyId)
+{
+	CPredictionCache &Cache = m_PredictionCache;
+	Cache.m_Tick = Tick;
+	Cache.m_GameTick = Client()->GameTick(g_Config.m_ClDummy);
+	Cache.m_Dummy = g_Config.m_ClDummy;
+	Cache.m_IsDummySwapping = m_IsDummySwapping;
+	Cache.m_LocalClientId = m_Snap.m_LocalClientId;
+	Cache.m_DummyId = DummyId;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+		Cache.m_aOtherTeam[i] = IsOtherTeam(i);
+
+	m_PredictionCacheWorld.CopyWorld(&m_PredictedWorld);
+	// the cache must not take over the links the previous predicted world uses
+	m_PredictionCacheWorld.Unlink();
+}
+
+bool CGameClient::PredictionCacheMatchesSnapshot()
+{
+	const CPredictionCache &Cache = m_PredictionCache;
+	const int GameTick = Client()->GameTick(g_Config.m_ClDummy);
+	// only ticks predicted since the snapshot the cache started from are known
+	if(Cache.m_Tick < GameTick || GameTick <= Cache.m_GameTick)
+		return false;
+	const CPredictionCache::CPredictedTick &Predicted = Cache.m_aTicks[GameTick % std::size(Cache.m_aTicks)];
+	if(Predicted.m_Tick != GameTick)
+		return false;
+
+	// the snapshot must not change anything else the prediction depends on
+	if(m_GameWorld.m_OtherEntitiesChanged)
+		return false;
+	if(mem_comp(m_GameWorld.m_Core.m_aTuning, m_PredictionCacheWorld.m_Core.m_aTuning, sizeof(m_GameWorld.m_Core.m_aTuning)) != 0)
+		return false;
+	auto WorldConfig = [](const CGameWorld &World) {
+		const auto &Config = World.m_WorldConfig;
+		return std::make_tuple(Config.m_IsDDRace, Config.m_IsVanilla, Config.m_IsFNG, Config.m_InfiniteAmmo, Config.m_PredictTiles, Config.m_PredictFreeze,
+			Config.m_PredictWeapons, Config.m_PredictDDRace, Config.m_IsSolo, Config.m_UseTuneZones, Config.m_BugDDRaceInput, Config.m_NoWeakHookAndBounce);
+	};
+	if(WorldConfig(m_GameWorld) != WorldConfig(m_PredictionCacheWorld))
+		return false;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+		if(m_GameWorld.m_Teams.Team(i) != m_PredictionCacheWorld.m_Teams.Team(i) || m_GameWorld.m_Teams.GetSolo(i) != m_PredictionCacheWorld.m_Teams.GetSolo(i))
+			return false;
+	const std::vector<SSwitchers> &vSwitchers = m_GameWorld.m_Core.m_vSwitchers;
+	if(vSwitchers.size() != Cache.m_vSwitchers.size())
+		return false;
+	for(size_t i = 0; i < vSwitchers.size(); i++)
+		if(mem_comp(vSwitchers[i].m_aStatus, Cache.m_vSwitchers[i].m_aStatus, sizeof(vSwitchers[i].m_aStatus)) != 0 ||
+			mem_comp(vSwitchers[i].m_aEndTick, Cache.m_vSwitchers[i].m_aEndTick, sizeof(vSwitchers[i].m_aEndTick)) != 0 ||
+			mem_comp(vSwitchers[i].m_aType, Cache.m_vSwitchers[i].m_aType, sizeof(vSwitchers[i].m_aType)) != 0)
+			return false;
+
+	// the snapshot characters must be exactly the predicted ones, snapshots
+	// carry quantized cores and so does the prediction after every tick.
+	// Weapons, freeze, jumps and the ddnet character flags are compared as
+	// well, the server changes them without the core changing.
+	size_t NumCharacters = 0;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		CCharacter *pChar = m_GameWorld.GetCharacterById(i);
+		// OnPredict removes these before predicting
+		if(!pChar || (!m_Snap.m_aCharacters[i].m_Active && pChar->m_SnapTicks > 10) || IsOtherTeam(i))
+			continue;
+		if(NumCharacters == Predicted.m_vCharacters.size() || Predicted.m_vCharacters[NumCharacters].m_ClientId != i)
+			return false;
+		const CPredictionCache::CPredictedCharacter &Character = Predicted.m_vCharacters[NumCharacters];
+		CNetObj_Character Char;
+		CNetObj_DDNetCharacter Extended;
+		pChar->Write(&Char, &Extended);
+		if(mem_comp(&Char, &Character.m_Char, sizeof(Char)) != 0 || mem_comp(&Extended, &Character.m_Extended, sizeof(Extended)) != 0)
+			return false;
+		NumCharacters++;
+	}
+	return NumCharacters == Predicted.m_vCharacters.size();
+}
+
 void CGameClient::UpdateEditorIngameMoved()
 {
 	const bool LocalCharacterMoved = m_Snap.m_pLocalCharacter && m_Snap.m_pLocalPrevCharacter && (m_Snap.m_pLocalCharacter->m_X != m_Snap.m_pLocalPrevCharacter->m_X || m_Snap.m_pLocalCharacter->m_Y != m_Snap.m_pLocalPrevCharacter->m_Y);
@@ -2349,21 +2468,35 @@ void CGameClient::OnPredict()
 
 	// init
 	bool Dummy = g_Config.m_ClDummy ^ m_IsDummySwapping;
-	m_PredictedWorld.CopyWorld(&m_GameWorld);
+	const int DummyId = PredictDummy() ? m_PredictedDummyId : -1;
+	int FirstTick = Client()->GameTick(g_Config.m_ClDummy) + 1;
+	if(CanContinuePrediction(DummyId))
+	{
+		// nothing changed up to the cached tick, only predict the new ones
+		m_PredictedWorld.CopyWorld(&m_PredictionCacheWorld);
+		// destroyed entities must be reported to the snapshot world, like after copying it
+		m_PredictedWorld.Relink(&m_GameWorld);
+		FirstTick = m_PredictionCache.m_Tick + 1;
+	}
+	else
+	{
+		m_PredictionCache.m_Tick = -1;
+		m_PredictedWorld.CopyWorld(&m_GameWorld);
 
-	// don't predict inactive players, or entities from other teams
-	for(int i = 0; i < MAX_CLIENTS; i++)
-		if(CCharacter *pChar = m_PredictedWorld.GetCharacterById(i))
-			if((!m_Snap.m_aCharacters[i].m_Active && pChar->m_SnapTicks > 10) || IsOtherTeam(i))
-				pChar->Destroy();
+		// don't predict inactive players, or entities from other teams
+		for(int i = 0; i < MAX_CLIENTS; i++)
+			if(CCharacter *pChar = m_PredictedWorld.GetCharacterById(i))
+				if((!m_Snap.m_aCharacters[i].m_Active && pChar->m_SnapTicks > 10) || IsOtherTeam(i))
+					pChar->Destroy();
 
-	CProjectile *pProjNext = nullptr;
-	for(CProjectile *pProj = (CProjectile *)m_PredictedWorld.FindFirst(CGameWorld::ENTTYPE_PROJECTILE); pProj; pProj = pProjNext)
-	{
-		pProjNext = (CProjectile *)pProj->TypeNext();
-		if(IsOtherTeam(pProj->GetOwner()))
+		CProjectile *pProjNext = nullptr;
+		for(CProjectile *pProj = (CProjectile *)m_PredictedWorld.FindFirst(CGameWorld::ENTTYPE_PROJECTILE); pProj; pProj = pProjNext)
 		{
-			pProj->Destroy();
+			pProjNext = (CProjectile *)pProj->TypeNext();
+			if(IsOtherTeam(pProj->GetOwner()))
+			{
+				pProj->Destroy();
+			}
 		}
 	}
 
@@ -2371,13 +2504,16 @@ void CGameClient::OnPredict()
 	if(!pLocalChar)
 		return;
 	CCharacter *pDummyChar = nullptr;
-	if(PredictDummy())
-		pDummyChar = m_PredictedWorld.GetCharacterById(m_PredictedDummyId);
+	if(DummyId >= 0)
+		pDummyChar = m_PredictedWorld.GetCharacterById(DummyId);
 
 	// int PredictionTick = Client()->GetPredictionTick();
 	// predict
 	int FinalTick = Client()->PredGameTick(g_Config.m_ClDummy) + g_Config.m_ClFastInp;
-	for(int Tick = Client()->GameTick(g_Config.m_ClDummy) + 1; Tick <= FinalTick; Tick++)
+	// the next prediction continues from before the last ticks, where the
+	// predicted characters are fetched and the fast input is applied
+	const int CacheTick = Client()->PredGameTick(g_Config.m_ClDummy) - 1;
+	for(int Tick = FirstTick; Tick <= FinalTick; Tick++)
 	{
 		// fetch the previous characters
 		if(Tick == FinalTick)
@@ -2421,6 +2557,28 @@ void CGameClient::OnPredict()
 			pDummyChar->OnPredictedInput(pDummyInputData);
 		m_PredictedWorld.Tick();
 
+		if(Tick <= CacheTick)
+		{
+			CPredictionCache::CPredictedTick &Predicted = m_PredictionCache.m_aTicks[Tick % std::size(m_PredictionCache.m_aTicks)];
+			Predicted.m_Tick = Tick;
+			Predicted.m_HasInput = pInputData;
+			Predicted.m_HasDummyInput = pDummyInputData;
+			if(pInputData)
+				Predicted.m_Input = *pInputData;
+			if(pDummyInputData)
+				Predicted.m_DummyInput = *pDummyInputData;
+			Predicted.m_vCharacters.clear();
+			for(int i = 0; i < MAX_CLIENTS; i++)
+				if(CCharacter *pChar = m_PredictedWorld.GetCharacterById(i))
+				{
+					CPredictionCache::CPredictedCharacter &Character = Predicted.m_vCharacters.emplace_back();
+					Character.m_ClientId = i;
+					pChar->Write(&Character.m_Char, &Character.m_Extended);
+				}
+			if(Tick == CacheTick)
+				StorePredictionCache(Tick, DummyId);
+		}
+
 		// fetch the current characters
 		if(Tick == FinalTick)
 		{
@@ -3152,6 +3310,7 @@ void CGameClient::UpdatePrediction()
 	{
 		if(CCharacter *pLocalChar = m_GameWorld.GetCharacterById(m_Snap.m_LocalClientId))
 			pLocalChar->Destroy();
+		m_PredictionCache.m_Tick = -1;
 		return;
 	}
 
@@ -3322,6 +3481,14 @@ void CGameClient::UpdatePrediction()
 		m_GameWorld.NetObjAdd(EntData.m_Item.m_Id, EntData.m_Item.m_Type, EntData.m_Item.m_pData, EntData.m_pDataEx);
 
 	m_GameWorld.NetObjEnd();
+
+	// keep continuing the prediction if it predicted this snapshot, the
+	// ticks after it don't need to be predicted again
+	if(PredictionCacheMatchesSnapshot())
+		m_PredictionCache.m_GameTick = Client()->GameTick(g_Config.m_ClDummy);
+	else
+		m_PredictionCache.m_Tick = -1;
+	m_PredictionCache.m_vSwitchers = m_GameWorld.m_Core.m_vSwitchers;
 }
 
 void CGameClient::UpdateSpectatorCursor()
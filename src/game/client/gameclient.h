@@ -912,6 +912,45 @@ private:
 	int m_PredictedDummyId;
 	int m_IsDummySwapping;
 	CCharOrder m_CharOrder;
+
+	// Predicted world after the last tick that was predicted with sent
+	// inputs. Prediction continues from here instead of replaying all ticks
+	// since the snapshot, also after a new snapshot that matches it.
+	CGameWorld m_PredictionCacheWorld;
+	struct CPredictionCache
+	{
+		// last tick in m_PredictionCacheWorld, -1 if there is nothing to continue from
+		int m_Tick = -1;
+		int m_GameTick;
+		int m_Dummy;
+		int m_IsDummySwapping;
+		int m_LocalClientId;
+		int m_DummyId;
+		bool m_aOtherTeam[MAX_CLIENTS];
+		struct CPredictedCharacter
+		{
+			int m_ClientId;
+			CNetObj_Character m_Char;
+			CNetObj_DDNetCharacter m_Extended;
+		};
+		struct CPredictedTick
+		{
+			int m_Tick;
+			bool m_HasInput;
+			bool m_HasDummyInput;
+			CNetObj_PlayerInput m_Input;
+			CNetObj_PlayerInput m_DummyInput;
+			// predicted characters after the tick like snapshots carry them, by client id
+			std::vector<CPredictedCharacter> m_vCharacters;
+		};
+		// inputs and results of the cached ticks, indexed by tick % 200
+		CPredictedTick m_aTicks[200];
+		// switch states of the previous snapshot
+		std::vector<SSwitchers> m_vSwitchers;
+	} m_PredictionCache;
+	bool CanContinuePrediction(int DummyId);
+	bool PredictionCacheMatchesSnapshot();
+	void StorePredictionCache(int Tick, int DummyId);
 	int m_aSwitchStateTeam[NUM_DUMMIES];
 
 	void LoadMapSettings();
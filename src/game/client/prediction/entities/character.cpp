@@ -604,7 +604,7 @@ void CCharacter::TickDeferred()
 {
 	m_Core.Move();
 	m_Core.Quantize();
-	m_Pos = m_Core.m_Pos;
+	SetPos(m_Core.m_Pos);
 }
 
 bool CCharacter::TakeDamage(vec2 Force, int Dmg, int From, int Weapon)
@@ -1071,11 +1071,11 @@ void CCharacter::DDRacePostCoreTick()
 	HandleSkippableTiles(CurrentIndex);
 
 	// handle Anti-Skip tiles
-	std::vector<int> vIndices = Collision()->GetMapIndices(m_PrevPos, m_Pos);
-	if(!vIndices.empty())
-		for(int Index : vIndices)
-			HandleTiles(Index);
-	else
+	const int NumIndices = Collision()->GetMapIndices(m_PrevPos, m_Pos, [&](int Index) {
+		HandleTiles(Index);
+		return true;
+	});
+	if(NumIndices == 0)
 	{
 		HandleTiles(CurrentIndex);
 	}
@@ -1188,7 +1188,8 @@ CCharacter::CCharacter(CGameWorld *pGameWorld, int Id, CNetObj_Character *pChar,
 	m_LastWeapon = WEAPON_HAMMER;
 	m_QueuedWeapon = -1;
 	m_LastRefillJumps = false;
-	m_PrevPrevPos = m_PrevPos = m_Pos = vec2(pChar->m_X, pChar->m_Y);
+	SetPos(vec2(pChar->m_X, pChar->m_Y));
+	m_PrevPrevPos = m_PrevPos = m_Pos;
 	m_Core.Reset();
 	m_Core.Init(&GameWorld()->m_Core, GameWorld()->Collision(), GameWorld()->Teams());
 	m_Core.m_Id = Id;
@@ -1366,7 +1367,7 @@ void CCharacter::Read(CNetObj_Character *pChar, CNetObj_DDNetCharacter *pExtende
 	}
 
 	vec2 PosBefore = m_Pos;
-	m_Pos = m_Core.m_Pos;
+	SetPos(m_Core.m_Pos);
 
 	if(distance(PosBefore, m_Pos) > 2.f) // misprediction, don't use prevpos
 		m_PrevPos = m_Pos;
@@ -1423,6 +1424,23 @@ void CCharacter::Read(CNetObj_Character *pChar, CNetObj_DDNetCharacter *pExtende
 	}
 }
 
+void CCharacter::Write(CNetObj_Character *pChar, CNetObj_DDNetCharacter *pExtended) const
+{
+	mem_zero(pChar, sizeof(*pChar));
+	m_Core.Write(pChar);
+	pChar->m_Weapon = m_Core.m_ActiveWeapon;
+	pChar->m_AmmoCount = m_Core.m_aWeapons[m_Core.m_ActiveWeapon].m_Ammo;
+	pChar->m_AttackTick = m_AttackTick;
+
+	m_Core.WriteDDNet(pExtended);
+	pExtended->m_TeleCheckpoint = m_TeleCheckpoint;
+	pExtended->m_StrongWeakId = m_StrongWeakId;
+	pExtended->m_TuneZoneOverride = m_TuneZoneOverride;
+	// the aim is part of the compared inputs and of the core's angle
+	pExtended->m_TargetX = 0;
+	pExtended->m_TargetY = 0;
+}
+
 void CCharacter::SetCoreWorld(CGameWorld *pGameWorld)
 {
 	m_Core.SetCoreWorld(&pGameWorld->m_Core, pGameWorld->Collision(), pGameWorld->Teams());
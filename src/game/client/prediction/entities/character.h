@@ -114,6 +114,9 @@ public:
 
 	CCharacter(CGameWorld *pGameWorld, int Id, CNetObj_Character *pChar, CNetObj_DDNetCharacter *pExtended = nullptr);
 	void Read(CNetObj_Character *pChar, CNetObj_DDNetCharacter *pExtended, bool IsLocal);
+	// Writes the predicted state like the snapshot items carry it, the
+	// state that isn't predicted, like health and aim, is left out.
+	void Write(CNetObj_Character *pChar, CNetObj_DDNetCharacter *pExtended) const;
 	void SetCoreWorld(CGameWorld *pGameWorld);
 
 	int m_LastSnapWeapon;
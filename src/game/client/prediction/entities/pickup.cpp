@@ -139,14 +139,14 @@ void CPickup::Move()
 		{
 			m_IsCoreActive = true;
 		}
-		m_Pos += m_Core;
+		SetPos(m_Pos + m_Core);
 	}
 }
 
 CPickup::CPickup(CGameWorld *pGameWorld, int Id, const CPickupData *pPickup) :
 	CEntity(pGameWorld, CGameWorld::ENTTYPE_PICKUP, vec2(0, 0), gs_PickupPhysSize)
 {
-	m_Pos = pPickup->m_Pos;
+	SetPos(pPickup->m_Pos);
 	m_Type = pPickup->m_Type;
 	m_Subtype = pPickup->m_Subtype;
 	m_Core = vec2(0.f, 0.f);
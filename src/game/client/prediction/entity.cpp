@@ -21,6 +21,7 @@ CEntity::CEntity(CGameWorld *pGameWorld, int ObjType, vec2 Pos, int ProximityRad
 
 	m_pPrevTypeEntity = nullptr;
 	m_pNextTypeEntity = nullptr;
+	m_GridBucket = -1;
 	m_SnapTicks = -1;
 
 	// DDRace
@@ -36,6 +37,13 @@ CEntity::~CEntity()
 		GameWorld()->RemoveEntity(this);
 }
 
+void CEntity::SetPos(vec2 Pos)
+{
+	m_Pos = Pos;
+	if(m_GridBucket != -1)
+		GameWorld()->UpdateEntityPos(this);
+}
+
 bool CEntity::GameLayerClipped(vec2 CheckPos)
 {
 	return round_to_int(CheckPos.x) / 32 < -200 || round_to_int(CheckPos.x) / 32 > Collision()->GetWidth() + 200 ||
@@ -17,6 +17,7 @@ private:
 	friend CGameWorld; // entity list handling
 	CEntity *m_pPrevTypeEntity;
 	CEntity *m_pNextTypeEntity;
+	int m_GridBucket;
 
 protected:
 	CGameWorld *m_pGameWorld;
@@ -40,6 +41,8 @@ public:
 	CEntity *TypePrev() { return m_pPrevTypeEntity; }
 	const vec2 &GetPos() const { return m_Pos; }
 	float GetProximityRadius() const { return m_ProximityRadius; }
+	// characters and pickups must be moved with this to keep the world index valid
+	void SetPos(vec2 Pos);
 	virtual bool CanCollide(int ClientId) { return true; }
 
 	virtual void Destroy() { delete this; }
@@ -69,6 +72,7 @@ public:
 	{
 		m_Id = -1;
 		m_pGameWorld = nullptr;
+		m_GridBucket = -1;
 	}
 };
 
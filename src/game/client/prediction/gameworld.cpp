@@ -37,6 +37,12 @@ CGameWorld::CGameWorld()
 CGameWorld::~CGameWorld()
 {
 	Clear();
+	for(auto &vpPool : m_avpEntityPool)
+	{
+		for(CEntity *pEnt : vpPool)
+			delete pEnt;
+		vpPool.clear();
+	}
 	if(m_pChild && m_pChild->m_pParent == this)
 	{
 		OnModified();
@@ -60,23 +66,54 @@ CEntity *CGameWorld::FindLast(int Type)
 	return pLast;
 }
 
+CEntityGrid<CEntity> *CGameWorld::Grid(int Type)
+{
+	if(Type == ENTTYPE_CHARACTER)
+		return &m_CharacterGrid;
+	if(Type == ENTTYPE_PICKUP)
+		return &m_PickupGrid;
+	return nullptr;
+}
+
+// calls Fn in list order on the entities of the type that may be inside
+// the box, until it returns false
+template<typename F>
+void CGameWorld::ForEachEntityNear(int Type, vec2 Min, vec2 Max, F &&Fn)
+{
+	// nested queries would overwrite the shared result, walk the list then
+	CEntityGrid<CEntity> *pGrid = Grid(Type);
+	if(pGrid && m_GridQueryDepth == 0 && pGrid->Query(Min, Max, m_vpGridResult))
+	{
+		m_GridQueryDepth++;
+		for(CEntity *pEnt : m_vpGridResult)
+			if(!Fn(pEnt))
+				break;
+		m_GridQueryDepth--;
+		return;
+	}
+
+	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		if(!Fn(pEnt))
+			break;
+}
+
 int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type)
 {
 	if(Type < 0 || Type >= NUM_ENTTYPES)
 		return 0;
 
 	int Num = 0;
-	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
-	{
+	ForEachEntityNear(Type, Pos - vec2(Radius, Radius), Pos + vec2(Radius, Radius), [&](CEntity *pEnt) {
 		if(distance(pEnt->m_Pos, Pos) < Radius + pEnt->m_ProximityRadius)
 		{
 			if(ppEnts)
 				ppEnts[Num] = pEnt;
 			Num++;
 			if(Num == Max)
-				break;
+				return false;
 		}
-	}
+		return true;
+	});
 
 	return Num;
 }
@@ -112,6 +149,11 @@ void CGameWorld::InsertEntity(CEntity *pEnt, bool Last)
 		pEnt->m_pNextTypeEntity = nullptr;
 	}
 
+	// copies of entities come with the bucket of their original
+	pEnt->m_GridBucket = -1;
+	if(CEntityGrid<CEntity> *pGrid = Grid(pEnt->m_ObjType))
+		pEnt->m_GridBucket = pGrid->Insert(pEnt, pEnt->m_Pos, pEnt->m_ProximityRadius, Last);
+
 	if(pEnt->m_ObjType == ENTTYPE_CHARACTER)
 	{
 		auto *pChar = (CCharacter *)pEnt;
@@ -146,6 +188,12 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 	pEnt->m_pNextTypeEntity = nullptr;
 	pEnt->m_pPrevTypeEntity = nullptr;
 
+	if(pEnt->m_GridBucket != -1)
+	{
+		Grid(pEnt->m_ObjType)->Remove(pEnt, pEnt->m_GridBucket);
+		pEnt->m_GridBucket = -1;
+	}
+
 	if(pEnt->m_pParent)
 	{
 		if(m_IsValidCopy && m_pParent && m_pParent->m_pChild == this)
@@ -160,6 +208,12 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 	}
 }
 
+void CGameWorld::UpdateEntityPos(CEntity *pEnt)
+{
+	if(pEnt->m_GridBucket != -1)
+		pEnt->m_GridBucket = Grid(pEnt->m_ObjType)->Move(pEnt, pEnt->m_GridBucket, pEnt->m_Pos);
+}
+
 void CGameWorld::RemoveCharacter(CCharacter *pChar)
 {
 	int Id = pChar->GetCid();
@@ -223,6 +277,12 @@ void CGameWorld::Tick()
 
 	RemoveEntities();
 
+#ifdef CONF_DEBUG
+	for(int Type : {ENTTYPE_CHARACTER, ENTTYPE_PICKUP})
+		for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+			dbg_assert(Grid(Type)->Contains(pEnt, pEnt->m_GridBucket, pEnt->m_Pos), "entity moved without SetPos");
+#endif
+
 	// update switch state
 	for(auto &Switcher : Switchers())
 	{
@@ -253,20 +313,23 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 
 CEntity *CGameWorld::IntersectEntity(vec2 Pos0, vec2 Pos1, float Radius, int Type, vec2 &NewPos, const CEntity *pNotThis, int CollideWith, const CEntity *pThisOnly)
 {
+	if(Type < 0 || Type >= NUM_ENTTYPES)
+		return nullptr;
+
 	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
 	CEntity *pClosest = nullptr;
 
-	CEntity *pEntity = FindFirst(Type);
-	for(; pEntity; pEntity = pEntity->TypeNext())
-	{
+	const vec2 Min = vec2(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y)) - vec2(Radius, Radius);
+	const vec2 Max = vec2(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y)) + vec2(Radius, Radius);
+	ForEachEntityNear(Type, Min, Max, [&](CEntity *pEntity) {
 		if(pEntity == pNotThis)
-			continue;
+			return true;
 
 		if(pThisOnly && pEntity != pThisOnly)
-			continue;
+			return true;
 
 		if(CollideWith != -1 && !pEntity->CanCollide(CollideWith))
-			continue;
+			return true;
 
 		vec2 IntersectPos;
 		if(closest_point_on_line(Pos0, Pos1, pEntity->m_Pos, IntersectPos))
@@ -283,7 +346,8 @@ CEntity *CGameWorld::IntersectEntity(vec2 Pos0, vec2 Pos1, float Radius, int Typ
 				}
 			}
 		}
-	}
+		return true;
+	});
 
 	return pClosest;
 }
@@ -291,11 +355,12 @@ CEntity *CGameWorld::IntersectEntity(vec2 Pos0, vec2 Pos1, float Radius, int Typ
 std::vector<CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, const CEntity *pNotThis)
 {
 	std::vector<CCharacter *> vpCharacters;
-	CCharacter *pChr = (CCharacter *)FindFirst(CGameWorld::ENTTYPE_CHARACTER);
-	for(; pChr; pChr = (CCharacter *)pChr->TypeNext())
-	{
+	const vec2 Min = vec2(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y)) - vec2(Radius, Radius);
+	const vec2 Max = vec2(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y)) + vec2(Radius, Radius);
+	ForEachEntityNear(ENTTYPE_CHARACTER, Min, Max, [&](CEntity *pEnt) {
+		CCharacter *pChr = (CCharacter *)pEnt;
 		if(pChr == pNotThis)
-			continue;
+			return true;
 
 		vec2 IntersectPos;
 		if(closest_point_on_line(Pos0, Pos1, pChr->m_Pos, IntersectPos))
@@ -306,7 +371,8 @@ std::vector<CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1
 				vpCharacters.push_back(pChr);
 			}
 		}
-	}
+		return true;
+	});
 	return vpCharacters;
 }
 
@@ -392,6 +458,9 @@ void CGameWorld::NetObjBegin(CTeamsCore Teams, int LocalClientId)
 			if(i == ENTTYPE_CHARACTER)
 				((CCharacter *)pEnt)->m_KeepHooked = false;
 		}
+	int NumMarked;
+	CountOtherEntities(&m_NumOtherEntities, &m_NumOtherEntitiesWithoutId, &NumMarked);
+	m_OtherEntitiesChanged = false;
 	OnModified();
 }
 
@@ -484,7 +553,7 @@ void CGameWorld::NetObjAdd(int ObjId, int ObjType, const void *pObjData, const C
 		{
 			if(NetPickup.Match(pPickup))
 			{
-				pPickup->m_Pos = NetPickup.m_Pos;
+				pPickup->SetPos(NetPickup.m_Pos);
 				pPickup->Keep();
 				return;
 			}
@@ -528,6 +597,7 @@ void CGameWorld::NetObjAdd(int ObjId, int ObjType, const void *pObjData, const C
 					// if the laser stopped earlier than predicted, set the energy to 0
 					pMatching->m_Energy = 0.f;
 					pMatching->m_Pos = NetLaser.m_Pos;
+					m_OtherEntitiesChanged = true;
 				}
 			}
 		}
@@ -573,13 +643,17 @@ void CGameWorld::NetObjEnd()
 				if(CCharacter *pHookedChar = GetCharacterById(pChar->m_Core.HookedPlayer()))
 					if(pHookedChar->m_MarkedForDestroy)
 					{
-						pHookedChar->m_Pos = pHookedChar->m_Core.m_Pos = pChar->m_Core.m_HookPos;
+						pHookedChar->m_Core.m_Pos = pChar->m_Core.m_HookPos;
+						pHookedChar->SetPos(pHookedChar->m_Core.m_Pos);
 						pHookedChar->ResetVelocity();
 						mem_zero(&pHookedChar->m_SavedInput, sizeof(pHookedChar->m_SavedInput));
 						pHookedChar->m_SavedInput.m_TargetY = -1;
 						pHookedChar->m_KeepHooked = true;
 						pHookedChar->m_MarkedForDestroy = false;
 					}
+	int NumOtherEntities, NumOtherEntitiesWithoutId, NumMarked;
+	CountOtherEntities(&NumOtherEntities, &NumOtherEntitiesWithoutId, &NumMarked);
+	m_OtherEntitiesChanged = m_OtherEntitiesChanged || NumOtherEntities != m_NumOtherEntities || NumOtherEntitiesWithoutId != m_NumOtherEntitiesWithoutId || NumMarked > 0;
 	RemoveEntities();
 
 	// Update character IDs and pointers
@@ -599,6 +673,59 @@ void CGameWorld::NetObjEnd()
 	}
 }
 
+void CGameWorld::CountOtherEntities(int *pNum, int *pNumWithoutId, int *pNumMarked)
+{
+	*pNum = 0;
+	*pNumWithoutId = 0;
+	*pNumMarked = 0;
+	for(int Type = 0; Type < NUM_ENTTYPES; Type++)
+	{
+		if(Type == ENTTYPE_CHARACTER)
+			continue;
+		for(CEntity *pEnt = FindFirst(Type); pEnt; pEnt = pEnt->TypeNext())
+		{
+			(*pNum)++;
+			if(pEnt->m_Id == -1)
+				(*pNumWithoutId)++;
+			if(pEnt->m_MarkedForDestroy)
+				(*pNumMarked)++;
+		}
+	}
+}
+
+void CGameWorld::RecycleEntities()
+{
+	for(int Type = 0; Type < NUM_ENTTYPES; Type++)
+	{
+		// only the types copied by CopyWorld are worth keeping
+		const bool Keep = Type == ENTTYPE_PROJECTILE || Type == ENTTYPE_LASER || Type == ENTTYPE_DRAGGER || Type == ENTTYPE_CHARACTER || Type == ENTTYPE_PICKUP;
+		while(CEntity *pEnt = m_apFirstEntityTypes[Type])
+		{
+			if(!Keep)
+			{
+				delete pEnt;
+				continue;
+			}
+			RemoveEntity(pEnt);
+			if(Type == ENTTYPE_CHARACTER)
+				RemoveCharacter((CCharacter *)pEnt);
+			m_avpEntityPool[Type].push_back(pEnt);
+		}
+	}
+}
+
+template<typename T>
+T *CGameWorld::CopyEntity(int Type, const T *pFrom)
+{
+	std::vector<CEntity *> &vpPool = m_avpEntityPool[Type];
+	if(vpPool.empty())
+		return new T(*pFrom);
+	T *pCopy = (T *)vpPool.back();
+	vpPool.pop_back();
+	*pCopy = *pFrom;
+	return pCopy;
+}
+
 void CGameWorld::CopyWorld(CGameWorld *pFrom)
 {
 	if(pFrom == this || !pFrom)
@@ -620,8 +747,8 @@ void CGameWorld::CopyWorld(CGameWorld *pFrom)
 	m_pMapBugs = pFrom->m_pMapBugs;
 	m_Teams = pFrom->m_Teams;
 	m_Core.m_vSwitchers = pFrom->m_Core.m_vSwitchers;
-	// delete the previous entities
-	Clear();
+	// take out the previous entities, to be overwritten below
+	RecycleEntities();
 	for(int i = 0; i < MAX_CLIENTS; i++)
 	{
 		m_apCharacters[i] = nullptr;
@@ -634,15 +761,15 @@ void CGameWorld::CopyWorld(CGameWorld *pFrom)
 		{
 			CEntity *pCopy = nullptr;
 			if(Type == ENTTYPE_PROJECTILE)
-				pCopy = new CProjectile(*((CProjectile *)pEnt));
+				pCopy = CopyEntity(Type, (CProjectile *)pEnt);
 			else if(Type == ENTTYPE_LASER)
-				pCopy = new CLaser(*((CLaser *)pEnt));
+				pCopy = CopyEntity(Type, (CLaser *)pEnt);
 			else if(Type == ENTTYPE_DRAGGER)
-				pCopy = new CDragger(*((CDragger *)pEnt));
+				pCopy = CopyEntity(Type, (CDragger *)pEnt);
 			else if(Type == ENTTYPE_CHARACTER)
-				pCopy = new CCharacter(*((CCharacter *)pEnt));
+				pCopy = CopyEntity(Type, (CCharacter *)pEnt);
 			else if(Type == ENTTYPE_PICKUP)
-				pCopy = new CPickup(*((CPickup *)pEnt));
+				pCopy = CopyEntity(Type, (CPickup *)pEnt);
 			if(pCopy)
 			{
 				pCopy->m_pParent = pEnt;
@@ -654,6 +781,38 @@ void CGameWorld::CopyWorld(CGameWorld *pFrom)
 	m_IsValidCopy = true;
 }
 
+void CGameWorld::Unlink()
+{
+	for(CEntity *pEnt : m_apFirstEntityTypes)
+		for(; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+			if(pEnt->m_pParent)
+			{
+				if(pEnt->m_pParent->m_pChild == pEnt)
+					pEnt->m_pParent->m_pChild = nullptr;
+				pEnt->m_pParent = nullptr;
+			}
+	if(m_pParent && m_pParent->m_pChild == this)
+		m_pParent->m_pChild = nullptr;
+	m_pParent = nullptr;
+}
+
+void CGameWorld::Relink(CGameWorld *pParent)
+{
+	Unlink();
+	m_pParent = pParent;
+	if(m_pParent->m_pChild && m_pParent->m_pChild != this)
+		m_pParent->m_pChild->m_IsValidCopy = false;
+	m_pParent->m_pChild = this;
+	for(int Type = 0; Type < NUM_ENTTYPES; Type++)
+		for(CEntity *pEnt = FindFirst(Type); pEnt; pEnt = pEnt->TypeNext())
+			if(pEnt->m_Id != -1)
+				if(CEntity *pParentEnt = pParent->GetEntity(pEnt->m_Id, Type))
+				{
+					pEnt->m_pParent = pParentEnt;
+					pParentEnt->m_pChild = pEnt;
+				}
+}
+
 CEntity *CGameWorld::FindMatch(int ObjId, int ObjType, const void *pObjData)
 {
 	switch(ObjType)
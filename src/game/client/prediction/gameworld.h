@@ -3,6 +3,7 @@
 #ifndef GAME_CLIENT_PREDICTION_GAMEWORLD_H
 #define GAME_CLIENT_PREDICTION_GAMEWORLD_H
 
+#include <game/entity_grid.h>
 #include <game/gamecore.h>
 #include <game/teamscore.h>
 
@@ -45,6 +46,7 @@ public:
 	CEntity *IntersectEntity(vec2 Pos0, vec2 Pos1, float Radius, int Type, vec2 &NewPos, const CEntity *pNotThis = nullptr, int CollideWith = -1, const CEntity *pThisOnly = nullptr);
 	void InsertEntity(CEntity *pEntity, bool Last = false);
 	void RemoveEntity(CEntity *pEntity);
+	void UpdateEntityPos(CEntity *pEntity);
 	void RemoveCharacter(CCharacter *pChar);
 	void Tick();
 
@@ -90,6 +92,9 @@ public:
 	CGameWorld *m_pChild;
 
 	int m_LocalClientId;
+	// whether the last snapshot added or removed entities other than
+	// characters, or matched them with locally predicted ones
+	bool m_OtherEntitiesChanged = false;
 
 	bool IsLocalTeam(int OwnerId) const;
 	void OnModified() const;
@@ -98,6 +103,10 @@ public:
 	void NetObjAdd(int ObjId, int ObjType, const void *pObjData, const CNetObj_EntityEx *pDataEx);
 	void NetObjEnd();
 	void CopyWorld(CGameWorld *pFrom);
+	// detaches the world and its entities from the world they were copied from
+	void Unlink();
+	// makes pParent the world this one was copied from, matching the entities by id
+	void Relink(CGameWorld *pParent);
 	CEntity *FindMatch(int ObjId, int ObjType, const void *pObjData);
 	void Clear();
 
@@ -110,11 +119,31 @@ public:
 
 private:
 	void RemoveEntities();
+	void CountOtherEntities(int *pNum, int *pNumWithoutId, int *pNumMarked);
+	// detaches all entities, keeping the ones CopyWorld can reuse
+	void RecycleEntities();
+	template<typename T>
+	T *CopyEntity(int Type, const T *pFrom);
 
 	CEntity *m_pNextTraverseEntity = nullptr;
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
 
+	// spatial index of the entity types that are queried by position
+	CEntityGrid<CEntity> m_CharacterGrid;
+	CEntityGrid<CEntity> m_PickupGrid;
+	std::vector<CEntity *> m_vpGridResult;
+	int m_GridQueryDepth = 0;
+	CEntityGrid<CEntity> *Grid(int Type);
+	template<typename F>
+	void ForEachEntityNear(int Type, vec2 Min, vec2 Max, F &&Fn);
+
 	CCharacter *m_apCharacters[MAX_CLIENTS];
+	int m_NumOtherEntities = 0;
+	int m_NumOtherEntitiesWithoutId = 0;
+
+	// entities of the previous copy, overwritten by the next CopyWorld
+	// instead of allocating new ones
+	std::vector<CEntity *> m_avpEntityPool[NUM_ENTTYPES];
 };
 
 class CCharOrder
@@ -102,17 +102,13 @@ bool CRaceHelper::IsStart(vec2 Prev, vec2 Pos) const
 	}
 	else
 	{
-		std::vector<int> vIndices = m_pGameClient->Collision()->GetMapIndices(Prev, Pos);
-		if(!vIndices.empty())
-		{
-			for(const int Index : vIndices)
-			{
-				if(m_pGameClient->Collision()->GetTileIndex(Index) == TILE_START)
-					return true;
-				if(m_pGameClient->Collision()->GetFrontTileIndex(Index) == TILE_START)
-					return true;
-			}
-		}
+		bool Start = false;
+		const int NumIndices = m_pGameClient->Collision()->GetMapIndices(Prev, Pos, [&](int Index) {
+			Start = m_pGameClient->Collision()->GetTileIndex(Index) == TILE_START || m_pGameClient->Collision()->GetFrontTileIndex(Index) == TILE_START;
+			return !Start;
+		});
+		if(NumIndices > 0)
+			return Start;
 		else
 		{
 			const int Index = m_pGameClient->Collision()->GetPureMapIndex(Pos);
@@ -7,6 +7,7 @@
 #include <antibot/antibot_data.h>
 
 #include <cmath>
+#include <limits>
 #include <engine/map.h>
 
 #include <game/collision.h>
@@ -146,6 +147,19 @@ void CCollision::Init(class CLayers *pLayers)
 			}
 		}
 	}
+
+	m_vTileFlags.resize((size_t)m_Width * m_Height);
+	for(int i = 0; i < m_Width * m_Height; i++)
+		m_vTileFlags[i] = TileFlags(i);
+
+	m_BlocksWidth = (m_Width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	m_BlocksHeight = (m_Height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	m_vBlockFlags.assign((size_t)m_BlocksWidth * m_BlocksHeight, 0);
+	for(int y = 0; y < m_Height; y++)
+	{
+		for(int x = 0; x < m_Width; x++)
+			m_vBlockFlags[y / BLOCK_SIZE * m_BlocksWidth + x / BLOCK_SIZE] |= m_vTileFlags[y * m_Width + x];
+	}
 }
 
 void CCollision::Unload()
@@ -161,6 +175,10 @@ void CCollision::Unload()
 	m_TeleOuts.clear();
 	m_TeleCheckOuts.clear();
 	m_TeleOthers.clear();
+	m_vTileFlags.clear();
+	m_vBlockFlags.clear();
+	m_BlocksWidth = 0;
+	m_BlocksHeight = 0;
 
 	m_pTele = nullptr;
 	m_pSpeedup = nullptr;
@@ -311,6 +329,62 @@ int CCollision::GetMoveRestrictions(CALLBACK_SWITCHACTIVE pfnSwitchActive, void
 	return Restrictions;
 }
 
+// A line sampled at mix(Pos0, Pos1, i / Div) for 0 <= i < End, one sample
+// per pixel like the collision functions step through the map. The cell of
+// the map a sample lies on only ever moves in one direction along each
+// axis, so the first sample on another cell can be found from a guess.
+class CSampledLine
+{
+public:
+	vec2 m_Pos0;
+	vec2 m_Pos1;
+	float m_Div;
+	int m_End;
+
+	vec2 Sample(int i) const
+	{
+		return mix(m_Pos0, m_Pos1, i / m_Div);
+	}
+
+	// Returns the first sample after Sample for which Moved is true, or
+	// m_End. Moved has to stay true for all the samples after it. The guess
+	// is where the line crosses the borders Min and Max of the current cell.
+	template<typename FMoved>
+	int Next(int Sample, vec2 Min, vec2 Max, FMoved &&Moved) const
+	{
+		const vec2 Delta = m_Pos1 - m_Pos0;
+		double Estimate = m_End;
+		if(Delta.x > 0)
+			Estimate = minimum<double>(Estimate, (Max.x - (double)m_Pos0.x) / Delta.x * m_Div);
+		else if(Delta.x < 0)
+			Estimate = minimum<double>(Estimate, (Min.x - (double)m_Pos0.x) / Delta.x * m_Div);
+		if(Delta.y > 0)
+			Estimate = minimum<double>(Estimate, (Max.y - (double)m_Pos0.y) / Delta.y * m_Div);
+		else if(Delta.y < 0)
+			Estimate = minimum<double>(Estimate, (Min.y - (double)m_Pos0.y) / Delta.y * m_Div);
+
+		// correct the guess with the exact samples
+		int Result = (int)std::ceil(clamp<double>(Estimate, Sample + 1, m_End));
+		while(Result < m_End && !Moved(Result))
+			Result++;
+		while(Result - 1 > Sample && Moved(Result - 1))
+			Result--;
+		return Result;
+	}
+};
+
+// Borders of a cell of Size pixels, the cells at the edges of the map
+// extend to infinity.
+static vec2 CellMin(ivec2 Cell, int Size)
+{
+	return vec2(Cell.x > 0 ? Cell.x * Size : -std::numeric_limits<float>::infinity(), Cell.y > 0 ? Cell.y * Size : -std::numeric_limits<float>::infinity());
+}
+
+static vec2 CellMax(ivec2 Cell, ivec2 LastCell, int Size)
+{
+	return vec2(Cell.x < LastCell.x ? (Cell.x + 1) * Size : std::numeric_limits<float>::infinity(), Cell.y < LastCell.y ? (Cell.y + 1) * Size : std::numeric_limits<float>::infinity());
+}
+
 int CCollision::GetTile(int x, int y) const
 {
 	if(!m_pTiles)
@@ -325,13 +399,48 @@ int CCollision::GetTile(int x, int y) const
 	return 0;
 }
 
-// TODO: rewrite this smarter!
+int CCollision::NextFlaggedSample(vec2 Pos0, vec2 Pos1, float Div, int NumSamples, int Sample, int Flags) const
+{
+	if(m_vTileFlags.empty())
+		return NumSamples;
+
+	const CSampledLine Line{Pos0, Pos1, Div, NumSamples};
+	const ivec2 LastTile(m_Width - 1, m_Height - 1);
+	// the tile of the rounded position, like CheckPoint and GetPureMapIndex
+	auto &&SampleTile = [&](int i) {
+		vec2 Pos = Line.Sample(i);
+		return ivec2(clamp(round_to_int(Pos.x) / 32, 0, LastTile.x), clamp(round_to_int(Pos.y) / 32, 0, LastTile.y));
+	};
+	while(Sample < NumSamples)
+	{
+		const ivec2 Tile = SampleTile(Sample);
+		const ivec2 Block = Tile / BLOCK_SIZE;
+		if(!(m_vBlockFlags[Block.y * m_BlocksWidth + Block.x] & Flags))
+		{
+			Sample = Line.Next(Sample, CellMin(Block, BLOCK_SIZE * 32), CellMax(Block, LastTile / BLOCK_SIZE, BLOCK_SIZE * 32), [&](int i) {
+				return SampleTile(i) / BLOCK_SIZE != Block;
+			});
+		}
+		else if(!(m_vTileFlags[Tile.y * m_Width + Tile.x] & Flags))
+		{
+			Sample = Line.Next(Sample, CellMin(Tile, 32), CellMax(Tile, LastTile, 32), [&](int i) {
+				return SampleTile(i) != Tile;
+			});
+		}
+		else
+		{
+			return Sample;
+		}
+	}
+	return NumSamples;
+}
+
 int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision) const
 {
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance + 1);
-	vec2 Last = Pos0;
-	for(int i = 0; i <= End; i++)
+	// step through every pixel, but skip the ones that can't collide
+	for(int i = NextFlaggedSample(Pos0, Pos1, End, End + 1, 0, FLAG_SOLID); i <= End; i = NextFlaggedSample(Pos0, Pos1, End, End + 1, i + 1, FLAG_SOLID))
 	{
 		float a = i / (float)End;
 		vec2 Pos = mix(Pos0, Pos1, a);
@@ -344,11 +453,9 @@ int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *p
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = i > 0 ? mix(Pos0, Pos1, (i - 1) / (float)End) : Pos0;
 			return GetCollisionAt(ix, iy);
 		}
-
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -361,11 +468,14 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 {
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance + 1);
-	vec2 Last = Pos0;
 	int dx = 0, dy = 0; // Offset for checking the "through" tile
 	ThroughOffset(Pos0, Pos1, &dx, &dy);
-	for(int i = 0; i <= End; i++)
+	// the skipped pixels would reset it
+	if(pTeleNr)
+		*pTeleNr = 0;
+	for(int i = NextFlaggedSample(Pos0, Pos1, End, End + 1, 0, FLAG_HOOK); i <= End; i = NextFlaggedSample(Pos0, Pos1, End, End + 1, i + 1, FLAG_HOOK))
 	{
+		vec2 Last = i > 0 ? mix(Pos0, Pos1, (i - 1) / (float)End) : Pos0;
 		float a = i / (float)End;
 		vec2 Pos = mix(Pos0, Pos1, a);
 		// Temporary position for checking collision
@@ -407,8 +517,6 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 				*pOutBeforeCollision = Last;
 			return hit;
 		}
-
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -421,9 +529,12 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 {
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance + 1);
-	vec2 Last = Pos0;
-	for(int i = 0; i <= End; i++)
+	// the skipped pixels would reset it
+	if(pTeleNr)
+		*pTeleNr = 0;
+	for(int i = NextFlaggedSample(Pos0, Pos1, End, End + 1, 0, FLAG_WEAPON); i <= End; i = NextFlaggedSample(Pos0, Pos1, End, End + 1, i + 1, FLAG_WEAPON))
 	{
+		vec2 Last = i > 0 ? mix(Pos0, Pos1, (i - 1) / (float)End) : Pos0;
 		float a = i / (float)End;
 		vec2 Pos = mix(Pos0, Pos1, a);
 		// Temporary position for checking collision
@@ -455,8 +566,6 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 				*pOutBeforeCollision = Last;
 			return GetCollisionAt(ix, iy);
 		}
-
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -839,7 +948,11 @@ bool CCollision::TileExists(int Index) const
 {
 	if(Index < 0)
 		return false;
+	return m_vTileFlags[Index] & FLAG_EXISTS;
+}
 
+bool CCollision::TileExistsUncached(int Index) const
+{
 	if((m_pTiles[Index].m_Index >= TILE_FREEZE && m_pTiles[Index].m_Index <= TILE_TELE_LASER_DISABLE) || (m_pTiles[Index].m_Index >= TILE_LFREEZE && m_pTiles[Index].m_Index <= TILE_LUNFREEZE))
 		return true;
 	if(m_pFront && ((m_pFront[Index].m_Index >= TILE_FREEZE && m_pFront[Index].m_Index <= TILE_TELE_LASER_DISABLE) || (m_pFront[Index].m_Index >= TILE_LFREEZE && m_pFront[Index].m_Index <= TILE_LUNFREEZE)))
@@ -857,6 +970,54 @@ bool CCollision::TileExists(int Index) const
 	return TileExistsNext(Index);
 }
 
+int CCollision::TileFlags(int Index) const
+{
+	int Flags = 0;
+	if(TileExistsUncached(Index))
+		Flags |= FLAG_EXISTS;
+
+	const int Tile = m_pTiles[Index].m_Index;
+	const int Front = m_pFront ? m_pFront[Index].m_Index : 0;
+	const int Tele = m_pTele ? m_pTele[Index].m_Type : 0;
+	if(Tile == TILE_SOLID || Tile == TILE_NOHOOK)
+		Flags |= FLAG_SOLID | FLAG_HOOK | FLAG_WEAPON | FLAG_LASER;
+	// hook blockers and both kinds of hook teleporters, see IntersectLineTeleHook
+	if(Tile == TILE_THROUGH_ALL || Tile == TILE_THROUGH_DIR || Front == TILE_THROUGH_ALL || Front == TILE_THROUGH_DIR || Tele == TILE_TELEIN || Tele == TILE_TELEINHOOK)
+		Flags |= FLAG_HOOK;
+	if(Tele == TILE_TELEIN || Tele == TILE_TELEINWEAPON)
+		Flags |= FLAG_WEAPON;
+	if(Tile == TILE_NOLASER || Front == TILE_NOLASER)
+		Flags |= FLAG_LASER;
+	return Flags;
+}
+
+void CCollision::UpdateTileFlags(int Index)
+{
+	// a tile depends on the stoppers of its direct neighbours, see TileExistsNext
+	const int aNeighbours[] = {Index - m_Width, Index - 1, Index, Index + 1, Index + m_Width};
+	for(int Neighbour : aNeighbours)
+	{
+		if(Neighbour >= 0 && Neighbour < m_Width * m_Height)
+		{
+			m_vTileFlags[Neighbour] = TileFlags(Neighbour);
+			UpdateBlockFlags(Neighbour);
+		}
+	}
+}
+
+void CCollision::UpdateBlockFlags(int Index)
+{
+	const int BlockX = Index % m_Width / BLOCK_SIZE;
+	const int BlockY = Index / m_Width / BLOCK_SIZE;
+	int Flags = 0;
+	for(int y = BlockY * BLOCK_SIZE; y < minimum((BlockY + 1) * BLOCK_SIZE, m_Height); y++)
+	{
+		for(int x = BlockX * BLOCK_SIZE; x < minimum((BlockX + 1) * BLOCK_SIZE, m_Width); x++)
+			Flags |= m_vTileFlags[y * m_Width + x];
+	}
+	m_vBlockFlags[BlockY * m_BlocksWidth + BlockX] = Flags;
+}
+
 bool CCollision::TileExistsNext(int Index) const
 {
 	if(Index < 0)
@@ -911,46 +1072,78 @@ int CCollision::GetMapIndex(vec2 Pos) const
 		return -1;
 }
 
+// the tile GetMapIndices looks at for a position
+static ivec2 MapIndicesTile(vec2 Pos, int Width, int Height)
+{
+	return ivec2(clamp((int)Pos.x / 32, 0, Width - 1), clamp((int)Pos.y / 32, 0, Height - 1));
+}
+
 std::vector<int> CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxIndices) const
 {
-	std::vector<int> vIndices;
+	std::vector<int> vIndices(GetMapIndices(PrevPos, Pos, nullptr, 0));
+	GetMapIndices(PrevPos, Pos, vIndices.data(), vIndices.size());
+	// one more index than MaxIndices is returned
+	if(MaxIndices && vIndices.size() > MaxIndices + 1)
+		vIndices.resize(MaxIndices + 1);
+	return vIndices;
+}
+
+// calls Visit for each index of GetMapIndices until it returns false
+template<typename FVisit>
+static int VisitMapIndices(const CCollision *pCollision, vec2 PrevPos, vec2 Pos, FVisit &&Visit)
+{
+	const int Width = pCollision->GetWidth();
+	const int Height = pCollision->GetHeight();
 	float d = distance(PrevPos, Pos);
-	int End(d + 1);
 	if(!d)
 	{
-		int Nx = clamp((int)Pos.x / 32, 0, m_Width - 1);
-		int Ny = clamp((int)Pos.y / 32, 0, m_Height - 1);
-		int Index = Ny * m_Width + Nx;
-
-		if(TileExists(Index))
-		{
-			vIndices.push_back(Index);
-			return vIndices;
-		}
-		else
-			return vIndices;
+		int Nx = clamp((int)Pos.x / 32, 0, Width - 1);
+		int Ny = clamp((int)Pos.y / 32, 0, Height - 1);
+		int Index = Ny * Width + Nx;
+
+		if(!pCollision->TileExists(Index))
+			return 0;
+		Visit(Index);
+		return 1;
 	}
-	else
+
+	// sample every pixel of the way like before, but skip over the
+	// samples that are on the same tile as the previous one
+	const CSampledLine Line{PrevPos, Pos, d, int(d + 1)};
+	int NumIndices = 0;
+	int LastIndex = 0;
+	for(int i = 0; i < Line.m_End;)
 	{
-		int LastIndex = 0;
-		for(int i = 0; i < End; i++)
+		const ivec2 Tile = MapIndicesTile(Line.Sample(i), Width, Height);
+		int Index = Tile.y * Width + Tile.x;
+		if(pCollision->TileExists(Index) && LastIndex != Index)
 		{
-			float a = i / d;
-			vec2 Tmp = mix(PrevPos, Pos, a);
-			int Nx = clamp((int)Tmp.x / 32, 0, m_Width - 1);
-			int Ny = clamp((int)Tmp.y / 32, 0, m_Height - 1);
-			int Index = Ny * m_Width + Nx;
-			if(TileExists(Index) && LastIndex != Index)
-			{
-				if(MaxIndices && vIndices.size() > MaxIndices)
-					return vIndices;
-				vIndices.push_back(Index);
-				LastIndex = Index;
-			}
+			NumIndices++;
+			LastIndex = Index;
+			if(!Visit(Index))
+				break;
 		}
-
-		return vIndices;
+		i = Line.Next(i, CellMin(Tile, 32), CellMax(Tile, ivec2(Width - 1, Height - 1), 32), [&](int Sample) {
+			return MapIndicesTile(Line.Sample(Sample), Width, Height) != Tile;
+		});
 	}
+	return NumIndices;
+}
+
+int CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, int *pIndices, int MaxIndices) const
+{
+	int NumIndices = 0;
+	return VisitMapIndices(this, PrevPos, Pos, [&](int Index) {
+		if(NumIndices < MaxIndices)
+			pIndices[NumIndices] = Index;
+		NumIndices++;
+		return true;
+	});
+}
+
+int CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, const std::function<bool(int Index)> &Visit) const
+{
+	return VisitMapIndices(this, PrevPos, Pos, Visit);
 }
 
 vec2 CCollision::GetPos(int Index) const
@@ -1079,6 +1272,7 @@ void CCollision::SetCollisionAt(float x, float y, int Index)
 	int Ny = clamp(round_to_int(y) / 32, 0, m_Height - 1);
 
 	m_pTiles[Ny * m_Width + Nx].m_Index = Index;
+	UpdateTileFlags(Ny * m_Width + Nx);
 }
 
 void CCollision::SetDoorCollisionAt(float x, float y, int Type, int Flags, int Number)
@@ -1091,6 +1285,7 @@ void CCollision::SetDoorCollisionAt(float x, float y, int Type, int Flags, int N
 	m_pDoor[Ny * m_Width + Nx].m_Index = Type;
 	m_pDoor[Ny * m_Width + Nx].m_Flags = Flags;
 	m_pDoor[Ny * m_Width + Nx].m_Number = Number;
+	UpdateTileFlags(Ny * m_Width + Nx);
 }
 
 void CCollision::GetDoorTile(int Index, CDoorTile *pDoorTile) const
@@ -1140,9 +1335,10 @@ void ThroughOffset(vec2 Pos0, vec2 Pos1, int *pOffsetX, int *pOffsetY)
 int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision) const
 {
 	float d = distance(Pos0, Pos1);
-	vec2 Last = Pos0;
+	int id = std::ceil(d);
 
-	for(int i = 0, id = std::ceil(d); i < id; i++)
+	// step through every pixel, but skip the ones that can't collide
+	for(int i = NextFlaggedSample(Pos0, Pos1, d, id, 0, FLAG_LASER); i < id; i = NextFlaggedSample(Pos0, Pos1, d, id, i + 1, FLAG_LASER))
 	{
 		float a = i / d;
 		vec2 Pos = mix(Pos0, Pos1, a);
@@ -1153,13 +1349,12 @@ int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = i > 0 ? mix(Pos0, Pos1, (i - 1) / d) : Pos0;
 			if(GetFrontIndex(Nx, Ny) == TILE_NOLASER)
 				return GetFrontCollisionAt(Pos.x, Pos.y);
 			else
 				return GetCollisionAt(Pos.x, Pos.y);
 		}
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -6,6 +6,7 @@
 #include <base/vmath.h>
 #include <engine/shared/protocol.h>
 
+#include <functional>
 #include <map>
 #include <vector>
 
@@ -76,8 +77,17 @@ public:
 	int GetPureMapIndex(float x, float y) const;
 	int GetPureMapIndex(vec2 Pos) const { return GetPureMapIndex(Pos.x, Pos.y); }
 	std::vector<int> GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxIndices = 0) const;
+	// Writes the same indices as the function above into pIndices without
+	// allocating, stopping after MaxIndices. Returns the number of all
+	// indices, which can be larger than MaxIndices.
+	int GetMapIndices(vec2 PrevPos, vec2 Pos, int *pIndices, int MaxIndices) const;
+	// Calls Visit for the same indices in order until it returns false.
+	// Returns the number of indices visited.
+	int GetMapIndices(vec2 PrevPos, vec2 Pos, const std::function<bool(int Index)> &Visit) const;
 	int GetMapIndex(vec2 Pos) const;
 	bool TileExists(int Index) const;
+	// same as TileExists, but computed from the tiles instead of the cache
+	bool TileExistsUncached(int Index) const;
 	bool TileExistsNext(int Index) const;
 	vec2 GetPos(int Index) const;
 	int GetTileIndex(int Index) const;
@@ -157,6 +167,37 @@ private:
 	CTuneTile *m_pTune;
 	CDoorTile *m_pDoor;
 
+	enum
+	{
+		// TileExists is true
+		FLAG_EXISTS = 1 << 0,
+		// stops IntersectLine
+		FLAG_SOLID = 1 << 1,
+		// can stop IntersectLineTeleHook
+		FLAG_HOOK = 1 << 2,
+		// can stop IntersectLineTeleWeapon
+		FLAG_WEAPON = 1 << 3,
+		// can stop IntersectNoLaser
+		FLAG_LASER = 1 << 4,
+
+		// side length of the blocks of tiles in m_vBlockFlags
+		BLOCK_SIZE = 8,
+	};
+
+	// the flags of every tile, updated whenever a tile changes
+	std::vector<unsigned char> m_vTileFlags;
+	// the flags of all tiles of a block combined, to skip empty blocks at once
+	std::vector<unsigned char> m_vBlockFlags;
+	int m_BlocksWidth;
+	int m_BlocksHeight;
+	int TileFlags(int Index) const;
+	void UpdateTileFlags(int Index);
+	void UpdateBlockFlags(int Index);
+	// Returns the first sample from Sample on that lies on a tile with one
+	// of the flags, for lines sampled at mix(Pos0, Pos1, i / Div) for
+	// 0 <= i < NumSamples. Returns NumSamples if there is none.
+	int NextFlaggedSample(vec2 Pos0, vec2 Pos1, float Div, int NumSamples, int Sample, int Flags) const;
+
 	// TILE_TELEIN
 	std::map<int, std::vector<vec2>> m_TeleIns;
 	// TILE_TELEOUT
@@ -0,0 +1,200 @@
+#ifndef GAME_ENTITY_GRID_H
+#define GAME_ENTITY_GRID_H
+
+#include <base/system.h>
+#include <base/vmath.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/*
+	Class: CEntityGrid
+		Uniform grid over world positions, hashed into a fixed number of
+		buckets. Entities are added with the position they currently have
+		and must be moved whenever that position changes.
+
+		Queries return every entity in a box, ordered like the world's
+		entity list: entities inserted in front come first, entities
+		appended at the end come last. This keeps iteration order and thus
+		tie breaking identical to a linear walk over the list.
+*/
+template<typename TEntity>
+class CEntityGrid
+{
+public:
+	enum
+	{
+		CELL_SIZE = 256,
+		NUM_BUCKETS = 1024,
+		// larger queries are cheaper as a linear walk
+		MAX_QUERY_CELLS = NUM_BUCKETS / 8,
+	};
+
+	CEntityGrid() { Clear(); }
+
+	void Clear()
+	{
+		for(auto &vBucket : m_avBuckets)
+			vBucket.clear();
+		std::fill(std::begin(m_aBucketStamps), std::end(m_aBucketStamps), 0);
+		m_Stamp = 0;
+		m_FirstOrder = 0;
+		m_LastOrder = 0;
+		m_MaxRadius = 0.0f;
+		m_Size = 0;
+	}
+
+	int Size() const { return m_Size; }
+
+	// returns the bucket the entity was put in, needed to move or remove it
+	int Insert(TEntity *pEntity, vec2 Pos, float Radius, bool Last)
+	{
+		m_MaxRadius = maximum(m_MaxRadius, Radius);
+		const int Bucket = BucketOf(Pos);
+		m_avBuckets[Bucket].push_back({pEntity, Pos, Last ? --m_LastOrder : ++m_FirstOrder});
+		m_Size++;
+		return Bucket;
+	}
+
+	// returns the new bucket of the entity
+	int Move(TEntity *pEntity, int Bucket, vec2 Pos)
+	{
+		std::vector<CEntry> &vBucket = m_avBuckets[Bucket];
+		auto It = Find(vBucket, pEntity);
+		const int NewBucket = BucketOf(Pos);
+		if(NewBucket == Bucket)
+		{
+			It->m_Pos = Pos;
+			return Bucket;
+		}
+		CEntry Entry = *It;
+		Entry.m_Pos = Pos;
+		*It = vBucket.back();
+		vBucket.pop_back();
+		m_avBuckets[NewBucket].push_back(Entry);
+		return NewBucket;
+	}
+
+	void Remove(TEntity *pEntity, int Bucket)
+	{
+		std::vector<CEntry> &vBucket = m_avBuckets[Bucket];
+		auto It = Find(vBucket, pEntity);
+		*It = vBucket.back();
+		vBucket.pop_back();
+		m_Size--;
+	}
+
+	// whether the entity is indexed in the given bucket at the given position
+	bool Contains(const TEntity *pEntity, int Bucket, vec2 Pos) const
+	{
+		if(Bucket < 0 || Bucket >= NUM_BUCKETS)
+			return false;
+		for(const CEntry &Entry : m_avBuckets[Bucket])
+			if(Entry.m_pEntity == pEntity)
+				return Entry.m_Pos == Pos;
+		return false;
+	}
+
+	/*
+		Function: Query
+			Collects all entities whose disc of radius up to the largest
+			inserted radius may overlap the box.
+
+		Returns:
+			False if the box spans too many cells, vpResult is left
+			untouched then and the caller should walk its list instead.
+	*/
+	bool Query(vec2 Min, vec2 Max, std::vector<TEntity *> &vpResult)
+	{
+		// one unit of slack against rounding in the callers' distance checks
+		const float Margin = m_MaxRadius + 1.0f;
+		Min -= vec2(Margin, Margin);
+		Max += vec2(Margin, Margin);
+		const int MinX = CellCoord(Min.x), MinY = CellCoord(Min.y);
+		const int MaxX = CellCoord(Max.x), MaxY = CellCoord(Max.y);
+		if((int64_t)(MaxX - MinX + 1) * (MaxY - MinY + 1) > MAX_QUERY_CELLS)
+			return false;
+
+		if(++m_Stamp == 0)
+		{
+			std::fill(std::begin(m_aBucketStamps), std::end(m_aBucketStamps), 0);
+			m_Stamp = 1;
+		}
+
+		m_vCandidates.clear();
+		for(int y = MinY; y <= MaxY; y++)
+		{
+			for(int x = MinX; x <= MaxX; x++)
+			{
+				const int Bucket = HashCell(x, y);
+				if(m_aBucketStamps[Bucket] == m_Stamp)
+					continue;
+				m_aBucketStamps[Bucket] = m_Stamp;
+				for(const CEntry &Entry : m_avBuckets[Bucket])
+				{
+					// also drops entities of other cells sharing the bucket
+					if(Entry.m_Pos.x >= Min.x && Entry.m_Pos.x <= Max.x && Entry.m_Pos.y >= Min.y && Entry.m_Pos.y <= Max.y)
+						m_vCandidates.push_back(Entry);
+				}
+			}
+		}
+
+		std::sort(m_vCandidates.begin(), m_vCandidates.end(), [](const CEntry &A, const CEntry &B) {
+			return A.m_Order > B.m_Order;
+		});
+		vpResult.clear();
+		for(const CEntry &Entry : m_vCandidates)
+			vpResult.push_back(Entry.m_pEntity);
+		return true;
+	}
+
+private:
+	struct CEntry
+	{
+		TEntity *m_pEntity;
+		vec2 m_Pos;
+		int64_t m_Order;
+	};
+
+	static typename std::vector<CEntry>::iterator Find(std::vector<CEntry> &vBucket, const TEntity *pEntity)
+	{
+		auto It = std::find_if(vBucket.begin(), vBucket.end(), [pEntity](const CEntry &Entry) { return Entry.m_pEntity == pEntity; });
+		dbg_assert(It != vBucket.end(), "entity not found in grid bucket");
+		return It;
+	}
+
+	static int CellCoord(float Value)
+	{
+		// clamp far away and invalid positions into the outermost cells
+		constexpr float LIMIT = 1 << 20;
+		float Cell = Value / CELL_SIZE;
+		if(!(Cell > -LIMIT))
+			Cell = -LIMIT;
+		if(!(Cell < LIMIT))
+			Cell = LIMIT;
+		return (int)std::floor(Cell);
+	}
+
+	static int HashCell(int x, int y)
+	{
+		return (int)(((unsigned)x * 73856093u) ^ ((unsigned)y * 19349663u)) & (NUM_BUCKETS - 1);
+	}
+
+	static int BucketOf(vec2 Pos)
+	{
+		return HashCell(CellCoord(Pos.x), CellCoord(Pos.y));
+	}
+
+	std::vector<CEntry> m_avBuckets[NUM_BUCKETS];
+	unsigned m_aBucketStamps[NUM_BUCKETS];
+	unsigned m_Stamp;
+	int64_t m_FirstOrder;
+	int64_t m_LastOrder;
+	float m_MaxRadius;
+	int m_Size;
+	std::vector<CEntry> m_vCandidates;
+};
+
+#endif
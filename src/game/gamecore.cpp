@@ -692,6 +692,68 @@ void CCharacterCore::ReadDDNet(const CNetObj_DDNetCharacter *pObjDDNet)
 	}
 }
 
+void CCharacterCore::WriteDDNet(CNetObj_DDNetCharacter *pObjDDNet) const
+{
+	pObjDDNet->m_Flags = 0;
+	if(m_Solo)
+		pObjDDNet->m_Flags |= CHARACTERFLAG_SOLO;
+	if(m_Jetpack)
+		pObjDDNet->m_Flags |= CHARACTERFLAG_JETPACK;
+	if(m_CollisionDisabled)
+		pObjDDNet->m_Flags |= CHARACTERFLAG_COLLISION_DISABLED;
+	if(m_HammerHitDisabled)
+		pObjDDNet->m_Flags |= CHARACTERFLAG_HAMMER_HIT_DISABLED;
+	if(m_ShotgunHitDisabled)
+		pObjDDNet->m_Flags |= CHARACTERFLAG_SHOTGUN_HIT_DISABLED;
+	if(m_GrenadeHitDisabled)
+		pObjDDNet->m_Flags |= CHARACTERFLAG_GRENADE_HIT_DISABLED;
+	if(m_LaserHitDisabled)
+		pObjDDNet->m_Flags |= CHARACTERFLAG_LASER_HIT_DISABLED;
+	if(m_HookHitDisabled)
+		pObjDDNet->m_Flags |= CHARACTERFLAG_HOOK_HIT_DISABLED;
+	if(m_Super)
+		pObjDDNet->m_Flags |= CHARACTERFLAG_SUPER;
+	if(m_Invincible)
+		pObjDDNet->m_Flags |= CHARACTERFLAG_INVINCIBLE;
+	if(m_EndlessHook)
+		pObjDDNet->m_Flags |= CHARACTERFLAG_ENDLESS_HOOK;
+	if(m_EndlessJump)
+		pObjDDNet->m_Flags |= CHARACTERFLAG_ENDLESS_JUMP;
+	if(m_LiveFrozen)
+		pObjDDNet->m_Flags |= CHARACTERFLAG_MOVEMENTS_DISABLED;
+	if(m_HasTelegunGrenade)
+		pObjDDNet->m_Flags |= CHARACTERFLAG_TELEGUN_GRENADE;
+	if(m_HasTelegunGun)
+		pObjDDNet->m_Flags |= CHARACTERFLAG_TELEGUN_GUN;
+	if(m_HasTelegunLaser)
+		pObjDDNet->m_Flags |= CHARACTERFLAG_TELEGUN_LASER;
+	if(m_aWeapons[WEAPON_HAMMER].m_Got)
+		pObjDDNet->m_Flags |= CHARACTERFLAG_WEAPON_HAMMER;
+	if(m_aWeapons[WEAPON_GUN].m_Got)
+		pObjDDNet->m_Flags |= CHARACTERFLAG_WEAPON_GUN;
+	if(m_aWeapons[WEAPON_SHOTGUN].m_Got)
+		pObjDDNet->m_Flags |= CHARACTERFLAG_WEAPON_SHOTGUN;
+	if(m_aWeapons[WEAPON_GRENADE].m_Got)
+		pObjDDNet->m_Flags |= CHARACTERFLAG_WEAPON_GRENADE;
+	if(m_aWeapons[WEAPON_LASER].m_Got)
+		pObjDDNet->m_Flags |= CHARACTERFLAG_WEAPON_LASER;
+	if(m_aWeapons[WEAPON_NINJA].m_Got)
+		pObjDDNet->m_Flags |= CHARACTERFLAG_WEAPON_NINJA;
+	if(m_IsInFreeze)
+		pObjDDNet->m_Flags |= CHARACTERFLAG_IN_FREEZE;
+
+	pObjDDNet->m_FreezeEnd = m_DeepFrozen ? -1 : m_FreezeEnd;
+	pObjDDNet->m_Jumps = m_Jumps;
+	pObjDDNet->m_TeleCheckpoint = -1;
+	pObjDDNet->m_StrongWeakId = 0;
+	pObjDDNet->m_JumpedTotal = m_JumpedTotal;
+	pObjDDNet->m_NinjaActivationTick = m_Ninja.m_ActivationTick;
+	pObjDDNet->m_FreezeStart = m_FreezeStart;
+	pObjDDNet->m_TargetX = m_Input.m_TargetX;
+	pObjDDNet->m_TargetY = m_Input.m_TargetY;
+	pObjDDNet->m_TuneZoneOverride = -1;
+}
+
 void CCharacterCore::Quantize()
 {
 	CNetObj_CharacterCore Core;
@@ -246,6 +246,9 @@ public:
 	// DDNet Character
 	void SetTeamsCore(CTeamsCore *pTeams);
 	void ReadDDNet(const CNetObj_DDNetCharacter *pObjDDNet);
+	// Writes the state ReadDDNet reads, the fields that only the character
+	// knows keep their defaults.
+	void WriteDDNet(CNetObj_DDNetCharacter *pObjDDNet) const;
 	bool m_Solo;
 	bool m_Jetpack;
 	bool m_CollisionDisabled;
@@ -44,9 +44,20 @@ void CDoor::Reset()
 	m_MarkedForDestroy = true;
 }
 
+bool CDoor::SnapVisible(int SnappingClient)
+{
+	return !NetworkClipped(SnappingClient, m_Pos) || !NetworkClipped(SnappingClient, m_To);
+}
+
+void CDoor::SnapShared()
+{
+	GameServer()->SnapLaserObject(CSnapContext(VERSION_DDNET_ENTITY_NETOBJS), GetId(),
+		m_Pos, m_To, -1, -1, LASERTYPE_DOOR, 0, m_Number);
+}
+
 void CDoor::Snap(int SnappingClient)
 {
-	if(NetworkClipped(SnappingClient, m_Pos) && NetworkClipped(SnappingClient, m_To))
+	if(!SnapVisible(SnappingClient))
 		return;
 
 	int SnappingClientVersion = GameServer()->GetClientVersion(SnappingClient);
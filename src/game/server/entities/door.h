@@ -19,6 +19,9 @@ public:
 
 	void Reset() override;
 	void Snap(int SnappingClient) override;
+	bool HasSharedSnap() const override { return true; }
+	void SnapShared() override;
+	bool SnapVisible(int SnappingClient) override;
 };
 
 #endif // GAME_SERVER_ENTITIES_DOOR_H
@@ -138,9 +138,21 @@ void CGun::Reset()
 	m_MarkedForDestroy = true;
 }
 
+bool CGun::SnapVisible(int SnappingClient)
+{
+	return !NetworkClipped(SnappingClient);
+}
+
+void CGun::SnapShared()
+{
+	int Subtype = (m_Explosive ? 1 : 0) | (m_Freeze ? 2 : 0);
+	GameServer()->SnapLaserObject(CSnapContext(VERSION_DDNET_ENTITY_NETOBJS), GetId(),
+		m_Pos, m_Pos, -1, -1, LASERTYPE_GUN, Subtype, m_Number);
+}
+
 void CGun::Snap(int SnappingClient)
 {
-	if(NetworkClipped(SnappingClient))
+	if(!SnapVisible(SnappingClient))
 		return;
 
 	int SnappingClientVersion = GameServer()->GetClientVersion(SnappingClient);
@@ -36,6 +36,9 @@ public:
 	void Reset() override;
 	void Tick() override;
 	void Snap(int SnappingClient) override;
+	bool HasSharedSnap() const override { return true; }
+	void SnapShared() override;
+	bool SnapVisible(int SnappingClient) override;
 };
 
 #endif // GAME_SERVER_ENTITIES_GUN_H
@@ -290,26 +290,35 @@ void CLaser::TickPaused()
 	++m_EvalTick;
 }
 
-void CLaser::Snap(int SnappingClient)
+bool CLaser::SnapVisible(int SnappingClient)
 {
 	if(NetworkClipped(SnappingClient) && NetworkClipped(SnappingClient, m_From))
-		return;
+		return false;
 	CCharacter *pOwnerChar = nullptr;
 	if(m_Owner >= 0)
 		pOwnerChar = GameServer()->GetPlayerChar(m_Owner);
 	if(!pOwnerChar)
-		return;
+		return false;
 
-	pOwnerChar = nullptr;
 	CClientMask TeamMask = CClientMask().set();
 
-	if(m_Owner >= 0)
-		pOwnerChar = GameServer()->GetPlayerChar(m_Owner);
-
-	if(pOwnerChar && pOwnerChar->IsAlive())
+	if(pOwnerChar->IsAlive())
 		TeamMask = pOwnerChar->TeamMask();
 
-	if(SnappingClient != SERVER_DEMO_CLIENT && !TeamMask.test(SnappingClient))
+	return SnappingClient == SERVER_DEMO_CLIENT || TeamMask.test(SnappingClient);
+}
+
+void CLaser::SnapShared()
+{
+	int LaserType = m_Type == WEAPON_LASER ? LASERTYPE_RIFLE : m_Type == WEAPON_SHOTGUN ? LASERTYPE_SHOTGUN : -1;
+
+	GameServer()->SnapLaserObject(CSnapContext(VERSION_DDNET_ENTITY_NETOBJS), GetId(),
+		m_Pos, m_From, m_EvalTick, m_Owner, LaserType, 0, m_Number);
+}
+
+void CLaser::Snap(int SnappingClient)
+{
+	if(!SnapVisible(SnappingClient))
 		return;
 
 	int SnappingClientVersion = GameServer()->GetClientVersion(SnappingClient);
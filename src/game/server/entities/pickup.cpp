@@ -163,9 +163,19 @@ void CPickup::TickPaused()
 {
 }
 
+bool CPickup::SnapVisible(int SnappingClient)
+{
+	return !NetworkClipped(SnappingClient);
+}
+
+void CPickup::SnapShared()
+{
+	GameServer()->SnapPickup(CSnapContext(VERSION_DDNET_ENTITY_NETOBJS), GetId(), m_Pos, m_Type, m_Subtype, m_Number);
+}
+
 void CPickup::Snap(int SnappingClient)
 {
-	if(NetworkClipped(SnappingClient))
+	if(!SnapVisible(SnappingClient))
 		return;
 
 	int SnappingClientVersion = GameServer()->GetClientVersion(SnappingClient);
@@ -191,6 +201,6 @@ void CPickup::Move()
 	if(Server()->Tick() % (int)(Server()->TickSpeed() * 0.15f) == 0)
 	{
 		GameServer()->Collision()->MoverSpeed(m_Pos.x, m_Pos.y, &m_Core);
-		m_Pos += m_Core;
+		SetPos(m_Pos + m_Core);
 	}
 }
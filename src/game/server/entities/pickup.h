@@ -16,6 +16,9 @@ public:
 	void Tick() override;
 	void TickPaused() override;
 	void Snap(int SnappingClient) override;
+	bool HasSharedSnap() const override { return true; }
+	void SnapShared() override;
+	bool SnapVisible(int SnappingClient) override;
 
 	int Type() const { return m_Type; }
 	int Subtype() const { return m_Subtype; }
@@ -105,17 +105,29 @@ void CPlasma::Reset()
 	m_MarkedForDestroy = true;
 }
 
-void CPlasma::Snap(int SnappingClient)
+bool CPlasma::SnapVisible(int SnappingClient)
 {
 	// Only players who can see the targeted player can see the plasma bullet
 	CCharacter *pTarget = GameServer()->GetPlayerChar(m_ForClientId);
 	if(!pTarget || !pTarget->CanSnapCharacter(SnappingClient))
 	{
-		return;
+		return false;
 	}
 
 	// Only players with the plasma bullet in their field of view or who want to see everything will receive the snap
-	if(NetworkClipped(SnappingClient))
+	return !NetworkClipped(SnappingClient);
+}
+
+void CPlasma::SnapShared()
+{
+	int Subtype = (m_Explosive ? 1 : 0) | (m_Freeze ? 2 : 0);
+	GameServer()->SnapLaserObject(CSnapContext(VERSION_DDNET_ENTITY_NETOBJS), GetId(),
+		m_Pos, m_Pos, m_EvalTick, -1, LASERTYPE_PLASMA, Subtype, m_Number);
+}
+
+void CPlasma::Snap(int SnappingClient)
+{
+	if(!SnapVisible(SnappingClient))
 		return;
 
 	int SnappingClientVersion = GameServer()->GetClientVersion(SnappingClient);
@@ -40,6 +40,9 @@ public:
 	void Reset() override;
 	void Tick() override;
 	void Snap(int SnappingClient) override;
+	bool HasSharedSnap() const override { return true; }
+	void SnapShared() override;
+	bool SnapVisible(int SnappingClient) override;
 	void SwapClients(int Client1, int Client2) override;
 };
 
@@ -29,6 +29,9 @@ public:
 	virtual void Tick() override;
 	virtual void TickPaused() override;
 	virtual void Snap(int SnappingClient) override;
+	virtual bool HasSharedSnap() const override { return true; }
+	virtual void SnapShared() override;
+	virtual bool SnapVisible(int SnappingClient) override;
 	virtual void SwapClients(int Client1, int Client2) override;
 
 private:
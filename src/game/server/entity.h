@@ -39,6 +39,9 @@ private:
 	*/
 	float m_ProximityRadius;
 
+	// bucket in the world's spatial index, -1 if the type is not indexed
+	int m_GridBucket;
+
 protected:
 	/* State */
 	bool m_MarkedForDestroy;
@@ -76,6 +79,14 @@ public: // TODO: Maybe make protected
 	const vec2 &GetPos() const { return m_Pos; }
 	float GetProximityRadius() const { return m_ProximityRadius; }
 
+	/*
+		Function: SetPos
+			Moves the entity and keeps the spatial index of the world
+			up to date. Characters and pickups must not write m_Pos
+			directly.
+	*/
+	void SetPos(vec2 Pos);
+
 	/* Other functions */
 
 	/*
@@ -123,6 +134,33 @@ public: // TODO: Maybe make protected
 	*/
 	virtual void Snap(int SnappingClient) {}
 
+	/*
+		Function: HasSharedSnap
+			Returns whether the entity looks the same to every client
+			that receives DDNet entity netobjs, so that its snapshot
+			items can be created once per snap with SnapShared.
+	*/
+	virtual bool HasSharedSnap() const { return false; }
+
+	/*
+		Function: SnapShared
+			Creates the snapshot items of the entity as seen by clients
+			that receive DDNet entity netobjs. Items must be created with
+			CGameContext::SnapNewItem so they end up in the shared pool.
+	*/
+	virtual void SnapShared() {}
+
+	/*
+		Function: SnapVisible
+			Returns whether the items created by SnapShared should be
+			sent to a specific client.
+
+		Arguments:
+			SnappingClient - ID of the client which snapshot is
+				being generated.
+	*/
+	virtual bool SnapVisible(int SnappingClient) { return true; }
+
 	/*
 		Function: PostSnap
 			Called after all clients received their snapshot.
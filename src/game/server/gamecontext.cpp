@@ -485,11 +485,18 @@ void CGameContext::SnapSwitchers(int SnappingClient)
 	}
 }
 
+void *CGameContext::SnapNewItem(int Type, int Id, int Size) const
+{
+	if(m_pSnapItemPool)
+		return m_pSnapItemPool->NewItem(Type, Id, Size);
+	return Server()->SnapNewItem(Type, Id, Size);
+}
+
 bool CGameContext::SnapLaserObject(const CSnapContext &Context, int SnapId, const vec2 &To, const vec2 &From, int StartTick, int Owner, int LaserType, int Subtype, int SwitchNumber) const
 {
 	if(Context.GetClientVersion() >= VERSION_DDNET_MULTI_LASER)
 	{
-		CNetObj_DDNetLaser *pObj = Server()->SnapNewItem<CNetObj_DDNetLaser>(SnapId);
+		CNetObj_DDNetLaser *pObj = SnapNewItem<CNetObj_DDNetLaser>(SnapId);
 		if(!pObj)
 			return false;
 
@@ -506,7 +513,7 @@ bool CGameContext::SnapLaserObject(const CSnapContext &Context, int SnapId, cons
 	}
 	else
 	{
-		CNetObj_Laser *pObj = Server()->SnapNewItem<CNetObj_Laser>(SnapId);
+		CNetObj_Laser *pObj = SnapNewItem<CNetObj_Laser>(SnapId);
 		if(!pObj)
 			return false;
 
@@ -524,7 +531,7 @@ bool CGameContext::SnapPickup(const CSnapContext &Context, int SnapId, const vec
 {
 	if(Context.IsSixup())
 	{
-		protocol7::CNetObj_Pickup *pPickup = Server()->SnapNewItem<protocol7::CNetObj_Pickup>(SnapId);
+		protocol7::CNetObj_Pickup *pPickup = SnapNewItem<protocol7::CNetObj_Pickup>(SnapId);
 		if(!pPickup)
 			return false;
 
@@ -534,7 +541,7 @@ bool CGameContext::SnapPickup(const CSnapContext &Context, int SnapId, const vec
 	}
 	else if(Context.GetClientVersion() >= VERSION_DDNET_ENTITY_NETOBJS)
 	{
-		CNetObj_DDNetPickup *pPickup = Server()->SnapNewItem<CNetObj_DDNetPickup>(SnapId);
+		CNetObj_DDNetPickup *pPickup = SnapNewItem<CNetObj_DDNetPickup>(SnapId);
 		if(!pPickup)
 			return false;
 
@@ -546,7 +553,7 @@ bool CGameContext::SnapPickup(const CSnapContext &Context, int SnapId, const vec
 	}
 	else
 	{
-		CNetObj_Pickup *pPickup = Server()->SnapNewItem<CNetObj_Pickup>(SnapId);
+		CNetObj_Pickup *pPickup = SnapNewItem<CNetObj_Pickup>(SnapId);
 		if(!pPickup)
 			return false;
 
@@ -3987,7 +3994,8 @@ void CGameContext::OnInit(const void *pPersistentData)
 		FormatUuid(m_GameUuid, aGameUuid, sizeof(aGameUuid));
 
 		char aFilename[IO_MAX_PATH_LENGTH];
-		str_format(aFilename, sizeof(aFilename), "teehistorian/%s.teehistorian", aGameUuid);
+		const int Compression = g_Config.m_SvTeeHistorianCompression;
+		str_format(aFilename, sizeof(aFilename), "teehistorian/%s.teehistorian%s", aGameUuid, Compression ? ".gz" : "");
 
 		IOHANDLE THFile = Storage()->OpenFile(aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
 		if(!THFile)
@@ -4000,7 +4008,7 @@ void CGameContext::OnInit(const void *pPersistentData)
 		{
 			dbg_msg("teehistorian", "recording to '%s'", aFilename);
 		}
-		m_pTeeHistorianFile = aio_new(THFile);
+		m_pTeeHistorianFile = Compression ? aio_new_compressed(THFile, Compression) : aio_new(THFile);
 
 		char aVersion[128];
 		if(GIT_SHORTREV_HASH)
@@ -245,6 +245,16 @@ public:
 	void CreateSoundGlobal(int Sound, int Target = -1) const;
 
 	void SnapSwitchers(int SnappingClient);
+
+	// set while the world serializes its shared snap items, see CSnapItemPool
+	CSnapItemPool *m_pSnapItemPool = nullptr;
+	void *SnapNewItem(int Type, int Id, int Size) const;
+	template<typename T>
+	T *SnapNewItem(int Id) const
+	{
+		const int Type = protocol7::is_sixup<T>::value ? -T::ms_MsgId : T::ms_MsgId;
+		return static_cast<T *>(SnapNewItem(Type, Id, sizeof(T)));
+	}
 	bool SnapLaserObject(const CSnapContext &Context, int SnapId, const vec2 &To, const vec2 &From, int StartTick, int Owner = -1, int LaserType = -1, int Subtype = -1, int SwitchNumber = -1) const;
 	bool SnapPickup(const CSnapContext &Context, int SnapId, const vec2 &Pos, int Type, int SubType, int SwitchNumber) const;
 
@@ -47,23 +47,54 @@ CEntity *CGameWorld::FindFirst(int Type)
 	return Type < 0 || Type >= NUM_ENTTYPES ? nullptr : m_apFirstEntityTypes[Type];
 }
 
+CEntityGrid<CEntity> *CGameWorld::Grid(int Type)
+{
+	if(Type == ENTTYPE_CHARACTER)
+		return &m_CharacterGrid;
+	if(Type == ENTTYPE_PICKUP)
+		return &m_PickupGrid;
+	return nullptr;
+}
+
+// calls Fn in list order on the entities of the type that may be inside
+// the box, until it returns false
+template<typename F>
+void CGameWorld::ForEachEntityNear(int Type, vec2 Min, vec2 Max, F &&Fn)
+{
+	// nested queries would overwrite the shared result, walk the list then
+	CEntityGrid<CEntity> *pGrid = Grid(Type);
+	if(pGrid && m_GridQueryDepth == 0 && pGrid->Query(Min, Max, m_vpGridResult))
+	{
+		m_GridQueryDepth++;
+		for(CEntity *pEnt : m_vpGridResult)
+			if(!Fn(pEnt))
+				break;
+		m_GridQueryDepth--;
+		return;
+	}
+
+	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		if(!Fn(pEnt))
+			break;
+}
+
 int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type)
 {
 	if(Type < 0 || Type >= NUM_ENTTYPES)
 		return 0;
 
 	int Num = 0;
-	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
-	{
+	ForEachEntityNear(Type, Pos - vec2(Radius, Radius), Pos + vec2(Radius, Radius), [&](CEntity *pEnt) {
 		if(distance(pEnt->m_Pos, Pos) < Radius + pEnt->m_ProximityRadius)
 		{
 			if(ppEnts)
 				ppEnts[Num] = pEnt;
 			Num++;
 			if(Num == Max)
-				break;
+				return false;
 		}
-	}
+		return true;
+	});
 
 	return Num;
 }
@@ -75,12 +106,17 @@ void CGameWorld::InsertEntity(CEntity *pEnt)
 		dbg_assert(pCur != pEnt, "err");
 #endif
 
+	m_SnapItemPool.Clear();
+
 	// insert it
 	if(m_apFirstEntityTypes[pEnt->m_ObjType])
 		m_apFirstEntityTypes[pEnt->m_ObjType]->m_pPrevTypeEntity = pEnt;
 	pEnt->m_pNextTypeEntity = m_apFirstEntityTypes[pEnt->m_ObjType];
 	pEnt->m_pPrevTypeEntity = nullptr;
 	m_apFirstEntityTypes[pEnt->m_ObjType] = pEnt;
+
+	if(CEntityGrid<CEntity> *pGrid = Grid(pEnt->m_ObjType))
+		pEnt->m_GridBucket = pGrid->Insert(pEnt, pEnt->m_Pos, pEnt->m_ProximityRadius, false);
 }
 
 void CGameWorld::RemoveEntity(CEntity *pEnt)
@@ -89,6 +125,9 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 	if(!pEnt->m_pNextTypeEntity && !pEnt->m_pPrevTypeEntity && m_apFirstEntityTypes[pEnt->m_ObjType] != pEnt)
 		return;
 
+	// the pool must not outlive the entities it points to
+	m_SnapItemPool.Clear();
+
 	// remove
 	if(pEnt->m_pPrevTypeEntity)
 		pEnt->m_pPrevTypeEntity->m_pNextTypeEntity = pEnt->m_pNextTypeEntity;
@@ -103,9 +142,42 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 
 	pEnt->m_pNextTypeEntity = nullptr;
 	pEnt->m_pPrevTypeEntity = nullptr;
+
+	if(pEnt->m_GridBucket != -1)
+	{
+		Grid(pEnt->m_ObjType)->Remove(pEnt, pEnt->m_GridBucket);
+		pEnt->m_GridBucket = -1;
+	}
+}
+
+void CGameWorld::UpdateEntityPos(CEntity *pEnt)
+{
+	if(pEnt->m_GridBucket != -1)
+		pEnt->m_GridBucket = Grid(pEnt->m_ObjType)->Move(pEnt, pEnt->m_GridBucket, pEnt->m_Pos);
 }
 
 //
+void CGameWorld::BuildSnapItemPool()
+{
+	m_SnapItemPool.Clear();
+	GameServer()->m_pSnapItemPool = &m_SnapItemPool;
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+	{
+		if(i == ENTTYPE_CHARACTER)
+			continue;
+
+		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		{
+			if(!pEnt->HasSharedSnap())
+				continue;
+			m_SnapItemPool.BeginEntity(pEnt);
+			pEnt->SnapShared();
+		}
+	}
+	GameServer()->m_pSnapItemPool = nullptr;
+	m_SnapItemPool.SetValid();
+}
+
 void CGameWorld::Snap(int SnappingClient)
 {
 	for(CEntity *pEnt = m_apFirstEntityTypes[ENTTYPE_CHARACTER]; pEnt;)
@@ -115,6 +187,14 @@ void CGameWorld::Snap(int SnappingClient)
 		pEnt = m_pNextTraverseEntity;
 	}
 
+	// entities that look the same to all up-to-date clients are serialized
+	// once per snap and only filtered by visibility per client
+	const bool SharedSnap = Config()->m_SvSharedSnap && SnappingClient != SERVER_DEMO_CLIENT &&
+				!Server()->IsSixup(SnappingClient) &&
+				GameServer()->GetClientVersion(SnappingClient) >= VERSION_DDNET_ENTITY_NETOBJS;
+	if(SharedSnap && !m_SnapItemPool.IsValid())
+		BuildSnapItemPool();
+
 	for(int i = 0; i < NUM_ENTTYPES; i++)
 	{
 		if(i == ENTTYPE_CHARACTER)
@@ -123,14 +203,19 @@ void CGameWorld::Snap(int SnappingClient)
 		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt;)
 		{
 			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
-			pEnt->Snap(SnappingClient);
+			if(!SharedSnap || !pEnt->HasSharedSnap())
+				pEnt->Snap(SnappingClient);
 			pEnt = m_pNextTraverseEntity;
 		}
 	}
+
+	if(SharedSnap)
+		m_SnapItemPool.SnapTo(Server(), SnappingClient);
 }
 
 void CGameWorld::PostSnap()
 {
+	m_SnapItemPool.Clear();
 	for(auto *pEnt : m_apFirstEntityTypes)
 	{
 		for(; pEnt;)
@@ -258,6 +343,12 @@ void CGameWorld::Tick()
 
 	RemoveEntities();
 
+#ifdef CONF_DEBUG
+	for(int Type : {ENTTYPE_CHARACTER, ENTTYPE_PICKUP})
+		for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+			dbg_assert(Grid(Type)->Contains(pEnt, pEnt->m_GridBucket, pEnt->m_Pos), "entity moved without SetPos");
+#endif
+
 	// find the characters' strong/weak id
 	int StrongWeakId = 0;
 	for(CCharacter *pChar = (CCharacter *)FindFirst(ENTTYPE_CHARACTER); pChar; pChar = (CCharacter *)pChar->TypeNext())
@@ -301,20 +392,23 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 
 CEntity *CGameWorld::IntersectEntity(vec2 Pos0, vec2 Pos1, float Radius, int Type, vec2 &NewPos, const CEntity *pNotThis, int CollideWith, const CEntity *pThisOnly)
 {
+	if(Type < 0 || Type >= NUM_ENTTYPES)
+		return nullptr;
+
 	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
 	CEntity *pClosest = nullptr;
 
-	CEntity *pEntity = FindFirst(Type);
-	for(; pEntity; pEntity = pEntity->TypeNext())
-	{
+	const vec2 Min = vec2(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y)) - vec2(Radius, Radius);
+	const vec2 Max = vec2(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y)) + vec2(Radius, Radius);
+	ForEachEntityNear(Type, Min, Max, [&](CEntity *pEntity) {
 		if(pEntity == pNotThis)
-			continue;
+			return true;
 
 		if(pThisOnly && pEntity != pThisOnly)
-			continue;
+			return true;
 
 		if(CollideWith != -1 && !pEntity->CanCollide(CollideWith))
-			continue;
+			return true;
 
 		vec2 IntersectPos;
 		if(closest_point_on_line(Pos0, Pos1, pEntity->m_Pos, IntersectPos))
@@ -331,7 +425,8 @@ CEntity *CGameWorld::IntersectEntity(vec2 Pos0, vec2 Pos1, float Radius, int Typ
 				}
 			}
 		}
-	}
+		return true;
+	});
 
 	return pClosest;
 }
@@ -342,11 +437,10 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, const CEntity *
 	float ClosestRange = Radius * 2;
 	CCharacter *pClosest = nullptr;
 
-	CCharacter *p = (CCharacter *)FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
-	{
+	ForEachEntityNear(ENTTYPE_CHARACTER, Pos - vec2(Radius, Radius), Pos + vec2(Radius, Radius), [&](CEntity *pEnt) {
+		CCharacter *p = (CCharacter *)pEnt;
 		if(p == pNotThis)
-			continue;
+			return true;
 
 		float Len = distance(Pos, p->m_Pos);
 		if(Len < p->m_ProximityRadius + Radius)
@@ -357,7 +451,8 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, const CEntity *
 				pClosest = p;
 			}
 		}
-	}
+		return true;
+	});
 
 	return pClosest;
 }
@@ -365,11 +460,12 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, const CEntity *
 std::vector<CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, const CEntity *pNotThis)
 {
 	std::vector<CCharacter *> vpCharacters;
-	CCharacter *pChr = (CCharacter *)FindFirst(CGameWorld::ENTTYPE_CHARACTER);
-	for(; pChr; pChr = (CCharacter *)pChr->TypeNext())
-	{
+	const vec2 Min = vec2(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y)) - vec2(Radius, Radius);
+	const vec2 Max = vec2(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y)) + vec2(Radius, Radius);
+	ForEachEntityNear(ENTTYPE_CHARACTER, Min, Max, [&](CEntity *pEnt) {
+		CCharacter *pChr = (CCharacter *)pEnt;
 		if(pChr == pNotThis)
-			continue;
+			return true;
 
 		vec2 IntersectPos;
 		if(closest_point_on_line(Pos0, Pos1, pChr->m_Pos, IntersectPos))
@@ -380,7 +476,8 @@ std::vector<CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1
 				vpCharacters.push_back(pChr);
 			}
 		}
-	}
+		return true;
+	});
 	return vpCharacters;
 }
 
@@ -3,9 +3,11 @@
 #ifndef GAME_SERVER_GAMEWORLD_H
 #define GAME_SERVER_GAMEWORLD_H
 
+#include <game/entity_grid.h>
 #include <game/gamecore.h>
 
 #include "save.h"
+#include "snap_item_pool.h"
 
 #include <vector>
 
@@ -37,6 +39,18 @@ private:
 	CEntity *m_pNextTraverseEntity = nullptr;
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
 
+	// spatial index of the entity types that are queried by position
+	CEntityGrid<CEntity> m_CharacterGrid;
+	CEntityGrid<CEntity> m_PickupGrid;
+	std::vector<CEntity *> m_vpGridResult;
+	int m_GridQueryDepth = 0;
+	CEntityGrid<CEntity> *Grid(int Type);
+	template<typename F>
+	void ForEachEntityNear(int Type, vec2 Min, vec2 Max, F &&Fn);
+
+	CSnapItemPool m_SnapItemPool;
+	void BuildSnapItemPool();
+
 	class CGameContext *m_pGameServer;
 	class CConfig *m_pConfig;
 	class IServer *m_pServer;
@@ -141,6 +155,13 @@ public:
 	*/
 	void RemoveEntity(CEntity *pEntity);
 
+	/*
+		Function: UpdateEntityPos
+			Moves an entity in the spatial index after its position
+			changed, see CEntity::SetPos.
+	*/
+	void UpdateEntityPos(CEntity *pEntity);
+
 	void RemoveEntitiesFromPlayer(int PlayerId);
 	void RemoveEntitiesFromPlayers(int PlayerIds[], int NumPlayers);
 
@@ -53,6 +53,103 @@ void CScorePlayerResult::SetVariant(Variant v)
 	}
 }
 
+bool CScoreResultCache::Get(const char *pMap, const char *pKey, CScorePlayerResult *pResult, int64_t *pGeneration)
+{
+	const CLockScope LockScope(m_Lock);
+	*pGeneration = m_Generation;
+	auto It = m_Entries.find(std::string(pMap) + '\n' + pKey);
+	if(It == m_Entries.end())
+		return false;
+	if(time_get_nanoseconds().count() - It->second.m_Time > g_Config.m_SvSqlCacheTime * (int64_t)1000000000)
+	{
+		m_Entries.erase(It);
+		return false;
+	}
+	for(size_t i = 0; i < It->second.m_vMessages.size(); i++)
+		str_copy(pResult->m_Data.m_aaMessages[i], It->second.m_vMessages[i].c_str(), sizeof(pResult->m_Data.m_aaMessages[i]));
+	return true;
+}
+
+void CScoreResultCache::Set(const char *pMap, const char *pKey, const CScorePlayerResult *pResult, int64_t Generation)
+{
+	const CLockScope LockScope(m_Lock);
+	if(Generation != m_Generation)
+		return;
+
+	const int64_t Now = time_get_nanoseconds().count();
+	if(m_Entries.size() >= MAX_ENTRIES)
+	{
+		for(auto It = m_Entries.begin(); It != m_Entries.end();)
+		{
+			if(Now - It->second.m_Time > g_Config.m_SvSqlCacheTime * (int64_t)1000000000)
+				It = m_Entries.erase(It);
+			else
+				++It;
+		}
+		if(m_Entries.size() >= MAX_ENTRIES)
+			m_Entries.clear();
+	}
+
+	CEntry &Entry = m_Entries[std::string(pMap) + '\n' + pKey];
+	Entry.m_Map = pMap;
+	Entry.m_Time = Now;
+	Entry.m_vMessages.clear();
+	int NumMessages = CScorePlayerResult::MAX_MESSAGES;
+	while(NumMessages > 0 && pResult->m_Data.m_aaMessages[NumMessages - 1][0] == '\0')
+		NumMessages--;
+	for(int i = 0; i < NumMessages; i++)
+		Entry.m_vMessages.emplace_back(pResult->m_Data.m_aaMessages[i]);
+}
+
+void CScoreResultCache::Invalidate(const char *pMap)
+{
+	const CLockScope LockScope(m_Lock);
+	m_Generation++;
+	for(auto It = m_Entries.begin(); It != m_Entries.end();)
+	{
+		if(It->second.m_Map.empty() || It->second.m_Map == pMap)
+			It = m_Entries.erase(It);
+		else
+			++It;
+	}
+}
+
+void CSqlScoreData::OnCommitted() const
+{
+	// the rank reached the tables leaderboards are read from
+	if(m_pResultCache)
+		m_pResultCache->Invalidate(m_aMap);
+}
+
+void CSqlTeamScoreData::OnCommitted() const
+{
+	if(m_pResultCache)
+		m_pResultCache->Invalidate(m_aMap);
+}
+
+// Answers the request from the result cache of the request if possible and
+// stores the result of the query in it otherwise.
+static bool CachedQuery(
+	bool (*pfnQuery)(IDbConnection *, const ISqlData *, char *pError, int ErrorSize),
+	const char *pMap,
+	const char *pKey,
+	IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const auto *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
+	auto *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
+	CScoreResultCache *pCache = pData->m_pResultCache.get();
+	if(pCache == nullptr || g_Config.m_SvSqlCacheTime == 0)
+		return pfnQuery(pSqlServer, pGameData, pError, ErrorSize);
+
+	int64_t Generation;
+	if(pCache->Get(pMap, pKey, pResult, &Generation))
+		return true;
+	if(!pfnQuery(pSqlServer, pGameData, pError, ErrorSize))
+		return false;
+	pCache->Set(pMap, pKey, pResult, Generation);
+	return true;
+}
+
 CTeamrank::CTeamrank() :
 	m_NumNames(0)
 {
@@ -363,7 +460,7 @@ bool CScoreWorker::MapVote(IDbConnection *pSqlServer, const ISqlData *pGameData,
 	return true;
 }
 
-bool CScoreWorker::MapInfo(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+static bool MapInfoQuery(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
 	auto *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
@@ -489,6 +586,17 @@ bool CScoreWorker::MapInfo(IDbConnection *pSqlServer, const ISqlData *pGameData,
 	return true;
 }
 
+bool CScoreWorker::MapInfo(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const auto *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
+
+	// the requested map isn't known before the query, so drop the entry
+	// whenever any rank is saved
+	char aKey[256];
+	str_format(aKey, sizeof(aKey), "map info %s\n%s", pData->m_aName, pData->m_aRequestingPlayer);
+	return CachedQuery(MapInfoQuery, "", aKey, pSqlServer, pGameData, pError, ErrorSize);
+}
+
 bool CScoreWorker::SaveScore(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlScoreData *>(pGameData);
@@ -1012,7 +1120,7 @@ bool CScoreWorker::ShowTeamRank(IDbConnection *pSqlServer, const ISqlData *pGame
 	return true;
 }
 
-bool CScoreWorker::ShowTop(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+static bool ShowTopQuery(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
 	auto *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
@@ -1105,7 +1213,16 @@ bool CScoreWorker::ShowTop(IDbConnection *pSqlServer, const ISqlData *pGameData,
 	return End;
 }
 
-bool CScoreWorker::ShowTeamTop5(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+bool CScoreWorker::ShowTop(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const auto *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
+
+	char aKey[64];
+	str_format(aKey, sizeof(aKey), "top %d %s %d", pData->m_Offset, pData->m_aServer, g_Config.m_SvRegionalRankings);
+	return CachedQuery(ShowTopQuery, pData->m_aMap, aKey, pSqlServer, pGameData, pError, ErrorSize);
+}
+
+static bool ShowTeamTop5Query(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
 	auto *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
@@ -1198,6 +1315,15 @@ bool CScoreWorker::ShowTeamTop5(IDbConnection *pSqlServer, const ISqlData *pGame
 	return true;
 }
 
+bool CScoreWorker::ShowTeamTop5(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const auto *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
+
+	char aKey[64];
+	str_format(aKey, sizeof(aKey), "team top %d %s %d", pData->m_Offset, pData->m_aServer, g_Config.m_SvRegionalRankings);
+	return CachedQuery(ShowTeamTop5Query, pData->m_aMap, aKey, pSqlServer, pGameData, pError, ErrorSize);
+}
+
 bool CScoreWorker::ShowPlayerTeamTop5(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
@@ -1450,7 +1576,7 @@ bool CScoreWorker::ShowPoints(IDbConnection *pSqlServer, const ISqlData *pGameDa
 	return true;
 }
 
-bool CScoreWorker::ShowTopPoints(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+static bool ShowTopPointsQuery(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
 	auto *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
@@ -1499,6 +1625,16 @@ bool CScoreWorker::ShowTopPoints(IDbConnection *pSqlServer, const ISqlData *pGam
 	return true;
 }
 
+bool CScoreWorker::ShowTopPoints(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const auto *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
+
+	// points of all maps, a first finish on any map changes them
+	char aKey[64];
+	str_format(aKey, sizeof(aKey), "top points %d", pData->m_Offset);
+	return CachedQuery(ShowTopPointsQuery, "", aKey, pSqlServer, pGameData, pError, ErrorSize);
+}
+
 bool CScoreWorker::RandomMap(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlRandomMapRequest *>(pGameData);
@@ -4,9 +4,11 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include <base/lock.h>
 #include <engine/map.h>
 #include <engine/server/databases/connection_pool.h>
 #include <engine/shared/protocol.h>
@@ -63,6 +65,44 @@ struct CScorePlayerResult : ISqlResult
 	void SetVariant(Variant v);
 };
 
+/*
+	Class: CScoreResultCache
+		Results of leaderboard queries that many players request the same
+		way, kept for sv_sql_cache_time seconds. Entries belong to a map and
+		are dropped when a rank on that map is saved, entries without a map
+		are dropped when any rank is saved.
+
+		Used from all database worker threads at once.
+*/
+class CScoreResultCache
+{
+public:
+	enum
+	{
+		MAX_ENTRIES = 256,
+	};
+
+	// Returns true and fills in pResult if a fresh entry exists. Otherwise
+	// pGeneration receives the value to pass to Set after the query.
+	bool Get(const char *pMap, const char *pKey, CScorePlayerResult *pResult, int64_t *pGeneration) REQUIRES(!m_Lock);
+	// Doesn't store the result if a rank was saved since the Get call, as
+	// the query might not have seen it.
+	void Set(const char *pMap, const char *pKey, const CScorePlayerResult *pResult, int64_t Generation) REQUIRES(!m_Lock);
+	void Invalidate(const char *pMap) REQUIRES(!m_Lock);
+
+private:
+	struct CEntry
+	{
+		std::string m_Map;
+		int64_t m_Time;
+		std::vector<std::string> m_vMessages;
+	};
+
+	CLock m_Lock;
+	std::unordered_map<std::string, CEntry> m_Entries GUARDED_BY(m_Lock);
+	int64_t m_Generation GUARDED_BY(m_Lock) = 0;
+};
+
 struct CScoreLoadBestTimeResult : ISqlResult
 {
 	CScoreLoadBestTimeResult() :
@@ -98,6 +138,8 @@ struct CSqlPlayerRequest : ISqlData
 	// relevant for /top5 kind of requests
 	int m_Offset;
 	char m_aServer[5];
+	// leaderboard requests are answered from here if set
+	std::shared_ptr<CScoreResultCache> m_pResultCache;
 };
 
 struct CScoreRandomMapResult : ISqlResult
@@ -135,6 +177,8 @@ struct CSqlScoreData : ISqlData
 
 	virtual ~CSqlScoreData(){};
 
+	void OnCommitted() const override;
+
 	char m_aMap[MAX_MAP_LENGTH];
 	char m_aGameUuid[UUID_MAXSTRSIZE];
 	char m_aName[MAX_MAP_LENGTH];
@@ -146,6 +190,8 @@ struct CSqlScoreData : ISqlData
 	int m_Num;
 	bool m_Search;
 	char m_aRequestingPlayer[MAX_NAME_LENGTH];
+	// invalidated when the score is saved
+	std::shared_ptr<CScoreResultCache> m_pResultCache;
 };
 
 struct CScoreSaveResult : ISqlResult
@@ -179,6 +225,8 @@ struct CSqlTeamScoreData : ISqlData
 	{
 	}
 
+	void OnCommitted() const override;
+
 	char m_aGameUuid[UUID_MAXSTRSIZE];
 	char m_aMap[MAX_MAP_LENGTH];
 	float m_Time;
@@ -186,6 +234,8 @@ struct CSqlTeamScoreData : ISqlData
 	unsigned int m_Size;
 	char m_aaNames[MAX_CLIENTS][MAX_NAME_LENGTH];
 	CUuid m_TeamrankUuid;
+	// invalidated when the score is saved
+	std::shared_ptr<CScoreResultCache> m_pResultCache;
 };
 
 struct CSqlTeamSaveData : ISqlData
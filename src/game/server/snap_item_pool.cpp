@@ -0,0 +1,61 @@
+#include "snap_item_pool.h"
+#include "entity.h"
+
+#include <base/system.h>
+
+#include <engine/server.h>
+
+void CSnapItemPool::Clear()
+{
+	// keep the capacity so that steady state snaps don't allocate
+	m_vEntries.clear();
+	m_vItems.clear();
+	m_vData.clear();
+	m_Valid = false;
+}
+
+void CSnapItemPool::BeginEntity(CEntity *pEntity)
+{
+	CEntry Entry;
+	Entry.m_pEntity = pEntity;
+	Entry.m_FirstItem = m_vItems.size();
+	Entry.m_NumItems = 0;
+	m_vEntries.push_back(Entry);
+}
+
+void *CSnapItemPool::NewItem(int Type, int Id, int Size)
+{
+	dbg_assert(!m_vEntries.empty(), "snap item pool item without entity");
+	dbg_assert(Size % sizeof(int) == 0, "snap item size must be a multiple of int");
+	if(Id < 0)
+		return nullptr;
+
+	CItem Item;
+	Item.m_Type = Type;
+	Item.m_Id = Id;
+	Item.m_Size = Size;
+	Item.m_Offset = m_vData.size();
+	m_vItems.push_back(Item);
+	m_vEntries.back().m_NumItems++;
+
+	m_vData.resize(m_vData.size() + Size / sizeof(int), 0);
+	return &m_vData[Item.m_Offset];
+}
+
+void CSnapItemPool::SnapTo(IServer *pServer, int SnappingClient) const
+{
+	for(const CEntry &Entry : m_vEntries)
+	{
+		if(!Entry.m_NumItems || !Entry.m_pEntity->SnapVisible(SnappingClient))
+			continue;
+
+		for(int i = Entry.m_FirstItem; i < Entry.m_FirstItem + Entry.m_NumItems; i++)
+		{
+			const CItem &Item = m_vItems[i];
+			void *pData = pServer->SnapNewItem(Item.m_Type, Item.m_Id, Item.m_Size);
+			if(!pData)
+				continue;
+			mem_copy(pData, &m_vData[Item.m_Offset], Item.m_Size);
+		}
+	}
+}
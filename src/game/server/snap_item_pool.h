@@ -0,0 +1,57 @@
+#ifndef GAME_SERVER_SNAP_ITEM_POOL_H
+#define GAME_SERVER_SNAP_ITEM_POOL_H
+
+#include <cstddef>
+#include <vector>
+
+class CEntity;
+class IServer;
+
+/*
+	Class: Snap Item Pool
+		Holds the snapshot items of entities that look the same to every
+		client receiving DDNet entity netobjs. The items are serialized
+		once per snap and copied into the snapshot of each client that
+		can see the entity, instead of calling Snap() for every client.
+*/
+class CSnapItemPool
+{
+	class CItem
+	{
+	public:
+		int m_Type;
+		int m_Id;
+		int m_Size;
+		size_t m_Offset;
+	};
+
+	class CEntry
+	{
+	public:
+		CEntity *m_pEntity;
+		int m_FirstItem;
+		int m_NumItems;
+	};
+
+	std::vector<CEntry> m_vEntries;
+	std::vector<CItem> m_vItems;
+	std::vector<int> m_vData;
+	bool m_Valid = false;
+
+public:
+	bool IsValid() const { return m_Valid; }
+	void SetValid() { m_Valid = true; }
+	void Clear();
+
+	void BeginEntity(CEntity *pEntity);
+	void *NewItem(int Type, int Id, int Size);
+
+	/*
+		Function: SnapTo
+			Copies the pooled items of every entity that is visible to
+			the snapping client into its snapshot.
+	*/
+	void SnapTo(IServer *pServer, int SnappingClient) const;
+};
+
+#endif
@@ -0,0 +1,1053 @@
+#include "teehistorian_reader.h"
+
+#include <base/logger.h>
+#include <base/math.h>
+
+#include <engine/shared/compression.h>
+
+#include <atomic>
+
+static const CUuid TEEHISTORIAN_UUID = CalculateUuid("teehistorian@ddnet.tw");
+static const CUuid TEEHISTORIAN_INDEX_UUID = CalculateUuid("teehistorian-index@ddnet.org");
+static const int TEEHISTORIAN_INDEX_VERSION = 1;
+
+#define UUID(id, name) static const CUuid UUID_##id = CalculateUuid(name);
+#include <engine/shared/teehistorian_ex_chunks.h>
+#undef UUID
+
+enum
+{
+	// largest payload accepted from a single chunk, anything above is
+	// treated as a corrupted file
+	MAX_CHUNK_DATA_SIZE = 64 * 1024 * 1024,
+};
+
+void CTeeHistorianStream::AddAccessPoint()
+{
+	CTeeHistorianAccessPoint Point;
+	Point.m_In = m_InStart + (m_Stream.next_in - m_aIn);
+	Point.m_Bits = m_Stream.data_type & 7;
+	Point.m_Out = m_Out;
+	if(m_WindowFull)
+	{
+		Point.m_vWindow.assign(m_aWindow + m_WindowPos, m_aWindow + TEEHISTORIAN_WINDOW_SIZE);
+	}
+	Point.m_vWindow.insert(Point.m_vWindow.end(), m_aWindow, m_aWindow + m_WindowPos);
+	m_pvPoints->push_back(std::move(Point));
+}
+
+void CTeeHistorianStream::AddWindow(const unsigned char *pData, unsigned Size)
+{
+	if(Size >= TEEHISTORIAN_WINDOW_SIZE)
+	{
+		mem_copy(m_aWindow, pData + Size - TEEHISTORIAN_WINDOW_SIZE, TEEHISTORIAN_WINDOW_SIZE);
+		m_WindowPos = 0;
+		m_WindowFull = true;
+		return;
+	}
+	const unsigned First = minimum<unsigned>(Size, TEEHISTORIAN_WINDOW_SIZE - m_WindowPos);
+	mem_copy(m_aWindow + m_WindowPos, pData, First);
+	mem_copy(m_aWindow, pData + First, Size - First);
+	if(m_WindowPos + Size >= TEEHISTORIAN_WINDOW_SIZE)
+	{
+		m_WindowFull = true;
+	}
+	m_WindowPos = (m_WindowPos + Size) % TEEHISTORIAN_WINDOW_SIZE;
+}
+
+CTeeHistorianStream::~CTeeHistorianStream()
+{
+	if(m_StreamInit)
+	{
+		inflateEnd(&m_Stream);
+	}
+	if(m_File)
+	{
+		io_close(m_File);
+	}
+}
+
+bool CTeeHistorianStream::Open(const char *pFilename)
+{
+	m_File = io_open(pFilename, IOFLAG_READ);
+	if(!m_File)
+	{
+		log_error("teehistorian", "failed to open '%s'", pFilename);
+		return false;
+	}
+	// the gzip magic can't be confused with the teehistorian uuid
+	unsigned char aMagic[2];
+	m_Compressed = io_read(m_File, aMagic, sizeof(aMagic)) == sizeof(aMagic) && aMagic[0] == 0x1f && aMagic[1] == 0x8b;
+	io_seek(m_File, 0, IOSEEK_START);
+	if(m_Compressed)
+	{
+		mem_zero(&m_Stream, sizeof(m_Stream));
+		// 15 window bits plus 16 to read a gzip header
+		if(inflateInit2(&m_Stream, 15 + 16) != Z_OK)
+		{
+			return false;
+		}
+		m_StreamInit = true;
+	}
+	return true;
+}
+
+void CTeeHistorianStream::CollectAccessPoints(std::vector<CTeeHistorianAccessPoint> *pvPoints, uint64_t Distance)
+{
+	m_pvPoints = pvPoints;
+	m_PointDistance = Distance;
+}
+
+bool CTeeHistorianStream::Seek(const CTeeHistorianAccessPoint *pPoint, uint64_t Offset)
+{
+	m_End = false;
+	if(!m_Compressed)
+	{
+		m_Out = Offset;
+		return io_seek(m_File, Offset, IOSEEK_START) == 0;
+	}
+
+	dbg_assert(pPoint && pPoint->m_Out <= Offset, "invalid access point");
+	inflateEnd(&m_Stream);
+	mem_zero(&m_Stream, sizeof(m_Stream));
+	m_StreamInit = false;
+	// raw deflate data, the gzip header is before the first point
+	if(inflateInit2(&m_Stream, -15) != Z_OK)
+	{
+		return false;
+	}
+	m_StreamInit = true;
+	m_InStart = pPoint->m_In - (pPoint->m_Bits ? 1 : 0);
+	if(io_seek(m_File, m_InStart, IOSEEK_START) != 0)
+	{
+		return false;
+	}
+	if(pPoint->m_Bits)
+	{
+		unsigned char LastByte;
+		if(io_read(m_File, &LastByte, 1) != 1)
+		{
+			return false;
+		}
+		m_InStart++;
+		inflatePrime(&m_Stream, pPoint->m_Bits, LastByte >> (8 - pPoint->m_Bits));
+	}
+	if(!pPoint->m_vWindow.empty())
+	{
+		inflateSetDictionary(&m_Stream, pPoint->m_vWindow.data(), pPoint->m_vWindow.size());
+	}
+	m_Out = pPoint->m_Out;
+
+	unsigned char aSkip[16 * 1024];
+	while(m_Out < Offset)
+	{
+		const int Skip = minimum<uint64_t>(sizeof(aSkip), Offset - m_Out);
+		if(Read(aSkip, Skip) != Skip)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int CTeeHistorianStream::Read(void *pBuffer, int Size)
+{
+	if(!m_Compressed)
+	{
+		const int Read = io_read(m_File, pBuffer, Size);
+		m_Out += Read;
+		return Read;
+	}
+
+	int Total = 0;
+	while(Total < Size && !m_End)
+	{
+		if(m_Stream.avail_in == 0)
+		{
+			m_InStart += m_Stream.next_in ? m_Stream.next_in - m_aIn : 0;
+			m_Stream.next_in = m_aIn;
+			m_Stream.avail_in = io_read(m_File, m_aIn, sizeof(m_aIn));
+			if(m_Stream.avail_in == 0)
+			{
+				// truncated stream, the server might still be writing it
+				m_End = true;
+				break;
+			}
+		}
+		unsigned char *pOut = (unsigned char *)pBuffer + Total;
+		m_Stream.next_out = pOut;
+		m_Stream.avail_out = Size - Total;
+		const int Result = inflate(&m_Stream, m_pvPoints ? Z_BLOCK : Z_NO_FLUSH);
+		const unsigned Produced = m_Stream.next_out - pOut;
+		Total += Produced;
+		m_Out += Produced;
+		if(m_pvPoints)
+		{
+			AddWindow(pOut, Produced);
+		}
+		if(Result == Z_STREAM_END)
+		{
+			m_End = true;
+		}
+		else if(Result != Z_OK && Result != Z_BUF_ERROR)
+		{
+			log_error("teehistorian", "failed to decompress: %s", m_Stream.msg ? m_Stream.msg : "unknown error");
+			return -1;
+		}
+		// at the end of a block or the gzip header, but not after the last block
+		if(m_pvPoints && (m_Stream.data_type & 128) && !(m_Stream.data_type & 64) &&
+			(m_pvPoints->empty() || m_Out - m_pvPoints->back().m_Out >= m_PointDistance))
+		{
+			AddAccessPoint();
+		}
+	}
+	return Total;
+}
+
+class CTeeHistorianRecordReader::CCursor
+{
+public:
+	const unsigned char *m_pCur;
+	const unsigned char *m_pEnd;
+	bool m_Incomplete = false;
+
+	int GetInt()
+	{
+		int Value = 0;
+		const unsigned char *pNext = m_Incomplete ? nullptr : CVariableInt::Unpack(m_pCur, &Value, m_pEnd - m_pCur);
+		if(!pNext)
+		{
+			m_Incomplete = true;
+			return 0;
+		}
+		m_pCur = pNext;
+		return Value;
+	}
+	const unsigned char *GetRaw(int Size)
+	{
+		if(m_Incomplete || m_pEnd - m_pCur < Size)
+		{
+			m_Incomplete = true;
+			return nullptr;
+		}
+		const unsigned char *pData = m_pCur;
+		m_pCur += Size;
+		return pData;
+	}
+	const char *GetString()
+	{
+		const unsigned char *pNull = m_Incomplete ? nullptr : (const unsigned char *)memchr(m_pCur, 0, m_pEnd - m_pCur);
+		if(!pNull)
+		{
+			m_Incomplete = true;
+			return "";
+		}
+		const char *pString = (const char *)m_pCur;
+		m_pCur = pNull + 1;
+		return pString;
+	}
+};
+
+CTeeHistorianRecordReader::CTeeHistorianRecordReader(CTeeHistorianStream *pStream, uint64_t Offset) :
+	m_pStream(pStream), m_vBuffer(64 * 1024), m_Offset(Offset)
+{
+}
+
+// Returns the size of the record, 0 if it isn't complete yet or -1 if it
+// is invalid.
+int CTeeHistorianRecordReader::Parse(CTeeHistorianRecord *pRecord)
+{
+	CCursor Cursor;
+	Cursor.m_pCur = m_vBuffer.data() + m_Start;
+	Cursor.m_pEnd = m_vBuffer.data() + m_End;
+	mem_zero(pRecord, sizeof(*pRecord));
+
+	const int First = Cursor.GetInt();
+	pRecord->m_Type = First >= 0 ? (int)TEEHISTORIAN_PLAYER_DIFF : -First;
+	pRecord->m_ClientId = First >= 0 ? First : -1;
+	switch(pRecord->m_Type)
+	{
+	case TEEHISTORIAN_PLAYER_DIFF:
+		pRecord->m_aValues[0] = Cursor.GetInt();
+		pRecord->m_aValues[1] = Cursor.GetInt();
+		break;
+	case TEEHISTORIAN_FINISH:
+		break;
+	case TEEHISTORIAN_TICK_SKIP:
+		pRecord->m_aValues[0] = Cursor.GetInt();
+		break;
+	case TEEHISTORIAN_PLAYER_NEW:
+		pRecord->m_ClientId = Cursor.GetInt();
+		pRecord->m_aValues[0] = Cursor.GetInt();
+		pRecord->m_aValues[1] = Cursor.GetInt();
+		break;
+	case TEEHISTORIAN_PLAYER_OLD:
+	case TEEHISTORIAN_JOIN:
+		pRecord->m_ClientId = Cursor.GetInt();
+		break;
+	case TEEHISTORIAN_INPUT_DIFF:
+	case TEEHISTORIAN_INPUT_NEW:
+		pRecord->m_ClientId = Cursor.GetInt();
+		for(int &Value : pRecord->m_aValues)
+		{
+			Value = Cursor.GetInt();
+		}
+		break;
+	case TEEHISTORIAN_MESSAGE:
+		pRecord->m_ClientId = Cursor.GetInt();
+		pRecord->m_DataSize = Cursor.GetInt();
+		if(pRecord->m_DataSize < 0 || pRecord->m_DataSize > MAX_CHUNK_DATA_SIZE)
+		{
+			return -1;
+		}
+		pRecord->m_pData = Cursor.GetRaw(pRecord->m_DataSize);
+		break;
+	case TEEHISTORIAN_DROP:
+		pRecord->m_ClientId = Cursor.GetInt();
+		pRecord->m_pString = Cursor.GetString();
+		break;
+	case TEEHISTORIAN_CONSOLE_COMMAND:
+	{
+		pRecord->m_ClientId = Cursor.GetInt();
+		pRecord->m_aValues[0] = Cursor.GetInt();
+		pRecord->m_pString = Cursor.GetString();
+		const int NumArgs = Cursor.GetInt();
+		for(int i = 0; i < NumArgs && !Cursor.m_Incomplete; i++)
+		{
+			Cursor.GetString();
+		}
+		break;
+	}
+	case TEEHISTORIAN_EX:
+	{
+		const unsigned char *pUuid = Cursor.GetRaw(sizeof(CUuid));
+		if(pUuid)
+		{
+			mem_copy(&pRecord->m_Uuid, pUuid, sizeof(CUuid));
+		}
+		pRecord->m_DataSize = Cursor.GetInt();
+		if(pRecord->m_DataSize < 0 || pRecord->m_DataSize > MAX_CHUNK_DATA_SIZE)
+		{
+			return -1;
+		}
+		pRecord->m_pData = Cursor.GetRaw(pRecord->m_DataSize);
+		break;
+	}
+	default:
+		return Cursor.m_Incomplete ? 0 : -1;
+	}
+	if(Cursor.m_Incomplete)
+	{
+		return 0;
+	}
+	if(pRecord->m_Type != TEEHISTORIAN_EX && pRecord->m_Type != TEEHISTORIAN_FINISH && pRecord->m_Type != TEEHISTORIAN_TICK_SKIP &&
+		(pRecord->m_ClientId < 0 || pRecord->m_ClientId >= MAX_CLIENTS))
+	{
+		return -1;
+	}
+	return Cursor.m_pCur - (m_vBuffer.data() + m_Start);
+}
+
+// Makes room for more data and reads it, returns false at the end of the
+// stream or on errors.
+bool CTeeHistorianRecordReader::Fill()
+{
+	if(m_Eof)
+	{
+		return false;
+	}
+	if(m_Start > 0)
+	{
+		mem_move(m_vBuffer.data(), m_vBuffer.data() + m_Start, m_End - m_Start);
+		m_End -= m_Start;
+		m_Start = 0;
+	}
+	if(m_End == m_vBuffer.size())
+	{
+		m_vBuffer.resize(m_vBuffer.size() * 2);
+	}
+	const int Read = m_pStream->Read(m_vBuffer.data() + m_End, m_vBuffer.size() - m_End);
+	if(Read <= 0)
+	{
+		m_Eof = true;
+		return false;
+	}
+	m_End += Read;
+	return true;
+}
+
+bool CTeeHistorianRecordReader::ReadHeader(std::string *pJson)
+{
+	while(true)
+	{
+		const unsigned char *pNull = m_End - m_Start > sizeof(CUuid) ? (const unsigned char *)memchr(m_vBuffer.data() + m_Start + sizeof(CUuid), 0, m_End - m_Start - sizeof(CUuid)) : nullptr;
+		if(pNull)
+		{
+			if(mem_comp(m_vBuffer.data() + m_Start, &TEEHISTORIAN_UUID, sizeof(CUuid)) != 0)
+			{
+				return false;
+			}
+			const char *pJsonStart = (const char *)m_vBuffer.data() + m_Start + sizeof(CUuid);
+			pJson->assign(pJsonStart, (const char *)pNull);
+			const size_t Size = pNull + 1 - (m_vBuffer.data() + m_Start);
+			m_Start += Size;
+			m_Offset += Size;
+			return true;
+		}
+		if(!Fill())
+		{
+			return false;
+		}
+	}
+}
+
+int CTeeHistorianRecordReader::Next(CTeeHistorianRecord *pRecord)
+{
+	while(true)
+	{
+		const int Size = Parse(pRecord);
+		if(Size < 0)
+		{
+			return -1;
+		}
+		if(Size > 0)
+		{
+			m_Start += Size;
+			m_Offset += Size;
+			return 1;
+		}
+		if(!Fill())
+		{
+			return 0;
+		}
+	}
+}
+
+void CTeeHistorianDecoderState::Reset()
+{
+	mem_zero(this, sizeof(*this));
+	// tick 0 is implicit at the start, the first player records can start
+	// tick 1 without a tick skip
+	m_PrevPlayerId = MAX_CLIENTS;
+}
+
+void CTeeHistorianDecoderState::Apply(const CTeeHistorianRecord &Record)
+{
+	const bool PlayerRecord = Record.m_Type == TEEHISTORIAN_PLAYER_DIFF || Record.m_Type == TEEHISTORIAN_PLAYER_NEW || Record.m_Type == TEEHISTORIAN_PLAYER_OLD;
+	if(PlayerRecord)
+	{
+		if(Record.m_ClientId <= m_PrevPlayerId)
+		{
+			m_Tick++;
+		}
+		m_PrevPlayerId = Record.m_ClientId;
+	}
+
+	CTeeHistorianPlayerState *pPlayer = Record.m_ClientId >= 0 ? &m_aPlayers[Record.m_ClientId] : nullptr;
+	switch(Record.m_Type)
+	{
+	case TEEHISTORIAN_PLAYER_DIFF:
+		pPlayer->m_X += Record.m_aValues[0];
+		pPlayer->m_Y += Record.m_aValues[1];
+		break;
+	case TEEHISTORIAN_PLAYER_NEW:
+		pPlayer->m_Alive = true;
+		pPlayer->m_X = Record.m_aValues[0];
+		pPlayer->m_Y = Record.m_aValues[1];
+		break;
+	case TEEHISTORIAN_PLAYER_OLD:
+		pPlayer->m_Alive = false;
+		break;
+	case TEEHISTORIAN_TICK_SKIP:
+		m_Tick += Record.m_aValues[0] + 1;
+		m_PrevPlayerId = -1;
+		break;
+	case TEEHISTORIAN_DROP:
+		// inputs of the next connection on this client id start anew
+		pPlayer->m_HaveInput = false;
+		break;
+	case TEEHISTORIAN_INPUT_NEW:
+		mem_copy(&pPlayer->m_Input, Record.m_aValues, sizeof(pPlayer->m_Input));
+		pPlayer->m_HaveInput = true;
+		break;
+	case TEEHISTORIAN_INPUT_DIFF:
+	{
+		// the diff is calculated with wrapping integers
+		unsigned aInput[TEEHISTORIAN_NUM_INPUT_INTS];
+		mem_copy(aInput, &pPlayer->m_Input, sizeof(aInput));
+		for(int i = 0; i < TEEHISTORIAN_NUM_INPUT_INTS; i++)
+		{
+			aInput[i] += (unsigned)Record.m_aValues[i];
+		}
+		mem_copy(&pPlayer->m_Input, aInput, sizeof(aInput));
+		break;
+	}
+	}
+}
+
+class CTeeHistorianIndexWriter
+{
+public:
+	std::vector<unsigned char> m_vData;
+
+	void AddInt(int Value)
+	{
+		unsigned char aBuf[CVariableInt::MAX_BYTES_PACKED];
+		const unsigned char *pEnd = CVariableInt::Pack(aBuf, Value, sizeof(aBuf));
+		m_vData.insert(m_vData.end(), (const unsigned char *)aBuf, pEnd);
+	}
+	void AddUint64(uint64_t Value)
+	{
+		AddInt((int)(Value & 0xffffffff));
+		AddInt((int)(Value >> 32));
+	}
+	void AddRaw(const void *pData, int Size)
+	{
+		AddInt(Size);
+		m_vData.insert(m_vData.end(), (const unsigned char *)pData, (const unsigned char *)pData + Size);
+	}
+};
+
+class CTeeHistorianIndexReader
+{
+public:
+	const unsigned char *m_pCur;
+	const unsigned char *m_pEnd;
+	bool m_Error = false;
+
+	int GetInt()
+	{
+		int Value = 0;
+		const unsigned char *pNext = m_Error ? nullptr : CVariableInt::Unpack(m_pCur, &Value, m_pEnd - m_pCur);
+		if(!pNext)
+		{
+			m_Error = true;
+			return 0;
+		}
+		m_pCur = pNext;
+		return Value;
+	}
+	uint64_t GetUint64()
+	{
+		const uint64_t Low = (unsigned)GetInt();
+		return Low | (uint64_t)(unsigned)GetInt() << 32;
+	}
+	const unsigned char *GetRaw(int *pSize)
+	{
+		*pSize = GetInt();
+		if(m_Error || *pSize < 0 || m_pEnd - m_pCur < *pSize)
+		{
+			m_Error = true;
+			*pSize = 0;
+			return nullptr;
+		}
+		const unsigned char *pData = m_pCur;
+		m_pCur += *pSize;
+		return pData;
+	}
+	// Fails for counts that couldn't possibly fit into the rest of the index.
+	int GetCount()
+	{
+		const int Count = GetInt();
+		if(Count < 0 || Count > m_pEnd - m_pCur)
+		{
+			m_Error = true;
+			return 0;
+		}
+		return Count;
+	}
+};
+
+static void WriteState(CTeeHistorianIndexWriter *pWriter, const CTeeHistorianDecoderState &State)
+{
+	pWriter->AddInt(State.m_Tick);
+	pWriter->AddInt(State.m_PrevPlayerId);
+	for(const CTeeHistorianPlayerState &Player : State.m_aPlayers)
+	{
+		pWriter->AddInt(Player.m_Alive | Player.m_HaveInput << 1);
+		pWriter->AddInt(Player.m_X);
+		pWriter->AddInt(Player.m_Y);
+		const int *pInput = (const int *)&Player.m_Input;
+		for(int i = 0; i < TEEHISTORIAN_NUM_INPUT_INTS; i++)
+		{
+			pWriter->AddInt(pInput[i]);
+		}
+	}
+}
+
+static void ReadState(CTeeHistorianIndexReader *pReader, CTeeHistorianDecoderState *pState)
+{
+	pState->m_Tick = pReader->GetInt();
+	pState->m_PrevPlayerId = pReader->GetInt();
+	for(CTeeHistorianPlayerState &Player : pState->m_aPlayers)
+	{
+		const int Flags = pReader->GetInt();
+		Player.m_Alive = Flags & 1;
+		Player.m_HaveInput = Flags & 2;
+		Player.m_X = pReader->GetInt();
+		Player.m_Y = pReader->GetInt();
+		int *pInput = (int *)&Player.m_Input;
+		for(int i = 0; i < TEEHISTORIAN_NUM_INPUT_INTS; i++)
+		{
+			pInput[i] = pReader->GetInt();
+		}
+	}
+}
+
+uint64_t CTeeHistorianIndex::SegmentEndOffset(int Segment) const
+{
+	return Segment + 1 < (int)m_vSegments.size() ? m_vSegments[Segment + 1].m_Offset : m_EndOffset;
+}
+
+bool CTeeHistorianIndex::Build(const char *pFilename, int SegmentSize)
+{
+	CTeeHistorianStream Stream;
+	if(!Stream.Open(pFilename))
+	{
+		return false;
+	}
+	m_FileSize = Stream.FileSize();
+	m_Compressed = Stream.Compressed();
+	Stream.CollectAccessPoints(&m_vAccessPoints, SegmentSize);
+
+	CTeeHistorianRecordReader Reader(&Stream, 0);
+	if(!Reader.ReadHeader(&m_Header))
+	{
+		log_error("teehistorian", "'%s' is not a teehistorian file", pFilename);
+		return false;
+	}
+
+	CTeeHistorianDecoderState State;
+	State.Reset();
+	uint64_t NextSegmentOffset = 0;
+	int NextAccessPoint = 0;
+	CTeeHistorianRecord Record;
+	int Result;
+	while(true)
+	{
+		// Segments of compressed files start at the first record after an
+		// access point, so that decoding them inflates little data that
+		// isn't used.
+		bool NewSegment = false;
+		if(m_Compressed)
+		{
+			while(NextAccessPoint < (int)m_vAccessPoints.size() && m_vAccessPoints[NextAccessPoint].m_Out <= Reader.Offset())
+			{
+				NextAccessPoint++;
+				NewSegment = true;
+			}
+		}
+		else
+		{
+			NewSegment = Reader.Offset() >= NextSegmentOffset;
+		}
+		if(NewSegment)
+		{
+			CTeeHistorianSegment Segment;
+			Segment.m_Offset = Reader.Offset();
+			Segment.m_AccessPoint = m_Compressed ? NextAccessPoint - 1 : -1;
+			Segment.m_State = State;
+			m_vSegments.push_back(Segment);
+			NextSegmentOffset = Reader.Offset() + SegmentSize;
+		}
+
+		Result = Reader.Next(&Record);
+		if(Result <= 0)
+		{
+			break;
+		}
+		State.Apply(Record);
+		if(Record.m_Type == TEEHISTORIAN_FINISH)
+		{
+			m_Finished = true;
+			break;
+		}
+		if(Record.m_Type == TEEHISTORIAN_JOIN)
+		{
+			m_vEvents.push_back({State.m_Tick, TEEHISTORIAN_JOIN, Record.m_ClientId, ""});
+		}
+		else if(Record.m_Type == TEEHISTORIAN_DROP)
+		{
+			m_vEvents.push_back({State.m_Tick, TEEHISTORIAN_DROP, Record.m_ClientId, Record.m_pString});
+		}
+		else if(Record.m_Type == TEEHISTORIAN_EX && Record.m_Uuid == UUID_TEEHISTORIAN_PLAYER_NAME)
+		{
+			const unsigned char *pEnd = Record.m_pData + Record.m_DataSize;
+			int ClientId;
+			const unsigned char *pName = CVariableInt::Unpack(Record.m_pData, &ClientId, Record.m_DataSize);
+			const unsigned char *pNull = pName ? (const unsigned char *)memchr(pName, 0, pEnd - pName) : nullptr;
+			if(pNull && ClientId >= 0 && ClientId < MAX_CLIENTS)
+			{
+				m_vEvents.push_back({State.m_Tick, TEEHISTORIAN_EX, ClientId, std::string((const char *)pName, (const char *)pNull)});
+			}
+		}
+	}
+	// don't keep a segment that has no records
+	if(m_vSegments.size() > 1 && m_vSegments.back().m_Offset == Reader.Offset())
+	{
+		m_vSegments.pop_back();
+	}
+	m_EndOffset = Reader.Offset();
+	m_LastTick = State.m_Tick;
+	if(Result < 0)
+	{
+		log_error("teehistorian", "invalid data at offset %" PRIu64 " in '%s'", Reader.Offset(), pFilename);
+		return false;
+	}
+	if(!m_Finished)
+	{
+		log_info("teehistorian", "'%s' ends without a finish chunk, it is probably still being written", pFilename);
+	}
+	return true;
+}
+
+bool CTeeHistorianIndex::Save(const char *pFilename) const
+{
+	CTeeHistorianIndexWriter Writer;
+	Writer.m_vData.insert(Writer.m_vData.end(), (const unsigned char *)&TEEHISTORIAN_INDEX_UUID, (const unsigned char *)(&TEEHISTORIAN_INDEX_UUID + 1));
+	Writer.AddInt(TEEHISTORIAN_INDEX_VERSION);
+	Writer.AddUint64(m_FileSize);
+	Writer.AddInt(m_Compressed);
+	Writer.AddInt(m_Finished);
+	Writer.AddUint64(m_EndOffset);
+	Writer.AddInt(m_LastTick);
+	Writer.AddRaw(m_Header.data(), m_Header.size());
+
+	Writer.AddInt(m_vAccessPoints.size());
+	for(const CTeeHistorianAccessPoint &Point : m_vAccessPoints)
+	{
+		Writer.AddUint64(Point.m_In);
+		Writer.AddInt(Point.m_Bits);
+		Writer.AddUint64(Point.m_Out);
+		// the windows make up most of the index otherwise
+		std::vector<unsigned char> vCompressed(compressBound(Point.m_vWindow.size()));
+		uLongf CompressedSize = vCompressed.size();
+		if(compress2(vCompressed.data(), &CompressedSize, Point.m_vWindow.data(), Point.m_vWindow.size(), Z_BEST_SPEED) != Z_OK)
+		{
+			return false;
+		}
+		Writer.AddInt(Point.m_vWindow.size());
+		Writer.AddRaw(vCompressed.data(), CompressedSize);
+	}
+
+	Writer.AddInt(m_vSegments.size());
+	for(const CTeeHistorianSegment &Segment : m_vSegments)
+	{
+		Writer.AddUint64(Segment.m_Offset);
+		Writer.AddInt(Segment.m_AccessPoint);
+		WriteState(&Writer, Segment.m_State);
+	}
+
+	Writer.AddInt(m_vEvents.size());
+	for(const CTeeHistorianEvent &Event : m_vEvents)
+	{
+		Writer.AddInt(Event.m_Tick);
+		Writer.AddInt(Event.m_Type);
+		Writer.AddInt(Event.m_ClientId);
+		Writer.AddRaw(Event.m_String.data(), Event.m_String.size());
+	}
+
+	IOHANDLE File = io_open(pFilename, IOFLAG_WRITE);
+	if(!File)
+	{
+		return false;
+	}
+	const bool Success = io_write(File, Writer.m_vData.data(), Writer.m_vData.size()) == Writer.m_vData.size();
+	return io_close(File) == 0 && Success;
+}
+
+bool CTeeHistorianIndex::Load(const char *pFilename, int64_t FileSize)
+{
+	IOHANDLE File = io_open(pFilename, IOFLAG_READ);
+	if(!File)
+	{
+		return false;
+	}
+	void *pData;
+	unsigned DataSize;
+	const bool Read = io_read_all(File, &pData, &DataSize);
+	io_close(File);
+	if(!Read)
+	{
+		return false;
+	}
+
+	CTeeHistorianIndexReader Reader;
+	Reader.m_pCur = (const unsigned char *)pData;
+	Reader.m_pEnd = Reader.m_pCur + DataSize;
+	bool Success = DataSize >= sizeof(CUuid) && mem_comp(pData, &TEEHISTORIAN_INDEX_UUID, sizeof(CUuid)) == 0;
+	Reader.m_pCur += sizeof(CUuid);
+	Success = Success && Reader.GetInt() == TEEHISTORIAN_INDEX_VERSION && (int64_t)Reader.GetUint64() == FileSize;
+	if(Success)
+	{
+		m_FileSize = FileSize;
+		m_Compressed = Reader.GetInt();
+		m_Finished = Reader.GetInt();
+		m_EndOffset = Reader.GetUint64();
+		m_LastTick = Reader.GetInt();
+		int Size;
+		const unsigned char *pHeader = Reader.GetRaw(&Size);
+		if(pHeader)
+		{
+			m_Header.assign((const char *)pHeader, Size);
+		}
+
+		m_vAccessPoints.resize(Reader.GetCount());
+		for(CTeeHistorianAccessPoint &Point : m_vAccessPoints)
+		{
+			Point.m_In = Reader.GetUint64();
+			Point.m_Bits = Reader.GetInt();
+			Point.m_Out = Reader.GetUint64();
+			const int WindowSize = Reader.GetInt();
+			const unsigned char *pWindow = Reader.GetRaw(&Size);
+			if(Reader.m_Error || WindowSize < 0 || WindowSize > TEEHISTORIAN_WINDOW_SIZE || Point.m_Bits < 0 || Point.m_Bits > 7)
+			{
+				Reader.m_Error = true;
+				break;
+			}
+			Point.m_vWindow.resize(WindowSize);
+			uLongf UncompressedSize = WindowSize;
+			if(uncompress(Point.m_vWindow.data(), &UncompressedSize, pWindow, Size) != Z_OK || UncompressedSize != (uLongf)WindowSize)
+			{
+				Reader.m_Error = true;
+				break;
+			}
+		}
+
+		m_vSegments.resize(Reader.GetCount());
+		for(CTeeHistorianSegment &Segment : m_vSegments)
+		{
+			Segment.m_Offset = Reader.GetUint64();
+			Segment.m_AccessPoint = Reader.GetInt();
+			ReadState(&Reader, &Segment.m_State);
+			if(Reader.m_Error || Segment.m_AccessPoint < (m_Compressed ? 0 : -1) || Segment.m_AccessPoint >= (int)m_vAccessPoints.size() ||
+				(m_Compressed && m_vAccessPoints[Segment.m_AccessPoint].m_Out > Segment.m_Offset))
+			{
+				Reader.m_Error = true;
+				break;
+			}
+		}
+
+		m_vEvents.resize(Reader.GetCount());
+		for(CTeeHistorianEvent &Event : m_vEvents)
+		{
+			Event.m_Tick = Reader.GetInt();
+			Event.m_Type = Reader.GetInt();
+			Event.m_ClientId = Reader.GetInt();
+			const unsigned char *pString = Reader.GetRaw(&Size);
+			if(pString)
+			{
+				Event.m_String.assign((const char *)pString, Size);
+			}
+		}
+		Success = !Reader.m_Error && !m_vSegments.empty();
+	}
+	free(pData);
+	return Success;
+}
+
+bool CTeeHistorianIndex::Open(const char *pFilename)
+{
+	char aIndexFilename[IO_MAX_PATH_LENGTH];
+	str_format(aIndexFilename, sizeof(aIndexFilename), "%s.index", pFilename);
+
+	IOHANDLE File = io_open(pFilename, IOFLAG_READ);
+	if(!File)
+	{
+		log_error("teehistorian", "failed to open '%s'", pFilename);
+		return false;
+	}
+	const int64_t FileSize = io_length(File);
+	io_close(File);
+	if(Load(aIndexFilename, FileSize))
+	{
+		return true;
+	}
+
+	*this = CTeeHistorianIndex();
+	log_info("teehistorian", "building index '%s'", aIndexFilename);
+	if(!Build(pFilename))
+	{
+		return false;
+	}
+	if(!Save(aIndexFilename))
+	{
+		// the queries still work, they just need to build it again next time
+		log_error("teehistorian", "failed to write index '%s'", aIndexFilename);
+	}
+	return true;
+}
+
+static void FormatInput(std::string *pOut, int Tick, const CNetObj_PlayerInput &Input)
+{
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\n",
+		Tick, Input.m_Direction, Input.m_TargetX, Input.m_TargetY, Input.m_Jump, Input.m_Fire,
+		Input.m_Hook, Input.m_PlayerFlags, Input.m_WantedWeapon, Input.m_NextWeapon, Input.m_PrevWeapon);
+	*pOut += aBuf;
+}
+
+static void FormatPosition(std::string *pOut, int Tick, const CTeeHistorianPlayerState &Player)
+{
+	char aBuf[64];
+	if(Player.m_Alive)
+	{
+		str_format(aBuf, sizeof(aBuf), "%d\t1\t%d\t%d\n", Tick, Player.m_X, Player.m_Y);
+	}
+	else
+	{
+		str_format(aBuf, sizeof(aBuf), "%d\t0\t\t\n", Tick);
+	}
+	*pOut += aBuf;
+}
+
+// Decodes one segment and appends the query results to pOut. The first
+// segment also outputs the state at the start of the query.
+static bool DecodeSegment(const char *pFilename, const CTeeHistorianIndex &Index, int Segment, bool First, const CTeeHistorianQuery &Query, std::string *pOut)
+{
+	const CTeeHistorianSegment &Start = Index.m_vSegments[Segment];
+	CTeeHistorianStream Stream;
+	if(!Stream.Open(pFilename) || !Stream.Seek(Start.m_AccessPoint >= 0 ? &Index.m_vAccessPoints[Start.m_AccessPoint] : nullptr, Start.m_Offset))
+	{
+		log_error("teehistorian", "failed to seek to segment %d", Segment);
+		return false;
+	}
+
+	CTeeHistorianRecordReader Reader(&Stream, Start.m_Offset);
+	CTeeHistorianDecoderState State = Start.m_State;
+	const CTeeHistorianPlayerState &Player = State.m_aPlayers[Query.m_ClientId];
+	const uint64_t EndOffset = Index.SegmentEndOffset(Segment);
+	CTeeHistorianRecord Record;
+	while(Reader.Offset() < EndOffset)
+	{
+		const int Result = Reader.Next(&Record);
+		if(Result <= 0)
+		{
+			if(Result < 0)
+			{
+				log_error("teehistorian", "invalid data in segment %d", Segment);
+			}
+			return Result == 0;
+		}
+		const CTeeHistorianPlayerState Prev = Player;
+		State.Apply(Record);
+		if(First && State.m_Tick >= Query.m_FirstTick)
+		{
+			// the state that is in effect at the start of the query
+			First = false;
+			if(Query.m_Type == CTeeHistorianQuery::TYPE_INPUTS && Prev.m_HaveInput)
+			{
+				FormatInput(pOut, Query.m_FirstTick, Prev.m_Input);
+			}
+			else if(Query.m_Type == CTeeHistorianQuery::TYPE_POSITIONS && Prev.m_Alive)
+			{
+				FormatPosition(pOut, Query.m_FirstTick, Prev);
+			}
+		}
+		if(State.m_Tick > Query.m_LastTick)
+		{
+			break;
+		}
+		if(State.m_Tick < Query.m_FirstTick || Record.m_ClientId != Query.m_ClientId)
+		{
+			continue;
+		}
+		if(Query.m_Type == CTeeHistorianQuery::TYPE_INPUTS && (Record.m_Type == TEEHISTORIAN_INPUT_NEW || Record.m_Type == TEEHISTORIAN_INPUT_DIFF))
+		{
+			FormatInput(pOut, State.m_Tick, Player.m_Input);
+		}
+		else if(Query.m_Type == CTeeHistorianQuery::TYPE_POSITIONS && (Record.m_Type == TEEHISTORIAN_PLAYER_DIFF || Record.m_Type == TEEHISTORIAN_PLAYER_NEW || Record.m_Type == TEEHISTORIAN_PLAYER_OLD))
+		{
+			FormatPosition(pOut, State.m_Tick, Player);
+		}
+	}
+	return true;
+}
+
+// Segments that are decoded by several threads at once, the outputs are
+// passed on in order once all of them are done.
+struct CTeeHistorianDecodeBatch
+{
+	const char *m_pFilename;
+	const CTeeHistorianIndex *m_pIndex;
+	const CTeeHistorianQuery *m_pQuery;
+	int m_FirstQuerySegment;
+	int m_FirstSegment;
+	std::vector<std::string> m_vOutputs;
+	std::atomic<int> m_NextSegment{0};
+	std::atomic<bool> m_Error{false};
+};
+
+static void DecodeBatch(CTeeHistorianDecodeBatch *pBatch)
+{
+	while(true)
+	{
+		const int i = pBatch->m_NextSegment.fetch_add(1, std::memory_order_relaxed);
+		if(i >= (int)pBatch->m_vOutputs.size())
+		{
+			break;
+		}
+		const int Segment = pBatch->m_FirstSegment + i;
+		if(!DecodeSegment(pBatch->m_pFilename, *pBatch->m_pIndex, Segment, Segment == pBatch->m_FirstQuerySegment, *pBatch->m_pQuery, &pBatch->m_vOutputs[i]))
+		{
+			pBatch->m_Error.store(true);
+		}
+	}
+}
+
+static void DecodeThread(void *pUser)
+{
+	DecodeBatch(static_cast<CTeeHistorianDecodeBatch *>(pUser));
+}
+
+bool CTeeHistorianIndex::Query(const char *pFilename, const CTeeHistorianQuery &Query, int NumThreads, OUTPUT_CALLBACK pfnOutput, void *pUser) const
+{
+	// Records of a segment have ticks between the tick of its state and the
+	// one of the next segment. The state before the first tick of the query
+	// is in the last segment that starts before it.
+	const int NumSegments = m_vSegments.size();
+	int FirstSegment = 0;
+	while(FirstSegment + 1 < NumSegments && SegmentStartTick(FirstSegment + 1) < Query.m_FirstTick)
+	{
+		FirstSegment++;
+	}
+	int LastSegment = FirstSegment;
+	while(LastSegment + 1 < NumSegments && SegmentStartTick(LastSegment + 1) <= Query.m_LastTick)
+	{
+		LastSegment++;
+	}
+
+	NumThreads = maximum(NumThreads, 1);
+	// keep only a few segments worth of output in memory
+	const int BatchSize = NumThreads * 4;
+	for(int Start = FirstSegment; Start <= LastSegment; Start += BatchSize)
+	{
+		CTeeHistorianDecodeBatch Batch;
+		Batch.m_pFilename = pFilename;
+		Batch.m_pIndex = this;
+		Batch.m_pQuery = &Query;
+		Batch.m_FirstQuerySegment = FirstSegment;
+		Batch.m_FirstSegment = Start;
+		Batch.m_vOutputs.resize(minimum(BatchSize, LastSegment + 1 - Start));
+
+		std::vector<void *> vpThreads;
+		for(int i = 1; i < minimum<int>(NumThreads, Batch.m_vOutputs.size()); i++)
+		{
+			vpThreads.push_back(thread_init(DecodeThread, &Batch, "teehistorian decode"));
+		}
+		DecodeBatch(&Batch);
+		for(void *pThread : vpThreads)
+		{
+			thread_wait(pThread);
+		}
+		if(Batch.m_Error.load())
+		{
+			return false;
+		}
+		for(const std::string &Output : Batch.m_vOutputs)
+		{
+			pfnOutput(Output.data(), Output.size(), pUser);
+		}
+	}
+	return true;
+}
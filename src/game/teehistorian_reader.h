@@ -0,0 +1,225 @@
+#ifndef GAME_TEEHISTORIAN_READER_H
+#define GAME_TEEHISTORIAN_READER_H
+
+#include <base/system.h>
+
+#include <engine/shared/protocol.h>
+#include <engine/shared/uuid_manager.h>
+
+#include <game/generated/protocol.h>
+
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+// Chunk types as written by CTeeHistorian, they are stored negated. Player
+// position diffs are stored with the positive client id instead of a type.
+enum
+{
+	TEEHISTORIAN_PLAYER_DIFF,
+	TEEHISTORIAN_FINISH,
+	TEEHISTORIAN_TICK_SKIP,
+	TEEHISTORIAN_PLAYER_NEW,
+	TEEHISTORIAN_PLAYER_OLD,
+	TEEHISTORIAN_INPUT_DIFF,
+	TEEHISTORIAN_INPUT_NEW,
+	TEEHISTORIAN_MESSAGE,
+	TEEHISTORIAN_JOIN,
+	TEEHISTORIAN_DROP,
+	TEEHISTORIAN_CONSOLE_COMMAND,
+	TEEHISTORIAN_EX,
+};
+
+enum
+{
+	TEEHISTORIAN_NUM_INPUT_INTS = sizeof(CNetObj_PlayerInput) / sizeof(int32_t),
+	// decompressed bytes between two index segments
+	TEEHISTORIAN_SEGMENT_SIZE = 1024 * 1024,
+	TEEHISTORIAN_WINDOW_SIZE = 32 * 1024,
+};
+
+// A position in a gzip compressed file that inflating can start from,
+// following zlib's examples/zran.c.
+struct CTeeHistorianAccessPoint
+{
+	uint64_t m_In; // offset of the first compressed byte not fully used
+	int m_Bits; // bits of the byte before m_In that belong to the point
+	uint64_t m_Out; // decompressed offset
+	std::vector<unsigned char> m_vWindow; // last decompressed bytes before m_Out
+};
+
+// Decompressed view of a plain or gzip compressed teehistorian file.
+class CTeeHistorianStream
+{
+	IOHANDLE m_File = nullptr;
+	bool m_Compressed = false;
+	bool m_End = false;
+	bool m_StreamInit = false;
+	z_stream m_Stream;
+	unsigned char m_aIn[64 * 1024];
+	uint64_t m_InStart = 0; // file offset of m_aIn
+	uint64_t m_Out = 0;
+
+	// only used to collect access points while building the index
+	std::vector<CTeeHistorianAccessPoint> *m_pvPoints = nullptr;
+	uint64_t m_PointDistance = 0;
+	unsigned char m_aWindow[TEEHISTORIAN_WINDOW_SIZE];
+	unsigned m_WindowPos = 0;
+	bool m_WindowFull = false;
+
+	void AddAccessPoint();
+	void AddWindow(const unsigned char *pData, unsigned Size);
+
+public:
+	~CTeeHistorianStream();
+
+	bool Open(const char *pFilename);
+	bool Compressed() const { return m_Compressed; }
+	int64_t FileSize() { return io_length(m_File); }
+
+	// Adds an access point at the first block boundary after every
+	// Distance decompressed bytes while reading.
+	void CollectAccessPoints(std::vector<CTeeHistorianAccessPoint> *pvPoints, uint64_t Distance);
+
+	// Continues at the decompressed offset, starting from the given
+	// access point for compressed files.
+	bool Seek(const CTeeHistorianAccessPoint *pPoint, uint64_t Offset);
+
+	// Returns the number of bytes read, less than Size only at the end
+	// of the file, or -1 on errors.
+	int Read(void *pBuffer, int Size);
+};
+
+struct CTeeHistorianRecord
+{
+	int m_Type;
+	int m_ClientId;
+	int m_aValues[TEEHISTORIAN_NUM_INPUT_INTS];
+	CUuid m_Uuid;
+	const unsigned char *m_pData;
+	int m_DataSize;
+	const char *m_pString;
+};
+
+// Splits the decompressed stream into records, the pointers of a record
+// stay valid until the next one is read.
+class CTeeHistorianRecordReader
+{
+	class CCursor;
+
+	CTeeHistorianStream *m_pStream;
+	std::vector<unsigned char> m_vBuffer;
+	size_t m_Start = 0;
+	size_t m_End = 0;
+	uint64_t m_Offset = 0;
+	bool m_Eof = false;
+
+	int Parse(CTeeHistorianRecord *pRecord);
+	bool Fill();
+
+public:
+	CTeeHistorianRecordReader(CTeeHistorianStream *pStream, uint64_t Offset);
+
+	// decompressed offset of the next record
+	uint64_t Offset() const { return m_Offset; }
+
+	// Reads the uuid and json header at the start of the file.
+	bool ReadHeader(std::string *pJson);
+
+	// Returns 1 if a record was read, 0 at the end of the stream, which
+	// may be truncated, or -1 if the data is invalid.
+	int Next(CTeeHistorianRecord *pRecord);
+};
+
+struct CTeeHistorianPlayerState
+{
+	bool m_Alive;
+	bool m_HaveInput;
+	int m_X;
+	int m_Y;
+	CNetObj_PlayerInput m_Input;
+};
+
+// Everything needed to continue decoding at a record boundary.
+struct CTeeHistorianDecoderState
+{
+	int m_Tick;
+	// client id of the last player record, a lower or equal one starts
+	// the next tick implicitly
+	int m_PrevPlayerId;
+	CTeeHistorianPlayerState m_aPlayers[MAX_CLIENTS];
+
+	void Reset();
+
+	// Applies the record, m_Tick is the tick of the record afterwards.
+	void Apply(const CTeeHistorianRecord &Record);
+};
+
+struct CTeeHistorianSegment
+{
+	uint64_t m_Offset;
+	int m_AccessPoint; // -1 for uncompressed files
+	CTeeHistorianDecoderState m_State;
+};
+
+struct CTeeHistorianEvent
+{
+	int m_Tick;
+	int m_Type; // TEEHISTORIAN_JOIN, TEEHISTORIAN_DROP or TEEHISTORIAN_EX for names
+	int m_ClientId;
+	std::string m_String;
+};
+
+struct CTeeHistorianQuery
+{
+	enum
+	{
+		TYPE_INPUTS,
+		TYPE_POSITIONS,
+	};
+
+	int m_Type;
+	int m_ClientId;
+	int m_FirstTick;
+	int m_LastTick;
+};
+
+// Decoder checkpoints, access points and player events of a recording,
+// stored next to it so that later runs don't have to read it all again.
+class CTeeHistorianIndex
+{
+public:
+	typedef void (*OUTPUT_CALLBACK)(const char *pData, int DataSize, void *pUser);
+
+	int64_t m_FileSize = 0;
+	bool m_Compressed = false;
+	bool m_Finished = false;
+	uint64_t m_EndOffset = 0;
+	int m_LastTick = 0;
+	std::string m_Header;
+	std::vector<CTeeHistorianAccessPoint> m_vAccessPoints;
+	std::vector<CTeeHistorianSegment> m_vSegments;
+	std::vector<CTeeHistorianEvent> m_vEvents;
+
+	int SegmentStartTick(int Segment) const { return m_vSegments[Segment].m_State.m_Tick; }
+	uint64_t SegmentEndOffset(int Segment) const;
+
+	// Reads the whole recording once, starting a new segment about every
+	// SegmentSize decompressed bytes.
+	bool Build(const char *pFilename, int SegmentSize = TEEHISTORIAN_SEGMENT_SIZE);
+	bool Save(const char *pFilename) const;
+	// Fails if the index is invalid or doesn't belong to a recording of
+	// the given size.
+	bool Load(const char *pFilename, int64_t FileSize);
+
+	// Loads the index next to the recording, building and saving it if it
+	// is missing or belongs to an older state of the file.
+	bool Open(const char *pFilename);
+
+	// Decodes the segments that the query needs with up to NumThreads
+	// threads and passes the tab separated rows to pfnOutput in order.
+	bool Query(const char *pFilename, const CTeeHistorianQuery &Query, int NumThreads, OUTPUT_CALLBACK pfnOutput, void *pUser) const;
+};
+
+#endif // GAME_TEEHISTORIAN_READER_H
@@ -3,6 +3,10 @@
 
 #include <base/system.h>
 
+#include <zlib.h>
+
+#include <string>
+
 static const int BUF_SIZE = 64 * 1024;
 
 class Async : public ::testing::Test
@@ -20,6 +24,18 @@ protected:
 		Delete = false;
 	}
 
+	void Compressed(int Level)
+	{
+		aio_close(m_pAio);
+		aio_wait(m_pAio);
+		aio_free(m_pAio);
+
+		IOHANDLE File = io_open(m_Info.m_aFilename, IOFLAG_WRITE);
+		ASSERT_TRUE(File);
+		m_pAio = aio_new_compressed(File, Level);
+		ASSERT_TRUE(m_pAio);
+	}
+
 	~Async()
 	{
 		if(Delete)
@@ -144,3 +160,47 @@ TEST_F(Async, Transaction)
 	}
 	Expect(aText);
 }
+
+TEST_F(Async, Compressed)
+{
+	Compressed(6);
+	std::string Text;
+	for(int i = 0; i < 20000; i++)
+	{
+		char aLine[32];
+		str_format(aLine, sizeof(aLine), "line %d\n", i % 1000);
+		Write(aLine);
+		Text += aLine;
+	}
+	aio_close(m_pAio);
+	aio_wait(m_pAio);
+	EXPECT_EQ(aio_error(m_pAio), 0);
+	aio_free(m_pAio);
+
+	void *pCompressed;
+	unsigned CompressedSize;
+	IOHANDLE File = io_open(m_Info.m_aFilename, IOFLAG_READ);
+	ASSERT_TRUE(File);
+	ASSERT_TRUE(io_read_all(File, &pCompressed, &CompressedSize));
+	io_close(File);
+	ASSERT_GE(CompressedSize, 2u);
+	// gzip magic, for readers to tell compressed files apart
+	EXPECT_EQ(((unsigned char *)pCompressed)[0], 0x1f);
+	EXPECT_EQ(((unsigned char *)pCompressed)[1], 0x8b);
+	EXPECT_LT(CompressedSize, Text.size() / 4);
+
+	std::string Decompressed(Text.size() + 1, '\0');
+	z_stream Stream;
+	mem_zero(&Stream, sizeof(Stream));
+	ASSERT_EQ(inflateInit2(&Stream, 15 + 16), Z_OK);
+	Stream.next_in = (Bytef *)pCompressed;
+	Stream.avail_in = CompressedSize;
+	Stream.next_out = (Bytef *)Decompressed.data();
+	Stream.avail_out = Decompressed.size();
+	EXPECT_EQ(inflate(&Stream, Z_FINISH), Z_STREAM_END);
+	Decompressed.resize(Decompressed.size() - Stream.avail_out);
+	inflateEnd(&Stream);
+	free(pCompressed);
+	EXPECT_EQ(Decompressed, Text);
+	Delete = true;
+}
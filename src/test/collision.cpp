@@ -0,0 +1,486 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/log.h>
+#include <base/system.h>
+#include <engine/engine.h>
+#include <engine/kernel.h>
+#include <engine/map.h>
+#include <engine/shared/config.h>
+#include <engine/shared/datafile.h>
+#include <engine/storage.h>
+#include <game/collision.h>
+#include <game/layers.h>
+#include <game/mapitems.h>
+
+#include <random>
+
+// the original implementation, sampling every pixel of the way
+static std::vector<int> GetMapIndicesPerPixel(const CCollision &Collision, vec2 PrevPos, vec2 Pos, unsigned MaxIndices = 0)
+{
+	std::vector<int> vIndices;
+	float d = distance(PrevPos, Pos);
+	int End(d + 1);
+	if(!d)
+	{
+		int Nx = clamp((int)Pos.x / 32, 0, Collision.GetWidth() - 1);
+		int Ny = clamp((int)Pos.y / 32, 0, Collision.GetHeight() - 1);
+		int Index = Ny * Collision.GetWidth() + Nx;
+
+		if(Collision.TileExists(Index))
+			vIndices.push_back(Index);
+		return vIndices;
+	}
+
+	int LastIndex = 0;
+	for(int i = 0; i < End; i++)
+	{
+		float a = i / d;
+		vec2 Tmp = mix(PrevPos, Pos, a);
+		int Nx = clamp((int)Tmp.x / 32, 0, Collision.GetWidth() - 1);
+		int Ny = clamp((int)Tmp.y / 32, 0, Collision.GetHeight() - 1);
+		int Index = Ny * Collision.GetWidth() + Nx;
+		if(Collision.TileExists(Index) && LastIndex != Index)
+		{
+			if(MaxIndices && vIndices.size() > MaxIndices)
+				return vIndices;
+			vIndices.push_back(Index);
+			LastIndex = Index;
+		}
+	}
+	return vIndices;
+}
+
+// the original implementations of the Intersect functions, checking every pixel
+static int IntersectLinePerPixel(const CCollision &Collision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance + 1);
+	vec2 Last = Pos0;
+	for(int i = 0; i <= End; i++)
+	{
+		float a = i / (float)End;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int ix = round_to_int(Pos.x);
+		int iy = round_to_int(Pos.y);
+		if(Collision.CheckPoint(ix, iy))
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return Collision.GetCollisionAt(ix, iy);
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int IntersectLineTeleHookPerPixel(const CCollision &Collision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision, int *pTeleNr)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance + 1);
+	vec2 Last = Pos0;
+	int dx = 0, dy = 0;
+	ThroughOffset(Pos0, Pos1, &dx, &dy);
+	for(int i = 0; i <= End; i++)
+	{
+		float a = i / (float)End;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int ix = round_to_int(Pos.x);
+		int iy = round_to_int(Pos.y);
+
+		int Index = Collision.GetPureMapIndex(Pos);
+		if(g_Config.m_SvOldTeleportHook)
+			*pTeleNr = Collision.IsTeleport(Index);
+		else
+			*pTeleNr = Collision.IsTeleportHook(Index);
+		if(*pTeleNr)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return TILE_TELEINHOOK;
+		}
+
+		int hit = 0;
+		if(Collision.CheckPoint(ix, iy))
+		{
+			if(!Collision.IsThrough(ix, iy, dx, dy, Pos0, Pos1))
+				hit = Collision.GetCollisionAt(ix, iy);
+		}
+		else if(Collision.IsHookBlocker(ix, iy, Pos0, Pos1))
+		{
+			hit = TILE_NOHOOK;
+		}
+		if(hit)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return hit;
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int IntersectLineTeleWeaponPerPixel(const CCollision &Collision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision, int *pTeleNr)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance + 1);
+	vec2 Last = Pos0;
+	for(int i = 0; i <= End; i++)
+	{
+		float a = i / (float)End;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int ix = round_to_int(Pos.x);
+		int iy = round_to_int(Pos.y);
+
+		int Index = Collision.GetPureMapIndex(Pos);
+		if(g_Config.m_SvOldTeleportWeapons)
+			*pTeleNr = Collision.IsTeleport(Index);
+		else
+			*pTeleNr = Collision.IsTeleportWeapon(Index);
+		if(*pTeleNr)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return TILE_TELEINWEAPON;
+		}
+
+		if(Collision.CheckPoint(ix, iy))
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return Collision.GetCollisionAt(ix, iy);
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int IntersectNoLaserPerPixel(const CCollision &Collision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float d = distance(Pos0, Pos1);
+	vec2 Last = Pos0;
+	for(int i = 0, id = std::ceil(d); i < id; i++)
+	{
+		float a = i / d;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int Nx = clamp(round_to_int(Pos.x) / 32, 0, Collision.GetWidth() - 1);
+		int Ny = clamp(round_to_int(Pos.y) / 32, 0, Collision.GetHeight() - 1);
+		if(Collision.GetIndex(Nx, Ny) == TILE_SOLID || Collision.GetIndex(Nx, Ny) == TILE_NOHOOK || Collision.GetIndex(Nx, Ny) == TILE_NOLASER || Collision.GetFrontIndex(Nx, Ny) == TILE_NOLASER)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			if(Collision.GetFrontIndex(Nx, Ny) == TILE_NOLASER)
+				return Collision.GetFrontCollisionAt(Pos.x, Pos.y);
+			else
+				return Collision.GetCollisionAt(Pos.x, Pos.y);
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+class CTestCollision : public ::testing::Test
+{
+public:
+	CTestInfo m_TestInfo;
+	std::unique_ptr<IKernel> m_pKernel;
+	std::unique_ptr<IStorage> m_pStorage;
+	IEngineMap *m_pMap;
+	CLayers m_Layers;
+	CCollision m_Collision;
+
+	CTestCollision()
+	{
+		m_pKernel = std::unique_ptr<IKernel>(IKernel::Create());
+		m_TestInfo.m_DeleteTestStorageFilesOnSuccess = true;
+		m_pStorage = m_TestInfo.CreateTestStorage();
+		m_pKernel->RegisterInterface(m_pStorage.get(), false);
+		m_pKernel->RegisterInterface(CreateTestEngine("test"));
+		m_pMap = CreateEngineMap();
+		m_pKernel->RegisterInterface(m_pMap);
+	}
+
+	~CTestCollision() override
+	{
+		m_Collision.Unload();
+		m_Layers.Unload();
+		m_pMap->Unload();
+	}
+
+	void Load(const char *pMap)
+	{
+		m_Collision.Unload();
+		m_Layers.Unload();
+		char aFilename[IO_MAX_PATH_LENGTH];
+		str_format(aFilename, sizeof(aFilename), "maps/%s.map", pMap);
+		ASSERT_TRUE(m_pMap->Load(aFilename)) << aFilename;
+		m_Layers.Init(m_pMap, false);
+		m_Collision.Init(&m_Layers);
+	}
+};
+
+TEST_F(CTestCollision, GetMapIndices)
+{
+	const char *apMaps[] = {"coverage", "Tutorial", "LearnToPlay"};
+	std::mt19937 Rng(1234);
+	for(const char *pMap : apMaps)
+	{
+		Load(pMap);
+		const float Width = m_Collision.GetWidth() * 32.0f;
+		const float Height = m_Collision.GetHeight() * 32.0f;
+		std::uniform_real_distribution<float> DistX(-100.0f, Width + 100.0f);
+		std::uniform_real_distribution<float> DistY(-100.0f, Height + 100.0f);
+		std::uniform_int_distribution<int> DistTileX(-2, m_Collision.GetWidth() + 2);
+		std::uniform_int_distribution<int> DistTileY(-2, m_Collision.GetHeight() + 2);
+		std::uniform_int_distribution<int> DistKind(0, 5);
+		std::normal_distribution<float> DistShort(0.0f, 30.0f);
+		std::normal_distribution<float> DistLong(0.0f, 600.0f);
+		for(int i = 0; i < 2000; i++)
+		{
+			vec2 PrevPos(DistX(Rng), DistY(Rng));
+			vec2 Pos;
+			switch(DistKind(Rng))
+			{
+			case 0: Pos = PrevPos; break;
+			case 1: Pos = PrevPos + vec2(DistShort(Rng), DistShort(Rng)); break;
+			case 2: Pos = PrevPos + vec2(DistLong(Rng), DistLong(Rng)); break;
+			case 3: Pos = vec2(PrevPos.x, PrevPos.y + DistLong(Rng)); break;
+			case 4: Pos = PrevPos + vec2(DistLong(Rng), DistLong(Rng)) * 2.0f; break;
+			case 5:
+				// ways along and onto tile borders
+				PrevPos = vec2(DistTileX(Rng) * 32.0f, DistTileY(Rng) * 32.0f);
+				Pos = vec2(DistTileX(Rng) * 32.0f, PrevPos.y);
+				break;
+			}
+
+			const std::vector<int> vExpected = GetMapIndicesPerPixel(m_Collision, PrevPos, Pos);
+			ASSERT_EQ(m_Collision.GetMapIndices(PrevPos, Pos), vExpected) << pMap << " " << PrevPos.x << "," << PrevPos.y << " -> " << Pos.x << "," << Pos.y;
+			ASSERT_EQ(m_Collision.GetMapIndices(PrevPos, Pos, 2), GetMapIndicesPerPixel(m_Collision, PrevPos, Pos, 2));
+
+			int aIndices[4];
+			const int NumIndices = m_Collision.GetMapIndices(PrevPos, Pos, aIndices, std::size(aIndices));
+			ASSERT_EQ(NumIndices, (int)vExpected.size());
+			for(int j = 0; j < minimum(NumIndices, (int)std::size(aIndices)); j++)
+				ASSERT_EQ(aIndices[j], vExpected[j]);
+
+			std::vector<int> vVisited;
+			const int NumVisited = m_Collision.GetMapIndices(PrevPos, Pos, [&](int Index) {
+				vVisited.push_back(Index);
+				return vVisited.size() < 2;
+			});
+			ASSERT_EQ(NumVisited, minimum((int)vExpected.size(), 2));
+			for(size_t j = 0; j < vVisited.size(); j++)
+				ASSERT_EQ(vVisited[j], vExpected[j]);
+		}
+	}
+}
+
+// none of the maps in data has a switch layer, which doors need
+static void WriteDoorMap(IStorage *pStorage, const char *pFilename)
+{
+	const int WIDTH = 60;
+	const int HEIGHT = 40;
+	std::mt19937 Rng(42);
+	std::uniform_int_distribution<int> DistTile(0, 9);
+	const int aTiles[] = {TILE_SOLID, TILE_FREEZE, TILE_STOP, TILE_STOPS};
+	std::vector<CTile> vTiles(WIDTH * HEIGHT);
+	for(CTile &Tile : vTiles)
+	{
+		const int Kind = DistTile(Rng);
+		Tile = {};
+		Tile.m_Index = Kind < (int)std::size(aTiles) ? aTiles[Kind] : TILE_AIR;
+	}
+	std::vector<CSwitchTile> vSwitches(WIDTH * HEIGHT);
+	for(size_t i = 0; i < vSwitches.size(); i++)
+	{
+		vSwitches[i] = {};
+		if(i % 7 == 0)
+		{
+			vSwitches[i].m_Type = TILE_SWITCHOPEN;
+			vSwitches[i].m_Number = 1 + i % 3;
+		}
+	}
+
+	CDataFileWriter Writer;
+	ASSERT_TRUE(Writer.Open(pStorage, pFilename));
+	CMapItemVersion Version;
+	Version.m_Version = 1;
+	Writer.AddItem(MAPITEMTYPE_VERSION, 0, sizeof(Version), &Version);
+	CMapItemGroup Group = {};
+	Group.m_Version = 3;
+	Group.m_ParallaxX = 100;
+	Group.m_ParallaxY = 100;
+	Group.m_NumLayers = 2;
+	Writer.AddItem(MAPITEMTYPE_GROUP, 0, sizeof(Group), &Group);
+	CMapItemLayerTilemap Layer = {};
+	Layer.m_Layer.m_Type = LAYERTYPE_TILES;
+	Layer.m_Version = 3;
+	Layer.m_Width = WIDTH;
+	Layer.m_Height = HEIGHT;
+	Layer.m_Image = -1;
+	Layer.m_Tele = Layer.m_Speedup = Layer.m_Front = Layer.m_Switch = Layer.m_Tune = -1;
+	Layer.m_Flags = TILESLAYERFLAG_GAME;
+	Layer.m_Data = Writer.AddData(vTiles.size() * sizeof(CTile), vTiles.data());
+	Writer.AddItem(MAPITEMTYPE_LAYER, 0, sizeof(Layer), &Layer);
+	Layer.m_Flags = TILESLAYERFLAG_SWITCH;
+	std::fill(vTiles.begin(), vTiles.end(), CTile{});
+	Layer.m_Data = Writer.AddData(vTiles.size() * sizeof(CTile), vTiles.data());
+	Layer.m_Switch = Writer.AddData(vSwitches.size() * sizeof(CSwitchTile), vSwitches.data());
+	Writer.AddItem(MAPITEMTYPE_LAYER, 1, sizeof(Layer), &Layer);
+	Writer.Finish();
+}
+
+TEST_F(CTestCollision, TileExistsChangedTiles)
+{
+	m_pStorage->CreateFolder("maps", IStorage::TYPE_SAVE);
+	WriteDoorMap(m_pStorage.get(), "maps/doors.map");
+	ASSERT_FALSE(HasFailure());
+
+	const char *apMaps[] = {"coverage", "doors"};
+	std::mt19937 Rng(5678);
+	for(const char *pMap : apMaps)
+	{
+		Load(pMap);
+		std::uniform_real_distribution<float> DistX(0.0f, m_Collision.GetWidth() * 32.0f);
+		std::uniform_real_distribution<float> DistY(0.0f, m_Collision.GetHeight() * 32.0f);
+		const int aTiles[] = {TILE_AIR, TILE_SOLID, TILE_FREEZE, TILE_STOP, TILE_STOPA, TILE_STOPS};
+		// doors are closed with stoppers and opened again by clearing them
+		const int aDoors[] = {0, TILE_STOP, TILE_STOPA, TILE_STOPS, 0};
+		for(int i = 0; i < 1000; i++)
+		{
+			m_Collision.SetCollisionAt(DistX(Rng), DistY(Rng), aTiles[i % std::size(aTiles)]);
+			m_Collision.SetDoorCollisionAt(DistX(Rng), DistY(Rng), aDoors[i % std::size(aDoors)], i % 4, i % 3);
+		}
+
+		for(int i = 0; i < m_Collision.GetWidth() * m_Collision.GetHeight(); i++)
+			ASSERT_EQ(m_Collision.TileExists(i), m_Collision.TileExistsUncached(i)) << pMap << " " << i;
+	}
+}
+
+// random lines like lasers and hooks, within and around the map
+static void RandomLine(std::mt19937 &Rng, const CCollision &Collision, vec2 *pPos0, vec2 *pPos1)
+{
+	const float Width = Collision.GetWidth() * 32.0f;
+	const float Height = Collision.GetHeight() * 32.0f;
+	std::uniform_real_distribution<float> DistX(-100.0f, Width + 100.0f);
+	std::uniform_real_distribution<float> DistY(-100.0f, Height + 100.0f);
+	std::uniform_int_distribution<int> DistTileX(-2, Collision.GetWidth() + 2);
+	std::uniform_int_distribution<int> DistTileY(-2, Collision.GetHeight() + 2);
+	std::uniform_real_distribution<float> DistAngle(0.0f, 2 * pi);
+	std::uniform_real_distribution<float> DistLength(0.0f, 1500.0f);
+	std::uniform_int_distribution<int> DistKind(0, 4);
+
+	*pPos0 = vec2(DistX(Rng), DistY(Rng));
+	switch(DistKind(Rng))
+	{
+	case 0: *pPos1 = *pPos0; break;
+	case 1: *pPos1 = *pPos0 + direction(DistAngle(Rng)) * DistLength(Rng); break;
+	case 2: *pPos1 = vec2(pPos0->x + DistLength(Rng) - 750.0f, pPos0->y); break;
+	case 3: *pPos1 = *pPos0 + direction(DistAngle(Rng)) * DistLength(Rng) * 3.0f; break;
+	case 4:
+		// lines along and onto tile borders, also at half pixels
+		*pPos0 = vec2(DistTileX(Rng) * 32.0f - 0.5f, DistTileY(Rng) * 32.0f);
+		*pPos1 = vec2(pPos0->x, DistTileY(Rng) * 32.0f + 0.5f);
+		break;
+	}
+}
+
+TEST_F(CTestCollision, Intersect)
+{
+	const char *apMaps[] = {"coverage", "Tutorial", "LearnToPlay", "ctf1"};
+	const int OldTeleportHook = g_Config.m_SvOldTeleportHook;
+	const int OldTeleportWeapons = g_Config.m_SvOldTeleportWeapons;
+	std::mt19937 Rng(4321);
+	for(const char *pMap : apMaps)
+	{
+		Load(pMap);
+		for(int i = 0; i < 5000; i++)
+		{
+			vec2 Pos0, Pos1;
+			RandomLine(Rng, m_Collision, &Pos0, &Pos1);
+			g_Config.m_SvOldTeleportHook = i % 2;
+			g_Config.m_SvOldTeleportWeapons = i % 2;
+
+			vec2 aExpected[2], aOut[2];
+			int ExpectedTeleNr, TeleNr = -1;
+			int Expected = IntersectLinePerPixel(m_Collision, Pos0, Pos1, &aExpected[0], &aExpected[1]);
+			ASSERT_EQ(m_Collision.IntersectLine(Pos0, Pos1, &aOut[0], &aOut[1]), Expected) << pMap << " " << Pos0.x << "," << Pos0.y << " -> " << Pos1.x << "," << Pos1.y;
+			ASSERT_TRUE(aOut[0] == aExpected[0] && aOut[1] == aExpected[1]);
+
+			Expected = IntersectLineTeleHookPerPixel(m_Collision, Pos0, Pos1, &aExpected[0], &aExpected[1], &ExpectedTeleNr);
+			ASSERT_EQ(m_Collision.IntersectLineTeleHook(Pos0, Pos1, &aOut[0], &aOut[1], &TeleNr), Expected);
+			ASSERT_TRUE(aOut[0] == aExpected[0] && aOut[1] == aExpected[1]);
+			ASSERT_EQ(TeleNr, ExpectedTeleNr);
+
+			Expected = IntersectLineTeleWeaponPerPixel(m_Collision, Pos0, Pos1, &aExpected[0], &aExpected[1], &ExpectedTeleNr);
+			ASSERT_EQ(m_Collision.IntersectLineTeleWeapon(Pos0, Pos1, &aOut[0], &aOut[1], &TeleNr), Expected);
+			ASSERT_TRUE(aOut[0] == aExpected[0] && aOut[1] == aExpected[1]);
+			ASSERT_EQ(TeleNr, ExpectedTeleNr);
+
+			Expected = IntersectNoLaserPerPixel(m_Collision, Pos0, Pos1, &aExpected[0], &aExpected[1]);
+			ASSERT_EQ(m_Collision.IntersectNoLaser(Pos0, Pos1, &aOut[0], &aOut[1]), Expected);
+			ASSERT_TRUE(aOut[0] == aExpected[0] && aOut[1] == aExpected[1]);
+		}
+	}
+	g_Config.m_SvOldTeleportHook = OldTeleportHook;
+	g_Config.m_SvOldTeleportWeapons = OldTeleportWeapons;
+}
+
+TEST_F(CTestCollision, IntersectChangedTiles)
+{
+	Load("coverage");
+	std::mt19937 Rng(8765);
+	std::uniform_real_distribution<float> DistX(0.0f, m_Collision.GetWidth() * 32.0f);
+	std::uniform_real_distribution<float> DistY(0.0f, m_Collision.GetHeight() * 32.0f);
+	const int aTiles[] = {TILE_AIR, TILE_SOLID, TILE_NOHOOK, TILE_NOLASER, TILE_THROUGH_ALL};
+	for(int i = 0; i < 2000; i++)
+	{
+		m_Collision.SetCollisionAt(DistX(Rng), DistY(Rng), aTiles[i % std::size(aTiles)]);
+		vec2 Pos0, Pos1;
+		RandomLine(Rng, m_Collision, &Pos0, &Pos1);
+		vec2 aExpected[2], aOut[2];
+		int ExpectedTeleNr, TeleNr;
+		ASSERT_EQ(m_Collision.IntersectLine(Pos0, Pos1, &aOut[0], &aOut[1]), IntersectLinePerPixel(m_Collision, Pos0, Pos1, &aExpected[0], &aExpected[1]));
+		ASSERT_TRUE(aOut[0] == aExpected[0] && aOut[1] == aExpected[1]);
+		ASSERT_EQ(m_Collision.IntersectLineTeleHook(Pos0, Pos1, &aOut[0], &aOut[1], &TeleNr), IntersectLineTeleHookPerPixel(m_Collision, Pos0, Pos1, &aExpected[0], &aExpected[1], &ExpectedTeleNr));
+		ASSERT_TRUE(aOut[0] == aExpected[0] && aOut[1] == aExpected[1]);
+		ASSERT_EQ(m_Collision.IntersectNoLaser(Pos0, Pos1, &aOut[0], &aOut[1]), IntersectNoLaserPerPixel(m_Collision, Pos0, Pos1, &aExpected[0], &aExpected[1]));
+		ASSERT_TRUE(aOut[0] == aExpected[0] && aOut[1] == aExpected[1]);
+	}
+}
+
+TEST_F(CTestCollision, IntersectBenchmark)
+{
+	Load("Tutorial");
+	std::mt19937 Rng(1);
+	std::uniform_real_distribution<float> DistX(0.0f, m_Collision.GetWidth() * 32.0f);
+	std::uniform_real_distribution<float> DistY(0.0f, m_Collision.GetHeight() * 32.0f);
+	std::uniform_real_distribution<float> DistAngle(0.0f, 2 * pi);
+	std::vector<std::pair<vec2, vec2>> vLines;
+	for(int i = 0; i < 2000; i++)
+	{
+		const vec2 Pos0(DistX(Rng), DistY(Rng));
+		vLines.emplace_back(Pos0, Pos0 + direction(DistAngle(Rng)) * 800.0f);
+	}
+
+	vec2 Out, Before;
+	int Hits = 0;
+	const int64_t Start = time_get_nanoseconds().count();
+	for(const auto &Line : vLines)
+		Hits += IntersectNoLaserPerPixel(m_Collision, Line.first, Line.second, &Out, &Before) != 0;
+	const int64_t Middle = time_get_nanoseconds().count();
+	for(const auto &Line : vLines)
+		Hits -= m_Collision.IntersectNoLaser(Line.first, Line.second, &Out, &Before) != 0;
+	const int64_t End = time_get_nanoseconds().count();
+	EXPECT_EQ(Hits, 0);
+	log_info("collision", "800 px lasers take %.0f ns with per pixel stepping and %.0f ns when skipping empty tiles", (Middle - Start) / (double)vLines.size(), (End - Middle) / (double)vLines.size());
+}
@@ -2,8 +2,15 @@
 #include <gtest/gtest.h>
 #include <memory>
 
+#include <base/log.h>
+#include <base/system.h>
+
+#include <engine/engine.h>
+#include <engine/kernel.h>
+#include <engine/map.h>
 #include <engine/shared/datafile.h>
 #include <engine/storage.h>
+#include <game/mapitems.h>
 #include <game/mapitems_ex.h>
 
 TEST(Datafile, ExtendedType)
@@ -109,3 +116,266 @@ TEST(Datafile, StringData)
 		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
 	}
 }
+
+TEST(Datafile, Mapped)
+{
+	std::unique_ptr<IStorage> pStorage = CreateLocalStorage();
+	ASSERT_NE(pStorage, nullptr) << "Error creating local storage";
+
+	CTestInfo Info;
+
+	const int aItem[] = {1, 2, 3, 4};
+	char aData[4096];
+	for(size_t i = 0; i < sizeof(aData); i++)
+		aData[i] = i % 7;
+
+	{
+		CDataFileWriter Writer;
+		Writer.Open(pStorage.get(), Info.m_aFilename);
+		Writer.AddItem(MAPITEMTYPE_TEST, 0, sizeof(aItem), aItem);
+		EXPECT_EQ(Writer.AddData(sizeof(aData), aData), 0);
+		EXPECT_EQ(Writer.AddDataString("Abc"), 1);
+		Writer.Finish();
+	}
+
+	CDataFileReader Reader;
+	ASSERT_TRUE(Reader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL));
+	CDataFileReader MappedReader;
+	ASSERT_TRUE(MappedReader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL, true));
+
+	EXPECT_EQ(MappedReader.Crc(), Reader.Crc());
+	EXPECT_EQ(MappedReader.Sha256(), Reader.Sha256());
+	EXPECT_EQ(MappedReader.MapSize(), Reader.MapSize());
+	EXPECT_EQ(MappedReader.NumItems(), Reader.NumItems());
+	EXPECT_EQ(MappedReader.NumData(), 2);
+
+	const int Index = MappedReader.FindItemIndex(MAPITEMTYPE_TEST, 0);
+	ASSERT_GE(Index, 0);
+	ASSERT_EQ(MappedReader.GetItemSize(Index), (int)sizeof(aItem));
+	EXPECT_EQ(mem_comp(MappedReader.GetItem(Index), aItem, sizeof(aItem)), 0);
+
+	for(int Load = 0; Load < 2; Load++)
+	{
+		ASSERT_EQ(MappedReader.GetDataSize(0), (int)sizeof(aData));
+		const void *pData = MappedReader.GetData(0);
+		ASSERT_TRUE(pData);
+		EXPECT_EQ(mem_comp(pData, aData, sizeof(aData)), 0);
+		EXPECT_STREQ(MappedReader.GetDataString(1), "Abc");
+		MappedReader.UnloadData(0);
+		MappedReader.UnloadData(1);
+	}
+
+	char *pReplaced = static_cast<char *>(malloc(3));
+	mem_copy(pReplaced, "xyz", 3);
+	MappedReader.ReplaceData(0, pReplaced, 3);
+	EXPECT_EQ(MappedReader.GetData(0), pReplaced);
+	EXPECT_EQ(MappedReader.GetDataSize(0), 3);
+
+	MappedReader.Close();
+	Reader.Close();
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+	}
+}
+
+TEST(Datafile, StartDecompression)
+{
+	std::unique_ptr<IStorage> pStorage = CreateLocalStorage();
+	ASSERT_NE(pStorage, nullptr) << "Error creating local storage";
+	std::unique_ptr<IEngine> pEngine(CreateTestEngine("test"));
+
+	CTestInfo Info;
+
+	const int NUM_DATA = 32;
+	const int DATA_SIZE = 64 * 1024;
+	std::vector<int> vData(DATA_SIZE / sizeof(int));
+	{
+		CDataFileWriter Writer;
+		Writer.Open(pStorage.get(), Info.m_aFilename);
+		for(int i = 0; i < NUM_DATA; i++)
+		{
+			for(size_t j = 0; j < vData.size(); j++)
+				vData[j] = i * j;
+			EXPECT_EQ(Writer.AddData(DATA_SIZE, vData.data()), i);
+		}
+		Writer.Finish();
+	}
+
+	for(int Pass = 0; Pass < 2; Pass++)
+	{
+		CDataFileReader Reader;
+		ASSERT_TRUE(Reader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL, true));
+		for(int i = 0; i < NUM_DATA; i++)
+			Reader.StartDecompression(pEngine.get(), i);
+		// ignored for invalid indices and data which is decompressed already
+		Reader.StartDecompression(pEngine.get(), -1);
+		Reader.StartDecompression(pEngine.get(), NUM_DATA);
+		Reader.StartDecompression(pEngine.get(), 0);
+
+		// the second pass closes the file while jobs are still pending
+		const int NumChecked = Pass == 0 ? NUM_DATA : NUM_DATA / 4;
+		for(int i = 0; i < NumChecked; i++)
+		{
+			if(i % 5 == 1)
+			{
+				// data which is unloaded before its job finished
+				Reader.UnloadData(i);
+			}
+			ASSERT_EQ(Reader.GetDataSize(i), DATA_SIZE);
+			const int *pData = static_cast<const int *>(i % 2 == 0 ? Reader.GetData(i) : Reader.GetDataSwapped(i));
+			ASSERT_TRUE(pData);
+			for(size_t j = 0; j < vData.size(); j++)
+				ASSERT_EQ(pData[j], (int)(i * j)) << "i=" << i << " j=" << j;
+		}
+		Reader.Close();
+	}
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+	}
+}
+
+TEST(Datafile, MapLoadBenchmark)
+{
+	std::unique_ptr<IKernel> pKernel(IKernel::Create());
+	std::unique_ptr<IStorage> pStorage = CreateLocalStorage();
+	ASSERT_NE(pStorage, nullptr) << "Error creating local storage";
+	pKernel->RegisterInterface(pStorage.get(), false);
+	IEngine *pEngine = CreateTestEngine("test");
+	pKernel->RegisterInterface(pEngine);
+	IEngineMap *pMap = CreateEngineMap();
+	pKernel->RegisterInterface(pMap);
+
+	CTestInfo Info;
+
+	// a large map with tile layers of a few different tiles each
+	const int NUM_LAYERS = 16;
+	const int WIDTH = 1000;
+	const int HEIGHT = 500;
+	{
+		CDataFileWriter Writer;
+		ASSERT_TRUE(Writer.Open(pStorage.get(), Info.m_aFilename));
+		CMapItemVersion Version;
+		Version.m_Version = 1;
+		Writer.AddItem(MAPITEMTYPE_VERSION, 0, sizeof(Version), &Version);
+		CMapItemGroup Group = {};
+		Group.m_Version = 3;
+		Group.m_ParallaxX = 100;
+		Group.m_ParallaxY = 100;
+		Group.m_StartLayer = 0;
+		Group.m_NumLayers = NUM_LAYERS;
+		Writer.AddItem(MAPITEMTYPE_GROUP, 0, sizeof(Group), &Group);
+		std::vector<CTile> vTiles(WIDTH * HEIGHT);
+		for(int l = 0; l < NUM_LAYERS; l++)
+		{
+			for(size_t i = 0; i < vTiles.size(); i++)
+			{
+				vTiles[i] = {};
+				vTiles[i].m_Index = ((i * 2654435761u) >> (20 + l % 8)) % 4 == 0 ? 1 + (i + l) % 7 : 0;
+			}
+			CMapItemLayerTilemap Layer = {};
+			Layer.m_Layer.m_Type = LAYERTYPE_TILES;
+			Layer.m_Version = CMapItemLayerTilemap::VERSION_TEEWORLDS_TILESKIP;
+			Layer.m_Width = WIDTH;
+			Layer.m_Height = HEIGHT;
+			Layer.m_Image = -1;
+			Layer.m_Data = Writer.AddData(vTiles.size() * sizeof(CTile), vTiles.data());
+			Layer.m_Tele = Layer.m_Speedup = Layer.m_Front = Layer.m_Switch = Layer.m_Tune = -1;
+			Writer.AddItem(MAPITEMTYPE_LAYER, l, sizeof(Layer), &Layer);
+		}
+		Writer.Finish();
+	}
+
+	// without a running job pool, the jobs are aborted and the data is
+	// decompressed when CMap::Load gets it
+	const int NUM_RUNS = 3;
+	int64_t aTimes[2];
+	ASSERT_TRUE(pMap->Load(Info.m_aFilename));
+	for(int JobPool = 1; JobPool >= 0; JobPool--)
+	{
+		if(!JobPool)
+			pEngine->ShutdownJobs();
+		const int64_t Start = time_get_nanoseconds().count();
+		for(int Run = 0; Run < NUM_RUNS; Run++)
+			ASSERT_TRUE(pMap->Load(Info.m_aFilename));
+		aTimes[JobPool] = time_get_nanoseconds().count() - Start;
+
+		int LayersStart, LayersNum;
+		pMap->GetType(MAPITEMTYPE_LAYER, &LayersStart, &LayersNum);
+		ASSERT_EQ(LayersNum, NUM_LAYERS);
+		const CMapItemLayerTilemap *pLayer = static_cast<CMapItemLayerTilemap *>(pMap->GetItem(LayersStart + NUM_LAYERS - 1));
+		ASSERT_EQ(pMap->GetDataSize(pLayer->m_Data), WIDTH * HEIGHT * (int)sizeof(CTile));
+	}
+	pMap->Unload();
+	log_info("datafile", "loading a map of %d layers of %dx%d tiles takes %.1f ms with the job pool and %.1f ms without", NUM_LAYERS, WIDTH, HEIGHT, aTimes[1] / 1e6 / NUM_RUNS, aTimes[0] / 1e6 / NUM_RUNS);
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+	}
+}
+
+TEST(Datafile, ParallelCompression)
+{
+	std::unique_ptr<IStorage> pStorage = CreateLocalStorage();
+	ASSERT_NE(pStorage, nullptr) << "Error creating local storage";
+
+	CTestInfo Info;
+	char aFilename[IO_MAX_PATH_LENGTH];
+
+	// large enough to be compressed by several threads by default
+	const int NUM_DATA = 24;
+	const int DATA_SIZE = 256 * 1024;
+	std::vector<int> vData(DATA_SIZE / sizeof(int));
+	// the first file is compressed on a single thread, 0 is the default
+	const int aNumThreads[] = {1, 2, 3, 8, 0};
+	for(int NumThreads : aNumThreads)
+	{
+		str_format(aFilename, sizeof(aFilename), "%s.%d", Info.m_aFilename, NumThreads);
+		CDataFileWriter Writer;
+		ASSERT_TRUE(Writer.Open(pStorage.get(), aFilename));
+		for(int i = 0; i < NUM_DATA; i++)
+		{
+			for(size_t j = 0; j < vData.size(); j++)
+				vData[j] = (j / (i + 1)) ^ i;
+			EXPECT_EQ(Writer.AddData(DATA_SIZE, vData.data(), i % 3 == 0 ? CDataFileWriter::COMPRESSION_BEST : CDataFileWriter::COMPRESSION_DEFAULT), i);
+		}
+		Writer.SetCompressionThreads(NumThreads);
+		Writer.Finish();
+	}
+
+	CDataFileReader Serial;
+	str_format(aFilename, sizeof(aFilename), "%s.%d", Info.m_aFilename, aNumThreads[0]);
+	ASSERT_TRUE(Serial.Open(pStorage.get(), aFilename, IStorage::TYPE_ALL));
+	ASSERT_EQ(Serial.NumData(), NUM_DATA);
+	for(int i = 0; i < NUM_DATA; i++)
+	{
+		ASSERT_EQ(Serial.GetDataSize(i), DATA_SIZE);
+		const int *pData = static_cast<const int *>(Serial.GetData(i));
+		ASSERT_TRUE(pData);
+		for(size_t j = 0; j < vData.size(); j++)
+			ASSERT_EQ(pData[j], (int)((j / (i + 1)) ^ i)) << "i=" << i << " j=" << j;
+	}
+	for(int NumThreads : aNumThreads)
+	{
+		CDataFileReader Reader;
+		str_format(aFilename, sizeof(aFilename), "%s.%d", Info.m_aFilename, NumThreads);
+		ASSERT_TRUE(Reader.Open(pStorage.get(), aFilename, IStorage::TYPE_ALL));
+		EXPECT_EQ(Reader.MapSize(), Serial.MapSize()) << "NumThreads=" << NumThreads;
+		EXPECT_EQ(Reader.Sha256(), Serial.Sha256()) << "NumThreads=" << NumThreads;
+		Reader.Close();
+	}
+	Serial.Close();
+
+	if(!HasFailure())
+	{
+		for(int NumThreads : aNumThreads)
+		{
+			str_format(aFilename, sizeof(aFilename), "%s.%d", Info.m_aFilename, NumThreads);
+			pStorage->RemoveFile(aFilename, IStorage::TYPE_SAVE);
+		}
+	}
+}
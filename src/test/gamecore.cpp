@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <game/gamecore.h>
+
+class CharacterCore : public ::testing::Test
+{
+protected:
+	CWorldCore m_World;
+	CNetObj_DDNetCharacter m_Snap;
+
+	CharacterCore()
+	{
+		m_Snap.m_Flags = CHARACTERFLAG_ENDLESS_HOOK | CHARACTERFLAG_WEAPON_HAMMER | CHARACTERFLAG_WEAPON_GUN | CHARACTERFLAG_WEAPON_GRENADE | CHARACTERFLAG_IN_FREEZE;
+		m_Snap.m_FreezeEnd = 1234;
+		m_Snap.m_Jumps = 3;
+		m_Snap.m_TeleCheckpoint = -1;
+		m_Snap.m_StrongWeakId = 0;
+		m_Snap.m_JumpedTotal = 1;
+		m_Snap.m_NinjaActivationTick = 500;
+		m_Snap.m_FreezeStart = 1200;
+		m_Snap.m_TargetX = 0;
+		m_Snap.m_TargetY = -1;
+		m_Snap.m_TuneZoneOverride = -1;
+	}
+
+	void Read(CCharacterCore *pCore, const CNetObj_DDNetCharacter *pSnap)
+	{
+		pCore->Init(&m_World, nullptr);
+		pCore->Reset();
+		mem_zero(pCore->m_aWeapons, sizeof(pCore->m_aWeapons));
+		pCore->m_ActiveWeapon = WEAPON_GUN;
+		pCore->ReadDDNet(pSnap);
+	}
+};
+
+TEST_F(CharacterCore, DDNetRoundTrip)
+{
+	CCharacterCore Core;
+	Read(&Core, &m_Snap);
+	CNetObj_DDNetCharacter Written;
+	Core.WriteDDNet(&Written);
+	EXPECT_EQ(mem_comp(&Written, &m_Snap, sizeof(Written)), 0);
+
+	m_Snap.m_FreezeEnd = -1;
+	Read(&Core, &m_Snap);
+	EXPECT_TRUE(Core.m_DeepFrozen);
+	Core.WriteDDNet(&Written);
+	EXPECT_EQ(Written.m_FreezeEnd, -1);
+}
+
+// The prediction cache is kept across snapshots whose characters match the
+// predicted ones. Changes that only show in the ddnet character must make
+// them differ, the core alone doesn't change.
+TEST_F(CharacterCore, DDNetChangesWithoutCoreChange)
+{
+	CCharacterCore Predicted;
+	Read(&Predicted, &m_Snap);
+	CNetObj_CharacterCore PredictedCore = {};
+	CNetObj_DDNetCharacter PredictedDDNet;
+	Predicted.Write(&PredictedCore);
+	Predicted.WriteDDNet(&PredictedDDNet);
+
+	auto Changed = [&](const CNetObj_DDNetCharacter &Snap) {
+		// the snapshot character is the predicted one updated by the new snapshot
+		CCharacterCore Core = Predicted;
+		Core.ReadDDNet(&Snap);
+		CNetObj_CharacterCore SnapCore = {};
+		CNetObj_DDNetCharacter SnapDDNet;
+		Core.Write(&SnapCore);
+		Core.WriteDDNet(&SnapDDNet);
+		EXPECT_EQ(mem_comp(&SnapCore, &PredictedCore, sizeof(SnapCore)), 0);
+		return mem_comp(&SnapDDNet, &PredictedDDNet, sizeof(SnapDDNet)) != 0;
+	};
+
+	EXPECT_FALSE(Changed(m_Snap));
+
+	CNetObj_DDNetCharacter Jetpack = m_Snap;
+	Jetpack.m_Flags |= CHARACTERFLAG_JETPACK;
+	EXPECT_TRUE(Changed(Jetpack));
+
+	CNetObj_DDNetCharacter Freeze = m_Snap;
+	Freeze.m_FreezeEnd = 1300;
+	EXPECT_TRUE(Changed(Freeze));
+
+	CNetObj_DDNetCharacter DeepFreeze = m_Snap;
+	DeepFreeze.m_FreezeEnd = -1;
+	EXPECT_TRUE(Changed(DeepFreeze));
+
+	CNetObj_DDNetCharacter Weapons = m_Snap;
+	Weapons.m_Flags &= ~CHARACTERFLAG_WEAPON_GRENADE;
+	EXPECT_TRUE(Changed(Weapons));
+
+	CNetObj_DDNetCharacter Solo = m_Snap;
+	Solo.m_Flags |= CHARACTERFLAG_SOLO;
+	EXPECT_TRUE(Changed(Solo));
+
+	CNetObj_DDNetCharacter Jumps = m_Snap;
+	Jumps.m_Jumps = 1;
+	EXPECT_TRUE(Changed(Jumps));
+}
@@ -20,6 +20,7 @@
 #include <game/version.h>
 
 #include <memory>
+#include <random>
 #include <thread>
 
 bool IsInterrupted()
@@ -235,7 +236,7 @@ TEST_F(CTestGameWorld, IntersectEntity)
 
 	vec2 CloserToFromButTooFarFromLine = vec2(11, 11 + Radius + pChrLeft->GetProximityRadius());
 	pChrLeft->SetPosition(CloserToFromButTooFarFromLine);
-	pChrLeft->m_Pos = CloserToFromButTooFarFromLine;
+	pChrLeft->SetPos(CloserToFromButTooFarFromLine);
 
 	pIntersectedChar = (CCharacter *)GameServer()->m_World.IntersectEntity(
 		vec2(10, 10), // intersect from
@@ -248,3 +249,87 @@ TEST_F(CTestGameWorld, IntersectEntity)
 		nullptr /* pThisOnly */);
 	EXPECT_EQ(pIntersectedChar, pChrRight);
 }
+
+TEST_F(CTestGameWorld, SpatialQueriesMatchLinearScan)
+{
+	CGameWorld &World = GameServer()->m_World;
+	std::mt19937 Rng(9);
+	std::uniform_real_distribution<float> Coord(-500.0f, 3500.0f);
+
+	CNetObj_PlayerInput Input = {};
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		CCharacter *pChr = new(i) CCharacter(&World, Input);
+		pChr->m_Pos = vec2(Coord(Rng), Coord(Rng));
+		World.InsertEntity(pChr);
+	}
+
+	for(int Round = 0; Round < 2000; Round++)
+	{
+		// move some characters around, sometimes onto the same spot
+		for(CEntity *pEnt = World.FindFirst(CGameWorld::ENTTYPE_CHARACTER); pEnt; pEnt = pEnt->TypeNext())
+			if(Rng() % 4 == 0)
+				pEnt->SetPos(Rng() % 8 == 0 ? vec2(1000.0f, 1000.0f) : vec2(Coord(Rng), Coord(Rng)));
+
+		const vec2 Pos0(Coord(Rng), Coord(Rng));
+		const vec2 Pos1 = Rng() % 2 ? Pos0 + vec2(Coord(Rng), Coord(Rng)) * 0.1f : vec2(Coord(Rng), Coord(Rng));
+		const float Radius = (float)(Rng() % 400);
+
+		std::vector<CEntity *> vpExpected;
+		for(CEntity *pEnt = World.FindFirst(CGameWorld::ENTTYPE_CHARACTER); pEnt; pEnt = pEnt->TypeNext())
+			if(distance(pEnt->m_Pos, Pos0) < Radius + pEnt->GetProximityRadius())
+				vpExpected.push_back(pEnt);
+		CEntity *apEnts[MAX_CLIENTS];
+		int Num = World.FindEntities(Pos0, Radius, apEnts, MAX_CLIENTS, CGameWorld::ENTTYPE_CHARACTER);
+		ASSERT_EQ(std::vector<CEntity *>(apEnts, apEnts + Num), vpExpected);
+
+		CEntity *pExpectedHit = nullptr;
+		vec2 ExpectedAt;
+		float ClosestLen = distance(Pos0, Pos1) * 100.0f;
+		for(CEntity *pEnt = World.FindFirst(CGameWorld::ENTTYPE_CHARACTER); pEnt; pEnt = pEnt->TypeNext())
+		{
+			vec2 IntersectPos;
+			if(closest_point_on_line(Pos0, Pos1, pEnt->m_Pos, IntersectPos) &&
+				distance(pEnt->m_Pos, IntersectPos) < pEnt->GetProximityRadius() + Radius &&
+				distance(Pos0, IntersectPos) < ClosestLen)
+			{
+				ClosestLen = distance(Pos0, IntersectPos);
+				ExpectedAt = IntersectPos;
+				pExpectedHit = pEnt;
+			}
+		}
+		vec2 At;
+		ASSERT_EQ(World.IntersectEntity(Pos0, Pos1, Radius, CGameWorld::ENTTYPE_CHARACTER, At), pExpectedHit);
+		if(pExpectedHit)
+		{
+			ASSERT_EQ(At, ExpectedAt);
+		}
+
+		std::vector<CCharacter *> vpIntersected = World.IntersectedCharacters(Pos0, Pos1, Radius, nullptr);
+		size_t NumExpected = 0;
+		for(CEntity *pEnt = World.FindFirst(CGameWorld::ENTTYPE_CHARACTER); pEnt; pEnt = pEnt->TypeNext())
+		{
+			vec2 IntersectPos;
+			if(closest_point_on_line(Pos0, Pos1, pEnt->m_Pos, IntersectPos) && distance(pEnt->m_Pos, IntersectPos) < pEnt->GetProximityRadius() + Radius)
+			{
+				ASSERT_LT(NumExpected, vpIntersected.size());
+				ASSERT_EQ(vpIntersected[NumExpected], pEnt);
+				NumExpected++;
+			}
+		}
+		ASSERT_EQ(vpIntersected.size(), NumExpected);
+
+		CEntity *pExpectedClosest = nullptr;
+		float ClosestRange = Radius * 2;
+		for(CEntity *pEnt = World.FindFirst(CGameWorld::ENTTYPE_CHARACTER); pEnt; pEnt = pEnt->TypeNext())
+		{
+			float Len = distance(Pos0, pEnt->m_Pos);
+			if(Len < pEnt->GetProximityRadius() + Radius && Len < ClosestRange)
+			{
+				ClosestRange = Len;
+				pExpectedClosest = pEnt;
+			}
+		}
+		ASSERT_EQ(World.ClosestCharacter(Pos0, Radius, nullptr), pExpectedClosest);
+	}
+}
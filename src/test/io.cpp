@@ -145,6 +145,34 @@ TEST(Io, SyncWorks)
 	EXPECT_FALSE(fs_remove(Info.m_aFilename));
 }
 
+TEST(Io, Map)
+{
+	CTestInfo Info;
+	IOHANDLE File = io_open(Info.m_aFilename, IOFLAG_WRITE);
+	ASSERT_TRUE(File);
+	EXPECT_EQ(io_write(File, "0123456789", 10), 10);
+	EXPECT_FALSE(io_close(File));
+
+	File = io_open(Info.m_aFilename, IOFLAG_READ);
+	ASSERT_TRUE(File);
+	EXPECT_EQ(io_map(File, 0), nullptr);
+	char *pData = static_cast<char *>(io_map(File, 10));
+	ASSERT_TRUE(pData);
+	EXPECT_FALSE(io_close(File));
+	EXPECT_EQ(mem_comp(pData, "0123456789", 10), 0);
+
+	// changes are not written to the file
+	pData[0] = 'X';
+	io_unmap(pData, 10);
+	File = io_open(Info.m_aFilename, IOFLAG_READ);
+	ASSERT_TRUE(File);
+	char aBuf[10];
+	EXPECT_EQ(io_read(File, aBuf, sizeof(aBuf)), sizeof(aBuf));
+	EXPECT_EQ(mem_comp(aBuf, "0123456789", 10), 0);
+	EXPECT_FALSE(io_close(File));
+	EXPECT_FALSE(fs_remove(Info.m_aFilename));
+}
+
 TEST(Io, WriteTruncatesFile)
 {
 	CTestInfo Info;
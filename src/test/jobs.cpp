@@ -6,7 +6,9 @@
 #include <engine/shared/host_lookup.h>
 #include <engine/shared/jobs.h>
 
+#include <algorithm>
 #include <functional>
+#include <thread>
 
 static const int TEST_NUM_THREADS = 4;
 
@@ -44,6 +46,11 @@ public:
 	{
 		IJob::Abortable(Abortable);
 	}
+
+	void SetPriority(EJobPriority Priority)
+	{
+		IJob::SetPriority(Priority);
+	}
 };
 
 TEST_F(Jobs, Constructor)
@@ -163,3 +170,190 @@ TEST_F(Jobs, Many)
 	}
 	SetUp();
 }
+
+TEST_F(Jobs, Priority)
+{
+	// occupy all workers so the following jobs are queued together
+	SEMAPHORE Blocked;
+	SEMAPHORE Release;
+	sphore_init(&Blocked);
+	sphore_init(&Release);
+	for(int i = 0; i < TEST_NUM_THREADS; i++)
+	{
+		Add(std::make_shared<CJob>([&] {
+			sphore_signal(&Blocked);
+			sphore_wait(&Release);
+		}));
+	}
+	for(int i = 0; i < TEST_NUM_THREADS; i++)
+		sphore_wait(&Blocked);
+
+	CLock Lock;
+	std::vector<IJob::EJobPriority> vOrder;
+	std::vector<std::shared_ptr<CJob>> vpJobs;
+	for(int i = 0; i < 3 * TEST_NUM_THREADS; i++)
+	{
+		const IJob::EJobPriority Priority = i % 3 == 0 ? IJob::PRIORITY_LOW : (i % 3 == 1 ? IJob::PRIORITY_NORMAL : IJob::PRIORITY_HIGH);
+		auto pJob = std::make_shared<CJob>([&, Priority] {
+			const CLockScope LockScope(Lock);
+			vOrder.push_back(Priority);
+		});
+		pJob->SetPriority(Priority);
+		EXPECT_EQ(pJob->Priority(), Priority);
+		vpJobs.push_back(pJob);
+		Add(pJob);
+	}
+
+	// with a single worker released everything runs in priority order
+	sphore_signal(&Release);
+	for(auto &pJob : vpJobs)
+	{
+		while(!pJob->Done())
+			thread_yield();
+	}
+	EXPECT_TRUE(std::is_sorted(vOrder.begin(), vOrder.end()));
+
+	for(int i = 0; i < TEST_NUM_THREADS - 1; i++)
+		sphore_signal(&Release);
+	TearDown();
+	sphore_destroy(&Blocked);
+	sphore_destroy(&Release);
+	SetUp();
+}
+
+TEST_F(Jobs, Steal)
+{
+	// one worker is blocked, the jobs queued to it must be stolen by the others
+	SEMAPHORE Blocked;
+	SEMAPHORE Release;
+	sphore_init(&Blocked);
+	sphore_init(&Release);
+	Add(std::make_shared<CJob>([&] {
+		sphore_signal(&Blocked);
+		sphore_wait(&Release);
+	}));
+	sphore_wait(&Blocked);
+
+	std::atomic<int> Done(0);
+	for(int i = 0; i < 10 * TEST_NUM_THREADS; i++)
+		Add(std::make_shared<CJob>([&] { Done++; }));
+	while(Done < 10 * TEST_NUM_THREADS)
+		thread_yield();
+
+	sphore_signal(&Release);
+	TearDown();
+	sphore_destroy(&Blocked);
+	sphore_destroy(&Release);
+	SetUp();
+}
+
+TEST_F(Jobs, Stats)
+{
+	std::vector<std::shared_ptr<CJob>> vpJobs;
+	for(int i = 0; i < 10; i++)
+	{
+		vpJobs.push_back(std::make_shared<CJob>([] {}));
+		vpJobs.back()->SetPriority(IJob::PRIORITY_LOW);
+		Add(vpJobs.back());
+	}
+	for(auto &pJob : vpJobs)
+	{
+		while(!pJob->Done())
+			thread_yield();
+	}
+
+	// stats are updated before the job is marked as done
+	const CJobPool::CStats Stats = m_Pool.Stats(IJob::PRIORITY_LOW);
+	EXPECT_EQ(Stats.m_NumJobs, 10);
+	EXPECT_GE(Stats.m_TotalWaitTime, Stats.m_MaxWaitTime);
+	EXPECT_GE(Stats.m_MaxWaitTime, 0);
+	EXPECT_GE(Stats.m_TotalRunTime, Stats.m_MaxRunTime);
+	EXPECT_EQ(m_Pool.Stats(IJob::PRIORITY_HIGH).m_NumJobs, 0);
+}
+
+TEST_F(Jobs, Group)
+{
+	static const int NUM_JOBS = 20;
+	std::atomic<int> NumDone(0);
+	std::vector<std::shared_ptr<IJob>> vpJobs;
+	auto pGroup = std::make_shared<CJobGroup>();
+	for(int i = 0; i < NUM_JOBS; i++)
+	{
+		vpJobs.push_back(std::make_shared<CJob>([&] { NumDone++; }));
+		pGroup->Add(vpJobs.back());
+	}
+
+	// the continuation sees all jobs of the group finished
+	bool ContinuationSawAll = false;
+	auto pContinuation = std::make_shared<CJob>([&] {
+		ContinuationSawAll = NumDone == NUM_JOBS && pGroup->Done();
+		for(auto &pJob : vpJobs)
+			ContinuationSawAll = ContinuationSawAll && pJob->State() == IJob::STATE_DONE;
+	});
+	pGroup->Then(pContinuation);
+
+	// the completion runs on the thread calling RunCompletions
+	std::thread::id CompletionThread;
+	pGroup->OnCompletion([&] { CompletionThread = std::this_thread::get_id(); });
+
+	m_Pool.AddGroup(pGroup);
+	while(!pContinuation->Done())
+		thread_yield();
+	EXPECT_TRUE(ContinuationSawAll);
+	EXPECT_TRUE(pGroup->Done());
+
+	m_Pool.RunCompletions();
+	EXPECT_EQ(CompletionThread, std::this_thread::get_id());
+}
+
+TEST_F(Jobs, GroupEmpty)
+{
+	bool Completed = false;
+	auto pGroup = std::make_shared<CJobGroup>();
+	pGroup->OnCompletion([&] { Completed = true; });
+	m_Pool.AddGroup(pGroup);
+	EXPECT_TRUE(pGroup->Done());
+	EXPECT_FALSE(Completed);
+	m_Pool.RunCompletions();
+	EXPECT_TRUE(Completed);
+}
+
+TEST_F(Jobs, GroupAborted)
+{
+	// block all workers, so the jobs of the group are still queued on shutdown
+	SEMAPHORE Blocked;
+	SEMAPHORE Release;
+	sphore_init(&Blocked);
+	sphore_init(&Release);
+	for(int i = 0; i < TEST_NUM_THREADS; i++)
+	{
+		Add(std::make_shared<CJob>([&] {
+			sphore_signal(&Blocked);
+			sphore_wait(&Release);
+		}));
+	}
+	for(int i = 0; i < TEST_NUM_THREADS; i++)
+		sphore_wait(&Blocked);
+
+	auto pGroup = std::make_shared<CJobGroup>();
+	for(int i = 0; i < 10; i++)
+	{
+		auto pJob = std::make_shared<CJob>([] {});
+		pJob->Abortable(true);
+		pGroup->Add(pJob);
+	}
+	bool Completed = false;
+	pGroup->OnCompletion([&] { Completed = true; });
+	m_Pool.AddGroup(pGroup);
+	EXPECT_FALSE(pGroup->Done());
+
+	for(int i = 0; i < TEST_NUM_THREADS; i++)
+		sphore_signal(&Release);
+	TearDown();
+	EXPECT_TRUE(pGroup->Done());
+	m_Pool.RunCompletions();
+	EXPECT_TRUE(Completed);
+	sphore_destroy(&Blocked);
+	sphore_destroy(&Release);
+	SetUp();
+}
@@ -48,3 +48,67 @@ TEST(Net, Ipv4AndIpv6Work)
 	net_udp_close(Socket1);
 	net_udp_close(Socket2);
 }
+
+TEST(Net, SendBatching)
+{
+	NETADDR Bindaddr = {};
+	NETSOCKET Socket1;
+	NETSOCKET Socket2;
+
+	Bindaddr.type = NETTYPE_IPV4;
+	Socket2 = net_udp_create(Bindaddr);
+	do
+	{
+		Bindaddr.port = secure_rand() % 64511 + 1024;
+	} while(!(Socket1 = net_udp_create(Bindaddr)));
+
+	NETADDR Target;
+	ASSERT_FALSE(net_addr_from_str(&Target, "127.0.0.1"));
+	Target.port = Bindaddr.port;
+
+	net_udp_set_send_batching(Socket2, true);
+
+	// a few more than the 128 packets that fit into one batch, but not so
+	// many that the receive buffer overflows
+	const int NUM_PACKETS = 130;
+	NETSTATS Before;
+	net_stats(&Before);
+	for(int i = 0; i < NUM_PACKETS; i++)
+		EXPECT_EQ(net_udp_send(Socket2, &Target, &i, sizeof(i)), (int)sizeof(i));
+	net_udp_flush(Socket2);
+	NETSTATS After;
+	net_stats(&After);
+	EXPECT_EQ(After.sent_packets - Before.sent_packets, (uint64_t)NUM_PACKETS);
+#if defined(CONF_PLATFORM_LINUX)
+	EXPECT_LT(After.send_syscalls - Before.send_syscalls, (uint64_t)NUM_PACKETS);
+#endif
+
+	// packets arrive complete and in order, several per read on Linux
+	for(int i = 0; i < NUM_PACKETS;)
+	{
+		NETADDR Addr;
+		unsigned char *pData;
+		int Bytes = net_udp_recv(Socket1, &Addr, &pData);
+		if(Bytes <= 0)
+		{
+			ASSERT_EQ(net_socket_read_wait(Socket1, 10000000), 1);
+			continue;
+		}
+		ASSERT_EQ(Bytes, (int)sizeof(i));
+		int Value;
+		mem_copy(&Value, pData, sizeof(Value));
+		EXPECT_EQ(Value, i);
+		i++;
+	}
+
+	// closing sends what is still queued
+	EXPECT_EQ(net_udp_send(Socket2, &Target, "abc", 3), 3);
+	net_udp_close(Socket2);
+	NETADDR Addr;
+	unsigned char *pData;
+	EXPECT_EQ(net_socket_read_wait(Socket1, 10000000), 1);
+	ASSERT_EQ(net_udp_recv(Socket1, &Addr, &pData), 3);
+	EXPECT_EQ(mem_comp(pData, "abc", 3), 0);
+
+	net_udp_close(Socket1);
+}
@@ -1,6 +1,8 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include "test.h"
+
 #include <base/detect.h>
 #include <engine/server/databases/connection.h>
 #include <engine/server/databases/connection_pool.h>
@@ -9,6 +11,13 @@
 
 #include <sqlite3.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using namespace std::chrono_literals;
+
 #if defined(CONF_TEST_MYSQL)
 int DummyMysqlInit = (MysqlInit(), 1);
 #endif
@@ -73,7 +82,7 @@ struct Score : public testing::TestWithParam<IDbConnection *>
 		ASSERT_EQ(NumInserted, 1);
 	}
 
-	void InsertRank(float Time = 100.0, bool WithTimeCheckPoints = false)
+	void InsertRank(float Time = 100.0, bool WithTimeCheckPoints = false, std::shared_ptr<CScoreResultCache> pResultCache = nullptr)
 	{
 		str_copy(g_Config.m_SvSqlServerName, "USA", sizeof(g_Config.m_SvSqlServerName));
 		CSqlScoreData ScoreData(std::make_shared<CScorePlayerResult>());
@@ -86,7 +95,10 @@ struct Score : public testing::TestWithParam<IDbConnection *>
 		for(int i = 0; i < NUM_CHECKPOINTS; i++)
 			ScoreData.m_aCurrentTimeCp[i] = WithTimeCheckPoints ? i : 0;
 		str_copy(ScoreData.m_aRequestingPlayer, "deen", sizeof(ScoreData.m_aRequestingPlayer));
+		ScoreData.m_pResultCache = std::move(pResultCache);
 		ASSERT_TRUE(CScoreWorker::SaveScore(m_pConn, &ScoreData, Write::NORMAL, m_aError, sizeof(m_aError))) << m_aError;
+		// like the write worker after committing
+		ScoreData.OnCommitted();
 	}
 
 	void ExpectLines(const std::shared_ptr<CScorePlayerResult> &pPlayerResult, std::initializer_list<const char *> Lines, bool All = false)
@@ -145,6 +157,35 @@ TEST_P(SingleScore, Top)
 			"-----------------------------------------"});
 }
 
+TEST_P(SingleScore, TopCached)
+{
+	g_Config.m_SvRegionalRankings = false;
+	g_Config.m_SvSqlCacheTime = 30;
+	auto pCache = std::make_shared<CScoreResultCache>();
+	m_PlayerRequest.m_pResultCache = pCache;
+	ASSERT_TRUE(CScoreWorker::ShowTop(m_pConn, &m_PlayerRequest, m_aError, sizeof(m_aError))) << m_aError;
+
+	// not saved through the cache, the old result is still served
+	InsertRank(50.0);
+	auto pCachedResult = std::make_shared<CScorePlayerResult>();
+	m_PlayerRequest.m_pResult = pCachedResult;
+	ASSERT_TRUE(CScoreWorker::ShowTop(m_pConn, &m_PlayerRequest, m_aError, sizeof(m_aError))) << m_aError;
+	ExpectLines(pCachedResult,
+		{"------------ Global Top ------------",
+			"1. nameless tee Time: 01:40.00",
+			"-----------------------------------------"});
+
+	InsertRank(40.0, false, pCache);
+	auto pNewResult = std::make_shared<CScorePlayerResult>();
+	m_PlayerRequest.m_pResult = pNewResult;
+	ASSERT_TRUE(CScoreWorker::ShowTop(m_pConn, &m_PlayerRequest, m_aError, sizeof(m_aError))) << m_aError;
+	ExpectLines(pNewResult,
+		{"------------ Global Top ------------",
+			"1. nameless tee Time: 40.00",
+			"-----------------------------------------"});
+	g_Config.m_SvSqlCacheTime = 0;
+}
+
 TEST_P(SingleScore, RankRegional)
 {
 	g_Config.m_SvRegionalRankings = true;
@@ -609,6 +650,159 @@ TEST_P(RandomMap, UnfinishedDoesntExist)
 	EXPECT_STREQ(m_pRandomMapResult->m_aMessage, "nameless tee has no more unfinished maps on this server!");
 }
 
+struct SqlPool : public testing::Test
+{
+	CTestInfo m_Info;
+	int m_SavedReadWorkers = g_Config.m_SvSqlReadWorkers;
+	int m_SavedWriteBatch = g_Config.m_SvSqlWriteBatch;
+	char m_aSavedServerName[sizeof(g_Config.m_SvSqlServerName)];
+
+	SqlPool()
+	{
+		str_copy(m_aSavedServerName, g_Config.m_SvSqlServerName, sizeof(m_aSavedServerName));
+	}
+
+	~SqlPool()
+	{
+		g_Config.m_SvSqlReadWorkers = m_SavedReadWorkers;
+		g_Config.m_SvSqlWriteBatch = m_SavedWriteBatch;
+		str_copy(g_Config.m_SvSqlServerName, m_aSavedServerName, sizeof(g_Config.m_SvSqlServerName));
+		fs_remove(m_Info.m_aFilename);
+	}
+};
+
+struct CConcurrentReadResult : ISqlResult
+{
+	bool m_SawOtherRead = false;
+};
+
+static std::mutex s_ReadMutex;
+static std::condition_variable s_ReadCondition;
+static int s_NumRunningReads = 0;
+static int s_NumFinishedReads = 0;
+
+static bool WaitForOtherRead(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	// succeeds only if another read runs at the same time, the timeout
+	// only keeps the test from hanging if the reads are serialized
+	auto *pResult = dynamic_cast<CConcurrentReadResult *>(pGameData->m_pResult.get());
+	std::unique_lock<std::mutex> Lock(s_ReadMutex);
+	s_NumRunningReads++;
+	s_ReadCondition.notify_all();
+	pResult->m_SawOtherRead = s_ReadCondition.wait_for(Lock, 5s, [] { return s_NumRunningReads >= 2; });
+	s_NumFinishedReads++;
+	s_ReadCondition.notify_all();
+	return true;
+}
+
+TEST_F(SqlPool, ConcurrentReads)
+{
+	g_Config.m_SvSqlReadWorkers = 2;
+	s_NumRunningReads = 0;
+	s_NumFinishedReads = 0;
+	std::vector<std::shared_ptr<CConcurrentReadResult>> vpResults;
+	{
+		CDbConnectionPool Pool;
+		Pool.RegisterSqliteDatabase(CDbConnectionPool::READ, m_Info.m_aFilename);
+		for(int i = 0; i < 2; i++)
+		{
+			vpResults.push_back(std::make_shared<CConcurrentReadResult>());
+			Pool.Execute(WaitForOtherRead, std::make_unique<ISqlData>(vpResults.back()), "wait for other read");
+		}
+		// a running read is completed even when the pool shuts down, waiting
+		// for both to run keeps the shutdown from dismissing a queued one
+		std::unique_lock<std::mutex> Lock(s_ReadMutex);
+		ASSERT_TRUE(s_ReadCondition.wait_for(Lock, 30s, [] { return s_NumFinishedReads == 2; }));
+	}
+	for(const auto &pResult : vpResults)
+	{
+		ASSERT_TRUE(pResult->m_Completed);
+		EXPECT_TRUE(pResult->m_Success);
+		EXPECT_TRUE(pResult->m_SawOtherRead);
+	}
+}
+
+static bool InsertAndFail(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize)
+{
+	// the insert has to be undone together with the failed query
+	char aBuf[128];
+	str_format(aBuf, sizeof(aBuf), "INSERT INTO %s_points(Name, Points) VALUES ('failing tee', 1)", pSqlServer->GetPrefix());
+	if(!pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+		return false;
+	int NumInserted;
+	if(!pSqlServer->ExecuteUpdate(&NumInserted, pError, ErrorSize))
+		return false;
+	str_copy(pError, "failing on purpose", ErrorSize);
+	return false;
+}
+
+TEST_F(SqlPool, BatchedWrites)
+{
+	g_Config.m_SvSqlWriteBatch = 32;
+	str_copy(g_Config.m_SvSqlServerName, "USA", sizeof(g_Config.m_SvSqlServerName));
+	char aError[256];
+	{
+		// create the tables before locking the database
+		auto pSetup = CreateSqliteConnection(m_Info.m_aFilename, true);
+		ASSERT_TRUE(pSetup->Connect(aError, sizeof(aError))) << aError;
+		pSetup->Disconnect();
+	}
+
+	std::vector<std::shared_ptr<ISqlResult>> vpResults;
+	{
+		CDbConnectionPool Pool;
+		Pool.RegisterSqliteDatabase(CDbConnectionPool::WRITE, m_Info.m_aFilename);
+
+		// keep the writes waiting so they pile up in the queue
+		sqlite3 *pLock;
+		ASSERT_EQ(sqlite3_open(m_Info.m_aFilename, &pLock), SQLITE_OK);
+		ASSERT_EQ(sqlite3_exec(pLock, "BEGIN IMMEDIATE", nullptr, nullptr, nullptr), SQLITE_OK);
+		for(int i = 0; i < 20; i++)
+		{
+			if(i == 10)
+			{
+				vpResults.push_back(std::make_shared<ISqlResult>());
+				Pool.ExecuteWrite(InsertAndFail, std::make_unique<ISqlData>(vpResults.back()), "insert and fail");
+			}
+			auto pResult = std::make_shared<CScorePlayerResult>();
+			vpResults.push_back(pResult);
+			auto pData = std::make_unique<CSqlScoreData>(pResult);
+			str_copy(pData->m_aMap, "Kobra 3", sizeof(pData->m_aMap));
+			str_copy(pData->m_aGameUuid, "8d300ecf-5873-4297-bee5-95668fdff320", sizeof(pData->m_aGameUuid));
+			str_format(pData->m_aName, sizeof(pData->m_aName), "tee %d", i);
+			pData->m_Time = 100.0f + i;
+			str_copy(pData->m_aTimestamp, "2021-11-24 19:24:08", sizeof(pData->m_aTimestamp));
+			for(float &TimeCp : pData->m_aCurrentTimeCp)
+				TimeCp = 0.0f;
+			Pool.ExecuteWrite(CScoreWorker::SaveScore, std::move(pData), "save score");
+		}
+		std::this_thread::sleep_for(50ms);
+		ASSERT_EQ(sqlite3_exec(pLock, "COMMIT", nullptr, nullptr, nullptr), SQLITE_OK);
+		sqlite3_close(pLock);
+
+		for(int i = 0; i < 1000 && !vpResults.back()->m_Completed; i++)
+			std::this_thread::sleep_for(10ms);
+	}
+
+	for(size_t i = 0; i < vpResults.size(); i++)
+	{
+		ASSERT_TRUE(vpResults[i]->m_Completed);
+		EXPECT_EQ(vpResults[i]->m_Success, i != 10);
+	}
+
+	auto pConn = CreateSqliteConnection(m_Info.m_aFilename, false);
+	ASSERT_TRUE(pConn->Connect(aError, sizeof(aError))) << aError;
+	ASSERT_TRUE(pConn->PrepareStatement("SELECT COUNT(*) FROM record_race", aError, sizeof(aError))) << aError;
+	bool End;
+	ASSERT_TRUE(pConn->Step(&End, aError, sizeof(aError))) << aError;
+	EXPECT_EQ(pConn->GetInt(1), 20);
+	ASSERT_TRUE(pConn->PrepareStatement("SELECT COUNT(*) FROM record_points WHERE Name = 'failing tee'", aError, sizeof(aError))) << aError;
+	ASSERT_TRUE(pConn->Step(&End, aError, sizeof(aError))) << aError;
+	EXPECT_EQ(pConn->GetInt(1), 0);
+	pConn->Disconnect();
+	pConn.reset();
+}
+
 auto g_pSqliteConn = CreateSqliteConnection(":memory:", true);
 #if defined(CONF_TEST_MYSQL)
 CMysqlConfig gMysqlConfig{
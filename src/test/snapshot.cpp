@@ -1,9 +1,16 @@
 #include <gtest/gtest.h>
 
+#include <base/log.h>
 #include <base/system.h>
+#include <engine/shared/compression.h>
 #include <engine/shared/snapshot.h>
 #include <game/generated/protocol.h>
 
+#include <climits>
+#include <memory>
+#include <random>
+#include <vector>
+
 TEST(Snapshot, CrcOneInt)
 {
 	CSnapshotBuilder Builder;
@@ -83,3 +90,399 @@ TEST(Snapshot, CrcOverflow)
 
 	ASSERT_EQ(pSnapshot->Crc(), 1);
 }
+
+static int ReferenceDiffItem(const int *pPast, const int *pCurrent, int *pOut, int Size)
+{
+	int Needed = 0;
+	for(int i = 0; i < Size; i++)
+	{
+		pOut[i] = (unsigned)pCurrent[i] - (unsigned)pPast[i];
+		Needed |= pOut[i];
+	}
+	return Needed;
+}
+
+static int RandomInt(std::mt19937 &Rng)
+{
+	// mix small deltas, which are the common case, with extremes that wrap
+	switch(Rng() % 4)
+	{
+	case 0: return 0;
+	case 1: return (int)(Rng() % 129) - 64;
+	case 2: return (Rng() % 2) ? INT_MAX : INT_MIN;
+	default: return (int)Rng();
+	}
+}
+
+TEST(Snapshot, DiffItemMatchesScalar)
+{
+	std::mt19937 Rng(1234);
+	int aPast[64];
+	int aCurrent[64];
+	int aOut[64];
+	int aExpected[64];
+	for(int Run = 0; Run < 1000; Run++)
+	{
+		const int Size = Run % 65;
+		for(int i = 0; i < Size; i++)
+		{
+			aPast[i] = RandomInt(Rng);
+			aCurrent[i] = (Rng() % 3) ? aPast[i] : RandomInt(Rng);
+		}
+		const int Expected = ReferenceDiffItem(aPast, aCurrent, aExpected, Size);
+		EXPECT_EQ(CSnapshotDelta::DiffItem(aPast, aCurrent, aOut, Size) != 0, Expected != 0);
+		for(int i = 0; i < Size; i++)
+			ASSERT_EQ(aOut[i], aExpected[i]) << "run " << Run << ", index " << i;
+	}
+}
+
+TEST(Snapshot, DeltaRoundtrip)
+{
+	static const int s_Type = 40;
+	static const int s_NumItems = 20;
+	std::mt19937 Rng(5678);
+	std::vector<int> avPast[s_NumItems];
+	std::vector<int> avCurrent[s_NumItems];
+	for(int Id = 0; Id < s_NumItems; Id++)
+	{
+		avPast[Id].resize(1 + Id * 3);
+		avCurrent[Id].resize(avPast[Id].size());
+		for(size_t i = 0; i < avPast[Id].size(); i++)
+		{
+			avPast[Id][i] = RandomInt(Rng);
+			avCurrent[Id][i] = (Rng() % 2) ? avPast[Id][i] : RandomInt(Rng);
+		}
+	}
+
+	char aPastData[CSnapshot::MAX_SIZE];
+	char aCurrentData[CSnapshot::MAX_SIZE];
+	CSnapshot *pPast = (CSnapshot *)aPastData;
+	CSnapshot *pCurrent = (CSnapshot *)aCurrentData;
+	CSnapshotBuilder Builder;
+	Builder.Init();
+	for(int Id = 0; Id < s_NumItems; Id++)
+		mem_copy(Builder.NewItem(s_Type, Id, avPast[Id].size() * sizeof(int)), avPast[Id].data(), avPast[Id].size() * sizeof(int));
+	Builder.Finish(pPast);
+	Builder.Init();
+	for(int Id = 0; Id < s_NumItems; Id++)
+		mem_copy(Builder.NewItem(s_Type, Id, avCurrent[Id].size() * sizeof(int)), avCurrent[Id].data(), avCurrent[Id].size() * sizeof(int));
+	const int CurrentSize = Builder.Finish(pCurrent);
+
+	std::unique_ptr<CSnapshotDelta> pDelta = std::make_unique<CSnapshotDelta>();
+	char aDeltaData[CSnapshot::MAX_SIZE];
+	const int DeltaSize = pDelta->CreateDelta(pPast, pCurrent, aDeltaData);
+	ASSERT_GT(DeltaSize, 0);
+
+	char aResultData[CSnapshot::MAX_SIZE];
+	CSnapshot *pResult = (CSnapshot *)aResultData;
+	ASSERT_EQ(pDelta->UnpackDelta(pPast, pResult, aDeltaData, DeltaSize, false), CurrentSize);
+	EXPECT_EQ(mem_comp(pResult, pCurrent, CurrentSize), 0);
+
+	// the data rate counts the bytes each changed int takes when packed
+	uint64_t ExpectedRate = 0;
+	for(int Id = 0; Id < s_NumItems; Id++)
+	{
+		std::vector<int> vDiff(avPast[Id].size());
+		if(!ReferenceDiffItem(avPast[Id].data(), avCurrent[Id].data(), vDiff.data(), vDiff.size()))
+			continue;
+		for(int Diff : vDiff)
+		{
+			if(Diff == 0)
+			{
+				ExpectedRate += 1;
+				continue;
+			}
+			unsigned char aBuf[CVariableInt::MAX_BYTES_PACKED];
+			const unsigned char *pEnd = CVariableInt::Pack(aBuf, Diff, sizeof(aBuf));
+			ExpectedRate += (pEnd - aBuf) * 8;
+		}
+	}
+	EXPECT_EQ(pDelta->GetDataRate(s_Type), ExpectedRate);
+}
+
+// the data rate is measured by packing every diff, like UnpackDelta used to
+static void ReferenceUndiffItem(const int *pPast, const int *pDiff, int *pOut, int Size, uint64_t *pDataRate)
+{
+	for(int i = 0; i < Size; i++)
+	{
+		pOut[i] = (unsigned)pPast[i] + (unsigned)pDiff[i];
+		if(pDiff[i] == 0)
+			*pDataRate += 1;
+		else
+		{
+			unsigned char aBuf[CVariableInt::MAX_BYTES_PACKED];
+			unsigned char *pEnd = CVariableInt::Pack(aBuf, pDiff[i], sizeof(aBuf));
+			*pDataRate += (uint64_t)(pEnd - aBuf) * 8;
+		}
+	}
+}
+
+// Fills a snapshot with the items of a full DDNet server. Only the first
+// ints of moving objects change between ticks, like positions do.
+static int BuildGameSnapshot(CSnapshot *pSnapshot, int Tick)
+{
+	struct CItemKind
+	{
+		int m_Type;
+		int m_Size;
+		int m_Num;
+		int m_NumMoving;
+	};
+	static const CItemKind s_aKinds[] = {
+		{CNetObj_Character::ms_MsgId, sizeof(CNetObj_Character), 64, 6},
+		{CNetObj_PlayerInfo::ms_MsgId, sizeof(CNetObj_PlayerInfo), 64, 1},
+		{30, sizeof(CNetObj_DDNetCharacter), 64, 2},
+		{31, sizeof(CNetObj_DDNetPlayer), 64, 0},
+		{32, sizeof(CNetObj_DDNetProjectile), 400, 0},
+		{33, sizeof(CNetObj_DDNetLaser), 200, 0},
+		{CNetObj_Pickup::ms_MsgId, sizeof(CNetObj_Pickup), 168, 0},
+	};
+
+	CSnapshotBuilder Builder;
+	Builder.Init();
+	for(const CItemKind &Kind : s_aKinds)
+	{
+		for(int Id = 0; Id < Kind.m_Num; Id++)
+		{
+			int *pItem = (int *)Builder.NewItem(Kind.m_Type, Id, Kind.m_Size);
+			if(!pItem)
+				return -1;
+			for(int i = 0; i < Kind.m_Size / (int)sizeof(int); i++)
+				pItem[i] = (Kind.m_Type * 7919 + Id * 31 + i) % 2048 + (i < Kind.m_NumMoving ? Tick * (1 + (Id + i) % 5) : 0);
+		}
+	}
+	return Builder.Finish(pSnapshot);
+}
+
+TEST(Snapshot, DiffItemBenchmark)
+{
+	char aPastData[CSnapshot::MAX_SIZE];
+	char aCurrentData[CSnapshot::MAX_SIZE];
+	CSnapshot *pPast = (CSnapshot *)aPastData;
+	CSnapshot *pCurrent = (CSnapshot *)aCurrentData;
+	ASSERT_GT(BuildGameSnapshot(pPast, 100), 0);
+	ASSERT_GT(BuildGameSnapshot(pCurrent, 101), 0);
+	ASSERT_EQ(pCurrent->NumItems(), CSnapshot::MAX_ITEMS);
+
+	// diff and undiff every item, like creating and unpacking a delta does
+	const int NUM_RUNS = 200;
+	int aDiff[64];
+	int aOut[64];
+	int aExpectedDiff[64];
+	int aExpectedOut[64];
+	uint64_t DataRate = 0;
+	uint64_t ExpectedDataRate = 0;
+	int Needed = 0;
+	int64_t aDiffTime[2] = {0, 0};
+	int64_t aUndiffTime[2] = {0, 0};
+	std::vector<int> vDiffs;
+	std::vector<int> vDiffOffsets;
+	for(int i = 0; i < pCurrent->NumItems(); i++)
+	{
+		vDiffOffsets.push_back(vDiffs.size());
+		vDiffs.resize(vDiffs.size() + pCurrent->GetItemSize(i) / sizeof(int));
+		ReferenceDiffItem(pPast->GetItem(i)->Data(), pCurrent->GetItem(i)->Data(), &vDiffs[vDiffOffsets[i]], pCurrent->GetItemSize(i) / sizeof(int));
+	}
+	for(int Run = 0; Run < NUM_RUNS; Run++)
+	{
+		int64_t Start = time_get_nanoseconds().count();
+		for(int i = 0; i < pCurrent->NumItems(); i++)
+			Needed += ReferenceDiffItem(pPast->GetItem(i)->Data(), pCurrent->GetItem(i)->Data(), aExpectedDiff, pCurrent->GetItemSize(i) / sizeof(int)) != 0;
+		int64_t End = time_get_nanoseconds().count();
+		aDiffTime[0] += End - Start;
+
+		Start = End;
+		for(int i = 0; i < pCurrent->NumItems(); i++)
+			Needed -= CSnapshotDelta::DiffItem(pPast->GetItem(i)->Data(), pCurrent->GetItem(i)->Data(), aDiff, pCurrent->GetItemSize(i) / sizeof(int)) != 0;
+		End = time_get_nanoseconds().count();
+		aDiffTime[1] += End - Start;
+
+		Start = End;
+		for(int i = 0; i < pCurrent->NumItems(); i++)
+			ReferenceUndiffItem(pPast->GetItem(i)->Data(), &vDiffs[vDiffOffsets[i]], aExpectedOut, pCurrent->GetItemSize(i) / sizeof(int), &ExpectedDataRate);
+		End = time_get_nanoseconds().count();
+		aUndiffTime[0] += End - Start;
+
+		Start = End;
+		for(int i = 0; i < pCurrent->NumItems(); i++)
+			CSnapshotDelta::UndiffItem(pPast->GetItem(i)->Data(), &vDiffs[vDiffOffsets[i]], aOut, pCurrent->GetItemSize(i) / sizeof(int), &DataRate);
+		End = time_get_nanoseconds().count();
+		aUndiffTime[1] += End - Start;
+	}
+	EXPECT_EQ(Needed, 0);
+	EXPECT_EQ(DataRate, ExpectedDataRate);
+	log_info("snapshot", "diffing a full snapshot takes %.0f ns with the scalar loop and %.0f ns with DiffItem", aDiffTime[0] / (double)NUM_RUNS, aDiffTime[1] / (double)NUM_RUNS);
+	log_info("snapshot", "undiffing a full snapshot takes %.0f ns with the scalar loop and %.0f ns with UndiffItem", aUndiffTime[0] / (double)NUM_RUNS, aUndiffTime[1] / (double)NUM_RUNS);
+
+	for(int i = 0; i < pCurrent->NumItems(); i++)
+	{
+		const int Size = pCurrent->GetItemSize(i) / sizeof(int);
+		ReferenceDiffItem(pPast->GetItem(i)->Data(), pCurrent->GetItem(i)->Data(), aExpectedDiff, Size);
+		CSnapshotDelta::DiffItem(pPast->GetItem(i)->Data(), pCurrent->GetItem(i)->Data(), aDiff, Size);
+		CSnapshotDelta::UndiffItem(pPast->GetItem(i)->Data(), aDiff, aOut, Size, &DataRate);
+		ASSERT_EQ(mem_comp(aDiff, aExpectedDiff, Size * sizeof(int)), 0);
+		ASSERT_EQ(mem_comp(aOut, pCurrent->GetItem(i)->Data(), Size * sizeof(int)), 0);
+	}
+}
+
+TEST(Snapshot, IndexFindsFirstItemOfKey)
+{
+	CSnapshotBuilder Builder;
+	Builder.Init();
+	for(int Id = 0; Id < CSnapshot::MAX_ITEMS - 1; Id++)
+		ASSERT_TRUE(Builder.NewItem(1 + Id % 7, Id, sizeof(int)));
+	// duplicate key, lookups must keep returning the first item
+	ASSERT_TRUE(Builder.NewItem(1, 0, sizeof(int)));
+
+	char aData[CSnapshot::MAX_SIZE];
+	CSnapshot *pSnapshot = (CSnapshot *)aData;
+	Builder.Finish(pSnapshot);
+
+	std::unique_ptr<CSnapshotIndex> pIndex = std::make_unique<CSnapshotIndex>();
+	pIndex->Build(pSnapshot);
+	for(int i = 0; i < pSnapshot->NumItems(); i++)
+	{
+		const int Key = pSnapshot->GetItem(i)->Key();
+		EXPECT_EQ(pIndex->Find(Key), pSnapshot->GetItemIndex(Key));
+	}
+	EXPECT_EQ(pIndex->Find(0), -1);
+	EXPECT_EQ(pIndex->Find((8 << 16) | 3), -1);
+	EXPECT_EQ(pSnapshot->FindItem(1, 0, pIndex.get()), pSnapshot->FindItem(1, 0));
+	EXPECT_EQ(pSnapshot->FindItem(2, 0, pIndex.get()), nullptr);
+}
+
+TEST(Snapshot, DeltaFullSnapshot)
+{
+	std::mt19937 Rng(91011);
+	char aPastData[CSnapshot::MAX_SIZE];
+	char aCurrentData[CSnapshot::MAX_SIZE];
+	CSnapshot *pPast = (CSnapshot *)aPastData;
+	CSnapshot *pCurrent = (CSnapshot *)aCurrentData;
+
+	// every tenth item only exists in one of the snapshots
+	CSnapshotBuilder Builder;
+	Builder.Init();
+	for(int Id = 0; Id < CSnapshot::MAX_ITEMS; Id++)
+	{
+		int *pItem = (int *)Builder.NewItem(1 + Id % 20, Id + (Id % 10 == 0 ? CSnapshot::MAX_ITEMS : 0), 3 * sizeof(int));
+		ASSERT_TRUE(pItem);
+		for(int i = 0; i < 3; i++)
+			pItem[i] = RandomInt(Rng);
+	}
+	Builder.Finish(pPast);
+	Builder.Init();
+	for(int Id = CSnapshot::MAX_ITEMS - 1; Id >= 0; Id--)
+	{
+		int *pItem = (int *)Builder.NewItem(1 + Id % 20, Id, 3 * sizeof(int));
+		ASSERT_TRUE(pItem);
+		for(int i = 0; i < 3; i++)
+			pItem[i] = RandomInt(Rng);
+	}
+	const int CurrentSize = Builder.Finish(pCurrent);
+
+	std::unique_ptr<CSnapshotDelta> pDelta = std::make_unique<CSnapshotDelta>();
+	char aDeltaData[CSnapshot::MAX_SIZE * 2];
+	const int DeltaSize = pDelta->CreateDelta(pPast, pCurrent, aDeltaData);
+	ASSERT_GT(DeltaSize, 0);
+	EXPECT_EQ(((CSnapshotDelta::CData *)aDeltaData)->m_NumDeletedItems, CSnapshot::MAX_ITEMS / 10 + 1);
+
+	// items from the past snapshot come first in the result, compare by key
+	char aResultData[CSnapshot::MAX_SIZE];
+	CSnapshot *pResult = (CSnapshot *)aResultData;
+	ASSERT_EQ(pDelta->UnpackDelta(pPast, pResult, aDeltaData, DeltaSize, false), CurrentSize);
+	ASSERT_EQ(pResult->NumItems(), pCurrent->NumItems());
+	for(int i = 0; i < pCurrent->NumItems(); i++)
+	{
+		const CSnapshotItem *pItem = pCurrent->GetItem(i);
+		const void *pResultItem = pResult->FindItem(pItem->Type(), pItem->Id());
+		ASSERT_TRUE(pResultItem);
+		EXPECT_EQ(mem_comp(pResultItem, pItem->Data(), pCurrent->GetItemSize(i)), 0);
+	}
+}
+
+TEST(Snapshot, DeltaBenchmark)
+{
+	char aPastData[CSnapshot::MAX_SIZE];
+	char aCurrentData[CSnapshot::MAX_SIZE];
+	CSnapshot *pPast = (CSnapshot *)aPastData;
+	CSnapshot *pCurrent = (CSnapshot *)aCurrentData;
+	ASSERT_GT(BuildGameSnapshot(pPast, 100), 0);
+	ASSERT_GT(BuildGameSnapshot(pCurrent, 101), 0);
+	ASSERT_EQ(pCurrent->NumItems(), CSnapshot::MAX_ITEMS);
+
+	// the key lookups of CreateDelta: every past item in the current
+	// snapshot to find deleted ones, then every current item in the past
+	const int NUM_RUNS = 20;
+	std::vector<int> vLinear(2 * CSnapshot::MAX_ITEMS);
+	std::vector<int> vIndexed(2 * CSnapshot::MAX_ITEMS);
+	const int64_t Start = time_get_nanoseconds().count();
+	for(int Run = 0; Run < NUM_RUNS; Run++)
+	{
+		for(int i = 0; i < pPast->NumItems(); i++)
+			vLinear[i] = pCurrent->GetItemIndex(pPast->GetItem(i)->Key());
+		for(int i = 0; i < pCurrent->NumItems(); i++)
+			vLinear[CSnapshot::MAX_ITEMS + i] = pPast->GetItemIndex(pCurrent->GetItem(i)->Key());
+	}
+	const int64_t Middle = time_get_nanoseconds().count();
+	std::unique_ptr<CSnapshotIndex> pIndex = std::make_unique<CSnapshotIndex>();
+	for(int Run = 0; Run < NUM_RUNS; Run++)
+	{
+		pIndex->Build(pCurrent);
+		for(int i = 0; i < pPast->NumItems(); i++)
+			vIndexed[i] = pIndex->Find(pPast->GetItem(i)->Key());
+		pIndex->Build(pPast);
+		for(int i = 0; i < pCurrent->NumItems(); i++)
+			vIndexed[CSnapshot::MAX_ITEMS + i] = pIndex->Find(pCurrent->GetItem(i)->Key());
+	}
+	const int64_t End = time_get_nanoseconds().count();
+	EXPECT_EQ(vIndexed, vLinear);
+
+	std::unique_ptr<CSnapshotDelta> pDelta = std::make_unique<CSnapshotDelta>();
+	char aDeltaData[CSnapshot::MAX_SIZE * 2];
+	int DeltaSize = 0;
+	const int64_t DeltaStart = time_get_nanoseconds().count();
+	for(int Run = 0; Run < NUM_RUNS; Run++)
+		DeltaSize = pDelta->CreateDelta(pPast, pCurrent, aDeltaData);
+	const int64_t DeltaEnd = time_get_nanoseconds().count();
+	EXPECT_GT(DeltaSize, 0);
+	log_info("snapshot", "the lookups of a delta between full snapshots take %.0f us with linear search and %.0f us with the index, the whole delta takes %.0f us",
+		(Middle - Start) / 1000.0 / NUM_RUNS, (End - Middle) / 1000.0 / NUM_RUNS, (DeltaEnd - DeltaStart) / 1000.0 / NUM_RUNS);
+}
+
+TEST(Snapshot, StorageRecyclesChunks)
+{
+	char aData[CSnapshot::MAX_SIZE];
+	CSnapshotBuilder Builder;
+	Builder.Init();
+	for(int Id = 0; Id < 200; Id++)
+		ASSERT_TRUE(Builder.NewItem(1, Id, 8 * sizeof(int)));
+	const int Size = Builder.Finish(aData);
+
+	// keep a three second window like the server does
+	CSnapshotStorage Storage;
+	int64_t WarmAllocations = 0;
+	for(int Tick = 0; Tick < 2000; Tick++)
+	{
+		Storage.PurgeUntil(Tick - 150);
+		Storage.Add(Tick, Tick, Size, aData, Tick % 2 ? Size : 0, aData);
+		if(Tick == 500)
+			WarmAllocations = Storage.NumAllocations();
+	}
+	EXPECT_GT(WarmAllocations, 0);
+	EXPECT_EQ(Storage.NumAllocations(), WarmAllocations);
+
+	const CSnapshot *pSnap;
+	const CSnapshot *pAltSnap;
+	EXPECT_EQ(Storage.Get(1999, nullptr, &pSnap, &pAltSnap), Size);
+	EXPECT_EQ(mem_comp(pSnap, aData, Size), 0);
+	EXPECT_EQ(mem_comp(pAltSnap, aData, Size), 0);
+	EXPECT_EQ(Storage.m_pLast->m_pAltIndex->Find((1 << 16) | 199), 199);
+	EXPECT_EQ(Storage.Get(1848, nullptr, nullptr, nullptr), -1);
+	EXPECT_EQ(Storage.Get(1850, nullptr, nullptr, &pAltSnap), Size);
+	EXPECT_EQ(pAltSnap, nullptr);
+
+	Storage.PurgeAll();
+	EXPECT_EQ(Storage.m_pFirst, nullptr);
+	Storage.Add(0, 0, Size, aData, 0, nullptr);
+	EXPECT_EQ(Storage.Get(0, nullptr, &pSnap, nullptr), Size);
+}
@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+
+#include <base/log.h>
+#include <base/system.h>
+#include <engine/client/sound_mix.h>
+
+#include <algorithm>
+#include <climits>
+#include <random>
+#include <vector>
+
+static void MixFramesScalar(int *pMix, const short *pIn, int Channels, unsigned Frames, int VolumeL, int VolumeR)
+{
+	for(unsigned i = 0; i < Frames; i++)
+	{
+		pMix[2 * i] += pIn[i * Channels] * VolumeL;
+		pMix[2 * i + 1] += pIn[i * Channels + Channels - 1] * VolumeR;
+	}
+}
+
+static std::vector<short> RandomSamples(std::mt19937 &Rng, size_t Num)
+{
+	std::uniform_int_distribution<int> Dist(SHRT_MIN, SHRT_MAX);
+	std::vector<short> vSamples(Num);
+	for(short &Sample : vSamples)
+		Sample = Dist(Rng);
+	return vSamples;
+}
+
+TEST(SoundMix, MatchesScalar)
+{
+	std::mt19937 Rng(1234);
+	std::uniform_int_distribution<int> VolumeDist(0, 255);
+	for(int Channels = 1; Channels <= 2; Channels++)
+	{
+		// every remainder of the vector widths, starting at odd offsets
+		for(unsigned Frames = 0; Frames < 40; Frames++)
+		{
+			const std::vector<short> vSamples = RandomSamples(Rng, (Frames + 3) * Channels);
+			const int VolumeL = VolumeDist(Rng);
+			const int VolumeR = VolumeDist(Rng);
+			std::vector<int> vExpected(Frames * 2, 7);
+			std::vector<int> vMix(Frames * 2, 7);
+			MixFramesScalar(vExpected.data(), vSamples.data() + 3 * Channels, Channels, Frames, VolumeL, VolumeR);
+			SoundMixFrames(vMix.data(), vSamples.data() + 3 * Channels, Channels, Frames, VolumeL, VolumeR);
+			EXPECT_EQ(vMix, vExpected) << "Channels=" << Channels << " Frames=" << Frames;
+		}
+	}
+}
+
+TEST(SoundMix, LargeVolume)
+{
+	// volumes outside of 16 bit can't use the vector paths
+	const short aSamples[] = {1000, -1000, 32767, -32768, 5, 6, 7, 8, 9, 10};
+	std::vector<int> vExpected(10);
+	std::vector<int> vMix(10);
+	MixFramesScalar(vExpected.data(), aSamples, 2, 5, 40000, 1);
+	SoundMixFrames(vMix.data(), aSamples, 2, 5, 40000, 1);
+	EXPECT_EQ(vMix, vExpected);
+}
+
+TEST(SoundMix, ManyVoices)
+{
+	const unsigned FRAMES = 2048;
+	const int NUM_VOICES = 256;
+	std::mt19937 Rng(5678);
+	std::uniform_int_distribution<int> VolumeDist(0, 255);
+	std::vector<int> vExpected(FRAMES * 2);
+	std::vector<int> vMix(FRAMES * 2);
+	for(int Voice = 0; Voice < NUM_VOICES; Voice++)
+	{
+		const int Channels = 1 + Voice % 2;
+		const std::vector<short> vSamples = RandomSamples(Rng, FRAMES * Channels);
+		const int VolumeL = VolumeDist(Rng);
+		const int VolumeR = VolumeDist(Rng);
+		MixFramesScalar(vExpected.data(), vSamples.data(), Channels, FRAMES, VolumeL, VolumeR);
+		SoundMixFrames(vMix.data(), vSamples.data(), Channels, FRAMES, VolumeL, VolumeR);
+	}
+	ASSERT_EQ(vMix, vExpected);
+
+	std::vector<short> vOut(FRAMES * 2);
+	SoundClipFrames(vOut.data(), vMix.data(), FRAMES, 100);
+	const float Scale = 100 / (101.0f * 256.0f);
+	for(unsigned i = 0; i < FRAMES * 2; i++)
+	{
+		const int Expected = std::clamp<int>(vMix[i] * Scale, SHRT_MIN, SHRT_MAX);
+		ASSERT_EQ(vOut[i], Expected) << "i=" << i;
+	}
+}
+
+TEST(SoundMix, Benchmark)
+{
+	// one mixer callback with all voices playing
+	const unsigned FRAMES = 512;
+	const int NUM_VOICES = 64;
+	const int NUM_RUNS = 200;
+	std::mt19937 Rng(4321);
+	std::vector<std::vector<short>> vvSamples;
+	for(int Voice = 0; Voice < NUM_VOICES; Voice++)
+		vvSamples.push_back(RandomSamples(Rng, FRAMES * (1 + Voice % 2)));
+	std::vector<int> vExpected(FRAMES * 2);
+	std::vector<int> vMix(FRAMES * 2);
+
+	const int64_t Start = time_get_nanoseconds().count();
+	for(int Run = 0; Run < NUM_RUNS; Run++)
+		for(int Voice = 0; Voice < NUM_VOICES; Voice++)
+			MixFramesScalar(vExpected.data(), vvSamples[Voice].data(), 1 + Voice % 2, FRAMES, 100 + Voice, 200 - Voice);
+	const int64_t Middle = time_get_nanoseconds().count();
+	for(int Run = 0; Run < NUM_RUNS; Run++)
+		for(int Voice = 0; Voice < NUM_VOICES; Voice++)
+			SoundMixFrames(vMix.data(), vvSamples[Voice].data(), 1 + Voice % 2, FRAMES, 100 + Voice, 200 - Voice);
+	const int64_t End = time_get_nanoseconds().count();
+	EXPECT_EQ(vMix, vExpected);
+	log_info("sound_mix", "mixing %d voices of %u frames takes %.0f ns with the scalar loop and %.0f ns with SoundMixFrames", NUM_VOICES, FRAMES, (Middle - Start) / (double)NUM_RUNS, (End - Middle) / (double)NUM_RUNS);
+}
+
+TEST(SoundMix, Clip)
+{
+	const int aMix[] = {0, 256 * 101, -256 * 101, 256 * 101 * 40000, -256 * 101 * 40000, INT_MAX, INT_MIN, 12345, -12345, 255};
+	const short aExpected[] = {0, 100, -100, SHRT_MAX, SHRT_MIN, SHRT_MAX, SHRT_MIN, 47, -47, 0};
+	const unsigned Frames = std::size(aMix) / 2;
+	short aOut[std::size(aMix)] = {0};
+	SoundClipFrames(aOut, aMix, Frames, 100);
+	for(unsigned i = 0; i < Frames * 2; i++)
+		EXPECT_EQ(aOut[i], aExpected[i]) << "i=" << i;
+
+	SoundClipFrames(aOut, aMix, Frames, 0);
+	for(unsigned i = 0; i < Frames * 2; i++)
+		EXPECT_EQ(aOut[i], 0) << "i=" << i;
+}
@@ -0,0 +1,423 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <engine/shared/config.h>
+#include <game/gamecore.h>
+#include <game/server/teehistorian.h>
+#include <game/teehistorian_reader.h>
+
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+void RegisterGameUuids(CUuidManager *pManager);
+
+class TeeHistorianReader : public ::testing::Test
+{
+protected:
+	enum
+	{
+		NUM_CLIENTS = 8,
+		NUM_TICKS = 25000,
+		// small segments so that even short recordings have many of them
+		SEGMENT_SIZE = 4 * 1024,
+	};
+
+	CTestInfo m_Info;
+	char m_aIndexFilename[IO_MAX_PATH_LENGTH];
+	char m_aTruncatedFilename[IO_MAX_PATH_LENGTH];
+	char m_aTruncatedIndexFilename[IO_MAX_PATH_LENGTH];
+	CConfig m_Config;
+	CTuningParams m_Tuning;
+	CUuidManager m_UuidManager;
+
+	std::vector<unsigned char> m_vRecording;
+	// last tick that has any records
+	int m_LastTick = 0;
+	// what the reader should output for the whole recording, per client
+	std::string m_aExpectedInputs[NUM_CLIENTS];
+	std::string m_aExpectedPositions[NUM_CLIENTS];
+	std::vector<CTeeHistorianEvent> m_vExpectedEvents;
+
+	TeeHistorianReader()
+	{
+		str_format(m_aIndexFilename, sizeof(m_aIndexFilename), "%s.index", m_Info.m_aFilename);
+		str_format(m_aTruncatedFilename, sizeof(m_aTruncatedFilename), "%s.truncated", m_Info.m_aFilename);
+		str_format(m_aTruncatedIndexFilename, sizeof(m_aTruncatedIndexFilename), "%s.index", m_aTruncatedFilename);
+
+		mem_zero(&m_Config, sizeof(m_Config));
+#define MACRO_CONFIG_INT(Name, ScriptName, Def, Min, Max, Save, Desc) \
+	m_Config.m_##Name = (Def);
+#define MACRO_CONFIG_COL(Name, ScriptName, Def, Save, Desc) MACRO_CONFIG_INT(Name, ScriptName, Def, 0, 0, Save, Desc)
+#define MACRO_CONFIG_STR(Name, ScriptName, Len, Def, Save, Desc) \
+	str_copy(m_Config.m_##Name, (Def), sizeof(m_Config.m_##Name));
+#include <engine/shared/config_variables.h>
+#undef MACRO_CONFIG_STR
+#undef MACRO_CONFIG_COL
+#undef MACRO_CONFIG_INT
+
+		RegisterUuids(&m_UuidManager);
+		RegisterTeehistorianUuids(&m_UuidManager);
+		RegisterGameUuids(&m_UuidManager);
+
+		Generate();
+	}
+
+	~TeeHistorianReader() override
+	{
+		fs_remove(m_Info.m_aFilename);
+		fs_remove(m_aIndexFilename);
+		fs_remove(m_aTruncatedFilename);
+		fs_remove(m_aTruncatedIndexFilename);
+	}
+
+	static void Write(const void *pData, int DataSize, void *pUser)
+	{
+		TeeHistorianReader *pThis = (TeeHistorianReader *)pUser;
+		pThis->m_vRecording.insert(pThis->m_vRecording.end(), (const unsigned char *)pData, (const unsigned char *)pData + DataSize);
+	}
+
+	static void AddInput(std::string *pOut, int Tick, const CNetObj_PlayerInput &Input)
+	{
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\n",
+			Tick, Input.m_Direction, Input.m_TargetX, Input.m_TargetY, Input.m_Jump, Input.m_Fire,
+			Input.m_Hook, Input.m_PlayerFlags, Input.m_WantedWeapon, Input.m_NextWeapon, Input.m_PrevWeapon);
+		*pOut += aBuf;
+	}
+
+	// Records random players that join, move, change their inputs and
+	// leave again, with a few ticks skipped now and then.
+	void Generate()
+	{
+		CTeeHistorian::CGameInfo GameInfo;
+		mem_zero(&GameInfo, sizeof(GameInfo));
+		GameInfo.m_GameUuid = CalculateUuid("test@ddnet.tw");
+		GameInfo.m_pServerVersion = "DDNet test";
+		GameInfo.m_StartTime = time(nullptr);
+		GameInfo.m_pPrngDescription = "test-prng:02468ace";
+		GameInfo.m_pServerName = "server name";
+		GameInfo.m_ServerPort = 8303;
+		GameInfo.m_pGameType = "game type";
+		GameInfo.m_pMapName = "Kobra 3 Solo";
+		GameInfo.m_pConfig = &m_Config;
+		GameInfo.m_pTuning = &m_Tuning;
+		GameInfo.m_pUuids = &m_UuidManager;
+
+		CTeeHistorian TeeHistorian;
+		TeeHistorian.Reset(&GameInfo, Write, this);
+
+		struct CClient
+		{
+			bool m_Connected;
+			bool m_Alive;
+			uint32_t m_UniqueId;
+			bool m_HaveInput;
+			CNetObj_CharacterCore m_Core;
+			CNetObj_PlayerInput m_Input;
+		};
+		CClient aClients[NUM_CLIENTS];
+		mem_zero(aClients, sizeof(aClients));
+		uint32_t NextUniqueId = 1;
+
+		std::mt19937 Rng(1234);
+		std::uniform_int_distribution<int> DistPercent(0, 99);
+		std::uniform_int_distribution<int> DistMove(-64, 64);
+		std::uniform_int_distribution<int> DistValue(-1000, 1000);
+		for(int Tick = 1; Tick <= NUM_TICKS; Tick++)
+		{
+			if(Tick % 500 >= 490)
+			{
+				continue;
+			}
+			TeeHistorian.BeginTick(Tick);
+			TeeHistorian.BeginPlayers();
+			for(int ClientId = 0; ClientId < NUM_CLIENTS; ClientId++)
+			{
+				CClient &Client = aClients[ClientId];
+				const bool WasAlive = Client.m_Alive;
+				const int PrevX = Client.m_Core.m_X;
+				const int PrevY = Client.m_Core.m_Y;
+				if(Client.m_Connected && DistPercent(Rng) < 2)
+				{
+					Client.m_Alive = !Client.m_Alive;
+				}
+				if(Client.m_Alive && DistPercent(Rng) < 70)
+				{
+					Client.m_Core.m_X += DistMove(Rng);
+					Client.m_Core.m_Y += DistMove(Rng);
+				}
+				if(Client.m_Alive)
+				{
+					TeeHistorian.RecordPlayer(ClientId, &Client.m_Core);
+				}
+				else
+				{
+					TeeHistorian.RecordDeadPlayer(ClientId);
+				}
+
+				char aBuf[64];
+				if(Client.m_Alive && (!WasAlive || Client.m_Core.m_X != PrevX || Client.m_Core.m_Y != PrevY))
+				{
+					str_format(aBuf, sizeof(aBuf), "%d\t1\t%d\t%d\n", Tick, Client.m_Core.m_X, Client.m_Core.m_Y);
+					m_aExpectedPositions[ClientId] += aBuf;
+					m_LastTick = Tick;
+				}
+				else if(!Client.m_Alive && WasAlive)
+				{
+					str_format(aBuf, sizeof(aBuf), "%d\t0\t\t\n", Tick);
+					m_aExpectedPositions[ClientId] += aBuf;
+					m_LastTick = Tick;
+				}
+			}
+			TeeHistorian.EndPlayers();
+
+			TeeHistorian.BeginInputs();
+			for(int ClientId = 0; ClientId < NUM_CLIENTS; ClientId++)
+			{
+				CClient &Client = aClients[ClientId];
+				if(!Client.m_Connected && DistPercent(Rng) < 1)
+				{
+					Client.m_Connected = true;
+					Client.m_UniqueId = NextUniqueId++;
+					Client.m_HaveInput = false;
+					TeeHistorian.RecordPlayerJoin(ClientId, CTeeHistorian::PROTOCOL_6);
+					m_vExpectedEvents.push_back({Tick, TEEHISTORIAN_JOIN, ClientId, ""});
+					char aName[16];
+					str_format(aName, sizeof(aName), "tee %u", Client.m_UniqueId);
+					TeeHistorian.RecordPlayerName(ClientId, aName);
+					m_vExpectedEvents.push_back({Tick, TEEHISTORIAN_EX, ClientId, aName});
+					m_LastTick = Tick;
+				}
+				else if(Client.m_Connected && !Client.m_Alive && DistPercent(Rng) < 5)
+				{
+					Client.m_Connected = false;
+					TeeHistorian.RecordPlayerDrop(ClientId, "bye");
+					m_vExpectedEvents.push_back({Tick, TEEHISTORIAN_DROP, ClientId, "bye"});
+					m_LastTick = Tick;
+				}
+				if(Client.m_Connected && (!Client.m_HaveInput || DistPercent(Rng) < 30))
+				{
+					const CNetObj_PlayerInput PrevInput = Client.m_Input;
+					int *pInput = (int *)&Client.m_Input;
+					pInput[DistPercent(Rng) % TEEHISTORIAN_NUM_INPUT_INTS] = DistValue(Rng);
+					TeeHistorian.RecordPlayerInput(ClientId, Client.m_UniqueId, &Client.m_Input);
+					// a new connection always gets a new input record
+					if(!Client.m_HaveInput || mem_comp(&PrevInput, &Client.m_Input, sizeof(PrevInput)) != 0)
+					{
+						AddInput(&m_aExpectedInputs[ClientId], Tick, Client.m_Input);
+						m_LastTick = Tick;
+					}
+					Client.m_HaveInput = true;
+				}
+			}
+			TeeHistorian.EndInputs();
+			TeeHistorian.EndTick();
+		}
+		TeeHistorian.Finish();
+	}
+
+	void WriteRecording(bool Compressed, size_t Size)
+	{
+		IOHANDLE File = io_open(m_Info.m_aFilename, IOFLAG_WRITE);
+		ASSERT_TRUE(File);
+		if(!Compressed)
+		{
+			io_write(File, m_vRecording.data(), Size);
+			io_close(File);
+			return;
+		}
+		ASYNCIO *pAio = aio_new_compressed(File, 6);
+		ASSERT_TRUE(pAio);
+		aio_write(pAio, m_vRecording.data(), Size);
+		aio_close(pAio);
+		aio_wait(pAio);
+		aio_free(pAio);
+	}
+
+	// Copies the start of the written recording to the truncated file.
+	void WriteTruncated(int64_t Size)
+	{
+		IOHANDLE File = io_open(m_Info.m_aFilename, IOFLAG_READ);
+		ASSERT_TRUE(File);
+		void *pData;
+		unsigned DataSize;
+		ASSERT_TRUE(io_read_all(File, &pData, &DataSize));
+		io_close(File);
+		ASSERT_LE(Size, DataSize);
+		File = io_open(m_aTruncatedFilename, IOFLAG_WRITE);
+		ASSERT_TRUE(File);
+		io_write(File, pData, Size);
+		io_close(File);
+		free(pData);
+	}
+
+	static int64_t FileSize(const char *pFilename)
+	{
+		IOHANDLE File = io_open(pFilename, IOFLAG_READ);
+		const int64_t Size = File ? io_length(File) : -1;
+		if(File)
+		{
+			io_close(File);
+		}
+		return Size;
+	}
+
+	static void Output(const char *pData, int DataSize, void *pUser)
+	{
+		((std::string *)pUser)->append(pData, DataSize);
+	}
+
+	static std::string Query(const char *pFilename, const CTeeHistorianIndex &Index, int Type, int ClientId, int FirstTick, int LastTick, int NumThreads)
+	{
+		CTeeHistorianQuery Query;
+		Query.m_Type = Type;
+		Query.m_ClientId = ClientId;
+		Query.m_FirstTick = FirstTick;
+		Query.m_LastTick = LastTick;
+		std::string Result;
+		EXPECT_TRUE(Index.Query(pFilename, Query, NumThreads, Output, &Result));
+		return Result;
+	}
+
+	void ExpectWholeRecording(const CTeeHistorianIndex &Index)
+	{
+		EXPECT_TRUE(Index.m_Finished);
+		EXPECT_EQ(Index.m_LastTick, m_LastTick);
+		ASSERT_EQ(Index.m_vEvents.size(), m_vExpectedEvents.size());
+		for(size_t i = 0; i < m_vExpectedEvents.size(); i++)
+		{
+			EXPECT_EQ(Index.m_vEvents[i].m_Tick, m_vExpectedEvents[i].m_Tick) << i;
+			EXPECT_EQ(Index.m_vEvents[i].m_Type, m_vExpectedEvents[i].m_Type) << i;
+			EXPECT_EQ(Index.m_vEvents[i].m_ClientId, m_vExpectedEvents[i].m_ClientId) << i;
+			EXPECT_EQ(Index.m_vEvents[i].m_String, m_vExpectedEvents[i].m_String) << i;
+		}
+		for(int ClientId = 0; ClientId < NUM_CLIENTS; ClientId++)
+		{
+			EXPECT_EQ(Query(m_Info.m_aFilename, Index, CTeeHistorianQuery::TYPE_INPUTS, ClientId, 0, std::numeric_limits<int>::max(), 4), m_aExpectedInputs[ClientId]) << ClientId;
+			EXPECT_EQ(Query(m_Info.m_aFilename, Index, CTeeHistorianQuery::TYPE_POSITIONS, ClientId, 0, std::numeric_limits<int>::max(), 4), m_aExpectedPositions[ClientId]) << ClientId;
+		}
+	}
+
+	// Random ranges decoded from the nearest segments with several threads
+	// must match decoding the whole file from the start.
+	void ExpectRandomRanges(const char *pFilename, const CTeeHistorianIndex &Index)
+	{
+		CTeeHistorianIndex FullScan;
+		ASSERT_TRUE(FullScan.Build(pFilename, std::numeric_limits<int>::max()));
+		ASSERT_EQ(FullScan.m_vSegments.size(), 1u);
+
+		std::mt19937 Rng(5678);
+		std::uniform_int_distribution<int> DistTick(0, Index.m_LastTick + 10);
+		std::uniform_int_distribution<int> DistClient(0, NUM_CLIENTS - 1);
+		for(int i = 0; i < 100; i++)
+		{
+			int FirstTick = DistTick(Rng);
+			int QueryLastTick = DistTick(Rng);
+			if(FirstTick > QueryLastTick)
+			{
+				std::swap(FirstTick, QueryLastTick);
+			}
+			const int Type = i % 2 ? CTeeHistorianQuery::TYPE_POSITIONS : CTeeHistorianQuery::TYPE_INPUTS;
+			const int ClientId = DistClient(Rng);
+			ASSERT_EQ(Query(pFilename, Index, Type, ClientId, FirstTick, QueryLastTick, 4), Query(pFilename, FullScan, Type, ClientId, FirstTick, QueryLastTick, 1))
+				<< "type=" << Type << " cid=" << ClientId << " ticks=" << FirstTick << "-" << QueryLastTick;
+		}
+	}
+
+	void RoundTrip(bool Compressed)
+	{
+		WriteRecording(Compressed, m_vRecording.size());
+
+		CTeeHistorianIndex Index;
+		ASSERT_TRUE(Index.Build(m_Info.m_aFilename, SEGMENT_SIZE));
+		EXPECT_EQ(Index.m_Compressed, Compressed);
+		EXPECT_GT(Index.m_vSegments.size(), 4u);
+		ExpectWholeRecording(Index);
+		ExpectRandomRanges(m_Info.m_aFilename, Index);
+
+		// the same again with the index read back from the file
+		ASSERT_TRUE(Index.Save(m_aIndexFilename));
+		CTeeHistorianIndex Loaded;
+		ASSERT_TRUE(Loaded.Load(m_aIndexFilename, FileSize(m_Info.m_aFilename)));
+		EXPECT_EQ(Loaded.m_vSegments.size(), Index.m_vSegments.size());
+		EXPECT_EQ(Loaded.m_vAccessPoints.size(), Index.m_vAccessPoints.size());
+		EXPECT_EQ(Loaded.m_Header, Index.m_Header);
+		ExpectWholeRecording(Loaded);
+		ExpectRandomRanges(m_Info.m_aFilename, Loaded);
+	}
+
+	void TruncatedFiles(bool Compressed)
+	{
+		WriteRecording(Compressed, m_vRecording.size());
+		CTeeHistorianIndex Full;
+		ASSERT_TRUE(Full.Build(m_Info.m_aFilename, SEGMENT_SIZE));
+		const int64_t Size = FileSize(m_Info.m_aFilename);
+
+		for(int Percent : {20, 50, 90, 99})
+		{
+			WriteTruncated(Size * Percent / 100);
+			CTeeHistorianIndex Index;
+			ASSERT_TRUE(Index.Build(m_aTruncatedFilename, SEGMENT_SIZE)) << Percent;
+			EXPECT_FALSE(Index.m_Finished);
+			EXPECT_GT(Index.m_LastTick, 0);
+			EXPECT_LT(Index.m_LastTick, m_LastTick);
+
+			// the last tick might be cut off in the middle
+			const int LastTick = Index.m_LastTick - 1;
+			for(int ClientId = 0; ClientId < NUM_CLIENTS; ClientId++)
+			{
+				for(int Type : {CTeeHistorianQuery::TYPE_INPUTS, CTeeHistorianQuery::TYPE_POSITIONS})
+				{
+					EXPECT_EQ(Query(m_aTruncatedFilename, Index, Type, ClientId, 0, LastTick, 4), Query(m_Info.m_aFilename, Full, Type, ClientId, 0, LastTick, 1))
+						<< Percent << " " << ClientId;
+				}
+			}
+			ExpectRandomRanges(m_aTruncatedFilename, Index);
+		}
+	}
+};
+
+TEST_F(TeeHistorianReader, RoundTrip)
+{
+	RoundTrip(false);
+}
+
+TEST_F(TeeHistorianReader, RoundTripCompressed)
+{
+	RoundTrip(true);
+}
+
+TEST_F(TeeHistorianReader, Truncated)
+{
+	TruncatedFiles(false);
+}
+
+TEST_F(TeeHistorianReader, TruncatedCompressed)
+{
+	TruncatedFiles(true);
+}
+
+TEST_F(TeeHistorianReader, IndexRebuiltOnSizeChange)
+{
+	// a recording that is still being written
+	WriteRecording(false, m_vRecording.size() / 2);
+	CTeeHistorianIndex Partial;
+	ASSERT_TRUE(Partial.Open(m_Info.m_aFilename));
+	EXPECT_FALSE(Partial.m_Finished);
+	const int64_t PartialSize = FileSize(m_Info.m_aFilename);
+	CTeeHistorianIndex Loaded;
+	EXPECT_TRUE(Loaded.Load(m_aIndexFilename, PartialSize));
+	EXPECT_EQ(Loaded.m_LastTick, Partial.m_LastTick);
+
+	WriteRecording(false, m_vRecording.size());
+	CTeeHistorianIndex Stale;
+	EXPECT_FALSE(Stale.Load(m_aIndexFilename, FileSize(m_Info.m_aFilename)));
+	CTeeHistorianIndex Index;
+	ASSERT_TRUE(Index.Open(m_Info.m_aFilename));
+	ExpectWholeRecording(Index);
+	CTeeHistorianIndex Rebuilt;
+	EXPECT_TRUE(Rebuilt.Load(m_aIndexFilename, FileSize(m_Info.m_aFilename)));
+	EXPECT_EQ(Rebuilt.m_LastTick, m_LastTick);
+}
@@ -11,7 +11,7 @@ bool Process(IStorage *pStorage, const char **pMapNames)
 
 	for(int i = 0; i < 2; ++i)
 	{
-		if(!aMaps[i].Open(pStorage, pMapNames[i], IStorage::TYPE_ABSOLUTE))
+		if(!aMaps[i].Open(pStorage, pMapNames[i], IStorage::TYPE_ABSOLUTE, true))
 		{
 			dbg_msg("map_compare", "error opening map '%s'", pMapNames[i]);
 			return false;
@@ -107,7 +107,7 @@ static void ExtractMapSounds(CDataFileReader &Reader, const char *pPathSave)
 static bool ExtractMap(IStorage *pStorage, const char *pMapName, const char *pPathSave)
 {
 	CDataFileReader Reader;
-	if(!Reader.Open(pStorage, pMapName, IStorage::TYPE_ABSOLUTE))
+	if(!Reader.Open(pStorage, pMapName, IStorage::TYPE_ABSOLUTE, true))
 	{
 		log_error("map_extract", "error opening map '%s'", pMapName);
 		return false;
@@ -22,7 +22,7 @@ bool OpenMap(const char pMapName[64], CDataFileReader &InputMap)
 		return false;
 	}
 
-	if(!InputMap.Open(pStorage.get(), pMapName, IStorage::TYPE_ABSOLUTE))
+	if(!InputMap.Open(pStorage.get(), pMapName, IStorage::TYPE_ABSOLUTE, true))
 	{
 		dbg_msg("map_find_env", "ERROR: unable to open map '%s'", pMapName);
 		return false;
@@ -12,7 +12,7 @@ static int TestMap(const char *pMap, bool CalcHashes, IStorage *pStorage)
 	log_info(TOOL_NAME, "Testing map '%s'...", pMap);
 
 	CDataFileReader Reader;
-	if(!Reader.Open(pStorage, pMap, IStorage::TYPE_ABSOLUTE))
+	if(!Reader.Open(pStorage, pMap, IStorage::TYPE_ABSOLUTE, true))
 	{
 		log_error(TOOL_NAME, "Failed to open map '%s' for reading", pMap);
 		return -1;
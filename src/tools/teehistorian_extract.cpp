@@ -0,0 +1,120 @@
+#include <base/logger.h>
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/external/json-parser/json.h>
+#include <engine/shared/json.h>
+
+#include <game/teehistorian_reader.h>
+
+#include <limits>
+#include <thread>
+
+static const char *TOOL_NAME = "teehistorian_extract";
+
+enum
+{
+	MAX_DECODE_THREADS = 8,
+};
+
+static void PrintInfo(const char *pFilename, const CTeeHistorianIndex &Index)
+{
+	printf("file: %s\n", pFilename);
+	printf("compressed: %s\n", Index.m_Compressed ? "yes" : "no");
+	json_value *pJson = json_parse(Index.m_Header.c_str(), Index.m_Header.size());
+	if(pJson)
+	{
+		static const char *const s_apFields[] = {"game_uuid", "server_version", "start_time", "server_name", "game_type", "map_name", "map_sha256"};
+		for(const char *pField : s_apFields)
+		{
+			const json_value *pValue = json_object_get(pJson, pField);
+			if(pValue != &json_value_none && pValue->type == json_string)
+			{
+				printf("%s: %s\n", pField, json_string_get(pValue));
+			}
+		}
+		json_value_free(pJson);
+	}
+	printf("ticks: 0 - %d\n", Index.m_LastTick);
+	printf("finished: %s\n", Index.m_Finished ? "yes" : "no");
+	printf("segments: %d\n", (int)Index.m_vSegments.size());
+}
+
+static void PrintPlayers(const CTeeHistorianIndex &Index)
+{
+	printf("tick\tevent\tcid\tdetails\n");
+	for(const CTeeHistorianEvent &Event : Index.m_vEvents)
+	{
+		const char *pEvent = Event.m_Type == TEEHISTORIAN_JOIN ? "join" : Event.m_Type == TEEHISTORIAN_DROP ? "drop" : "name";
+		printf("%d\t%s\t%d\t%s\n", Event.m_Tick, pEvent, Event.m_ClientId, Event.m_String.c_str());
+	}
+}
+
+static void PrintOutput(const char *pData, int DataSize, void *pUser)
+{
+	fwrite(pData, 1, DataSize, stdout);
+}
+
+static bool RunQuery(const char *pFilename, const CTeeHistorianIndex &Index, const CTeeHistorianQuery &Query)
+{
+	if(Query.m_Type == CTeeHistorianQuery::TYPE_INPUTS)
+	{
+		printf("tick\tdirection\ttarget_x\ttarget_y\tjump\tfire\thook\tplayer_flags\twanted_weapon\tnext_weapon\tprev_weapon\n");
+	}
+	else
+	{
+		printf("tick\talive\tx\ty\n");
+	}
+	const int NumThreads = clamp<int>(std::thread::hardware_concurrency(), 1, MAX_DECODE_THREADS);
+	return Index.Query(pFilename, Query, NumThreads, PrintOutput, nullptr);
+}
+
+int main(int argc, const char *argv[])
+{
+	CCmdlineFix CmdlineFix(&argc, &argv);
+	log_set_global_logger_default();
+
+	const char *pCommand = argc >= 3 ? argv[2] : "";
+	const bool QueryCommand = str_comp(pCommand, "inputs") == 0 || str_comp(pCommand, "positions") == 0;
+	if(!(argc == 3 && (str_comp(pCommand, "info") == 0 || str_comp(pCommand, "players") == 0)) && !(QueryCommand && argc >= 4 && argc <= 6))
+	{
+		log_error(TOOL_NAME, "Usage: %s <teehistorian_file> info", TOOL_NAME);
+		log_error(TOOL_NAME, "       %s <teehistorian_file> players", TOOL_NAME);
+		log_error(TOOL_NAME, "       %s <teehistorian_file> inputs|positions <client_id> [<first_tick> [<last_tick>]]", TOOL_NAME);
+		return -1;
+	}
+
+	const char *pFilename = argv[1];
+	CTeeHistorianQuery Query;
+	if(QueryCommand)
+	{
+		Query.m_Type = str_comp(pCommand, "inputs") == 0 ? CTeeHistorianQuery::TYPE_INPUTS : CTeeHistorianQuery::TYPE_POSITIONS;
+		Query.m_FirstTick = 0;
+		Query.m_LastTick = std::numeric_limits<int>::max();
+		if(!str_toint(argv[3], &Query.m_ClientId) || Query.m_ClientId < 0 || Query.m_ClientId >= MAX_CLIENTS ||
+			(argc >= 5 && !str_toint(argv[4], &Query.m_FirstTick)) ||
+			(argc >= 6 && !str_toint(argv[5], &Query.m_LastTick)))
+		{
+			log_error(TOOL_NAME, "invalid client id or tick");
+			return -1;
+		}
+	}
+
+	CTeeHistorianIndex Index;
+	if(!Index.Open(pFilename))
+	{
+		return -1;
+	}
+
+	if(str_comp(pCommand, "info") == 0)
+	{
+		PrintInfo(pFilename, Index);
+		return 0;
+	}
+	if(str_comp(pCommand, "players") == 0)
+	{
+		PrintPlayers(Index);
+		return 0;
+	}
+	return RunQuery(pFilename, Index, Query) ? 0 : -1;
+}